@@ -1561,7 +1561,9 @@ write_mir (CamelDB *cdb,
 
 	sqlite3_free (ins_query);
 
-	if (ret == 0) {
+	/* Summaries don't load the body structure back, so
+	 * don't let a missing one overwrite what is stored. */
+	if (ret == 0 && record->bodystructure != NULL) {
 		ins_query = sqlite3_mprintf (
 			"INSERT OR REPLACE INTO "
 			"'%q_bodystructure' VALUES (%Q, %Q )",
@@ -1784,6 +1786,91 @@ camel_db_read_message_info_records (CamelDB *cdb,
 	return (ret);
 }
 
+/**
+ * camel_db_write_bodystructure:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of the folder
+ * @uid: the message UID
+ * @bodystructure: the message's body structure
+ * @error: return location for a #GError, or %NULL
+ *
+ * Stores the body structure of a message, in whatever form the
+ * provider uses, so it can be had without asking the server again.
+ *
+ * Returns: 0 on success, -1 on error
+ *
+ * Since: 3.8
+ **/
+gint
+camel_db_write_bodystructure (CamelDB *cdb,
+                              const gchar *folder_name,
+                              const gchar *uid,
+                              const gchar *bodystructure,
+                              GError **error)
+{
+	gchar *query;
+	gint ret;
+
+	query = sqlite3_mprintf (
+		"INSERT OR REPLACE INTO '%q_bodystructure' VALUES (%Q, %Q)",
+		folder_name, uid, bodystructure);
+	ret = camel_db_command (cdb, query, error);
+	sqlite3_free (query);
+
+	return ret;
+}
+
+static gint
+read_bodystructure_callback (gpointer ref,
+                             gint ncol,
+                             gchar **cols,
+                             gchar **name)
+{
+	gchar **bodystructure = ref;
+
+	g_return_val_if_fail (ncol == 1, 0);
+
+	g_free (*bodystructure);
+	*bodystructure = g_strdup (cols[0]);
+
+	return 0;
+}
+
+/**
+ * camel_db_read_bodystructure:
+ * @cdb: a #CamelDB
+ * @folder_name: full name of the folder
+ * @uid: the message UID
+ * @error: return location for a #GError, or %NULL
+ *
+ * Reads back a body structure stored with camel_db_write_bodystructure().
+ *
+ * Returns: the body structure, or %NULL if none is stored.
+ * Free it with g_free().
+ *
+ * Since: 3.8
+ **/
+gchar *
+camel_db_read_bodystructure (CamelDB *cdb,
+                             const gchar *folder_name,
+                             const gchar *uid,
+                             GError **error)
+{
+	gchar *query;
+	gchar *bodystructure = NULL;
+
+	query = sqlite3_mprintf (
+		"SELECT bodystructure FROM '%q_bodystructure' WHERE uid = %Q",
+		folder_name, uid);
+	if (camel_db_select (cdb, query, read_bodystructure_callback, &bodystructure, error) != 0) {
+		g_free (bodystructure);
+		bodystructure = NULL;
+	}
+	sqlite3_free (query);
+
+	return bodystructure;
+}
+
 /**
  * camel_db_create_deleted_table:
  *
@@ -286,6 +286,8 @@ gint camel_db_write_message_info_record (CamelDB *cdb, const gchar *folder_name,
 gint camel_db_write_fresh_message_info_record (CamelDB *cdb, const gchar *folder_name, CamelMIRecord *record, GError **error);
 gint camel_db_read_message_info_records (CamelDB *cdb, const gchar *folder_name, gpointer p, CamelDBSelectCB read_mir_callback, GError **error);
 gint camel_db_read_message_info_record_with_uid (CamelDB *cdb, const gchar *folder_name, const gchar *uid, gpointer p, CamelDBSelectCB read_mir_callback, GError **error);
+gint camel_db_write_bodystructure (CamelDB *cdb, const gchar *folder_name, const gchar *uid, const gchar *bodystructure, GError **error);
+gchar * camel_db_read_bodystructure (CamelDB *cdb, const gchar *folder_name, const gchar *uid, GError **error);
 
 gint camel_db_count_junk_message_info (CamelDB *cdb, const gchar *table_name, guint32 *count, GError **error);
 gint camel_db_count_unread_message_info (CamelDB *cdb, const gchar *table_name, guint32 *count, GError **error);
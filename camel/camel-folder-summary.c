@@ -3603,31 +3603,33 @@ content_info_new_from_message (CamelFolderSummary *summary,
 	return ci;
 }
 
-static gchar *
+/* Formats the address list into @buffer, which the caller reuses
+ * between headers; the result is only valid until the next call. */
+static const gchar *
 summary_format_address (struct _camel_header_raw *h,
                         const gchar *name,
-                        const gchar *charset)
+                        const gchar *charset,
+                        GString *buffer)
 {
-	struct _camel_header_address *addr;
-	gchar *text, *str;
+	const gchar *text;
+	gchar *unfolded = NULL;
 
-	if (!(text = (gchar *) camel_header_raw_find (&h, name, NULL)))
+	if (!(text = camel_header_raw_find (&h, name, NULL)))
 		return NULL;
 
 	while (isspace ((unsigned) *text))
 		text++;
 
-	text = camel_header_unfold (text);
+	if (strchr (text, '\n'))
+		text = unfolded = camel_header_unfold (text);
 
-	if ((addr = camel_header_address_decode (text, charset))) {
-		str = camel_header_address_list_format (addr);
-		camel_header_address_list_clear (&addr);
-		g_free (text);
-	} else {
-		str = text;
-	}
+	g_string_truncate (buffer, 0);
+	if (!camel_header_address_list_format_append (buffer, text, charset))
+		g_string_append (buffer, text);
 
-	return str;
+	g_free (unfolded);
+
+	return buffer->str;
 }
 
 static gchar *
@@ -3680,8 +3682,10 @@ message_info_new_from_header (CamelFolderSummary *summary,
 {
 	const gchar *received, *date, *content, *charset = NULL;
 	struct _camel_header_references *refs, *irt, *scan;
-	gchar *subject, *from, *to, *cc, *mlist;
+	gchar *subject, *mlist;
+	const gchar *from, *to, *cc;
 	CamelContentType *ct = NULL;
+	GString *buffer;
 	CamelMessageInfoBase *mi;
 	guint8 *digest;
 	gsize length;
@@ -3701,19 +3705,25 @@ message_info_new_from_header (CamelFolderSummary *summary,
 
 	charset = charset ? camel_iconv_charset_name (charset) : NULL;
 
+	/* the pool copies the formatted address lists only when it
+	 * has not seen them yet, common with mailing list traffic */
+	buffer = g_string_sized_new (256);
+
 	subject = summary_format_string (h, "subject", charset);
-	from = summary_format_address (h, "from", charset);
-	to = summary_format_address (h, "to", charset);
-	cc = summary_format_address (h, "cc", charset);
+	from = summary_format_address (h, "from", charset, buffer);
+	mi->from = camel_pstring_add ((gchar *) from, FALSE);
+	to = summary_format_address (h, "to", charset, buffer);
+	mi->to = camel_pstring_add ((gchar *) to, FALSE);
+	cc = summary_format_address (h, "cc", charset, buffer);
+	mi->cc = camel_pstring_add ((gchar *) cc, FALSE);
 	mlist = camel_header_raw_check_mailing_list (&h);
 
+	g_string_free (buffer, TRUE);
+
 	if (ct)
 		camel_content_type_unref (ct);
 
 	mi->subject = camel_pstring_add (subject, TRUE);
-	mi->from = camel_pstring_add (from, TRUE);
-	mi->to = camel_pstring_add (to, TRUE);
-	mi->cc = camel_pstring_add (cc, TRUE);
 	mi->mlist = camel_pstring_add (mlist, TRUE);
 
 	mi->user_flags = NULL;
@@ -62,6 +62,30 @@ static GQueue iconv_cache_list = G_QUEUE_INIT;
 static GHashTable *iconv_cache;
 static GHashTable *iconv_cache_open;
 
+/* Each thread keeps a handful of converters of its own, so that the
+ * common open/convert/close cycle done while decoding headers and text
+ * parts does not have to go through the global lock at all.  Nodes are
+ * only ever marked busy by their owning thread; they may be released
+ * by any thread, in which case the release goes through the lock and
+ * iconv_pool_open. */
+struct _iconv_pool_node {
+	struct _iconv_pool *pool;	/* NULL once the owning thread is gone */
+	volatile gint busy;
+	iconv_t ip;
+};
+
+struct _iconv_pool {
+	GHashTable *convs;	/* "to%from" -> GSList of pool nodes */
+	GHashTable *open;	/* iconv_t -> pool node */
+};
+
+#define E_ICONV_POOL_SIZE (8)
+
+static GHashTable *iconv_pool_open;	/* iconv_t -> pool node, all threads */
+
+static void iconv_pool_free (gpointer data);
+static GPrivate iconv_pool = G_PRIVATE_INIT (iconv_pool_free);
+
 static GHashTable *iconv_charsets = NULL;
 static gchar *locale_charset = NULL;
 static gchar *locale_lang = NULL;
@@ -218,6 +242,7 @@ iconv_init (gint keep)
 
 	iconv_cache = g_hash_table_new (g_str_hash, g_str_equal);
 	iconv_cache_open = g_hash_table_new (NULL, NULL);
+	iconv_pool_open = g_hash_table_new (NULL, NULL);
 
 #ifndef G_OS_WIN32
 	locale = setlocale (LC_ALL, NULL);
@@ -372,6 +397,133 @@ flush_entry (struct _iconv_cache *ic)
 	g_free (ic);
 }
 
+static void
+iconv_reset (iconv_t ip)
+{
+	/* work around some broken iconv implementations
+	 * that die if the length arguments are NULL
+	 */
+	gsize buggy_iconv_len = 0;
+	gchar *buggy_iconv_buf = NULL;
+
+	iconv (ip, &buggy_iconv_buf, &buggy_iconv_len, &buggy_iconv_buf, &buggy_iconv_len);
+}
+
+static void
+iconv_pool_free (gpointer data)
+{
+	struct _iconv_pool *pool = data;
+	struct _iconv_pool_node *pn;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	G_LOCK (iconv);
+
+	g_hash_table_iter_init (&iter, pool->open);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		pn = value;
+
+		if (pn->busy) {
+			/* still in use somewhere, camel_iconv_close ()
+			 * will close it once it gets released */
+			pn->pool = NULL;
+		} else {
+			g_hash_table_remove (iconv_pool_open, pn->ip);
+			iconv_close (pn->ip);
+			g_free (pn);
+		}
+	}
+
+	G_UNLOCK (iconv);
+
+	g_hash_table_iter_init (&iter, pool->convs);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_slist_free (value);
+
+	g_hash_table_destroy (pool->convs);
+	g_hash_table_destroy (pool->open);
+	g_free (pool);
+}
+
+static struct _iconv_pool *
+iconv_pool_get (void)
+{
+	struct _iconv_pool *pool;
+
+	pool = g_private_get (&iconv_pool);
+	if (pool == NULL) {
+		pool = g_malloc (sizeof (*pool));
+		pool->convs = g_hash_table_new_full (
+			g_str_hash, g_str_equal,
+			(GDestroyNotify) g_free, NULL);
+		pool->open = g_hash_table_new (NULL, NULL);
+		g_private_set (&iconv_pool, pool);
+	}
+
+	return pool;
+}
+
+/* Called without the lock held, only ever touches the pool
+ * of the calling thread. */
+static iconv_t
+iconv_pool_lookup (struct _iconv_pool *pool,
+                   const gchar *tofrom)
+{
+	struct _iconv_pool_node *pn;
+	GSList *link;
+
+	link = g_hash_table_lookup (pool->convs, tofrom);
+	for (; link != NULL; link = g_slist_next (link)) {
+		pn = link->data;
+
+		if (!g_atomic_int_get (&pn->busy)) {
+			cd (printf ("using pooled iconv converter '%s'\n", tofrom));
+			iconv_reset (pn->ip);
+			g_atomic_int_set (&pn->busy, TRUE);
+			return pn->ip;
+		}
+	}
+
+	return (iconv_t) -1;
+}
+
+static iconv_t
+iconv_pool_add (struct _iconv_pool *pool,
+                const gchar *tofrom,
+                const gchar *to,
+                const gchar *from)
+{
+	struct _iconv_pool_node *pn;
+	GSList *list;
+	iconv_t ip;
+
+	if (g_hash_table_size (pool->open) >= E_ICONV_POOL_SIZE)
+		return (iconv_t) -1;
+
+	ip = iconv_open (to, from);
+	if (ip == (iconv_t) -1)
+		return ip;
+
+	cd (printf ("creating pooled iconv converter '%s'\n", tofrom));
+
+	pn = g_malloc (sizeof (*pn));
+	pn->pool = pool;
+	pn->busy = TRUE;
+	pn->ip = ip;
+
+	list = g_hash_table_lookup (pool->convs, tofrom);
+	g_hash_table_insert (
+		pool->convs, g_strdup (tofrom),
+		g_slist_prepend (list, pn));
+	g_hash_table_insert (pool->open, ip, pn);
+
+	G_LOCK (iconv);
+	g_hash_table_insert (iconv_pool_open, ip, pn);
+	G_UNLOCK (iconv);
+
+	return ip;
+}
+
 /* This should run pretty quick, its called a lot */
 iconv_t
 camel_iconv_open (const gchar *oto,
@@ -379,6 +531,7 @@ camel_iconv_open (const gchar *oto,
 {
 	const gchar *to, *from;
 	gchar *tofrom;
+	struct _iconv_pool *pool;
 	struct _iconv_cache *ic;
 	struct _iconv_cache_node *in;
 	gint errnosav;
@@ -389,8 +542,24 @@ camel_iconv_open (const gchar *oto,
 		return (iconv_t) -1;
 	}
 
+	/* The per-thread pool is keyed on the names as given, which
+	 * lets us skip the charset name canonicalisation (and its
+	 * lock) entirely when we already have a spare converter. */
+	pool = iconv_pool_get ();
+	tofrom = g_alloca (strlen (oto) + strlen (ofrom) + 2);
+	sprintf (tofrom, "%s%%%s", oto, ofrom);
+
+	ip = iconv_pool_lookup (pool, tofrom);
+	if (ip != (iconv_t) -1)
+		return ip;
+
 	to = camel_iconv_charset_name (oto);
 	from = camel_iconv_charset_name (ofrom);
+
+	ip = iconv_pool_add (pool, tofrom, to, from);
+	if (ip != (iconv_t) -1)
+		return ip;
+
 	tofrom = g_alloca (strlen (to) + strlen (from) + 2);
 	sprintf (tofrom, "%s%%%s", to, from);
 
@@ -436,14 +605,8 @@ camel_iconv_open (const gchar *oto,
 		cd (printf ("using existing iconv converter '%s'\n", ic->conv));
 		ip = in->ip;
 		if (ip != (iconv_t) - 1) {
-			/* work around some broken iconv implementations
-			 * that die if the length arguments are NULL
-			 */
-			gsize buggy_iconv_len = 0;
-			gchar *buggy_iconv_buf = NULL;
-
 			/* resets the converter */
-			iconv (ip, &buggy_iconv_buf, &buggy_iconv_len, &buggy_iconv_buf, &buggy_iconv_len);
+			iconv_reset (ip);
 			in->busy = TRUE;
 			g_queue_remove (&ic->open, in);
 			g_queue_push_head (&ic->open, in);
@@ -485,17 +648,36 @@ void
 camel_iconv_close (iconv_t ip)
 {
 	struct _iconv_cache_node *in;
+	struct _iconv_pool_node *pn;
+	struct _iconv_pool *pool;
 
 	if (ip == (iconv_t) - 1)
 		return;
 
+	/* fast path, the converter came from our own pool */
+	pool = g_private_get (&iconv_pool);
+	if (pool != NULL && (pn = g_hash_table_lookup (pool->open, ip)) != NULL) {
+		g_atomic_int_set (&pn->busy, FALSE);
+		return;
+	}
+
 	G_LOCK (iconv);
 	in = g_hash_table_lookup (iconv_cache_open, ip);
+	pn = in ? NULL : g_hash_table_lookup (iconv_pool_open, ip);
 	if (in) {
 		cd (printf ("closing iconv converter '%s'\n", in->parent->conv));
 		g_queue_remove (&in->parent->open, in);
 		in->busy = FALSE;
 		g_queue_push_tail (&in->parent->open, in);
+	} else if (pn) {
+		/* pooled by another thread, hand it back to it */
+		if (pn->pool != NULL) {
+			g_atomic_int_set (&pn->busy, FALSE);
+		} else {
+			g_hash_table_remove (iconv_pool_open, ip);
+			iconv_close (ip);
+			g_free (pn);
+		}
 	} else {
 		g_warning ("trying to close iconv i dont know about: %p", ip);
 		iconv_close (ip);
@@ -503,6 +685,59 @@ camel_iconv_close (iconv_t ip)
 	G_UNLOCK (iconv);
 }
 
+/* charsets (as returned by camel_iconv_charset_name()) in which every
+ * byte below 0x80 always stands for the same US-ASCII character, so
+ * that pure 7-bit text in them needs no conversion to UTF-8 */
+static const gchar *ascii_compatible_charsets[] = {
+	"utf-8",
+	"utf8",
+	"us-ascii",
+	"ascii",
+	"ansi_x3.4",
+	"iso-8859-",
+	"iso8859-",
+	"cp125",
+	"koi8-",
+	"euc",
+	"gb2312",
+	"gbk",
+	"gb18030",
+	"big5",
+	"tis-620"
+};
+
+/**
+ * camel_iconv_charset_is_ascii_compatible:
+ * @charset: a charset name
+ *
+ * Checks whether @charset is a stateless superset of US-ASCII, where
+ * text consisting only of 7-bit bytes reads the same as UTF-8.  Note
+ * that Shift-JIS, UTF-7 and the ISO-2022 family are deliberately not
+ * considered compatible.
+ *
+ * Returns: %TRUE if 7-bit text in @charset can be used as UTF-8 as is
+ *
+ * Since: 3.8
+ **/
+gboolean
+camel_iconv_charset_is_ascii_compatible (const gchar *charset)
+{
+	gint i;
+
+	if (charset == NULL)
+		return FALSE;
+
+	charset = camel_iconv_charset_name (charset);
+	for (i = 0; i < G_N_ELEMENTS (ascii_compatible_charsets); i++) {
+		const gchar *name = ascii_compatible_charsets[i];
+
+		if (!g_ascii_strncasecmp (charset, name, strlen (name)))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 const gchar *
 camel_iconv_locale_charset (void)
 {
@@ -38,6 +38,8 @@ const gchar *	camel_iconv_locale_language	(void);
 
 const gchar *	camel_iconv_charset_name	(const gchar *charset);
 const gchar *	camel_iconv_charset_language	(const gchar *charset);
+gboolean	camel_iconv_charset_is_ascii_compatible
+						(const gchar *charset);
 
 iconv_t		camel_iconv_open		(const gchar *to,
 						 const gchar *from);
@@ -85,6 +85,11 @@ struct _CamelIMAPXCommand {
 
 	guint32 tag;
 
+	/* Monotonic times the command was queued and sent,
+	 * for the imapx:stats counters. */
+	gint64 queued_time;
+	gint64 sent_time;
+
 	GQueue parts;
 	GList *current_part;
 
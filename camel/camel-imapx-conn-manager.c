@@ -47,8 +47,35 @@ struct _CamelIMAPXConnManagerPrivate {
 	GList *connections;
 	gpointer store;  /* weak pointer */
 	GRWLock rw_lock;
+
+	/* Counters of connections that have gone away */
+	IMAPXServerStats *closed_stats;
+
+	/* Held while a message download is looked up on all the
+	 * connections and queued if there is none yet. */
+	GMutex fetch_lock;
+
+	/* The connection with NOTIFY enabled, only compared
+	 * against, never dereferenced.  Guarded by notify_lock. */
+	gpointer notify_server;
+	/* Whether NOTIFY SET went through on it, and for
+	 * subscribed folders only rather than all personal ones */
+	gboolean notify_active;
+	gboolean notify_subscribed_only;
+	/* The folder selected there, whose changes come as
+	 * EXISTS and FETCH rather than as NOTIFY events */
+	gchar *notify_selected;
+	/* Folder path -> IMAPXNotifyState, see
+	 * camel_imapx_conn_manager_begin_notify_refresh() */
+	GHashTable *notify_folders;
+	GMutex notify_lock;
 };
 
+typedef enum {
+	IMAPX_NOTIFY_REFRESHING = 1,
+	IMAPX_NOTIFY_QUIET
+} IMAPXNotifyState;
+
 struct _ConnectionInfo {
 	GMutex lock;
 	CamelIMAPXServer *is;
@@ -153,6 +180,21 @@ connection_info_is_available (ConnectionInfo *cinfo)
 	return available;
 }
 
+static gboolean
+connection_info_has_bulk_work (ConnectionInfo *cinfo)
+{
+	IMAPXJobQueueInfo *jinfo;
+	gboolean busy;
+
+	g_return_val_if_fail (cinfo != NULL, FALSE);
+
+	jinfo = camel_imapx_server_get_job_queue_info (cinfo->is);
+	busy = (jinfo->latency[IMAPX_JOB_KIND_BULK].pending > 0);
+	camel_imapx_destroy_job_queue_info (jinfo);
+
+	return busy;
+}
+
 static gboolean
 connection_info_has_folder_name (ConnectionInfo *cinfo,
                                  const gchar *folder_name)
@@ -385,6 +427,13 @@ imapx_conn_manager_finalize (GObject *object)
 	priv = CAMEL_IMAPX_CONN_MANAGER_GET_PRIVATE (object);
 
 	g_rw_lock_clear (&priv->rw_lock);
+	g_mutex_clear (&priv->fetch_lock);
+	g_mutex_clear (&priv->notify_lock);
+
+	g_free (priv->notify_selected);
+	g_hash_table_destroy (priv->notify_folders);
+
+	camel_imapx_stats_free (priv->closed_stats);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_imapx_conn_manager_parent_class)->finalize (object);
@@ -422,10 +471,47 @@ camel_imapx_conn_manager_init (CamelIMAPXConnManager *con_man)
 	con_man->priv = CAMEL_IMAPX_CONN_MANAGER_GET_PRIVATE (con_man);
 
 	g_rw_lock_init (&con_man->priv->rw_lock);
+	g_mutex_init (&con_man->priv->fetch_lock);
+	g_mutex_init (&con_man->priv->notify_lock);
+
+	con_man->priv->notify_folders = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
+	con_man->priv->closed_stats = camel_imapx_stats_new ();
 }
 
 /* Static functions go here */
 
+/* Forgets all NOTIFY state; call with notify_lock held. */
+static void
+imapx_conn_manager_reset_notify (CamelIMAPXConnManager *con_man)
+{
+	con_man->priv->notify_active = FALSE;
+	g_free (con_man->priv->notify_selected);
+	con_man->priv->notify_selected = NULL;
+	g_hash_table_remove_all (con_man->priv->notify_folders);
+}
+
+/* Folds a departing connection's counters into closed_stats */
+static void
+imapx_conn_manager_keep_stats (CamelIMAPXConnManager *con_man,
+                               CamelIMAPXServer *is,
+                               gboolean lost)
+{
+	IMAPXServerStats *stats;
+
+	stats = camel_imapx_server_dup_stats (is);
+	camel_imapx_stats_merge (con_man->priv->closed_stats, stats);
+	camel_imapx_stats_free (stats);
+
+	if (lost)
+		camel_imapx_stats_add_connections (
+			con_man->priv->closed_stats, 0, 1);
+}
+
 /* TODO destroy unused connections in a time-out loop */
 static void
 imapx_conn_shutdown (CamelIMAPXServer *is,
@@ -437,9 +523,13 @@ imapx_conn_shutdown (CamelIMAPXServer *is,
 	cinfo = imapx_conn_manager_lookup_info (con_man, is);
 
 	if (cinfo != NULL) {
-		imapx_conn_manager_remove_info (con_man, cinfo);
+		/* Still listed, so nobody asked it to close */
+		if (imapx_conn_manager_remove_info (con_man, cinfo))
+			imapx_conn_manager_keep_stats (con_man, is, TRUE);
 		connection_info_unref (cinfo);
 	}
+
+	camel_imapx_conn_manager_release_notify (con_man, is);
 }
 
 static void
@@ -474,17 +564,36 @@ imapx_conn_update_select (CamelIMAPXServer *is,
 	connection_info_set_selected_folder (cinfo, selected_folder);
 
 	connection_info_unref (cinfo);
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+	if (con_man->priv->notify_server == is) {
+		gchar *old_selected = con_man->priv->notify_selected;
+
+		/* What changed in a folder while it was selected was
+		 * not reported as an event, nor will it be now. */
+		if (old_selected != NULL)
+			g_hash_table_remove (
+				con_man->priv->notify_folders, old_selected);
+		if (selected_folder != NULL)
+			g_hash_table_remove (
+				con_man->priv->notify_folders, selected_folder);
+		con_man->priv->notify_selected = g_strdup (selected_folder);
+		g_free (old_selected);
+	}
+	g_mutex_unlock (&con_man->priv->notify_lock);
 }
 
 /* This should find a connection if the slots are full, returns NULL if there are slots available for a new connection for a folder */
 static CamelIMAPXServer *
 imapx_find_connection_unlocked (CamelIMAPXConnManager *con_man,
-                                const gchar *folder_name)
+                                const gchar *folder_name,
+                                IMAPXJobKind kind)
 {
 	CamelService *service;
 	CamelSettings *settings;
 	CamelIMAPXServer *is = NULL;
 	ConnectionInfo *cinfo = NULL;
+	ConnectionInfo *busy = NULL;
 	GList *list, *link;
 	guint concurrent_connections;
 	guint min_jobs = G_MAXUINT;
@@ -509,14 +618,24 @@ imapx_find_connection_unlocked (CamelIMAPXConnManager *con_man,
 	if (folder_name == NULL)
 		goto least_busy;
 
-	/* First try to find a connection already handling this folder. */
+	/* First try to find a connection already handling this folder.
+	 * Interactive requests skip connections busy with bulk work, so
+	 * that opening a message does not wait behind a refresh. */
 	for (link = list; link != NULL; link = g_list_next (link)) {
 		ConnectionInfo *candidate = link->data;
 
-		if (connection_info_has_folder_name (candidate, folder_name)) {
-			cinfo = connection_info_ref (candidate);
-			goto exit;
+		if (!connection_info_has_folder_name (candidate, folder_name))
+			continue;
+
+		if (kind == IMAPX_JOB_KIND_INTERACTIVE &&
+		    connection_info_has_bulk_work (candidate)) {
+			if (busy == NULL)
+				busy = candidate;
+			continue;
 		}
+
+		cinfo = connection_info_ref (candidate);
+		goto exit;
 	}
 
 	/* Next try to find a connection not handling any folders. */
@@ -529,6 +648,16 @@ imapx_find_connection_unlocked (CamelIMAPXConnManager *con_man,
 		}
 	}
 
+	/* Otherwise open a new connection for the interactive request
+	 * if we may, or else queue it where the folder is handled. */
+	if (busy != NULL) {
+		if (g_list_length (list) < concurrent_connections)
+			goto exit;
+
+		cinfo = connection_info_ref (busy);
+		goto exit;
+	}
+
 least_busy:
 	/* Pick the connection with the least number of jobs in progress. */
 	for (link = list; link != NULL; link = g_list_next (link)) {
@@ -651,11 +780,12 @@ camel_imapx_conn_manager_get_store (CamelIMAPXConnManager *con_man)
 	return CAMEL_STORE (con_man->priv->store);
 }
 
-CamelIMAPXServer *
-camel_imapx_conn_manager_get_connection (CamelIMAPXConnManager *con_man,
-                                         const gchar *folder_name,
-                                         GCancellable *cancellable,
-                                         GError **error)
+static CamelIMAPXServer *
+imapx_conn_manager_get_connection (CamelIMAPXConnManager *con_man,
+                                   const gchar *folder_name,
+                                   IMAPXJobKind kind,
+                                   GCancellable *cancellable,
+                                   GError **error)
 {
 	CamelIMAPXServer *is = NULL;
 
@@ -667,7 +797,8 @@ camel_imapx_conn_manager_get_connection (CamelIMAPXConnManager *con_man,
 
 	/* Check if we got cancelled while waiting for the lock. */
 	if (!g_cancellable_set_error_if_cancelled (cancellable, error)) {
-		is = imapx_find_connection_unlocked (con_man, folder_name);
+		is = imapx_find_connection_unlocked (
+			con_man, folder_name, kind);
 		if (is == NULL)
 			is = imapx_create_new_connection_unlocked (
 				con_man, folder_name, cancellable, error);
@@ -678,6 +809,97 @@ camel_imapx_conn_manager_get_connection (CamelIMAPXConnManager *con_man,
 	return is;
 }
 
+CamelIMAPXServer *
+camel_imapx_conn_manager_get_connection (CamelIMAPXConnManager *con_man,
+                                         const gchar *folder_name,
+                                         GCancellable *cancellable,
+                                         GError **error)
+{
+	return imapx_conn_manager_get_connection (
+		con_man, folder_name, IMAPX_JOB_KIND_BULK,
+		cancellable, error);
+}
+
+/* Like camel_imapx_conn_manager_get_connection(), but avoids the
+ * connection handling @folder_name while it has bulk work queued,
+ * using an idle or a new connection instead when there is one. */
+CamelIMAPXServer *
+camel_imapx_conn_manager_get_interactive_connection (CamelIMAPXConnManager *con_man,
+                                                     const gchar *folder_name,
+                                                     GCancellable *cancellable,
+                                                     GError **error)
+{
+	return imapx_conn_manager_get_connection (
+		con_man, folder_name, IMAPX_JOB_KIND_INTERACTIVE,
+		cancellable, error);
+}
+
+/* Requisitions up to @max connections besides the one already handling
+ * @folder_name, reusing idle ones and opening new ones while below the
+ * concurrent-connections limit.  They all get @folder_name pinned to them,
+ * so callers must release each with camel_imapx_conn_manager_update_con_info()
+ * once done.  Failing to open a connection is not an error; the caller
+ * just gets fewer of them. */
+GList *
+camel_imapx_conn_manager_get_spare_connections (CamelIMAPXConnManager *con_man,
+                                                const gchar *folder_name,
+                                                guint max,
+                                                GCancellable *cancellable)
+{
+	CamelService *service;
+	CamelSettings *settings;
+	GList *spares = NULL;
+	GList *link;
+	guint concurrent_connections;
+	guint n_spares = 0;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man), NULL);
+	g_return_val_if_fail (folder_name != NULL, NULL);
+
+	service = CAMEL_SERVICE (con_man->priv->store);
+
+	settings = camel_service_ref_settings (service);
+
+	concurrent_connections =
+		camel_imapx_settings_get_concurrent_connections (
+		CAMEL_IMAPX_SETTINGS (settings));
+
+	g_object_unref (settings);
+
+	CON_WRITE_LOCK (con_man);
+
+	for (link = con_man->priv->connections;
+	     link != NULL && n_spares < max;
+	     link = g_list_next (link)) {
+		ConnectionInfo *candidate = link->data;
+
+		if (connection_info_is_available (candidate)) {
+			connection_info_insert_folder_name (
+				candidate, folder_name);
+			spares = g_list_prepend (
+				spares, g_object_ref (candidate->is));
+			n_spares++;
+		}
+	}
+
+	while (n_spares < max &&
+	       g_list_length (con_man->priv->connections) < concurrent_connections) {
+		CamelIMAPXServer *is;
+
+		is = imapx_create_new_connection_unlocked (
+			con_man, folder_name, cancellable, NULL);
+		if (is == NULL)
+			break;
+
+		spares = g_list_prepend (spares, is);
+		n_spares++;
+	}
+
+	CON_WRITE_UNLOCK (con_man);
+
+	return g_list_reverse (spares);
+}
+
 GList *
 camel_imapx_conn_manager_get_connections (CamelIMAPXConnManager *con_man)
 {
@@ -727,15 +949,243 @@ camel_imapx_conn_manager_update_con_info (CamelIMAPXConnManager *con_man,
 void
 camel_imapx_conn_manager_close_connections (CamelIMAPXConnManager *con_man)
 {
+	GList *link;
+
 	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
 
 	CON_WRITE_LOCK (con_man);
 
+	for (link = con_man->priv->connections; link != NULL; link = g_list_next (link)) {
+		ConnectionInfo *cinfo = link->data;
+
+		imapx_conn_manager_keep_stats (con_man, cinfo->is, FALSE);
+	}
+
 	g_list_free_full (
 		con_man->priv->connections,
 		(GDestroyNotify) connection_info_cancel_and_unref);
 	con_man->priv->connections = NULL;
 
 	CON_WRITE_UNLOCK (con_man);
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+	con_man->priv->notify_server = NULL;
+	imapx_conn_manager_reset_notify (con_man);
+	g_mutex_unlock (&con_man->priv->notify_lock);
+}
+
+/* Returns the counters of all connections, past and present,
+ * added together.  Free with camel_imapx_stats_free(). */
+IMAPXServerStats *
+camel_imapx_conn_manager_dup_stats (CamelIMAPXConnManager *con_man)
+{
+	IMAPXServerStats *stats;
+	GList *list, *link;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man), NULL);
+
+	stats = camel_imapx_stats_copy (con_man->priv->closed_stats);
+
+	list = camel_imapx_conn_manager_get_connections (con_man);
+
+	for (link = list; link != NULL; link = g_list_next (link)) {
+		IMAPXServerStats *server_stats;
+
+		server_stats = camel_imapx_server_dup_stats (link->data);
+		camel_imapx_stats_merge (stats, server_stats);
+		camel_imapx_stats_free (server_stats);
+	}
+
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+	return stats;
+}
+
+/* Serializes looking for a download with
+ * camel_imapx_conn_manager_ref_fetching_connection() and queueing one
+ * when there is none, so that no two connections fetch the same message
+ * or part into the same cache file. */
+void
+camel_imapx_conn_manager_lock_fetches (CamelIMAPXConnManager *con_man)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
+
+	g_mutex_lock (&con_man->priv->fetch_lock);
+}
+
+void
+camel_imapx_conn_manager_unlock_fetches (CamelIMAPXConnManager *con_man)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
+
+	g_mutex_unlock (&con_man->priv->fetch_lock);
 }
 
+/* Returns the connection with a download of @cache_key from @folder
+ * queued or in progress, or NULL if there is none. */
+CamelIMAPXServer *
+camel_imapx_conn_manager_ref_fetching_connection (CamelIMAPXConnManager *con_man,
+                                                  CamelFolder *folder,
+                                                  const gchar *cache_key)
+{
+	CamelIMAPXServer *is = NULL;
+	GList *list, *link;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man), NULL);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (cache_key != NULL, NULL);
+
+	list = imapx_conn_manager_list_info (con_man);
+
+	for (link = list; link != NULL && is == NULL; link = g_list_next (link)) {
+		ConnectionInfo *cinfo = link->data;
+
+		if (camel_imapx_server_is_fetching (cinfo->is, folder, cache_key))
+			is = g_object_ref (cinfo->is);
+	}
+
+	g_list_free_full (list, (GDestroyNotify) connection_info_unref);
+
+	return is;
+}
+
+/* NOTIFY (RFC 5465) events for all the folders go to whichever
+ * connection enabled it, so only one connection of the store should.
+ * Returns whether that is @is, making it so if no connection is. */
+gboolean
+camel_imapx_conn_manager_claim_notify (CamelIMAPXConnManager *con_man,
+                                       CamelIMAPXServer *is)
+{
+	gboolean claimed;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man), FALSE);
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+
+	if (con_man->priv->notify_server == NULL)
+		con_man->priv->notify_server = is;
+	claimed = (con_man->priv->notify_server == is);
+
+	g_mutex_unlock (&con_man->priv->notify_lock);
+
+	return claimed;
+}
+
+/* Lets the next connection to log in take over NOTIFY from @is. */
+void
+camel_imapx_conn_manager_release_notify (CamelIMAPXConnManager *con_man,
+                                         CamelIMAPXServer *is)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+	if (con_man->priv->notify_server == is) {
+		con_man->priv->notify_server = NULL;
+		imapx_conn_manager_reset_notify (con_man);
+	}
+	g_mutex_unlock (&con_man->priv->notify_lock);
+}
+
+/* Called by @is once its NOTIFY SET succeeded, for subscribed
+ * folders if @subscribed_only, else for all personal folders. */
+void
+camel_imapx_conn_manager_notify_enabled (CamelIMAPXConnManager *con_man,
+                                         CamelIMAPXServer *is,
+                                         gboolean subscribed_only)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+	if (con_man->priv->notify_server == is) {
+		imapx_conn_manager_reset_notify (con_man);
+		con_man->priv->notify_active = TRUE;
+		con_man->priv->notify_subscribed_only = subscribed_only;
+	}
+	g_mutex_unlock (&con_man->priv->notify_lock);
+}
+
+/* Called by @is for a NOTIFY event about the folder at @path,
+ * which will need its next refresh to go to the server. */
+void
+camel_imapx_conn_manager_notify_event (CamelIMAPXConnManager *con_man,
+                                       CamelIMAPXServer *is,
+                                       const gchar *path)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
+	g_return_if_fail (path != NULL);
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+	if (con_man->priv->notify_server == is)
+		g_hash_table_remove (con_man->priv->notify_folders, path);
+	g_mutex_unlock (&con_man->priv->notify_lock);
+}
+
+/* With NOTIFY on, a folder the filter covers which had no event
+ * since its last refresh is the same on the server as here.  Returns
+ * TRUE when the refresh of the folder at @path can skip asking the
+ * server for that reason.  Otherwise sets @tracked if NOTIFY covers
+ * the folder; then camel_imapx_conn_manager_end_notify_refresh()
+ * must follow once the refresh is done. */
+gboolean
+camel_imapx_conn_manager_begin_notify_refresh (CamelIMAPXConnManager *con_man,
+                                               const gchar *path,
+                                               gboolean personal,
+                                               gboolean subscribed,
+                                               gboolean *tracked)
+{
+	gboolean quiet = FALSE;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man), FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (tracked != NULL, FALSE);
+
+	*tracked = FALSE;
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+
+	if (con_man->priv->notify_active &&
+	    (con_man->priv->notify_subscribed_only ? subscribed : personal) &&
+	    g_strcmp0 (con_man->priv->notify_selected, path) != 0) {
+		quiet = GPOINTER_TO_INT (g_hash_table_lookup (
+			con_man->priv->notify_folders, path)) == IMAPX_NOTIFY_QUIET;
+		if (!quiet) {
+			/* An event from here on removes this again */
+			g_hash_table_insert (
+				con_man->priv->notify_folders, g_strdup (path),
+				GINT_TO_POINTER (IMAPX_NOTIFY_REFRESHING));
+			*tracked = TRUE;
+		}
+	}
+
+	g_mutex_unlock (&con_man->priv->notify_lock);
+
+	return quiet;
+}
+
+/* Marks the folder at @path as needing no refresh until its next
+ * NOTIFY event if @success, and if no event came since
+ * camel_imapx_conn_manager_begin_notify_refresh(). */
+void
+camel_imapx_conn_manager_end_notify_refresh (CamelIMAPXConnManager *con_man,
+                                             const gchar *path,
+                                             gboolean success)
+{
+	IMAPXNotifyState state;
+
+	g_return_if_fail (CAMEL_IS_IMAPX_CONN_MANAGER (con_man));
+	g_return_if_fail (path != NULL);
+
+	g_mutex_lock (&con_man->priv->notify_lock);
+
+	state = GPOINTER_TO_INT (g_hash_table_lookup (
+		con_man->priv->notify_folders, path));
+	if (state == IMAPX_NOTIFY_REFRESHING && success)
+		g_hash_table_insert (
+			con_man->priv->notify_folders, g_strdup (path),
+			GINT_TO_POINTER (IMAPX_NOTIFY_QUIET));
+	else if (state == IMAPX_NOTIFY_REFRESHING)
+		g_hash_table_remove (con_man->priv->notify_folders, path);
+
+	g_mutex_unlock (&con_man->priv->notify_lock);
+}
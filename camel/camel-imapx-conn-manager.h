@@ -71,6 +71,17 @@ CamelIMAPXServer *
 						 const gchar *folder_name,
 						 GCancellable *cancellable,
 						 GError **error);
+GList *		camel_imapx_conn_manager_get_spare_connections
+						(CamelIMAPXConnManager *con_man,
+						 const gchar *folder_name,
+						 guint max,
+						 GCancellable *cancellable);
+CamelIMAPXServer *
+		camel_imapx_conn_manager_get_interactive_connection
+						(CamelIMAPXConnManager *con_man,
+						 const gchar *folder_name,
+						 GCancellable *cancellable,
+						 GError **error);
 void		camel_imapx_conn_manager_close_connections
 						(CamelIMAPXConnManager *con_man);
 GList *		camel_imapx_conn_manager_get_connections
@@ -79,5 +90,41 @@ void		camel_imapx_conn_manager_update_con_info
 						(CamelIMAPXConnManager *con_man,
 						 CamelIMAPXServer *server,
 						 const gchar *folder_name);
+struct _IMAPXServerStats *
+		camel_imapx_conn_manager_dup_stats
+						(CamelIMAPXConnManager *con_man);
+void		camel_imapx_conn_manager_lock_fetches
+						(CamelIMAPXConnManager *con_man);
+void		camel_imapx_conn_manager_unlock_fetches
+						(CamelIMAPXConnManager *con_man);
+CamelIMAPXServer *
+		camel_imapx_conn_manager_ref_fetching_connection
+						(CamelIMAPXConnManager *con_man,
+						 CamelFolder *folder,
+						 const gchar *cache_key);
+gboolean	camel_imapx_conn_manager_claim_notify
+						(CamelIMAPXConnManager *con_man,
+						 CamelIMAPXServer *is);
+void		camel_imapx_conn_manager_release_notify
+						(CamelIMAPXConnManager *con_man,
+						 CamelIMAPXServer *is);
+void		camel_imapx_conn_manager_notify_enabled
+						(CamelIMAPXConnManager *con_man,
+						 CamelIMAPXServer *is,
+						 gboolean subscribed_only);
+void		camel_imapx_conn_manager_notify_event
+						(CamelIMAPXConnManager *con_man,
+						 CamelIMAPXServer *is,
+						 const gchar *path);
+gboolean	camel_imapx_conn_manager_begin_notify_refresh
+						(CamelIMAPXConnManager *con_man,
+						 const gchar *path,
+						 gboolean personal,
+						 gboolean subscribed,
+						 gboolean *tracked);
+void		camel_imapx_conn_manager_end_notify_refresh
+						(CamelIMAPXConnManager *con_man,
+						 const gchar *path,
+						 gboolean success);
 
 #endif /* _CAMEL_IMAPX_SERVER_H */
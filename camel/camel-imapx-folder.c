@@ -33,16 +33,85 @@
 #include "camel-imapx-store.h"
 #include "camel-imapx-summary.h"
 #include "camel-imapx-utils.h"
+#include "camel-imapx-wrapper.h"
 
 #include <stdlib.h>
 #include <string.h>
 
 #define d(...) camel_imapx_debug(debug, '?', __VA_ARGS__)
 
+/* The initial download of a folder with at least this many messages
+ * is split across all the connections we are allowed to open, each
+ * fetching roughly IMAPX_SPLIT_SYNC_BATCH messages at a time. */
+#define IMAPX_SPLIT_SYNC_THRESHOLD (10000)
+#define IMAPX_SPLIT_SYNC_BATCH (5000)
+
+/* How long prefetch workers sleep while interactive jobs are queued. */
+#define IMAPX_PREFETCH_PAUSE (100 * 1000)
+
+/* With fetch-text-first, messages at least this big are opened with
+ * only their text parts; smaller ones are not worth the round trip. */
+#define IMAPX_FETCH_TEXT_FIRST_SIZE (64 * 1024)
+
 #define CAMEL_IMAPX_FOLDER_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), CAMEL_TYPE_IMAPX_FOLDER, CamelIMAPXFolderPrivate))
 
+typedef struct _SplitSyncData SplitSyncData;
+typedef struct _SplitSyncWorker SplitSyncWorker;
+
+struct _SplitSyncData {
+	CamelFolder *folder;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+
+	guint32 last_uid;
+	guint32 uids_per_batch;
+	guint n_batches;
+	guint next_batch;
+
+	/* Fetched CamelMessageInfo-s, per batch, in UID order of
+	 * the batches.  Each slot stays NULL until it is fetched. */
+	GPtrArray **results;
+
+	GError *error;
+};
+
+struct _SplitSyncWorker {
+	SplitSyncData *data;
+	CamelIMAPXServer *server;
+	GThread *thread;
+};
+
+typedef struct _PrefetchData PrefetchData;
+typedef struct _PrefetchWorker PrefetchWorker;
+
+struct _PrefetchData {
+	CamelFolder *folder;
+	CamelIMAPXStore *istore;
+	GCancellable *cancellable;
+
+	GMutex lock;
+
+	/* UIDs to download with their sizes, newest first. */
+	GPtrArray *uids;
+	GArray *sizes;
+	guint next_uid;
+	guint n_done;
+
+	guint64 bytes_per_second;
+	guint64 bytes_queued;
+	gint64 start_time;
+};
+
+struct _PrefetchWorker {
+	PrefetchData *data;
+	CamelIMAPXServer *server;
+	GThread *thread;
+};
+
 struct _CamelIMAPXFolderPrivate {
 	GMutex property_lock;
 	gchar **quota_root_names;
@@ -50,6 +119,9 @@ struct _CamelIMAPXFolderPrivate {
 	GMutex move_to_hash_table_lock;
 	GHashTable *move_to_real_junk_uids;
 	GHashTable *move_to_real_trash_uids;
+
+	/* Whether imapx_split_sync() had its one chance already. */
+	gboolean split_sync_tried;
 };
 
 /* The custom property ID is a CamelArg artifact.
@@ -320,7 +392,7 @@ imapx_search_by_uids (CamelFolder *folder,
 		CAMEL_OFFLINE_STORE (parent_store));
 
 	if (online) {
-		server = camel_imapx_store_get_server (
+		server = camel_imapx_store_get_interactive_server (
 			CAMEL_IMAPX_STORE (parent_store),
 			folder_name, cancellable, error);
 		if (server == NULL)
@@ -369,7 +441,7 @@ imapx_count_by_expression (CamelFolder *folder,
 		CAMEL_OFFLINE_STORE (parent_store));
 
 	if (online) {
-		server = camel_imapx_store_get_server (
+		server = camel_imapx_store_get_interactive_server (
 			CAMEL_IMAPX_STORE (parent_store),
 			folder_name, cancellable, error);
 		if (server == NULL)
@@ -418,7 +490,7 @@ imapx_search_by_expression (CamelFolder *folder,
 		CAMEL_OFFLINE_STORE (parent_store));
 
 	if (online) {
-		server = camel_imapx_store_get_server (
+		server = camel_imapx_store_get_interactive_server (
 			CAMEL_IMAPX_STORE (parent_store),
 			folder_name, cancellable, error);
 		if (server == NULL)
@@ -569,6 +641,260 @@ imapx_fetch_messages_sync (CamelFolder *folder,
 	return success;
 }
 
+static gboolean
+imapx_folder_want_text_first (CamelIMAPXFolder *ifolder,
+                              const gchar *uid)
+{
+	CamelFolder *folder = CAMEL_FOLDER (ifolder);
+	CamelStore *parent_store;
+	CamelSettings *settings;
+	CamelMessageInfo *mi;
+	gboolean fetch_text_first;
+	guint32 size = 0;
+
+	parent_store = camel_folder_get_parent_store (folder);
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (parent_store));
+	fetch_text_first = camel_imapx_settings_get_fetch_text_first (
+		CAMEL_IMAPX_SETTINGS (settings));
+	g_object_unref (settings);
+
+	if (!fetch_text_first)
+		return FALSE;
+
+	mi = camel_folder_summary_get (folder->summary, uid);
+	if (mi != NULL) {
+		size = camel_message_info_size (mi);
+		camel_message_info_free (mi);
+	}
+
+	return size >= IMAPX_FETCH_TEXT_FIRST_SIZE;
+}
+
+/* Returns the MIME structure of a message and sets @header to its
+ * header, from the database and data cache if they were fetched
+ * before, else from the server. */
+static CamelMessageContentInfo *
+imapx_folder_get_bodystructure (CamelIMAPXFolder *ifolder,
+                                const gchar *uid,
+                                CamelStream **header,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (ifolder);
+	CamelMessageContentInfo *cinfo = NULL;
+	CamelStore *parent_store;
+	CamelIMAPXStore *istore;
+	CamelIMAPXServer *server;
+	const gchar *folder_name;
+	gchar *header_key;
+	gchar *bodystructure;
+
+	folder_name = camel_folder_get_full_name (folder);
+	parent_store = camel_folder_get_parent_store (folder);
+	istore = CAMEL_IMAPX_STORE (parent_store);
+
+	header_key = imapx_message_part_key (uid, "HEADER");
+
+	*header = camel_data_cache_get (
+		ifolder->cache, "part", header_key, NULL);
+	if (*header != NULL) {
+		bodystructure = camel_db_read_bodystructure (
+			parent_store->cdb_r, folder_name, uid, NULL);
+		if (bodystructure != NULL)
+			cinfo = imapx_body_from_string (bodystructure, NULL);
+		g_free (bodystructure);
+	}
+
+	if (cinfo != NULL)
+		goto exit;
+
+	g_clear_object (header);
+
+	if (!camel_offline_store_get_online (CAMEL_OFFLINE_STORE (istore))) {
+		g_set_error (
+			error, CAMEL_SERVICE_ERROR,
+			CAMEL_SERVICE_ERROR_UNAVAILABLE,
+			_("You must be working online to complete this operation"));
+		goto exit;
+	}
+
+	server = camel_imapx_store_get_interactive_server (
+		istore, folder_name, cancellable, error);
+	if (server == NULL)
+		goto exit;
+
+	cinfo = camel_imapx_server_get_bodystructure (
+		server, folder, uid, cancellable, error);
+	camel_imapx_store_op_done (istore, server, folder_name);
+	g_object_unref (server);
+
+	if (cinfo != NULL) {
+		*header = camel_data_cache_get (
+			ifolder->cache, "part", header_key, error);
+		if (*header == NULL) {
+			imapx_free_body (cinfo);
+			cinfo = NULL;
+		}
+	}
+
+exit:
+	g_free (header_key);
+
+	return cinfo;
+}
+
+/* Builds the content of the part @cinfo of a message, numbered
+ * @section.  Multiparts are built recursively, text parts are
+ * fetched now and anything else is left for when it is needed. */
+static CamelDataWrapper *
+imapx_folder_build_content (CamelIMAPXFolder *ifolder,
+                            const gchar *uid,
+                            CamelMessageContentInfo *cinfo,
+                            const gchar *section,
+                            GCancellable *cancellable,
+                            GError **error)
+{
+	CamelDataWrapper *content;
+	CamelMessageContentInfo *child;
+	CamelStream *stream;
+	gint ii = 1;
+
+	if (camel_content_type_is (cinfo->type, "text", "plain") ||
+	    camel_content_type_is (cinfo->type, "text", "html")) {
+		stream = camel_imapx_folder_get_message_part (
+			ifolder, uid, section, cinfo->encoding,
+			cancellable, error);
+		if (stream == NULL)
+			return NULL;
+
+		content = camel_data_wrapper_new ();
+		camel_data_wrapper_set_mime_type_field (content, cinfo->type);
+		if (!camel_data_wrapper_construct_from_stream_sync (
+			content, stream, cancellable, error))
+			g_clear_object (&content);
+		g_object_unref (stream);
+
+		return content;
+	}
+
+	if (!camel_content_type_is (cinfo->type, "multipart", "*"))
+		return camel_imapx_wrapper_new (
+			ifolder, uid, section, cinfo->encoding, cinfo->type);
+
+	content = (CamelDataWrapper *) camel_multipart_new ();
+	camel_data_wrapper_set_mime_type_field (content, cinfo->type);
+	if (camel_content_type_param (cinfo->type, "boundary") == NULL)
+		camel_multipart_set_boundary (CAMEL_MULTIPART (content), NULL);
+
+	for (child = cinfo->childs; child != NULL; child = child->next) {
+		CamelMimePart *part;
+		CamelDataWrapper *part_content;
+		gchar *child_section;
+
+		if (*section != '\0')
+			child_section = g_strdup_printf ("%s.%d", section, ii++);
+		else
+			child_section = g_strdup_printf ("%d", ii++);
+
+		part_content = imapx_folder_build_content (
+			ifolder, uid, child, child_section,
+			cancellable, error);
+		g_free (child_section);
+
+		if (part_content == NULL) {
+			g_object_unref (content);
+			return NULL;
+		}
+
+		part = camel_mime_part_new ();
+		camel_medium_set_content (CAMEL_MEDIUM (part), part_content);
+		g_object_unref (part_content);
+
+		if (child->encoding != NULL)
+			camel_mime_part_set_encoding (
+				part, camel_transfer_encoding_from_string (
+				child->encoding));
+		if (child->description != NULL)
+			camel_mime_part_set_description (
+				part, child->description);
+		if (child->id != NULL) {
+			gchar *content_id;
+
+			content_id = camel_header_contentid_decode (child->id);
+			camel_mime_part_set_content_id (part, content_id);
+			g_free (content_id);
+		}
+
+		/* The parser drops Content-Disposition, so guess it:
+		 * parts we did not download are attachments, unless
+		 * something refers to them by Content-ID. */
+		if (camel_data_wrapper_is_offline (part_content)) {
+			const gchar *filename;
+
+			filename = camel_content_type_param (child->type, "name");
+			if (filename != NULL)
+				camel_mime_part_set_filename (part, filename);
+			camel_mime_part_set_disposition (
+				part, child->id != NULL ? "inline" : "attachment");
+		}
+
+		camel_multipart_add_part (CAMEL_MULTIPART (content), part);
+		g_object_unref (part);
+	}
+
+	return content;
+}
+
+/* Opens a multipart message with only its text parts downloaded; the
+ * rest come down when something reads them.  Returns NULL without
+ * setting @error when the message is better fetched whole. */
+static CamelMimeMessage *
+imapx_folder_get_message_text_first (CamelIMAPXFolder *ifolder,
+                                     const gchar *uid,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	CamelMimeMessage *msg = NULL;
+	CamelMessageContentInfo *cinfo;
+	CamelDataWrapper *content;
+	CamelStream *header = NULL;
+
+	cinfo = imapx_folder_get_bodystructure (
+		ifolder, uid, &header, cancellable, error);
+	if (cinfo == NULL)
+		return NULL;
+
+	if (!camel_content_type_is (cinfo->type, "multipart", "*"))
+		goto exit;
+
+	msg = camel_mime_message_new ();
+
+	g_mutex_lock (&ifolder->stream_lock);
+	if (!camel_data_wrapper_construct_from_stream_sync (
+		CAMEL_DATA_WRAPPER (msg), header, cancellable, error))
+		g_clear_object (&msg);
+	g_mutex_unlock (&ifolder->stream_lock);
+
+	if (msg == NULL)
+		goto exit;
+
+	content = imapx_folder_build_content (
+		ifolder, uid, cinfo, "", cancellable, error);
+	if (content != NULL) {
+		camel_medium_set_content (CAMEL_MEDIUM (msg), content);
+		g_object_unref (content);
+	} else {
+		g_clear_object (&msg);
+	}
+
+exit:
+	imapx_free_body (cinfo);
+	g_object_unref (header);
+
+	return msg;
+}
+
 static CamelMimeMessage *
 imapx_get_message_sync (CamelFolder *folder,
                         const gchar *uid,
@@ -597,7 +923,21 @@ imapx_get_message_sync (CamelFolder *folder,
 	}
 
 	stream = camel_data_cache_get (ifolder->cache, path, uid, NULL);
-	if (stream == NULL) {
+
+	if (stream == NULL && !offline_message &&
+	    imapx_folder_want_text_first (ifolder, uid)) {
+		GError *local_error = NULL;
+
+		msg = imapx_folder_get_message_text_first (
+			ifolder, uid, cancellable, &local_error);
+
+		if (local_error != NULL) {
+			g_propagate_error (error, local_error);
+			return NULL;
+		}
+	}
+
+	if (stream == NULL && msg == NULL) {
 		if (offline_message) {
 			g_set_error (
 				error, CAMEL_FOLDER_ERROR,
@@ -614,8 +954,13 @@ imapx_get_message_sync (CamelFolder *folder,
 			return NULL;
 		}
 
-		server = camel_imapx_store_get_server (
-			istore, folder_name, cancellable, error);
+		/* If offline sync is downloading it already, join in
+		 * there rather than fetch it again elsewhere. */
+		server = camel_imapx_conn_manager_ref_fetching_connection (
+			istore->con_man, folder, uid);
+		if (server == NULL)
+			server = camel_imapx_store_get_interactive_server (
+				istore, folder_name, cancellable, error);
 		if (server == NULL)
 			return NULL;
 
@@ -724,6 +1069,270 @@ imapx_purge_message_cache_sync (CamelFolder *folder,
 	return TRUE;
 }
 
+static gint
+imapx_split_sync_info_cmp (gconstpointer ap,
+                           gconstpointer bp)
+{
+	const CamelMessageInfo *a = *((CamelMessageInfo **) ap);
+	const CamelMessageInfo *b = *((CamelMessageInfo **) bp);
+	gulong auid, buid;
+
+	auid = strtoul (camel_message_info_uid (a), NULL, 10);
+	buid = strtoul (camel_message_info_uid (b), NULL, 10);
+
+	return (auid < buid) ? -1 : (auid > buid) ? 1 : 0;
+}
+
+static gpointer
+imapx_split_sync_thread (gpointer user_data)
+{
+	SplitSyncWorker *worker = user_data;
+	SplitSyncData *data = worker->data;
+
+	while (TRUE) {
+		GPtrArray *infos;
+		GError *local_error = NULL;
+		guint32 first_uid, last_uid;
+		guint batch;
+
+		g_mutex_lock (&data->lock);
+
+		if (data->error != NULL || data->next_batch >= data->n_batches) {
+			g_mutex_unlock (&data->lock);
+			break;
+		}
+
+		batch = data->next_batch++;
+
+		g_mutex_unlock (&data->lock);
+
+		first_uid = 1 + batch * data->uids_per_batch;
+		last_uid = MIN (
+			first_uid + data->uids_per_batch - 1,
+			data->last_uid);
+
+		infos = camel_imapx_server_fetch_summary_range (
+			worker->server, data->folder, first_uid, last_uid,
+			data->cancellable, &local_error);
+
+		g_mutex_lock (&data->lock);
+
+		if (infos != NULL)
+			data->results[batch] = infos;
+		else if (data->error == NULL)
+			g_propagate_error (&data->error, local_error);
+		else
+			g_clear_error (&local_error);
+
+		g_cond_broadcast (&data->cond);
+		g_mutex_unlock (&data->lock);
+	}
+
+	return NULL;
+}
+
+/* Adds one fetched batch to the summary, in one database transaction. */
+static void
+imapx_split_sync_merge (CamelFolder *folder,
+                        GPtrArray *infos)
+{
+	CamelIMAPXFolder *ifolder;
+	CamelFolderChangeInfo *changes;
+	guint ii;
+
+	ifolder = CAMEL_IMAPX_FOLDER (folder);
+	changes = camel_folder_change_info_new ();
+
+	g_ptr_array_sort (infos, imapx_split_sync_info_cmp);
+
+	for (ii = 0; ii < infos->len; ii++) {
+		CamelMessageInfo *mi = infos->pdata[ii];
+		const gchar *uid = camel_message_info_uid (mi);
+
+		if (camel_folder_summary_check_uid (folder->summary, uid)) {
+			camel_message_info_free (mi);
+			continue;
+		}
+
+		camel_folder_summary_add (folder->summary, mi);
+		camel_folder_change_info_add_uid (changes, uid);
+
+		if (!g_hash_table_lookup (ifolder->ignore_recent, uid))
+			camel_folder_change_info_recent_uid (changes, uid);
+	}
+
+	camel_folder_summary_save_to_db (folder->summary, NULL);
+
+	if (camel_folder_change_info_changed (changes))
+		camel_folder_changed (folder, changes);
+
+	camel_folder_change_info_free (changes);
+}
+
+/* Downloads the summary of a large folder we know nothing about yet
+ * using several connections at once.  Each of them selects the folder
+ * and fetches its share of the UID range, while the results are merged
+ * into the summary here in UID order.  Whatever is left afterwards,
+ * like flag changes made meanwhile, is picked up by the normal refresh
+ * which follows.  Only tried on the first sync, and only when what
+ * we already know of the folder says it is large. */
+static gboolean
+imapx_split_sync (CamelFolder *folder,
+                  CamelIMAPXServer *server,
+                  GCancellable *cancellable,
+                  GError **error)
+{
+	CamelIMAPXFolder *ifolder;
+	CamelIMAPXStore *istore;
+	CamelSettings *settings;
+	SplitSyncData data;
+	SplitSyncWorker *workers;
+	GList *servers, *link;
+	const gchar *folder_name;
+	guint concurrent_connections;
+	guint n_workers, ii;
+
+	ifolder = CAMEL_IMAPX_FOLDER (folder);
+
+	/* Only the first sync of the folder is worth it. */
+	if (ifolder->priv->split_sync_tried)
+		return TRUE;
+
+	ifolder->priv->split_sync_tried = TRUE;
+
+	if (camel_folder_summary_count (folder->summary) > 0)
+		return TRUE;
+
+	istore = CAMEL_IMAPX_STORE (camel_folder_get_parent_store (folder));
+	folder_name = camel_folder_get_full_name (folder);
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (istore));
+	concurrent_connections =
+		camel_imapx_settings_get_concurrent_connections (
+		CAMEL_IMAPX_SETTINGS (settings));
+	g_object_unref (settings);
+
+	if (concurrent_connections < 2)
+		return TRUE;
+
+	/* Counts from LIST-STATUS or NOTIFY, on whichever
+	 * connection got them, tell the folder size for free. */
+	servers = camel_imapx_conn_manager_get_connections (istore->con_man);
+	for (link = servers; link != NULL; link = g_list_next (link))
+		camel_imapx_server_peek_stashed_status (link->data, folder);
+	g_list_free_full (servers, (GDestroyNotify) g_object_unref);
+
+	if (ifolder->exists_on_server < IMAPX_SPLIT_SYNC_THRESHOLD)
+		return TRUE;
+
+	/* The folder is big enough, but UIDNEXT is still unknown; learn
+	 * it without selecting the folder, which would start downloading
+	 * new messages right away. */
+	if (ifolder->uidnext_on_server < 2) {
+		if (!camel_imapx_server_status (server, folder, cancellable, error))
+			return FALSE;
+
+		if (ifolder->exists_on_server < IMAPX_SPLIT_SYNC_THRESHOLD ||
+		    ifolder->uidnext_on_server < 2)
+			return TRUE;
+	}
+
+	servers = camel_imapx_conn_manager_get_spare_connections (
+		istore->con_man, folder_name,
+		concurrent_connections - 1, cancellable);
+
+	if (servers == NULL)
+		return TRUE;
+
+	servers = g_list_prepend (servers, g_object_ref (server));
+	n_workers = g_list_length (servers);
+
+	memset (&data, 0, sizeof (SplitSyncData));
+	data.folder = folder;
+	data.cancellable = cancellable;
+	g_mutex_init (&data.lock);
+	g_cond_init (&data.cond);
+
+	/* UIDs are usually sparse, so split the UID range into about
+	 * as many batches as there would be batches of existing messages. */
+	data.last_uid = ifolder->uidnext_on_server - 1;
+	data.n_batches = (ifolder->exists_on_server +
+		IMAPX_SPLIT_SYNC_BATCH - 1) / IMAPX_SPLIT_SYNC_BATCH;
+	data.uids_per_batch =
+		(data.last_uid + data.n_batches - 1) / data.n_batches;
+	data.n_batches =
+		(data.last_uid + data.uids_per_batch - 1) / data.uids_per_batch;
+	data.results = g_new0 (GPtrArray *, data.n_batches);
+
+	camel_operation_push_message (
+		cancellable,
+		_("Fetching summary information for new messages in '%s'"),
+		camel_folder_get_display_name (folder));
+
+	workers = g_new0 (SplitSyncWorker, n_workers);
+
+	for (link = servers, ii = 0; link != NULL; link = g_list_next (link), ii++) {
+		workers[ii].data = &data;
+		workers[ii].server = link->data;
+		workers[ii].thread = g_thread_new (
+			NULL, imapx_split_sync_thread, &workers[ii]);
+	}
+
+	for (ii = 0; ii < data.n_batches; ii++) {
+		GPtrArray *infos;
+
+		g_mutex_lock (&data.lock);
+
+		while (data.results[ii] == NULL && data.error == NULL)
+			g_cond_wait (&data.cond, &data.lock);
+
+		infos = data.results[ii];
+		data.results[ii] = NULL;
+
+		g_mutex_unlock (&data.lock);
+
+		if (infos == NULL)
+			break;
+
+		imapx_split_sync_merge (folder, infos);
+		g_ptr_array_free (infos, TRUE);
+
+		camel_operation_progress (
+			cancellable, (ii + 1) * 100 / data.n_batches);
+	}
+
+	for (ii = 0; ii < n_workers; ii++)
+		g_thread_join (workers[ii].thread);
+
+	camel_operation_pop_message (cancellable);
+
+	/* Batches fetched after another one failed. */
+	for (ii = 0; ii < data.n_batches; ii++) {
+		if (data.results[ii] != NULL) {
+			g_ptr_array_foreach (
+				data.results[ii], (GFunc)
+				camel_message_info_free, NULL);
+			g_ptr_array_free (data.results[ii], TRUE);
+		}
+	}
+
+	for (link = g_list_next (servers); link != NULL; link = g_list_next (link))
+		camel_imapx_store_op_done (istore, link->data, folder_name);
+
+	g_list_free_full (servers, (GDestroyNotify) g_object_unref);
+	g_free (workers);
+	g_free (data.results);
+	g_mutex_clear (&data.lock);
+	g_cond_clear (&data.cond);
+
+	if (data.error != NULL) {
+		g_propagate_error (error, data.error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static gboolean
 imapx_refresh_info_sync (CamelFolder *folder,
                          GCancellable *cancellable,
@@ -755,8 +1364,11 @@ imapx_refresh_info_sync (CamelFolder *folder,
 	server = camel_imapx_store_get_server (
 		istore, folder_name, cancellable, error);
 	if (server != NULL) {
-		success = camel_imapx_server_refresh_info (
-			server, folder, cancellable, error);
+		success = imapx_split_sync (
+			folder, server, cancellable, error);
+		if (success)
+			success = camel_imapx_server_refresh_info (
+				server, folder, cancellable, error);
 		camel_imapx_store_op_done (istore, server, folder_name);
 		g_object_unref (server);
 	}
@@ -1074,11 +1686,303 @@ imapx_rename (CamelFolder *folder,
 		folder_name, folder->summary);
 }
 
+static gint
+imapx_prefetch_uid_cmp (gconstpointer ap,
+                        gconstpointer bp)
+{
+	gulong auid, buid;
+
+	auid = strtoul (*((const gchar **) ap), NULL, 10);
+	buid = strtoul (*((const gchar **) bp), NULL, 10);
+
+	/* Highest UID, i.e. newest message, first */
+	return (auid < buid) ? 1 : (auid > buid) ? -1 : 0;
+}
+
+static gboolean
+imapx_prefetch_interactive_pending (CamelIMAPXStore *istore)
+{
+	GList *servers, *link;
+	gboolean pending = FALSE;
+
+	servers = camel_imapx_conn_manager_get_connections (istore->con_man);
+
+	for (link = servers; link != NULL && !pending; link = g_list_next (link)) {
+		IMAPXJobQueueInfo *jinfo;
+
+		jinfo = camel_imapx_server_get_job_queue_info (link->data);
+		pending = jinfo->latency[IMAPX_JOB_KIND_INTERACTIVE].pending > 0;
+		camel_imapx_destroy_job_queue_info (jinfo);
+	}
+
+	g_list_free_full (servers, (GDestroyNotify) g_object_unref);
+
+	return pending;
+}
+
+/* Holds a worker back while the user is waiting for something
+ * else, and for as long as needed to stay within the rate limit.
+ * Returns FALSE if cancelled meanwhile. */
+static gboolean
+imapx_prefetch_wait (PrefetchData *data,
+                     guint32 size)
+{
+	gint64 due = 0;
+
+	if (data->bytes_per_second > 0) {
+		g_mutex_lock (&data->lock);
+		data->bytes_queued += size;
+		due = data->start_time +
+			data->bytes_queued * G_USEC_PER_SEC /
+			data->bytes_per_second;
+		g_mutex_unlock (&data->lock);
+	}
+
+	while (!g_cancellable_is_cancelled (data->cancellable)) {
+		if (imapx_prefetch_interactive_pending (data->istore)) {
+			g_usleep (IMAPX_PREFETCH_PAUSE);
+			continue;
+		}
+
+		if (g_get_monotonic_time () < due) {
+			g_usleep (MIN (
+				due - g_get_monotonic_time (),
+				IMAPX_PREFETCH_PAUSE));
+			continue;
+		}
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gpointer
+imapx_prefetch_thread (gpointer user_data)
+{
+	PrefetchWorker *worker = user_data;
+	PrefetchData *data = worker->data;
+
+	while (TRUE) {
+		const gchar *uid;
+		guint32 size;
+		guint index;
+
+		g_mutex_lock (&data->lock);
+
+		if (data->next_uid >= data->uids->len) {
+			g_mutex_unlock (&data->lock);
+			break;
+		}
+
+		index = data->next_uid++;
+		uid = data->uids->pdata[index];
+		size = g_array_index (data->sizes, guint32, index);
+
+		g_mutex_unlock (&data->lock);
+
+		if (!imapx_prefetch_wait (data, size))
+			break;
+
+		/* Like the generic downsync, a message which fails
+		 * to download is left for the next time. */
+		camel_imapx_server_sync_message (
+			worker->server, data->folder, uid,
+			data->cancellable, NULL);
+
+		g_mutex_lock (&data->lock);
+		data->n_done++;
+		camel_operation_progress (
+			data->cancellable,
+			data->n_done * 100 / data->uids->len);
+		g_mutex_unlock (&data->lock);
+	}
+
+	return NULL;
+}
+
+/* Picks the messages to download: those not cached yet, newest first,
+ * for as long as the folder stays under its size limit.  The messages
+ * already cached count towards the limit too. */
+static void
+imapx_prefetch_select (PrefetchData *data,
+                       GPtrArray *uids,
+                       guint64 size_limit)
+{
+	CamelFolder *folder = data->folder;
+	GPtrArray *uncached;
+	GHashTable *uncached_set;
+	guint64 total = 0;
+	guint ii;
+
+	uncached = camel_folder_get_uncached_uids (folder, uids, NULL);
+	if (uncached == NULL)
+		return;
+
+	g_ptr_array_sort (uncached, imapx_prefetch_uid_cmp);
+
+	uncached_set = g_hash_table_new (g_str_hash, g_str_equal);
+	for (ii = 0; ii < uncached->len; ii++)
+		g_hash_table_add (uncached_set, uncached->pdata[ii]);
+
+	for (ii = 0; size_limit > 0 && ii < uids->len; ii++) {
+		CamelMessageInfo *mi;
+
+		if (g_hash_table_contains (uncached_set, uids->pdata[ii]))
+			continue;
+
+		mi = camel_folder_summary_get (folder->summary, uids->pdata[ii]);
+		if (mi != NULL) {
+			total += camel_message_info_size (mi);
+			camel_message_info_free (mi);
+		}
+	}
+
+	for (ii = 0; ii < uncached->len; ii++) {
+		CamelMessageInfo *mi;
+		guint32 size = 0;
+
+		mi = camel_folder_summary_get (folder->summary, uncached->pdata[ii]);
+		if (mi != NULL) {
+			size = camel_message_info_size (mi);
+			camel_message_info_free (mi);
+		}
+
+		if (size_limit > 0 && total + size > size_limit)
+			break;
+
+		total += size;
+
+		g_ptr_array_add (
+			data->uids,
+			(gpointer) camel_pstring_strdup (uncached->pdata[ii]));
+		g_array_append_val (data->sizes, size);
+	}
+
+	g_hash_table_destroy (uncached_set);
+	camel_folder_free_uids (folder, uncached);
+}
+
+/* Downloads messages for offline use on all the connections we may
+ * open but one, which stays free for whatever the user does next.
+ * Workers also step aside whenever an interactive job is queued. */
+static gboolean
+imapx_downsync_sync (CamelOfflineFolder *offline_folder,
+                     const gchar *expression,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (offline_folder);
+	CamelIMAPXStore *istore;
+	CamelIMAPXServer *server;
+	CamelSettings *settings;
+	PrefetchData data;
+	PrefetchWorker *workers;
+	GPtrArray *uids;
+	GList *servers, *link;
+	const gchar *folder_name;
+	guint concurrent_connections;
+	guint64 size_limit;
+	guint n_workers, ii;
+
+	istore = CAMEL_IMAPX_STORE (camel_folder_get_parent_store (folder));
+	folder_name = camel_folder_get_full_name (folder);
+
+	if (!camel_offline_store_get_online (CAMEL_OFFLINE_STORE (istore)))
+		return TRUE;
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (istore));
+	concurrent_connections =
+		camel_imapx_settings_get_concurrent_connections (
+		CAMEL_IMAPX_SETTINGS (settings));
+	size_limit = (guint64)
+		camel_imapx_settings_get_prefetch_size_limit (
+		CAMEL_IMAPX_SETTINGS (settings)) * 1024 * 1024;
+	memset (&data, 0, sizeof (PrefetchData));
+	data.bytes_per_second = (guint64)
+		camel_imapx_settings_get_prefetch_bandwidth (
+		CAMEL_IMAPX_SETTINGS (settings)) * 1024;
+	g_object_unref (settings);
+
+	data.folder = folder;
+	data.istore = istore;
+	data.cancellable = cancellable;
+	data.uids = g_ptr_array_new_with_free_func (
+		(GDestroyNotify) camel_pstring_free);
+	data.sizes = g_array_new (FALSE, FALSE, sizeof (guint32));
+	g_mutex_init (&data.lock);
+
+	camel_operation_push_message (
+		cancellable, _("Syncing messages in folder '%s' to disk"),
+		camel_folder_get_display_name (folder));
+
+	if (expression != NULL)
+		uids = camel_folder_search_by_expression (
+			folder, expression, cancellable, NULL);
+	else
+		uids = camel_folder_get_uids (folder);
+
+	if (uids != NULL) {
+		imapx_prefetch_select (&data, uids, size_limit);
+
+		if (expression != NULL)
+			camel_folder_search_free (folder, uids);
+		else
+			camel_folder_free_uids (folder, uids);
+	}
+
+	if (data.uids->len == 0)
+		goto exit;
+
+	server = camel_imapx_store_get_server (
+		istore, folder_name, cancellable, NULL);
+	if (server == NULL)
+		goto exit;
+
+	servers = NULL;
+	if (concurrent_connections > 2 && data.uids->len > 1)
+		servers = camel_imapx_conn_manager_get_spare_connections (
+			istore->con_man, folder_name,
+			MIN (concurrent_connections - 2, data.uids->len - 1),
+			cancellable);
+	servers = g_list_prepend (servers, server);
+	n_workers = g_list_length (servers);
+
+	data.start_time = g_get_monotonic_time ();
+	workers = g_new0 (PrefetchWorker, n_workers);
+
+	for (link = servers, ii = 0; link != NULL; link = g_list_next (link), ii++) {
+		workers[ii].data = &data;
+		workers[ii].server = link->data;
+		workers[ii].thread = g_thread_new (
+			NULL, imapx_prefetch_thread, &workers[ii]);
+	}
+
+	for (ii = 0; ii < n_workers; ii++)
+		g_thread_join (workers[ii].thread);
+
+	for (link = servers; link != NULL; link = g_list_next (link))
+		camel_imapx_store_op_done (istore, link->data, folder_name);
+
+	g_list_free_full (servers, (GDestroyNotify) g_object_unref);
+	g_free (workers);
+
+exit:
+	camel_operation_pop_message (cancellable);
+
+	g_ptr_array_free (data.uids, TRUE);
+	g_array_free (data.sizes, TRUE);
+	g_mutex_clear (&data.lock);
+
+	return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
 static void
 camel_imapx_folder_class_init (CamelIMAPXFolderClass *class)
 {
 	GObjectClass *object_class;
 	CamelFolderClass *folder_class;
+	CamelOfflineFolderClass *offline_folder_class;
 
 	g_type_class_add_private (class, sizeof (CamelIMAPXFolderPrivate));
 
@@ -1106,6 +2010,9 @@ camel_imapx_folder_class_init (CamelIMAPXFolderClass *class)
 	folder_class->synchronize_message_sync = imapx_synchronize_message_sync;
 	folder_class->transfer_messages_to_sync = imapx_transfer_messages_to_sync;
 
+	offline_folder_class = CAMEL_OFFLINE_FOLDER_CLASS (class);
+	offline_folder_class->downsync_sync = imapx_downsync_sync;
+
 	g_object_class_install_property (
 		object_class,
 		PROP_APPLY_FILTERS,
@@ -1361,3 +2268,78 @@ camel_imapx_folder_add_move_to_real_trash (CamelIMAPXFolder *folder,
 	g_mutex_unlock (&folder->priv->move_to_hash_table_lock);
 }
 
+/**
+ * camel_imapx_folder_get_message_part:
+ * @folder: a #CamelIMAPXFolder
+ * @message_uid: a message UID
+ * @section: the part's section number, as in BODYSTRUCTURE
+ * @encoding: the part's Content-Transfer-Encoding, or %NULL
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns the decoded content of a single MIME part of a message,
+ * from @folder's data cache if it was downloaded before, else from
+ * the server.  Unreference the returned #CamelStream with
+ * g_object_unref() when finished with it.
+ *
+ * Returns: a #CamelStream, or %NULL on error
+ *
+ * Since: 3.8
+ **/
+CamelStream *
+camel_imapx_folder_get_message_part (CamelIMAPXFolder *folder,
+                                     const gchar *message_uid,
+                                     const gchar *section,
+                                     const gchar *encoding,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	CamelStore *parent_store;
+	CamelIMAPXStore *istore;
+	CamelIMAPXServer *server;
+	CamelStream *stream;
+	const gchar *folder_name;
+	gchar *cache_key;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_FOLDER (folder), NULL);
+	g_return_val_if_fail (message_uid != NULL, NULL);
+	g_return_val_if_fail (section != NULL, NULL);
+
+	cache_key = imapx_message_part_key (message_uid, section);
+	stream = camel_data_cache_get (folder->cache, "part", cache_key, NULL);
+	g_free (cache_key);
+
+	if (stream != NULL)
+		return stream;
+
+	folder_name = camel_folder_get_full_name (CAMEL_FOLDER (folder));
+	parent_store = camel_folder_get_parent_store (CAMEL_FOLDER (folder));
+	istore = CAMEL_IMAPX_STORE (parent_store);
+
+	if (!camel_offline_store_get_online (CAMEL_OFFLINE_STORE (istore))) {
+		g_set_error (
+			error, CAMEL_SERVICE_ERROR,
+			CAMEL_SERVICE_ERROR_UNAVAILABLE,
+			_("You must be working online to complete this operation"));
+		return NULL;
+	}
+
+	cache_key = imapx_message_part_key (message_uid, section);
+	server = camel_imapx_conn_manager_ref_fetching_connection (
+		istore->con_man, CAMEL_FOLDER (folder), cache_key);
+	g_free (cache_key);
+
+	if (server == NULL)
+		server = camel_imapx_store_get_interactive_server (
+			istore, folder_name, cancellable, error);
+	if (server == NULL)
+		return NULL;
+
+	stream = camel_imapx_server_get_message_part (
+		server, CAMEL_FOLDER (folder), message_uid,
+		section, encoding, cancellable, error);
+	camel_imapx_store_op_done (istore, server, folder_name);
+	g_object_unref (server);
+
+	return stream;
+}
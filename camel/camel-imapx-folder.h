@@ -101,6 +101,13 @@ void		camel_imapx_folder_add_move_to_real_junk
 void		camel_imapx_folder_add_move_to_real_trash
 						(CamelIMAPXFolder *folder,
 						 const gchar *message_uid);
+CamelStream *	camel_imapx_folder_get_message_part
+						(CamelIMAPXFolder *folder,
+						 const gchar *message_uid,
+						 const gchar *section,
+						 const gchar *encoding,
+						 GCancellable *cancellable,
+						 GError **error);
 
 G_END_DECLS
 
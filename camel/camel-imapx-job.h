@@ -56,6 +56,9 @@ struct _CamelIMAPXJob {
 	guint32 type;		/* operation type */
 	gint pri;		/* the command priority */
 	gshort commands;	/* counts how many commands are outstanding */
+
+	gint64 queued_time;	/* monotonic time when it was queued */
+	gint64 started_time;	/* ... and when its first command was sent */
 };
 
 CamelIMAPXJob *	camel_imapx_job_new		(GCancellable *cancellable);
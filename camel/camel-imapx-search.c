@@ -157,6 +157,37 @@ imapx_search_body_contains (CamelSExp *sexp,
 		}
 	}
 
+	if (search->current != NULL) {
+		guint count = 0;
+
+		/* Only a yes or no is needed for a single message,
+		 * so let the server just count the matches. */
+		camel_imapx_server_uid_search_count (
+			server, search->folder, criteria->str,
+			&count, NULL, &error);
+
+		/* XXX No allowance for errors in CamelSExp callbacks!
+		 *     Dump the error to the console and make like we
+		 *     got an empty result. */
+		if (error != NULL) {
+			g_warning (
+				"%s: (UID SEARCH %s): %s",
+				G_STRFUNC, criteria->str, error->message);
+			g_error_free (error);
+			count = 0;
+		}
+
+		type = CAMEL_SEXP_RES_BOOL;
+		result = camel_sexp_result_new (sexp, type);
+		result->value.boolean = (count > 0);
+
+		g_string_free (criteria, TRUE);
+
+		g_object_unref (server);
+
+		return result;
+	}
+
 	uids = camel_imapx_server_uid_search (
 		server, search->folder, criteria->str, NULL, &error);
 
@@ -176,15 +207,9 @@ imapx_search_body_contains (CamelSExp *sexp,
 		g_error_free (error);
 	}
 
-	if (search->current != NULL) {
-		type = CAMEL_SEXP_RES_BOOL;
-		result = camel_sexp_result_new (sexp, type);
-		result->value.boolean = (uids->len > 0);
-	} else {
-		type = CAMEL_SEXP_RES_ARRAY_PTR;
-		result = camel_sexp_result_new (sexp, type);
-		result->value.ptrarray = g_ptr_array_ref (uids);
-	}
+	type = CAMEL_SEXP_RES_ARRAY_PTR;
+	result = camel_sexp_result_new (sexp, type);
+	result->value.ptrarray = g_ptr_array_ref (uids);
 
 	g_ptr_array_unref (uids);
 
@@ -68,15 +68,34 @@
 /* Try pipelining fetch requests, 'in bits' */
 #define MULTI_SIZE (20480)
 
+/* Large messages are fetched with this many partial fetches in flight.
+ * Chunks start at MULTI_SIZE and are resized from the measured rate so
+ * that each takes about IMAPX_FETCH_CHUNK_TIME (in microseconds), but
+ * never more than IMAPX_FETCH_MAX_CHUNK bytes. */
+#define IMAPX_FETCH_PIPELINE_DEPTH (4)
+#define IMAPX_FETCH_CHUNK_TIME (250 * 1000)
+#define IMAPX_FETCH_MAX_CHUNK (1024 * 1024)
+
 /* How many outstanding commands do we allow before we just queue them? */
 #define MAX_COMMANDS (10)
 
 #define MAX_COMMAND_LEN 1000
 
+/* With CONDSTORE we only ask for flags changed since the last known
+ * HIGHESTMODSEQ, but still fetch all of them this often (in seconds),
+ * in case something slipped through. */
+#define IMAPX_FULL_SCAN_INTERVAL (6 * 60 * 60)
+
+/* With MULTIAPPEND, upload at most this many messages, or about
+ * this many bytes, in a single APPEND command. */
+#define IMAPX_APPEND_BATCH_COUNT (50)
+#define IMAPX_APPEND_BATCH_SIZE (8 * 1024 * 1024)
+
 extern gint camel_application_is_exiting;
 
 /* Job-specific structs */
 typedef struct _GetMessageData GetMessageData;
+typedef struct _BodystructureData BodystructureData;
 typedef struct _RefreshInfoData RefreshInfoData;
 typedef struct _SyncChangesData SyncChangesData;
 typedef struct _AppendMessageData AppendMessageData;
@@ -92,6 +111,14 @@ typedef struct _SearchData SearchData;
 struct _GetMessageData {
 	/* in: uid requested */
 	gchar *uid;
+	/* in: single MIME part requested, or NULL for the whole message */
+	gchar *section;
+	/* in: data cache key; the uid, or the uid and section for parts */
+	gchar *cache_key;
+	/* in: the part's Content-Transfer-Encoding, to decode it here */
+	gchar *encoding;
+	/* in: fetch the part as BINARY, already decoded by the server */
+	gboolean use_binary;
 	/* in/out: message content stream output */
 	CamelStream *stream;
 	/* working variables */
@@ -100,6 +127,23 @@ struct _GetMessageData {
 	gsize fetch_offset;
 	gsize size;
 	gboolean use_multi_fetch;
+	/* size of the next partial fetch, and when the last one ended */
+	gsize chunk_size;
+	gint64 chunk_time;
+	/* why storing the fetched data failed, reported once
+	 * the last FETCH of the job is done */
+	GError *error;
+};
+
+struct _BodystructureData {
+	/* in: uid requested */
+	gchar *uid;
+	/* out: the parsed BODYSTRUCTURE */
+	struct _CamelMessageContentInfo *cinfo;
+	/* out: the message header, fetched alongside */
+	GByteArray *header;
+	/* out: why the command failed */
+	GError *error;
 };
 
 struct _RefreshInfoData {
@@ -112,9 +156,17 @@ struct _RefreshInfoData {
 	CamelFetchType fetch_type;
 	gboolean update_unseen;
 	gboolean scan_changes;
+	/* whether the connection manager counts this
+	 * refresh as the last one before a NOTIFY event */
+	gboolean notify_tracked;
+	/* non-zero when only changes since this modseq were fetched */
+	guint64 changed_since;
 	struct _uidset_state uidset;
 	/* changes during refresh */
 	CamelFolderChangeInfo *changes;
+	/* when set, new message infos are collected
+	 * here instead of going into the summary */
+	GPtrArray *collected;
 };
 
 struct _SyncChangesData {
@@ -133,15 +185,21 @@ struct _SyncChangesData {
 };
 
 struct _AppendMessageData {
-	gchar *path;
-	CamelMessageInfo *info;
-	gchar *appended_uid;
+	/* spool file paths and infos with temporary uids, one per message */
+	GPtrArray *paths;
+	GPtrArray *infos;
+	/* uids assigned by the server, NULL where not known */
+	GPtrArray *appended_uids;
+	/* the messages sent by the APPEND in progress */
+	guint index;
+	guint batch;
 };
 
 struct _CopyMessagesData {
 	CamelFolder *dest;
 	GPtrArray *uids;
 	gboolean delete_originals;
+	gboolean use_move;
 	gint index;
 	gint last_index;
 	struct _uidset_state uidset;
@@ -174,7 +232,10 @@ struct _DeleteFolderData {
 
 struct _SearchData {
 	gchar *criteria;
+	/* only ask the server for the number of matches */
+	gboolean count_only;
 	GArray *results;
+	gint64 count;
 };
 
 struct _QuotaData {
@@ -219,6 +280,10 @@ static gboolean	imapx_untagged_capability	(CamelIMAPXServer *is,
 						 CamelIMAPXStream *stream,
 						 GCancellable *cancellable,
 						 GError **error);
+static gboolean	imapx_untagged_esearch		(CamelIMAPXServer *is,
+						 CamelIMAPXStream *stream,
+						 GCancellable *cancellable,
+						 GError **error);
 static gboolean	imapx_untagged_exists		(CamelIMAPXServer *is,
 						 CamelIMAPXStream *stream,
 						 GCancellable *cancellable,
@@ -284,6 +349,7 @@ enum {
 	IMAPX_UNTAGGED_ID_BAD = 0,
 	IMAPX_UNTAGGED_ID_BYE,
 	IMAPX_UNTAGGED_ID_CAPABILITY,
+	IMAPX_UNTAGGED_ID_ESEARCH,
 	IMAPX_UNTAGGED_ID_EXISTS,
 	IMAPX_UNTAGGED_ID_EXPUNGE,
 	IMAPX_UNTAGGED_ID_FETCH,
@@ -307,6 +373,7 @@ static const CamelIMAPXUntaggedRespHandlerDesc _untagged_descr[] = {
 	{CAMEL_IMAPX_UNTAGGED_BAD, imapx_untagged_ok_no_bad, NULL, FALSE},
 	{CAMEL_IMAPX_UNTAGGED_BYE, imapx_untagged_bye, NULL, FALSE},
 	{CAMEL_IMAPX_UNTAGGED_CAPABILITY, imapx_untagged_capability, NULL, FALSE},
+	{CAMEL_IMAPX_UNTAGGED_ESEARCH, imapx_untagged_esearch, NULL, FALSE},
 	{CAMEL_IMAPX_UNTAGGED_EXISTS, imapx_untagged_exists, NULL, TRUE},
 	{CAMEL_IMAPX_UNTAGGED_EXPUNGE, imapx_untagged_expunge, NULL, TRUE},
 	{CAMEL_IMAPX_UNTAGGED_FETCH, imapx_untagged_fetch, NULL, TRUE},
@@ -338,7 +405,38 @@ struct _CamelIMAPXServerPrivate {
 	 * The search command should claim the results
 	 * when finished and reset the pointer to NULL. */
 	GArray *search_results;
+	/* COUNT from an untagged ESEARCH, or -1 if there was none */
+	gint64 search_count;
 	GMutex search_results_lock;
+
+	/* Folder counts reported with LIST-STATUS or NOTIFY, keyed
+	 * by folder path.  Each entry stands in for a STATUS once. */
+	GHashTable *stashed_status;
+	GMutex stashed_status_lock;
+
+	/* Paths of folders with a refresh after a NOTIFY event
+	 * submitted but not started, guarded by stashed_status_lock. */
+	GHashTable *notify_refreshes;
+
+	/* Per IMAPXJobKind, guarded by QUEUE_LOCK. */
+	IMAPXJobLatency latency[IMAPX_N_JOB_KINDS];
+
+	/* Reused for every untagged FETCH, only
+	 * touched from the parser thread. */
+	struct _fetch_info *fetch_info;
+	CamelMimeParser *header_parser;
+
+	/* Traffic and command timings for this connection,
+	 * shared with the stream.  Has its own lock. */
+	IMAPXServerStats *stats;
+
+	/* The pending SELECT carries QRESYNC parameters. */
+	gboolean select_qresync;
+
+	/* Set while the parser thread waits for the next response with
+	 * nothing of it read, the only time the IDLE dwell timer may
+	 * cancel its read to wake it.  Guarded by QUEUE_LOCK. */
+	gboolean parser_waiting;
 };
 
 enum {
@@ -413,7 +511,9 @@ enum {
 	IMAPX_JOB_RENAME_FOLDER = 1 << 13,
 	IMAPX_JOB_FETCH_MESSAGES = 1 << 14,
 	IMAPX_JOB_UPDATE_QUOTA_INFO = 1 << 15,
-	IMAPX_JOB_UID_SEARCH = 1 << 16
+	IMAPX_JOB_UID_SEARCH = 1 << 16,
+	IMAPX_JOB_STATUS = 1 << 17,
+	IMAPX_JOB_GET_BODYSTRUCTURE = 1 << 18
 };
 
 /* Operations on the store (folder_tree) will have highest priority as we know for sure they are sync
@@ -471,6 +571,16 @@ static gboolean	imapx_command_copy_messages_step_start
 						 gint index,
 						 GCancellable *cancellable,
 						 GError **error);
+static gboolean	imapx_command_fetch_message_done
+						(CamelIMAPXServer *is,
+						 CamelIMAPXCommand *ic,
+						 GCancellable *cancellable,
+						 GError **error);
+static gboolean	imapx_job_append_message_step
+						(CamelIMAPXJob *job,
+						 CamelIMAPXServer *is,
+						 GCancellable *cancellable,
+						 GError **error);
 
 enum _idle_state {
 	IMAPX_IDLE_OFF,
@@ -487,15 +597,14 @@ enum _idle_state {
 
 struct _CamelIMAPXIdle {
 	GMutex idle_lock;
-	GThread *idle_thread;
 
-	GCond start_watch_cond;
-	GMutex start_watch_mutex;
-	gboolean start_watch_is_set;
+	/* Dwell timer on the shared IDLE context, while PENDING */
+	GSource *dwell_source;
+	/* Set when it fires, for the parser thread to send IDLE */
+	gboolean wake;
 
 	time_t started;
 	enum _idle_state state;
-	gboolean idle_exit;
 };
 
 typedef enum {
@@ -518,6 +627,12 @@ static gboolean	camel_imapx_server_idle		(CamelIMAPXServer *is,
 						 CamelFolder *folder,
 						 GCancellable *cancellable,
 						 GError **error);
+static gboolean	imapx_server_fetch_new_messages	(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 gboolean async,
+						 gboolean update_unseen,
+						 GCancellable *cancellable,
+						 GError **error);
 
 enum {
 	USE_SSL_NEVER,
@@ -597,13 +712,34 @@ static void
 get_message_data_free (GetMessageData *data)
 {
 	g_free (data->uid);
+	g_free (data->section);
+	g_free (data->encoding);
+	g_free (data->cache_key);
 
 	if (data->stream != NULL)
 		g_object_unref (data->stream);
 
+	g_clear_error (&data->error);
+
 	g_slice_free (GetMessageData, data);
 }
 
+static void
+bodystructure_data_free (BodystructureData *data)
+{
+	g_free (data->uid);
+
+	if (data->cinfo != NULL)
+		imapx_free_body (data->cinfo);
+
+	if (data->header != NULL)
+		g_byte_array_free (data->header, TRUE);
+
+	g_clear_error (&data->error);
+
+	g_slice_free (BodystructureData, data);
+}
+
 static void
 refresh_info_data_infos_free (RefreshInfoData *data)
 {
@@ -629,6 +765,13 @@ refresh_info_data_free (RefreshInfoData *data)
 	camel_folder_change_info_free (data->changes);
 	refresh_info_data_infos_free (data);
 
+	if (data->collected != NULL) {
+		g_ptr_array_foreach (
+			data->collected, (GFunc)
+			camel_message_info_free, NULL);
+		g_ptr_array_free (data->collected, TRUE);
+	}
+
 	g_slice_free (RefreshInfoData, data);
 }
 
@@ -649,10 +792,14 @@ sync_changes_data_free (SyncChangesData *data)
 static void
 append_message_data_free (AppendMessageData *data)
 {
-	g_free (data->path);
-	g_free (data->appended_uid);
+	g_ptr_array_free (data->paths, TRUE);
+	g_ptr_array_foreach (data->infos, (GFunc) camel_message_info_free, NULL);
+	g_ptr_array_free (data->infos, TRUE);
 
-	camel_message_info_free (data->info);
+	if (data->appended_uids != NULL) {
+		g_ptr_array_foreach (data->appended_uids, (GFunc) g_free, NULL);
+		g_ptr_array_free (data->appended_uids, TRUE);
+	}
 
 	g_slice_free (AppendMessageData, data);
 }
@@ -671,6 +818,23 @@ copy_messages_data_free (CopyMessagesData *data)
 	g_slice_free (CopyMessagesData, data);
 }
 
+/* New messages in the destination folder which we put there ourselves
+ * should not be treated as recent when they are fetched. */
+static void
+imapx_copy_messages_ignore_recent (CopyMessagesData *data,
+                                   GPtrArray *copied_uids)
+{
+	CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) data->dest;
+	gint i;
+
+	for (i = 0; i < copied_uids->len; i++) {
+		guint32 uid = GPOINTER_TO_UINT (g_ptr_array_index (copied_uids, i));
+		gchar *str = g_strdup_printf ("%d",uid);
+
+		g_hash_table_insert (ifolder->ignore_recent, str, GINT_TO_POINTER (1));
+	}
+}
+
 static void
 list_data_free (ListData *data)
 {
@@ -829,6 +993,7 @@ imapx_command_start (CamelIMAPXServer *is,
 {
 	CamelIMAPXStream *stream = NULL;
 	CamelIMAPXCommandPart *cp;
+	CamelIMAPXJob *job;
 	gboolean cp_continuation;
 	gboolean cp_literal_plus;
 	GList *head;
@@ -854,6 +1019,14 @@ imapx_command_start (CamelIMAPXServer *is,
 
 	camel_imapx_command_queue_push_tail (is->active, ic);
 
+	ic->sent_time = g_get_monotonic_time ();
+	if (ic->queued_time == 0)
+		ic->queued_time = ic->sent_time;
+
+	job = camel_imapx_command_get_job (ic);
+	if (job != NULL && job->started_time == 0)
+		job->started_time = ic->sent_time;
+
 	stream = camel_imapx_server_ref_stream (is);
 
 	if (stream == NULL) {
@@ -930,6 +1103,24 @@ duplicate_fetch_or_refresh (CamelIMAPXServer *is,
 	return FALSE;
 }
 
+/* A NOOP for the folder being selected does the same whether or not
+ * the SELECT works, so it can go out right behind it instead of
+ * waiting a round trip.  Refreshing a folder with QRESYNC relies on
+ * this to cost a single round trip when nothing has changed. */
+static gboolean
+imapx_command_follows_select (CamelIMAPXServer *is,
+                              CamelIMAPXCommand *ic)
+{
+	CamelIMAPXJob *job;
+
+	if (ic->select == NULL || ic->select != is->select_pending)
+		return FALSE;
+
+	job = camel_imapx_command_get_job (ic);
+
+	return job != NULL && job->type == IMAPX_JOB_NOOP;
+}
+
 /* See if we can start another task yet.
  *
  * If we're waiting for a literal, we cannot proceed.
@@ -979,7 +1170,7 @@ imapx_command_start_next (CamelIMAPXServer *is,
 				break;
 
 			c (is->tagprefix, "-- %3d '%s'?\n", (gint) ic->pri, ic->name);
-			if (!ic->select) {
+			if (!ic->select || imapx_command_follows_select (is, ic)) {
 				c (is->tagprefix, "--> starting '%s'\n", ic->name);
 				min_pri = ic->pri;
 				g_queue_push_tail (&start, link);
@@ -1264,6 +1455,7 @@ imapx_command_queue (CamelIMAPXServer *is,
 		return FALSE;
 	}
 
+	ic->queued_time = g_get_monotonic_time ();
 	camel_imapx_command_queue_insert_sorted (is->queue, ic);
 
 	success = imapx_command_start_next (is, cancellable, error);
@@ -1305,6 +1497,38 @@ exit:
 	return ic;
 }
 
+/* Returns whether a STATUS we sent for @folder is awaiting its
+ * reply, so an untagged STATUS for it is most likely that reply. */
+static gboolean
+imapx_is_status_active (CamelIMAPXServer *is,
+                        CamelFolder *folder)
+{
+	GList *head, *link;
+	gboolean active = FALSE;
+
+	QUEUE_LOCK (is);
+
+	head = camel_imapx_command_queue_peek_head_link (is->active);
+
+	for (link = head; link != NULL; link = g_list_next (link)) {
+		CamelIMAPXCommand *ic = link->data;
+		CamelIMAPXJob *job;
+
+		if (g_strcmp0 (ic->name, "STATUS") != 0)
+			continue;
+
+		job = camel_imapx_command_get_job (ic);
+		if (job != NULL && camel_imapx_job_has_folder (job, folder)) {
+			active = TRUE;
+			break;
+		}
+	}
+
+	QUEUE_UNLOCK (is);
+
+	return active;
+}
+
 /* Must not have QUEUE lock */
 static CamelIMAPXJob *
 imapx_match_active_job (CamelIMAPXServer *is,
@@ -1341,6 +1565,59 @@ imapx_match_active_job (CamelIMAPXServer *is,
 	return match;
 }
 
+/* Returns the data of the UID MOVE in progress which moved the source
+ * @uids of an untagged COPYUID, so with several moves in flight the
+ * new uids are credited to the right destination. */
+static CopyMessagesData *
+imapx_match_active_move (CamelIMAPXServer *is,
+                         GPtrArray *uids)
+{
+	CopyMessagesData *match = NULL;
+	GList *head, *link;
+	guint32 first_uid;
+
+	if (uids == NULL || uids->len == 0)
+		return NULL;
+
+	first_uid = GPOINTER_TO_UINT (g_ptr_array_index (uids, 0));
+
+	QUEUE_LOCK (is);
+
+	head = camel_imapx_command_queue_peek_head_link (is->active);
+
+	for (link = head; link != NULL && match == NULL; link = g_list_next (link)) {
+		CamelIMAPXCommand *ic = link->data;
+		CamelIMAPXJob *job;
+		CopyMessagesData *data;
+		gint ii;
+
+		if (g_strcmp0 (ic->name, "MOVE") != 0)
+			continue;
+
+		job = camel_imapx_command_get_job (ic);
+		if (job == NULL)
+			continue;
+
+		data = camel_imapx_job_get_data (job);
+		if (data == NULL || !data->use_move)
+			continue;
+
+		/* A job has one MOVE at a time, for these uids. */
+		for (ii = data->last_index; ii < data->index; ii++) {
+			const gchar *uid = g_ptr_array_index (data->uids, ii);
+
+			if (strtoul (uid, NULL, 10) == first_uid) {
+				match = data;
+				break;
+			}
+		}
+	}
+
+	QUEUE_UNLOCK (is);
+
+	return match;
+}
+
 static CamelIMAPXJob *
 imapx_is_job_in_queue (CamelIMAPXServer *is,
                        CamelFolder *folder,
@@ -1467,6 +1744,7 @@ invalidate_local_cache (CamelIMAPXFolder *ifolder,
 
 	camel_data_cache_clear (ifolder->cache, "cache");
 	camel_data_cache_clear (ifolder->cache, "cur");
+	camel_data_cache_clear (ifolder->cache, "part");
 
 	camel_folder_changed (cfolder, changes);
 	camel_folder_change_info_free (changes);
@@ -1678,6 +1956,133 @@ imapx_untagged_flags (CamelIMAPXServer *is,
 	return TRUE;
 }
 
+/* Header fields requested for new messages.  This is everything
+ * camel_folder_summary_info_new_from_parser() looks at, plus the
+ * fields camel_header_raw_check_mailing_list() uses to detect the
+ * mailing list.  Received is left out on purpose; there are often
+ * a dozen of them and INTERNALDATE gives us the same timestamp. */
+#define IMAPX_SUMMARY_HEADERS \
+	"DATE FROM TO CC SUBJECT MESSAGE-ID IN-REPLY-TO REFERENCES " \
+	"CONTENT-TYPE LIST-ID LIST-POST LIST-UNSUBSCRIBE MAILING-LIST " \
+	"ORIGINATOR X-MAILING-LIST X-LOOP X-LIST SENDER DELIVERED-TO " \
+	"RETURN-PATH X-BEENTHERE"
+
+/* Builds the FETCH items used to create summary entries for new
+ * messages, including any additional header fields the user asked
+ * for in CamelIMAPXSettings:fetch-headers-extra. */
+static gchar *
+imapx_dup_summary_fetch_items (CamelIMAPXServer *is,
+                               gboolean with_flags)
+{
+	CamelIMAPXSettings *settings;
+	gchar **extra;
+	GString *items;
+	gint ii;
+
+	settings = camel_imapx_server_ref_settings (is);
+	extra = camel_imapx_settings_dup_fetch_headers_extra (settings);
+	g_object_unref (settings);
+
+	items = g_string_new (
+		"RFC822.SIZE INTERNALDATE BODY.PEEK[HEADER.FIELDS ("
+		IMAPX_SUMMARY_HEADERS);
+
+	for (ii = 0; extra != NULL && extra[ii] != NULL; ii++) {
+		const gchar *name = extra[ii];
+
+		/* Only plain field names are valid here, anything
+		 * else would break the command. */
+		if (*name == '\0' || strpbrk (name, " \t\r\n()[]{}\"\\") != NULL)
+			continue;
+
+		g_string_append_c (items, ' ');
+		g_string_append (items, name);
+	}
+
+	g_string_append (items, ")]");
+
+	if (with_flags)
+		g_string_append (items, " FLAGS");
+
+	g_strfreev (extra);
+
+	return g_string_free (items, FALSE);
+}
+
+/* INTERNALDATE looks like "17-Jul-1996 02:44:25 -0700", which
+ * camel_header_decode_date() does not read as-is because of the
+ * dashes in the date part. */
+static time_t
+imapx_decode_internaldate (const gchar *internaldate)
+{
+	gchar *date, *dash;
+	time_t result;
+	gint ii;
+
+	date = g_strdup (internaldate);
+
+	for (ii = 0, dash = date; ii < 2; ii++) {
+		dash = strchr (dash, '-');
+		if (dash == NULL)
+			break;
+		*dash = ' ';
+	}
+
+	result = camel_header_decode_date (date, NULL);
+
+	g_free (date);
+
+	return result;
+}
+
+static CamelIMAPXJob *
+imapx_match_fetch_body_job (CamelIMAPXServer *is,
+                            struct _fetch_info *finfo)
+{
+	CamelIMAPXJob *job;
+
+	if (finfo->section != NULL && *finfo->section != '\0') {
+		gchar *key;
+
+		key = imapx_message_part_key (finfo->uid, finfo->section);
+		job = imapx_match_active_job (
+			is, IMAPX_JOB_GET_MESSAGE, key);
+		g_free (key);
+	} else {
+		job = imapx_match_active_job (
+			is, IMAPX_JOB_GET_MESSAGE, finfo->uid);
+	}
+
+	return job;
+}
+
+/* Lets the FETCH parser write message data straight
+ * to the cache stream of the job it is meant for. */
+static CamelStream *
+imapx_fetch_body_sink (struct _fetch_info *finfo,
+                       gpointer user_data)
+{
+	CamelIMAPXServer *is = user_data;
+	CamelIMAPXJob *job;
+	GetMessageData *data;
+
+	job = imapx_match_fetch_body_job (is, finfo);
+	if (job == NULL)
+		return NULL;
+
+	data = camel_imapx_job_get_data (job);
+	if (data == NULL || data->stream == NULL)
+		return NULL;
+
+	if (data->use_multi_fetch)
+		g_seekable_seek (
+			G_SEEKABLE (data->stream),
+			finfo->offset, G_SEEK_SET,
+			NULL, NULL);
+
+	return g_object_ref (data->stream);
+}
+
 static gboolean
 imapx_untagged_fetch (CamelIMAPXServer *is,
                       CamelIMAPXStream *stream,
@@ -1690,18 +2095,28 @@ imapx_untagged_fetch (CamelIMAPXServer *is,
 	/* cancellable may be NULL */
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	finfo = imapx_parse_fetch (stream, cancellable, error);
-	if (finfo == NULL) {
-		imapx_free_fetch (finfo);
+	if (is->priv->fetch_info == NULL) {
+		is->priv->fetch_info = g_malloc0 (sizeof (struct _fetch_info));
+		is->priv->fetch_info->body_sink = imapx_fetch_body_sink;
+		is->priv->fetch_info->body_sink_data = is;
+	}
+
+	/* Also drops anything left over from an earlier
+	 * response whose processing stopped halfway. */
+	finfo = is->priv->fetch_info;
+	imapx_reset_fetch (finfo);
+
+	if (!imapx_parse_fetch_into (stream, finfo, cancellable, error)) {
+		imapx_reset_fetch (finfo);
 		return FALSE;
 	}
 
 	if ((finfo->got & (FETCH_BODY | FETCH_UID)) == (FETCH_BODY | FETCH_UID)) {
 		CamelIMAPXJob *job;
 		GetMessageData *data;
+		GError *local_error = NULL;
 
-		job = imapx_match_active_job (
-			is, IMAPX_JOB_GET_MESSAGE, finfo->uid);
+		job = imapx_match_fetch_body_job (is, finfo);
 		g_return_val_if_fail (job != NULL, FALSE);
 
 		data = camel_imapx_job_get_data (job);
@@ -1713,19 +2128,70 @@ imapx_untagged_fetch (CamelIMAPXServer *is,
 		if (job != NULL) {
 			if (data->use_multi_fetch) {
 				data->body_offset = finfo->offset;
-				g_seekable_seek (
-					G_SEEKABLE (data->stream),
-					finfo->offset, G_SEEK_SET,
-					NULL, NULL);
+				if (!(finfo->got & FETCH_BODY_SUNK))
+					g_seekable_seek (
+						G_SEEKABLE (data->stream),
+						finfo->offset, G_SEEK_SET,
+						NULL, NULL);
 			}
 
-			data->body_len = camel_stream_write_to_stream (
-				finfo->body, data->stream, cancellable, error);
-			if (data->body_len == -1) {
-				g_prefix_error (
-					error, "%s: ",
-					_("Error writing to cache stream"));
-				return FALSE;
+			/* Already written by imapx_fetch_body_sink()? */
+			if (finfo->got & FETCH_BODY_SUNK) {
+				data->body_len = finfo->body_len;
+				local_error = finfo->body_error;
+				finfo->body_error = NULL;
+			} else {
+				data->body_len = camel_stream_write_to_stream (
+					finfo->body, data->stream,
+					cancellable, &local_error);
+			}
+
+			/* Only the job fails; the response was read in
+			 * full, so the connection carries on. */
+			if (data->body_len == -1 && data->error == NULL) {
+				if (local_error == NULL)
+					g_set_error (
+						&local_error, CAMEL_IMAPX_ERROR, 1,
+						"%s", _("Error writing to cache stream"));
+				else
+					g_prefix_error (
+						&local_error, "%s: ",
+						_("Error writing to cache stream"));
+				g_propagate_error (&data->error, local_error);
+				local_error = NULL;
+			}
+
+			g_clear_error (&local_error);
+		}
+	}
+
+	if ((finfo->got & (FETCH_CINFO | FETCH_UID)) == (FETCH_CINFO | FETCH_UID)) {
+		CamelIMAPXJob *job;
+
+		job = imapx_match_active_job (
+			is, IMAPX_JOB_GET_BODYSTRUCTURE, finfo->uid);
+
+		if (job != NULL) {
+			BodystructureData *data;
+
+			data = camel_imapx_job_get_data (job);
+			g_return_val_if_fail (data != NULL, FALSE);
+
+			if (data->cinfo != NULL)
+				imapx_free_body (data->cinfo);
+			data->cinfo = finfo->cinfo;
+			finfo->cinfo = NULL;
+
+			/* The header is ours, not a new message's */
+			if (finfo->got & FETCH_HEADER) {
+				if (data->header == NULL)
+					data->header = g_byte_array_new ();
+				g_byte_array_set_size (data->header, 0);
+				g_byte_array_append (
+					data->header,
+					finfo->header_buffer->data,
+					finfo->header_buffer->len);
+				finfo->got &= ~FETCH_HEADER;
 			}
 		}
 	}
@@ -1831,10 +2297,12 @@ imapx_untagged_fetch (CamelIMAPXServer *is,
 
 			/* Do we want to save these headers for later too?  Do we care? */
 
-			mp = camel_mime_parser_new ();
+			if (is->priv->header_parser == NULL)
+				is->priv->header_parser = camel_mime_parser_new ();
+
+			mp = is->priv->header_parser;
 			camel_mime_parser_init_with_stream (mp, finfo->header, NULL);
 			mi = camel_folder_summary_info_new_from_parser (folder->summary, mp);
-			g_object_unref (mp);
 
 			if (mi != NULL) {
 				guint32 server_flags;
@@ -1844,6 +2312,15 @@ imapx_untagged_fetch (CamelIMAPXServer *is,
 
 				mi->uid = camel_pstring_strdup (finfo->uid);
 
+				/* We don't fetch Received headers, so take the
+				 * received date from INTERNALDATE instead. */
+				if (finfo->date != NULL) {
+					binfo = (CamelMessageInfoBase *) mi;
+					if (binfo->date_received <= 0)
+						binfo->date_received =
+							imapx_decode_internaldate (finfo->date);
+				}
+
 				if (!(finfo->got & FETCH_FLAGS)) {
 					RefreshInfoData *data;
 					struct _refresh_info *r = NULL;
@@ -1915,16 +2392,22 @@ imapx_untagged_fetch (CamelIMAPXServer *is,
 					g_return_val_if_fail (data != NULL, FALSE);
 
 					imapx_set_message_info_flags_for_new_message (mi, server_flags, server_user_flags, folder);
-					camel_folder_summary_add (folder->summary, mi);
-					camel_folder_change_info_add_uid (data->changes, mi->uid);
 
-					if (!g_hash_table_lookup (ifolder->ignore_recent, mi->uid)) {
-						camel_folder_change_info_recent_uid (data->changes, mi->uid);
-						g_hash_table_remove (ifolder->ignore_recent, mi->uid);
-					}
+					/* A split sync merges these itself, in UID order. */
+					if (data->collected != NULL) {
+						g_ptr_array_add (data->collected, mi);
+					} else {
+						camel_folder_summary_add (folder->summary, mi);
+						camel_folder_change_info_add_uid (data->changes, mi->uid);
+
+						if (!g_hash_table_lookup (ifolder->ignore_recent, mi->uid)) {
+							camel_folder_change_info_recent_uid (data->changes, mi->uid);
+							g_hash_table_remove (ifolder->ignore_recent, mi->uid);
+						}
 
-					cnt = (camel_folder_summary_count (folder->summary) * 100 ) / ifolder->exists_on_server;
-					camel_operation_progress (cancellable, cnt ? cnt : 1);
+						cnt = (camel_folder_summary_count (folder->summary) * 100 ) / ifolder->exists_on_server;
+						camel_operation_progress (cancellable, cnt ? cnt : 1);
+					}
 				} else {
 					camel_message_info_free (mi);
 				}
@@ -1938,7 +2421,7 @@ imapx_untagged_fetch (CamelIMAPXServer *is,
 		}
 	}
 
-	imapx_free_fetch (finfo);
+	imapx_reset_fetch (finfo);
 
 	return TRUE;
 }
@@ -2169,63 +2652,476 @@ exit:
 	return success;
 }
 
-static gboolean
-imapx_untagged_status (CamelIMAPXServer *is,
-                       CamelIMAPXStream *stream,
-                       GCancellable *cancellable,
-                       GError **error)
+/* Returns the job of the active command tagged @tag, if any. */
+static CamelIMAPXJob *
+imapx_match_active_tag (CamelIMAPXServer *is,
+                        const gchar *tag)
 {
-	CamelIMAPXStore *store;
-	struct _state_info *sinfo = NULL;
-
-	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
-	/* cancellable may be NULL */
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	store = camel_imapx_server_ref_store (is);
-
-	sinfo = imapx_parse_status_info (stream, cancellable, error);
+	CamelIMAPXJob *match = NULL;
+	GList *head, *link;
+	gchar *ic_tag;
 
-	if (sinfo) {
-		CamelIMAPXStoreSummary *s = store->summary;
-		CamelIMAPXStoreNamespace *ns;
-		CamelFolder *folder = NULL;
+	QUEUE_LOCK (is);
 
-		ns = camel_imapx_store_summary_namespace_find_full (s, sinfo->name);
-		if (ns) {
-			gchar *path_name;
+	head = camel_imapx_command_queue_peek_head_link (is->active);
 
-			path_name = camel_imapx_store_summary_full_to_path (s, sinfo->name, ns->sep);
-			c (is->tagprefix, "Got folder path '%s' for full '%s'\n", path_name, sinfo->name);
-			if (path_name) {
-				folder = camel_store_get_folder_sync (
-					CAMEL_STORE (store),
-					path_name, 0, cancellable, error);
-				g_free (path_name);
-			}
-		}
-		if (folder != NULL) {
-			CamelIMAPXFolder *ifolder;
-
-			ifolder = CAMEL_IMAPX_FOLDER (folder);
-			ifolder->unread_on_server = sinfo->unseen;
-			ifolder->exists_on_server = sinfo->messages;
-			ifolder->modseq_on_server = sinfo->highestmodseq;
-			ifolder->uidnext_on_server = sinfo->uidnext;
-			ifolder->uidvalidity_on_server = sinfo->uidvalidity;
-			if (sinfo->uidvalidity && sinfo->uidvalidity != ((CamelIMAPXSummary *) folder->summary)->validity)
-				invalidate_local_cache (ifolder, sinfo->uidvalidity);
-		} else {
-			c (is->tagprefix, "Received STATUS for unknown folder '%s'\n", sinfo->name);
-		}
+	for (link = head; link != NULL && match == NULL; link = g_list_next (link)) {
+		CamelIMAPXCommand *ic = link->data;
 
-		g_free (sinfo->name);
-		g_free (sinfo);
+		ic_tag = g_strdup_printf ("%c%05u", is->tagprefix, ic->tag);
+		if (g_strcmp0 (ic_tag, tag) == 0)
+			match = camel_imapx_command_get_job (ic);
+		g_free (ic_tag);
 	}
 
-	g_object_unref (store);
+	QUEUE_UNLOCK (is);
 
-	return TRUE;
+	return match;
+}
+
+/* RFC 4731 ESEARCH:
+ *   ESEARCH [(TAG "tag")] [UID] *(name SP value)
+ * ALL is a sequence set, so large results stay compact on the wire.
+ * The TAG names the search the results belong to. */
+static gboolean
+imapx_untagged_esearch (CamelIMAPXServer *is,
+                        CamelIMAPXStream *stream,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	GArray *search_results;
+	CamelIMAPXJob *job = NULL;
+	gchar *tag = NULL;
+	gint64 count = -1;
+	gint tok;
+	guint len;
+	guchar *token;
+	gboolean success = FALSE;
+	GError *local_error = NULL;
+
+	search_results = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+	while (TRUE) {
+		tok = camel_imapx_stream_token (
+			stream, &token, &len, cancellable, error);
+		if (tok == '\n')
+			break;
+		if (tok == IMAPX_TOK_ERROR || tok == IMAPX_TOK_PROTOCOL)
+			goto exit;
+
+		if (tok == '(') {
+			gboolean is_tag = FALSE;
+
+			/* search correlator: (TAG "tag") */
+			while (tok != ')' && tok != '\n') {
+				tok = camel_imapx_stream_token (
+					stream, &token, &len, cancellable, error);
+				if (tok == IMAPX_TOK_ERROR || tok == IMAPX_TOK_PROTOCOL)
+					goto exit;
+				if (is_tag && tag == NULL &&
+				    (tok == IMAPX_TOK_STRING || tok == IMAPX_TOK_TOKEN))
+					tag = g_strndup ((gchar *) token, len);
+				is_tag = tok == IMAPX_TOK_TOKEN &&
+					g_ascii_strcasecmp ((gchar *) token, "TAG") == 0;
+			}
+			if (tok == '\n')
+				break;
+			continue;
+		}
+
+		if (tok != IMAPX_TOK_TOKEN)
+			continue;
+
+		if (g_ascii_strcasecmp ((gchar *) token, "UID") == 0)
+			continue;
+
+		if (g_ascii_strcasecmp ((gchar *) token, "ALL") == 0) {
+			GPtrArray *uids;
+			guint ii;
+
+			uids = imapx_parse_uids (stream, cancellable, error);
+			if (uids == NULL)
+				goto exit;
+
+			for (ii = 0; ii < uids->len; ii++) {
+				guint64 number;
+
+				number = GPOINTER_TO_UINT (uids->pdata[ii]);
+				g_array_append_val (search_results, number);
+			}
+
+			g_ptr_array_free (uids, TRUE);
+
+		} else if (g_ascii_strcasecmp ((gchar *) token, "COUNT") == 0) {
+			count = camel_imapx_stream_number (
+				stream, cancellable, &local_error);
+			if (local_error != NULL) {
+				g_propagate_error (error, local_error);
+				goto exit;
+			}
+
+		} else {
+			/* MIN, MAX, MODSEQ and anything else we did not
+			 * ask for; skip the value. */
+			tok = camel_imapx_stream_token (
+				stream, &token, &len, cancellable, error);
+			if (tok == IMAPX_TOK_ERROR || tok == IMAPX_TOK_PROTOCOL)
+				goto exit;
+			if (tok == '\n')
+				break;
+		}
+	}
+
+	if (tag != NULL)
+		job = imapx_match_active_tag (is, tag);
+
+	g_mutex_lock (&is->priv->search_results_lock);
+
+	if (job != NULL && job->type == IMAPX_JOB_UID_SEARCH) {
+		SearchData *data = camel_imapx_job_get_data (job);
+
+		/* Straight to the search that asked for them, so
+		 * concurrent searches cannot take each other's. */
+		if (data != NULL && data->results == NULL) {
+			data->results = g_array_ref (search_results);
+			data->count = count;
+		}
+	} else if (tag != NULL) {
+		c (is->tagprefix, "ESEARCH for unknown command %s ignored\n", tag);
+	} else if (is->priv->search_results == NULL) {
+		is->priv->search_results = g_array_ref (search_results);
+		is->priv->search_count = count;
+	} else
+		g_warning ("%s: Conflicting search results", G_STRFUNC);
+
+	g_mutex_unlock (&is->priv->search_results_lock);
+
+	success = TRUE;
+
+exit:
+	g_array_unref (search_results);
+	g_free (tag);
+
+	return success;
+}
+
+/* The STATUS attributes a folder refresh needs to decide whether
+ * the folder has to be rescanned. */
+#define IMAPX_STATUS_REFRESH_ITEMS \
+	(IMAPX_STATUS_MESSAGES | IMAPX_STATUS_UNSEEN | \
+	 IMAPX_STATUS_UIDNEXT | IMAPX_STATUS_UIDVALIDITY)
+
+/* Copies the attributes present in @src over those of @dest. */
+static void
+imapx_state_info_merge (struct _state_info *dest,
+                        const struct _state_info *src)
+{
+	if (src->have & IMAPX_STATUS_MESSAGES)
+		dest->messages = src->messages;
+	if (src->have & IMAPX_STATUS_RECENT)
+		dest->recent = src->recent;
+	if (src->have & IMAPX_STATUS_UIDNEXT)
+		dest->uidnext = src->uidnext;
+	if (src->have & IMAPX_STATUS_UNSEEN)
+		dest->unseen = src->unseen;
+	if (src->have & IMAPX_STATUS_UIDVALIDITY)
+		dest->uidvalidity = src->uidvalidity;
+	if (src->have & IMAPX_STATUS_HIGHESTMODSEQ)
+		dest->highestmodseq = src->highestmodseq;
+
+	dest->have |= src->have;
+}
+
+static void
+imapx_folder_apply_status (CamelIMAPXFolder *ifolder,
+                           const struct _state_info *sinfo)
+{
+	CamelFolder *folder = CAMEL_FOLDER (ifolder);
+
+	if (sinfo->have & IMAPX_STATUS_UNSEEN)
+		ifolder->unread_on_server = sinfo->unseen;
+	if (sinfo->have & IMAPX_STATUS_MESSAGES)
+		ifolder->exists_on_server = sinfo->messages;
+	if (sinfo->have & IMAPX_STATUS_HIGHESTMODSEQ)
+		ifolder->modseq_on_server = sinfo->highestmodseq;
+	if (sinfo->have & IMAPX_STATUS_UIDNEXT)
+		ifolder->uidnext_on_server = sinfo->uidnext;
+	if (sinfo->have & IMAPX_STATUS_UIDVALIDITY) {
+		ifolder->uidvalidity_on_server = sinfo->uidvalidity;
+		if (sinfo->uidvalidity && sinfo->uidvalidity != ((CamelIMAPXSummary *) folder->summary)->validity)
+			invalidate_local_cache (ifolder, sinfo->uidvalidity);
+	}
+}
+
+/* Records a STATUS we did not ask for, sent along with a LIST
+ * (RFC 5819) or as a NOTIFY event (RFC 5465).  The store summary
+ * counts are updated straight away; the rest is kept until the
+ * folder is next refreshed, so that refresh can skip its own STATUS.
+ * LIST-STATUS reports every item again, so with @replace the older
+ * counts are dropped; a NOTIFY event only updates what it carries. */
+static void
+imapx_server_stash_status (CamelIMAPXServer *is,
+                           CamelIMAPXStore *store,
+                           const gchar *path_name,
+                           const struct _state_info *sinfo,
+                           gboolean replace)
+{
+	CamelStoreSummary *summary;
+	CamelStoreInfo *si;
+	struct _state_info *stashed;
+
+	summary = (CamelStoreSummary *) store->summary;
+
+	si = camel_store_summary_path (summary, path_name);
+	if (si != NULL) {
+		if ((sinfo->have & IMAPX_STATUS_UNSEEN) && si->unread != sinfo->unseen) {
+			si->unread = sinfo->unseen;
+			camel_store_summary_touch (summary);
+		}
+		if ((sinfo->have & IMAPX_STATUS_MESSAGES) && si->total != sinfo->messages) {
+			si->total = sinfo->messages;
+			camel_store_summary_touch (summary);
+		}
+		camel_store_summary_info_free (summary, si);
+	}
+
+	g_mutex_lock (&is->priv->stashed_status_lock);
+
+	stashed = g_hash_table_lookup (is->priv->stashed_status, path_name);
+	if (stashed == NULL) {
+		stashed = g_new0 (struct _state_info, 1);
+		g_hash_table_insert (
+			is->priv->stashed_status,
+			g_strdup (path_name), stashed);
+	} else if (replace) {
+		memset (stashed, 0, sizeof (struct _state_info));
+	}
+
+	imapx_state_info_merge (stashed, sinfo);
+
+	g_mutex_unlock (&is->priv->stashed_status_lock);
+}
+
+/* Applies and forgets the counts stashed for @folder.  Returns
+ * whether they were complete enough to stand in for a STATUS. */
+static gboolean
+imapx_server_take_stashed_status (CamelIMAPXServer *is,
+                                  CamelFolder *folder)
+{
+	struct _state_info *stashed = NULL;
+	const gchar *full_name;
+	gpointer key = NULL;
+	gboolean complete;
+
+	full_name = camel_folder_get_full_name (folder);
+
+	g_mutex_lock (&is->priv->stashed_status_lock);
+	if (g_hash_table_lookup_extended (
+		is->priv->stashed_status, full_name,
+		&key, (gpointer *) &stashed))
+		g_hash_table_steal (is->priv->stashed_status, full_name);
+	g_mutex_unlock (&is->priv->stashed_status_lock);
+
+	if (stashed == NULL)
+		return FALSE;
+
+	imapx_folder_apply_status (CAMEL_IMAPX_FOLDER (folder), stashed);
+
+	complete = (stashed->have & IMAPX_STATUS_REFRESH_ITEMS) ==
+		IMAPX_STATUS_REFRESH_ITEMS;
+
+	g_free (key);
+	g_free (stashed);
+
+	return complete;
+}
+
+/* Whether an untagged STATUS for mailbox @name belongs to the reply
+ * to a LIST-STATUS in progress, which sends it right after the LIST
+ * response for the same mailbox (RFC 5819). */
+static gboolean
+imapx_is_list_status (CamelIMAPXServer *is,
+                      const gchar *name)
+{
+	CamelIMAPXJob *job;
+	ListData *data;
+
+	job = imapx_match_active_job (is, IMAPX_JOB_LIST, NULL);
+	if (job == NULL)
+		return FALSE;
+
+	data = camel_imapx_job_get_data (job);
+
+	return data != NULL && data->ext != NULL &&
+		strstr (data->ext, "STATUS") != NULL &&
+		g_hash_table_lookup (data->folders, name) != NULL;
+}
+
+/* Whether the last known server state of @folder no
+ * longer matches what we have in the local summary. */
+static gboolean
+imapx_folder_changed_on_server (CamelFolder *folder)
+{
+	CamelIMAPXFolder *ifolder = CAMEL_IMAPX_FOLDER (folder);
+	CamelIMAPXSummary *isum = CAMEL_IMAPX_SUMMARY (folder->summary);
+
+	return camel_folder_summary_count (folder->summary) != ifolder->exists_on_server ||
+		camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server ||
+		isum->uidnext != ifolder->uidnext_on_server;
+}
+
+typedef struct _RefreshNotifiedData RefreshNotifiedData;
+
+struct _RefreshNotifiedData {
+	GWeakRef server;
+	CamelFolder *folder;
+};
+
+static void
+refresh_notified_data_free (RefreshNotifiedData *data)
+{
+	g_weak_ref_clear (&data->server);
+	g_object_unref (data->folder);
+	g_slice_free (RefreshNotifiedData, data);
+}
+
+static void
+imapx_server_refresh_notified (CamelSession *session,
+                               GCancellable *cancellable,
+                               RefreshNotifiedData *data,
+                               GError **error)
+{
+	CamelIMAPXServer *is;
+
+	/* Events from here on need a new refresh. */
+	is = g_weak_ref_get (&data->server);
+	if (is != NULL) {
+		g_mutex_lock (&is->priv->stashed_status_lock);
+		g_hash_table_remove (
+			is->priv->notify_refreshes,
+			camel_folder_get_full_name (data->folder));
+		g_mutex_unlock (&is->priv->stashed_status_lock);
+		g_object_unref (is);
+	}
+
+	camel_folder_refresh_info_sync (data->folder, cancellable, error);
+}
+
+/* Submits a refresh of @folder after a NOTIFY event, unless one is
+ * waiting to run already; a burst of events gets a single refresh. */
+static void
+imapx_server_queue_refresh_notified (CamelIMAPXServer *is,
+                                     CamelIMAPXStore *store,
+                                     CamelFolder *folder)
+{
+	RefreshNotifiedData *data;
+	CamelSession *session;
+	const gchar *full_name;
+	gboolean pending;
+
+	full_name = camel_folder_get_full_name (folder);
+
+	g_mutex_lock (&is->priv->stashed_status_lock);
+	pending = g_hash_table_contains (is->priv->notify_refreshes, full_name);
+	if (!pending)
+		g_hash_table_add (is->priv->notify_refreshes, g_strdup (full_name));
+	g_mutex_unlock (&is->priv->stashed_status_lock);
+
+	if (pending)
+		return;
+
+	data = g_slice_new0 (RefreshNotifiedData);
+	g_weak_ref_init (&data->server, is);
+	data->folder = g_object_ref (folder);
+
+	session = camel_service_get_session (CAMEL_SERVICE (store));
+	camel_session_submit_job (
+		session, (CamelSessionCallback)
+		imapx_server_refresh_notified, data,
+		(GDestroyNotify) refresh_notified_data_free);
+}
+
+static gboolean
+imapx_untagged_status (CamelIMAPXServer *is,
+                       CamelIMAPXStream *stream,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	CamelIMAPXStore *store;
+	struct _state_info *sinfo = NULL;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+	/* cancellable may be NULL */
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	store = camel_imapx_server_ref_store (is);
+
+	sinfo = imapx_parse_status_info (stream, cancellable, error);
+
+	if (sinfo) {
+		CamelIMAPXStoreSummary *s = store->summary;
+		CamelIMAPXStoreNamespace *ns;
+		CamelFolder *folder = NULL;
+		gboolean notified = FALSE;
+
+		ns = camel_imapx_store_summary_namespace_find_full (s, sinfo->name);
+		if (ns) {
+			gchar *path_name;
+
+			path_name = camel_imapx_store_summary_full_to_path (s, sinfo->name, ns->sep);
+			c (is->tagprefix, "Got folder path '%s' for full '%s'\n", path_name, sinfo->name);
+			if (path_name && imapx_is_list_status (is, sinfo->name)) {
+				/* LIST-STATUS reports every folder; remember
+				 * the counts rather than opening them all. */
+				imapx_server_stash_status (
+					is, store, path_name, sinfo, TRUE);
+				folder = camel_object_bag_peek (
+					CAMEL_STORE (store)->folders, path_name);
+				g_free (path_name);
+			} else if (path_name && is->use_notify) {
+				/* NOTIFY is on for this connection, so unless
+				 * it answers our own STATUS this is an event;
+				 * same as above, but an open folder is
+				 * refreshed if it is out of date. */
+				folder = camel_object_bag_peek (
+					CAMEL_STORE (store)->folders, path_name);
+				notified = folder == NULL ||
+					!imapx_is_status_active (is, folder);
+				if (notified)
+					imapx_server_stash_status (
+						is, store, path_name, sinfo, FALSE);
+				if (notified && store->con_man != NULL)
+					camel_imapx_conn_manager_notify_event (
+						store->con_man, is, path_name);
+				g_free (path_name);
+			} else if (path_name) {
+				folder = camel_store_get_folder_sync (
+					CAMEL_STORE (store),
+					path_name, 0, cancellable, error);
+				g_free (path_name);
+			}
+		}
+		if (folder != NULL) {
+			imapx_folder_apply_status (
+				CAMEL_IMAPX_FOLDER (folder), sinfo);
+
+			if (notified && folder != is->select_folder &&
+			    imapx_folder_changed_on_server (folder))
+				imapx_server_queue_refresh_notified (
+					is, store, folder);
+
+			g_object_unref (folder);
+		} else {
+			c (is->tagprefix, "Received STATUS for unknown folder '%s'\n", sinfo->name);
+		}
+
+		g_free (sinfo->name);
+		g_free (sinfo);
+	}
+
+	g_object_unref (store);
+
+	return TRUE;
 }
 
 static gboolean
@@ -2319,6 +3215,31 @@ imapx_untagged_ok_no_bad (CamelIMAPXServer *is,
 	case IMAPX_UIDNEXT:
 		is->uidnext = is->priv->context->sinfo->u.uidnext;
 		break;
+	case IMAPX_NOTIFICATIONOVERFLOW: {
+		CamelIMAPXStore *store;
+
+		/* The server gave up on NOTIFY (RFC 5465), so
+		 * events may have been lost; poll from now on. */
+		c (is->tagprefix, "NOTIFY events overflowed, polling instead\n");
+		is->use_notify = FALSE;
+		store = camel_imapx_server_ref_store (is);
+		if (store->con_man != NULL)
+			camel_imapx_conn_manager_release_notify (store->con_man, is);
+		g_object_unref (store);
+		break;
+	}
+	case IMAPX_COPYUID: {
+		CopyMessagesData *data;
+
+		/* UID MOVE reports COPYUID in an untagged OK, since
+		 * the tagged response comes after the EXPUNGEs. */
+		data = imapx_match_active_move (
+			is, is->priv->context->sinfo->u.copyuid.uids);
+		if (data != NULL)
+			imapx_copy_messages_ignore_recent (
+				data, is->priv->context->sinfo->u.copyuid.copied_uids);
+		break;
+	}
 	case IMAPX_ALERT:
 		c (is->tagprefix, "ALERT!: %s\n", is->priv->context->sinfo->text);
 		break;
@@ -2719,6 +3640,17 @@ imapx_completion (CamelIMAPXServer *is,
 	if (ic->status == NULL)
 		return FALSE;
 
+	/* IDLE's round trip is however long we stayed idle */
+	if (g_strcmp0 (ic->name, "IDLE") != 0) {
+		gint64 now = g_get_monotonic_time ();
+
+		camel_imapx_stats_add_command (
+			is->priv->stats, ic->name,
+			ic->status->result != IMAPX_OK,
+			ic->sent_time - ic->queued_time,
+			now - ic->sent_time);
+	}
+
 	if (ic->complete != NULL)
 		if (!ic->complete (is, ic, cancellable, error))
 			return FALSE;
@@ -2739,10 +3671,13 @@ imapx_step (CamelIMAPXServer *is,
 	guint len;
 	guchar *token;
 	gint tok;
+	gint64 start;
 	gboolean success = FALSE;
 
 	stream = camel_imapx_server_ref_stream (is);
 
+	start = g_get_monotonic_time ();
+
 	// poll ?  wait for other stuff? loop?
 	tok = camel_imapx_stream_token (
 		stream, &token, &len, cancellable, error);
@@ -2771,6 +3706,9 @@ imapx_step (CamelIMAPXServer *is,
 			break;
 	}
 
+	camel_imapx_stats_add_parse (
+		is->priv->stats, g_get_monotonic_time () - start);
+
 	g_object_unref (stream);
 
 	return success;
@@ -2875,6 +3813,89 @@ imapx_command_run_sync (CamelIMAPXServer *is,
 	return success;
 }
 
+static IMAPXJobKind
+imapx_job_kind (CamelIMAPXJob *job)
+{
+	switch (job->type) {
+		case IMAPX_JOB_GET_MESSAGE:
+			/* Offline synchronization downloads messages too. */
+			if (job->pri <= IMAPX_PRIORITY_SYNC_MESSAGE)
+				return IMAPX_JOB_KIND_BULK;
+			return IMAPX_JOB_KIND_INTERACTIVE;
+		case IMAPX_JOB_GET_BODYSTRUCTURE:
+		case IMAPX_JOB_UID_SEARCH:
+		case IMAPX_JOB_MANAGE_SUBSCRIPTION:
+		case IMAPX_JOB_CREATE_FOLDER:
+		case IMAPX_JOB_DELETE_FOLDER:
+		case IMAPX_JOB_RENAME_FOLDER:
+			return IMAPX_JOB_KIND_INTERACTIVE;
+		default:
+			return IMAPX_JOB_KIND_BULK;
+	}
+}
+
+/* Must hold QUEUE_LOCK */
+static void
+imapx_job_update_latency (CamelIMAPXServer *is,
+                          CamelIMAPXJob *job)
+{
+	IMAPXJobLatency *latency;
+	gint64 now, wait, run;
+
+	/* IDLE runs until interrupted, nobody waits on it. */
+	if (job->type == IMAPX_JOB_IDLE)
+		return;
+
+	latency = &is->priv->latency[imapx_job_kind (job)];
+
+	now = g_get_monotonic_time ();
+	run = now - job->queued_time;
+	wait = (job->started_time > 0 ? job->started_time : now) -
+		job->queued_time;
+
+	latency->finished++;
+	latency->wait_total += wait;
+	latency->wait_max = MAX (latency->wait_max, wait);
+	latency->run_total += run;
+	latency->run_max = MAX (latency->run_max, run);
+}
+
+/* Raises the priority of @job and of its commands still waiting in
+ * the queue, so that bulk work picked up by an interactive request
+ * goes ahead of other bulk work from its next command on. */
+static void
+imapx_job_promote (CamelIMAPXServer *is,
+                   CamelIMAPXJob *job,
+                   gint pri)
+{
+	GQueue promote = G_QUEUE_INIT;
+	GList *head, *link;
+	CamelIMAPXCommand *ic;
+
+	/* Caller must be holding QUEUE_LOCK. */
+
+	if (pri <= job->pri)
+		return;
+
+	job->pri = pri;
+
+	head = camel_imapx_command_queue_peek_head_link (is->queue);
+
+	for (link = head; link != NULL; link = g_list_next (link)) {
+		ic = link->data;
+
+		if (camel_imapx_command_get_job (ic) == job && ic->pri < pri)
+			g_queue_push_tail (&promote, camel_imapx_command_ref (ic));
+	}
+
+	while ((ic = g_queue_pop_head (&promote)) != NULL) {
+		camel_imapx_command_queue_remove (is->queue, ic);
+		ic->pri = pri;
+		camel_imapx_command_queue_insert_sorted (is->queue, ic);
+		camel_imapx_command_unref (ic);
+	}
+}
+
 static gboolean
 imapx_register_job (CamelIMAPXServer *is,
                     CamelIMAPXJob *job,
@@ -2882,6 +3903,8 @@ imapx_register_job (CamelIMAPXServer *is,
 {
 	if (is->state >= IMAPX_INITIALISED) {
 		QUEUE_LOCK (is);
+		job->queued_time = g_get_monotonic_time ();
+		job->started_time = 0;
 		g_queue_push_head (&is->jobs, camel_imapx_job_ref (job));
 		QUEUE_UNLOCK (is);
 
@@ -2905,8 +3928,10 @@ imapx_unregister_job (CamelIMAPXServer *is,
 		camel_imapx_job_done (job);
 
 	QUEUE_LOCK (is);
-	if (g_queue_remove (&is->jobs, job))
+	if (g_queue_remove (&is->jobs, job)) {
+		imapx_job_update_latency (is, job);
 		camel_imapx_job_unref (job);
+	}
 	QUEUE_UNLOCK (is);
 }
 
@@ -2976,6 +4001,28 @@ imapx_command_idle_done (CamelIMAPXServer *is,
 	idle->state = IMAPX_IDLE_OFF;
 	IDLE_UNLOCK (idle);
 
+	/* IDLE stops early for new mail; fetch it unless something
+	 * else is already queued, which will bring it anyway. */
+	if (success) {
+		CamelIMAPXFolder *ifolder;
+		gboolean fetch_new;
+
+		ifolder = (CamelIMAPXFolder *) camel_imapx_job_ref_folder (job);
+
+		QUEUE_LOCK (is);
+		fetch_new = ifolder->exists_on_server >
+			camel_folder_summary_count (((CamelFolder *) ifolder)->summary) &&
+			imapx_is_command_queue_empty (is);
+		QUEUE_UNLOCK (is);
+
+		if (fetch_new)
+			imapx_server_fetch_new_messages (
+				is, (CamelFolder *) ifolder,
+				TRUE, TRUE, NULL, NULL);
+
+		g_object_unref (ifolder);
+	}
+
 	imapx_unregister_job (is, job);
 	camel_imapx_command_unref (ic);
 
@@ -3036,6 +4083,7 @@ camel_imapx_server_idle (CamelIMAPXServer *is,
 	job = camel_imapx_job_new (cancellable);
 	job->type = IMAPX_JOB_IDLE;
 	job->start = imapx_job_idle_start;
+	job->noreply = TRUE;
 
 	camel_imapx_job_set_folder (job, folder);
 
@@ -3090,61 +4138,168 @@ imapx_server_fetch_new_messages (CamelIMAPXServer *is,
 }
 
 static gpointer
-imapx_idle_thread (gpointer data)
+imapx_idle_loop_thread (gpointer data)
 {
-	CamelIMAPXServer *is = (CamelIMAPXServer *) data;
-	GError *local_error = NULL;
+	GMainLoop *loop = data;
 
-	while (TRUE) {
-		CamelIMAPXFolder *ifolder;
+	g_main_context_push_thread_default (g_main_loop_get_context (loop));
+	g_main_loop_run (loop);
 
-		g_mutex_lock (&is->idle->start_watch_mutex);
-		is->idle->start_watch_is_set = FALSE;
-		g_mutex_unlock (&is->idle->start_watch_mutex);
+	return NULL;
+}
 
-		IDLE_LOCK (is->idle);
-		while ((ifolder = (CamelIMAPXFolder *) is->select_folder) &&
-		       is->idle->state == IMAPX_IDLE_PENDING &&
-		       !is->idle->idle_exit) {
-			time_t dwelled = time (NULL) - is->idle->started;
+/* The dwell timers of every connection, in every account, run on
+ * this one context and thread, rather than on a thread apiece that
+ * mostly sleeps.  The timer only wakes the connection's parser
+ * thread, which queues and writes IDLE itself. */
+static GMainContext *
+imapx_idle_context (void)
+{
+	static gsize initialized = 0;
+	static GMainContext *context;
 
-			if (dwelled < IMAPX_IDLE_DWELL_TIME) {
-				IDLE_UNLOCK (is->idle);
-				g_usleep ((IMAPX_IDLE_DWELL_TIME - dwelled) * G_USEC_PER_SEC);
-				IDLE_LOCK (is->idle);
-				continue;
-			}
-			IDLE_UNLOCK (is->idle);
+	if (g_once_init_enter (&initialized)) {
+		GMainLoop *loop;
+		GThread *thread;
 
-			camel_imapx_server_idle (is, (gpointer) ifolder, is->cancellable, &local_error);
+		context = g_main_context_new ();
+		loop = g_main_loop_new (context, FALSE);
 
-			if (local_error == NULL && ifolder->exists_on_server >
-			    camel_folder_summary_count (((CamelFolder *) ifolder)->summary) && imapx_is_command_queue_empty (is))
-				imapx_server_fetch_new_messages (is, is->select_folder, TRUE, TRUE, is->cancellable, &local_error);
+		thread = g_thread_new (
+			"imapx-idle", imapx_idle_loop_thread, loop);
+		g_thread_unref (thread);
 
-			if (local_error != NULL) {
-				e (is->tagprefix, "Caught exception in idle thread:  %s \n", local_error->message);
-				/* No way to asyncronously notify UI ? */
-				g_clear_error (&local_error);
-			}
-			IDLE_LOCK (is->idle);
-		}
+		g_once_init_leave (&initialized, 1);
+	}
+
+	return context;
+}
+
+static void
+imapx_idle_dwell_data_free (GWeakRef *weak_ref)
+{
+	g_weak_ref_clear (weak_ref);
+	g_free (weak_ref);
+}
+
+/* Runs on the shared thread, so it only marks IDLE as due and wakes
+ * the parser thread, which sends it; see imapx_idle_issue_if_due().
+ * Nothing here may block, nor keep the server alive.  The wakeup
+ * cancels the parser's read, so it is only sent while that read is
+ * waiting for a response to begin; a parser busy with one sees that
+ * IDLE is due once it is done. */
+static gboolean
+imapx_idle_dwell_cb (gpointer user_data)
+{
+	CamelIMAPXServer *is;
+	gboolean again = FALSE;
+
+	is = g_weak_ref_get (user_data);
+	if (is == NULL)
+		return FALSE;
+
+	QUEUE_LOCK (is);
+	IDLE_LOCK (is->idle);
+
+	if (g_source_is_destroyed (g_main_current_source ())) {
 		IDLE_UNLOCK (is->idle);
+		QUEUE_UNLOCK (is);
+		g_object_unref (is);
+		return FALSE;
+	}
 
-		g_mutex_lock (&is->idle->start_watch_mutex);
-		while (!is->idle->start_watch_is_set)
-			g_cond_wait (
-				&is->idle->start_watch_cond,
-				&is->idle->start_watch_mutex);
-		g_mutex_unlock (&is->idle->start_watch_mutex);
+	/* Anything else means IDLE was called off meanwhile */
+	if (is->idle->state == IMAPX_IDLE_PENDING && is->select_folder != NULL &&
+	    camel_imapx_command_queue_is_empty (is->active)) {
+		if (time (NULL) - is->idle->started < IMAPX_IDLE_DWELL_TIME) {
+			again = TRUE;
+		} else if (is->cancellable != NULL) {
+			/* Nothing is awaiting a reply, so the parser
+			 * thread takes this as a wakeup, not an error */
+			is->idle->wake = TRUE;
+			if (is->priv->parser_waiting)
+				g_cancellable_cancel (is->cancellable);
+		}
+	}
 
-		if (is->idle->idle_exit)
-			break;
+	if (!again) {
+		g_source_unref (is->idle->dwell_source);
+		is->idle->dwell_source = NULL;
 	}
 
-	g_clear_error (&local_error);
-	is->idle->idle_thread = NULL;
-	return NULL;
+	IDLE_UNLOCK (is->idle);
+	QUEUE_UNLOCK (is);
+
+	g_object_unref (is);
+
+	return again;
+}
+
+static void
+imapx_idle_stop_dwell (CamelIMAPXServer *is)
+{
+	CamelIMAPXIdle *idle = is->idle;
+
+	if (idle == NULL)
+		return;
+
+	IDLE_LOCK (idle);
+
+	if (idle->dwell_source != NULL) {
+		g_source_destroy (idle->dwell_source);
+		g_source_unref (idle->dwell_source);
+		idle->dwell_source = NULL;
+	}
+
+	IDLE_UNLOCK (idle);
+}
+
+static gboolean
+imapx_idle_is_due (CamelIMAPXServer *is)
+{
+	gboolean due;
+
+	if (is->idle == NULL)
+		return FALSE;
+
+	IDLE_LOCK (is->idle);
+	due = is->idle->wake;
+	IDLE_UNLOCK (is->idle);
+
+	return due;
+}
+
+/* Called from the parser thread: sends IDLE if the dwell timer said
+ * so and the connection has been left alone since. */
+static gboolean
+imapx_idle_issue_if_due (CamelIMAPXServer *is,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+	CamelFolder *folder = NULL;
+	gboolean success = TRUE;
+
+	if (is->idle == NULL)
+		return TRUE;
+
+	IDLE_LOCK (is->idle);
+
+	if (is->idle->wake) {
+		is->idle->wake = FALSE;
+
+		if (is->idle->state == IMAPX_IDLE_PENDING && is->select_folder != NULL)
+			folder = g_object_ref (is->select_folder);
+	}
+
+	IDLE_UNLOCK (is->idle);
+
+	if (folder != NULL) {
+		success = camel_imapx_server_idle (
+			is, folder, cancellable, error);
+		g_object_unref (folder);
+	}
+
+	return success;
 }
 
 static CamelIMAPXIdleStopResult
@@ -3205,43 +4360,19 @@ imapx_init_idle (CamelIMAPXServer *is)
 {
 	is->idle = g_new0 (CamelIMAPXIdle, 1);
 	g_mutex_init (&is->idle->idle_lock);
-
-	g_cond_init (&is->idle->start_watch_cond);
-	g_mutex_init (&is->idle->start_watch_mutex);
 }
 
 static void
 imapx_exit_idle (CamelIMAPXServer *is)
-{
-	CamelIMAPXIdle *idle = is->idle;
-	GThread *thread = NULL;
-
-	if (!idle)
-		return;
-
-	IDLE_LOCK (idle);
-
-	if (idle->idle_thread) {
-		idle->idle_exit = TRUE;
-
-		g_mutex_lock (&idle->start_watch_mutex);
-		idle->start_watch_is_set = TRUE;
-		g_cond_broadcast (&idle->start_watch_cond);
-		g_mutex_unlock (&idle->start_watch_mutex);
-
-		thread = idle->idle_thread;
-		idle->idle_thread = NULL;
-	}
+{
+	CamelIMAPXIdle *idle = is->idle;
 
-	idle->idle_thread = NULL;
-	IDLE_UNLOCK (idle);
+	if (!idle)
+		return;
 
-	if (thread)
-		g_thread_join (thread);
+	imapx_idle_stop_dwell (is);
 
 	g_mutex_clear (&idle->idle_lock);
-	g_cond_clear (&idle->start_watch_cond);
-	g_mutex_clear (&idle->start_watch_mutex);
 
 	g_free (is->idle);
 	is->idle = NULL;
@@ -3261,16 +4392,23 @@ imapx_start_idle (CamelIMAPXServer *is)
 	time (&idle->started);
 	idle->state = IMAPX_IDLE_PENDING;
 
-	if (!idle->idle_thread) {
-		idle->start_watch_is_set = FALSE;
+	/* A timer left over from an earlier PENDING state
+	 * goes by the new start time when it next fires. */
+	if (idle->dwell_source == NULL) {
+		GWeakRef *weak_ref;
 
-		idle->idle_thread = g_thread_new (
-			NULL, (GThreadFunc) imapx_idle_thread, is);
-	} else {
-		g_mutex_lock (&idle->start_watch_mutex);
-		idle->start_watch_is_set = TRUE;
-		g_cond_broadcast (&idle->start_watch_cond);
-		g_mutex_unlock (&idle->start_watch_mutex);
+		/* Only a weak reference, the timer must not
+		 * keep the server around, nor be the one to
+		 * dispose of it on the shared thread. */
+		weak_ref = g_new0 (GWeakRef, 1);
+		g_weak_ref_init (weak_ref, is);
+
+		idle->dwell_source = g_timeout_source_new_seconds (
+			IMAPX_IDLE_DWELL_TIME);
+		g_source_set_callback (
+			idle->dwell_source, imapx_idle_dwell_cb, weak_ref,
+			(GDestroyNotify) imapx_idle_dwell_data_free);
+		g_source_attach (idle->dwell_source, imapx_idle_context ());
 	}
 
 	IDLE_UNLOCK (idle);
@@ -3374,9 +4512,17 @@ imapx_command_select_done (CamelIMAPXServer *is,
 	} else {
 		CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) is->select_pending;
 		CamelFolder *cfolder = is->select_pending;
+		CamelIMAPXSummary *isum = (CamelIMAPXSummary *) cfolder->summary;
+		gboolean resynced;
 
 		c (is->tagprefix, "Select ok!\n");
 
+		/* The server only honours QRESYNC if the UIDVALIDITY
+		 * we sent still holds, and then all VANISHED and flag
+		 * changes since isum->modseq came with the SELECT. */
+		resynced = is->priv->select_qresync && is->highestmodseq &&
+			is->uidvalidity && is->uidvalidity == isum->validity;
+
 		if (!is->select_folder) {
 			/* This could have been done earlier by a [CLOSED] status */
 			is->select_folder = is->select_pending;
@@ -3409,9 +4555,14 @@ imapx_command_select_done (CamelIMAPXServer *is,
 		ifolder->uidvalidity_on_server = is->uidvalidity;
 		selected_folder = camel_folder_get_full_name (is->select_folder);
 
-		if (is->uidvalidity && is->uidvalidity != ((CamelIMAPXSummary *) cfolder->summary)->validity)
+		if (is->uidvalidity && is->uidvalidity != isum->validity)
 			invalidate_local_cache (ifolder, is->uidvalidity);
 
+		if (resynced && isum->modseq != is->highestmodseq) {
+			isum->modseq = is->highestmodseq;
+			camel_folder_summary_touch (cfolder->summary);
+		}
+
 #if 0  /* see comment for disabled bits in imapx_job_refresh_info_start() */
 		/* This should trigger a new messages scan */
 		if (is->exists != is->select_folder->summary->root_view->total_count)
@@ -3423,6 +4574,7 @@ imapx_command_select_done (CamelIMAPXServer *is,
 	}
 
 	is->select_pending = NULL;
+	is->priv->select_qresync = FALSE;
 	camel_imapx_command_unref (ic);
 
 	g_signal_emit (is, signals[SELECT_CHANGED], 0, selected_folder);
@@ -3480,6 +4632,7 @@ imapx_select (CamelIMAPXServer *is,
 	is->recent = 0;
 	is->mode = 0;
 	is->uidnext = 0;
+	is->priv->select_qresync = FALSE;
 
 	/* Hrm, what about reconnecting? */
 	is->state = IMAPX_INITIALISED;
@@ -3491,9 +4644,15 @@ imapx_select (CamelIMAPXServer *is,
 		CamelIMAPXSummary *isum = (CamelIMAPXSummary *) folder->summary;
 		CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) folder;
 		gint total = camel_folder_summary_count (folder->summary);
+		guint64 uidvalidity = ifolder->uidvalidity_on_server;
 		gchar *firstuid, *lastuid;
 
-		if (total && isum->modseq && ifolder->uidvalidity_on_server) {
+		/* Until this session has seen the folder, the UIDVALIDITY
+		 * saved in the summary is as good as any. */
+		if (uidvalidity == 0)
+			uidvalidity = isum->validity;
+
+		if (total && isum->modseq && uidvalidity) {
 
 			firstuid = imapx_get_uid_from_index (folder->summary, 0);
 			lastuid = imapx_get_uid_from_index (folder->summary, total - 1);
@@ -3501,16 +4660,18 @@ imapx_select (CamelIMAPXServer *is,
 			c (
 				is->tagprefix, "SELECT QRESYNC %" G_GUINT64_FORMAT
 				" %" G_GUINT64_FORMAT "\n",
-				ifolder->uidvalidity_on_server, isum->modseq);
+				uidvalidity, isum->modseq);
 
 			camel_imapx_command_add (
 				ic, " (QRESYNC (%"
 				G_GUINT64_FORMAT " %"
 				G_GUINT64_FORMAT " %s:%s",
-				ifolder->uidvalidity_on_server,
+				uidvalidity,
 				isum->modseq,
 				firstuid, lastuid);
 
+			is->priv->select_qresync = TRUE;
+
 			g_free (firstuid);
 			g_free (lastuid);
 
@@ -3696,6 +4857,8 @@ connect_to_server_process (CamelIMAPXServer *is,
 	g_free (full_cmd);
 
 	imapx_stream = camel_imapx_stream_new (cmd_stream);
+	camel_imapx_stream_set_stats (
+		CAMEL_IMAPX_STREAM (imapx_stream), is->priv->stats);
 
 	g_object_unref (cmd_stream);
 
@@ -3791,6 +4954,8 @@ imapx_connect_to_server (CamelIMAPXServer *is,
 	camel_tcp_stream_setsockopt (CAMEL_TCP_STREAM (tcp_stream), &sockopt);
 
 	imapx_stream = camel_imapx_stream_new (tcp_stream);
+	camel_imapx_stream_set_stats (
+		CAMEL_IMAPX_STREAM (imapx_stream), is->priv->stats);
 
 	/* CamelIMAPXServer takes ownership of the IMAPX stream.
 	 * We need to set this right away for imapx_command_run()
@@ -4088,6 +5253,7 @@ imapx_reconnect (CamelIMAPXServer *is,
 	gchar *mechanism;
 	gboolean use_idle;
 	gboolean use_qresync;
+	gboolean use_subscriptions;
 	gboolean success = FALSE;
 
 	store = camel_imapx_server_ref_store (is);
@@ -4106,6 +5272,9 @@ imapx_reconnect (CamelIMAPXServer *is,
 	use_qresync = camel_imapx_settings_get_use_qresync (
 		CAMEL_IMAPX_SETTINGS (settings));
 
+	use_subscriptions = camel_imapx_settings_get_use_subscriptions (
+		CAMEL_IMAPX_SETTINGS (settings));
+
 	g_object_unref (settings);
 
 	if (!imapx_connect_to_server (is, cancellable, error))
@@ -4133,6 +5302,36 @@ imapx_reconnect (CamelIMAPXServer *is,
 	is->state = IMAPX_AUTHENTICATED;
 
  preauthed:
+	/* RFC 4978: compress the rest of the session, if offered.
+	 * A NO just leaves the connection as it is. */
+	if (is->cinfo && (is->cinfo->capa & IMAPX_CAPABILITY_COMPRESS_DEFLATE) != 0) {
+		ic = camel_imapx_command_new (
+			is, "COMPRESS", NULL, "COMPRESS DEFLATE");
+		if (!imapx_command_run (is, ic, cancellable, error)) {
+			camel_imapx_command_unref (ic);
+			goto exception;
+		}
+
+		if (ic->status->result == IMAPX_OK) {
+			CamelIMAPXStream *stream;
+			gboolean compressed = FALSE;
+
+			stream = camel_imapx_server_ref_stream (is);
+			if (stream != NULL) {
+				compressed = camel_imapx_stream_start_compress (
+					stream, error);
+				g_object_unref (stream);
+			}
+
+			if (!compressed) {
+				camel_imapx_command_unref (ic);
+				goto exception;
+			}
+		}
+
+		camel_imapx_command_unref (ic);
+	}
+
 	is->use_idle = use_idle;
 
 	if (imapx_idle_supported (is))
@@ -4164,6 +5363,43 @@ imapx_reconnect (CamelIMAPXServer *is,
 	} else
 		is->use_qresync = FALSE;
 
+	/* RFC 5465: have the server report new, expunged and changed
+	 * messages in the other folders, instead of us polling them.
+	 * The selected folder keeps using IDLE, so only bother when
+	 * push notifications are wanted at all, and on one connection
+	 * only, or every event would be handled once per connection.
+	 * Flag changes in other folders are optional for servers; try
+	 * without them if they get refused. */
+	is->use_notify = FALSE;
+	if (use_idle && is->cinfo && (is->cinfo->capa & IMAPX_CAPABILITY_NOTIFY) != 0 &&
+	    store->con_man != NULL && camel_imapx_conn_manager_claim_notify (store->con_man, is)) {
+		const gchar *events[] = {
+			"MessageNew MessageExpunge FlagChange",
+			"MessageNew MessageExpunge"
+		};
+		guint ii;
+
+		for (ii = 0; ii < G_N_ELEMENTS (events) && !is->use_notify; ii++) {
+			ic = camel_imapx_command_new (
+				is, "NOTIFY", NULL,
+				"NOTIFY SET (%t (%t))",
+				use_subscriptions ? "subscribed" : "personal",
+				events[ii]);
+			if (!imapx_command_run (is, ic, cancellable, error)) {
+				camel_imapx_command_unref (ic);
+				goto exception;
+			}
+
+			is->use_notify = (ic->status->result == IMAPX_OK);
+
+			camel_imapx_command_unref (ic);
+		}
+
+		if (is->use_notify)
+			camel_imapx_conn_manager_notify_enabled (
+				store->con_man, is, use_subscriptions);
+	}
+
 	if (store->summary->namespaces == NULL) {
 		CamelIMAPXNamespaceList *nsl = NULL;
 		CamelIMAPXStoreNamespace *ns = NULL;
@@ -4197,6 +5433,10 @@ exception:
 		is->cinfo = NULL;
 	}
 
+	is->use_notify = FALSE;
+	if (store->con_man != NULL)
+		camel_imapx_conn_manager_release_notify (store->con_man, is);
+
 exit:
 	g_free (mechanism);
 
@@ -4207,6 +5447,132 @@ exit:
 
 /* ********************************************************************** */
 
+/* Queues the next partial fetch of a large message. */
+static gboolean
+imapx_get_message_queue_chunk (CamelIMAPXServer *is,
+                               CamelIMAPXJob *job,
+                               CamelFolder *folder,
+                               gint pri,
+                               GCancellable *cancellable,
+                               GError **error)
+{
+	CamelIMAPXCommand *ic;
+	GetMessageData *data;
+
+	data = camel_imapx_job_get_data (job);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	ic = camel_imapx_command_new (
+		is, "FETCH", folder,
+		"UID FETCH %t (BODY.PEEK[]",
+		data->uid);
+	camel_imapx_command_add (
+		ic, "<%u.%u>",
+		(guint) data->fetch_offset,
+		(guint) data->chunk_size);
+	camel_imapx_command_add (ic, ")");
+	ic->complete = imapx_command_fetch_message_done;
+	camel_imapx_command_set_job (ic, job);
+	ic->pri = pri;
+	data->fetch_offset += data->chunk_size;
+	job->commands++;
+
+	return imapx_command_queue (is, ic, cancellable, error);
+}
+
+/* Without BINARY we get the part as it is in the message, so
+ * take the transfer encoding off on the way to the cache. */
+static void
+imapx_get_message_decode_part (GetMessageData *data)
+{
+	CamelMimeFilter *filter = NULL;
+	CamelStream *filtered;
+
+	switch (camel_transfer_encoding_from_string (data->encoding)) {
+		case CAMEL_TRANSFER_ENCODING_BASE64:
+			filter = camel_mime_filter_basic_new (
+				CAMEL_MIME_FILTER_BASIC_BASE64_DEC);
+			break;
+		case CAMEL_TRANSFER_ENCODING_QUOTEDPRINTABLE:
+			filter = camel_mime_filter_basic_new (
+				CAMEL_MIME_FILTER_BASIC_QP_DEC);
+			break;
+		case CAMEL_TRANSFER_ENCODING_UUENCODE:
+			filter = camel_mime_filter_basic_new (
+				CAMEL_MIME_FILTER_BASIC_UU_DEC);
+			break;
+		default:
+			break;
+	}
+
+	if (filter == NULL)
+		return;
+
+	filtered = camel_stream_filter_new (data->stream);
+	camel_stream_filter_add (CAMEL_STREAM_FILTER (filtered), filter);
+	g_object_unref (filter);
+
+	g_object_unref (data->stream);
+	data->stream = filtered;
+}
+
+static gboolean
+imapx_get_message_queue_part (CamelIMAPXServer *is,
+                              CamelIMAPXJob *job,
+                              CamelFolder *folder,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	CamelIMAPXCommand *ic;
+	GetMessageData *data;
+
+	data = camel_imapx_job_get_data (job);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	if (data->use_binary)
+		ic = camel_imapx_command_new (
+			is, "FETCH", folder,
+			"UID FETCH %t (BINARY.PEEK[%t])",
+			data->uid, data->section);
+	else
+		ic = camel_imapx_command_new (
+			is, "FETCH", folder,
+			"UID FETCH %t (BODY.PEEK[%t])",
+			data->uid, data->section);
+	ic->complete = imapx_command_fetch_message_done;
+	camel_imapx_command_set_job (ic, job);
+	ic->pri = job->pri;
+	job->commands++;
+
+	return imapx_command_queue (is, ic, cancellable, error);
+}
+
+/* Resizes the partial fetches from the rate the last one came in at.
+ * With the pipeline full, the time between two completions is about
+ * the time it took to transfer one chunk. */
+static void
+imapx_get_message_adapt_chunk (GetMessageData *data)
+{
+	gint64 now, elapsed;
+	gsize chunk_size;
+
+	now = g_get_monotonic_time ();
+	elapsed = now - data->chunk_time;
+	data->chunk_time = now;
+
+	if (data->body_len <= 0 || elapsed <= 0)
+		return;
+
+	chunk_size = (gsize) ((gdouble) data->body_len *
+		IMAPX_FETCH_CHUNK_TIME / elapsed);
+
+	/* Grow gradually, but back off at once on a slow link. */
+	chunk_size = MIN (chunk_size, data->chunk_size * 2);
+	chunk_size = CLAMP (chunk_size, MULTI_SIZE, IMAPX_FETCH_MAX_CHUNK);
+
+	data->chunk_size = chunk_size;
+}
+
 static gboolean
 imapx_command_fetch_message_done (CamelIMAPXServer *is,
                                   CamelIMAPXCommand *ic,
@@ -4217,6 +5583,7 @@ imapx_command_fetch_message_done (CamelIMAPXServer *is,
 	CamelFolder *folder;
 	GetMessageData *data;
 	CamelIMAPXFolder *ifolder;
+	const gchar *cache_path;
 	gboolean success = TRUE;
 	GError *local_error = NULL;
 
@@ -4226,6 +5593,9 @@ imapx_command_fetch_message_done (CamelIMAPXServer *is,
 	data = camel_imapx_job_get_data (job);
 	g_return_val_if_fail (data != NULL, FALSE);
 
+	/* Whole messages live in "cur", single parts in "part". */
+	cache_path = (data->section != NULL) ? "part" : "cur";
+
 	folder = camel_imapx_job_ref_folder (job);
 	g_return_val_if_fail (folder != NULL, FALSE);
 
@@ -4235,43 +5605,50 @@ imapx_command_fetch_message_done (CamelIMAPXServer *is,
 
 	job->commands--;
 
-	if (camel_imapx_command_set_error_if_failed (ic, &local_error)) {
+	if (data->use_binary && ic->status != NULL &&
+	    ic->status->result == IMAPX_NO && data->stream != NULL) {
+		/* The server could not decode the part, most likely
+		 * NO [UNKNOWN-CTE] (RFC 3516); fetch it as it is in the
+		 * message and decode it here instead. */
+		c (is->tagprefix, "BINARY fetch refused, trying BODY\n");
+		data->use_binary = FALSE;
+		imapx_get_message_decode_part (data);
+		if (imapx_get_message_queue_part (
+			is, job, folder, cancellable, &local_error))
+			goto exit;
+		data->body_len = -1;
+
+	} else if (camel_imapx_command_set_error_if_failed (ic, &local_error)) {
 		g_prefix_error (
 			&local_error, "%s: ",
 			_("Error fetching message"));
 		data->body_len = -1;
 
-	} else if (data->use_multi_fetch) {
+	} else if (data->use_multi_fetch && data->error == NULL) {
 		gsize really_fetched = g_seekable_tell (G_SEEKABLE (data->stream));
+		gboolean queued = FALSE;
+
+		imapx_get_message_adapt_chunk (data);
+
 		/* Don't automatically stop when we reach the reported message
 		 * size -- some crappy servers (like Microsoft Exchange) have
 		 * a tendency to lie about it. Keep going (one request at a
 		 * time) until the data actually stop coming. */
-		if (data->fetch_offset < data->size ||
-		    data->fetch_offset == really_fetched) {
-			CamelIMAPXCommand *new_ic;
-
+		while (success && job->commands < IMAPX_FETCH_PIPELINE_DEPTH &&
+		       (data->fetch_offset < data->size ||
+			(job->commands == 0 && data->fetch_offset == really_fetched))) {
 			camel_operation_progress (
 				cancellable,
 				(data->fetch_offset *100) / data->size);
 
-			new_ic = camel_imapx_command_new (
-				is, "FETCH", folder,
-				"UID FETCH %t (BODY.PEEK[]",
-				data->uid);
-			camel_imapx_command_add (new_ic, "<%u.%u>", data->fetch_offset, MULTI_SIZE);
-			camel_imapx_command_add (new_ic, ")");
-			new_ic->complete = imapx_command_fetch_message_done;
-			camel_imapx_command_set_job (new_ic, job);
-			new_ic->pri = job->pri - 1;
-			data->fetch_offset += MULTI_SIZE;
-			job->commands++;
-
-			success = imapx_command_queue (
-				is, new_ic, cancellable, error);
+			success = imapx_get_message_queue_chunk (
+				is, job, folder, job->pri - 1,
+				cancellable, error);
+			queued = TRUE;
+		}
 
+		if (queued)
 			goto exit;
-		}
 	}
 
 	/* If we have more messages to fetch, skip the rest. */
@@ -4282,6 +5659,12 @@ imapx_command_fetch_message_done (CamelIMAPXServer *is,
 
 	ifolder = CAMEL_IMAPX_FOLDER (folder);
 
+	/* A failed command says more than the data it did send */
+	if (local_error == NULL && data->error != NULL) {
+		local_error = data->error;
+		data->error = NULL;
+	}
+
 	/* return the exception from last command */
 	if (local_error != NULL) {
 		if (data->stream != NULL) {
@@ -4306,10 +5689,10 @@ imapx_command_fetch_message_done (CamelIMAPXServer *is,
 			gchar *dirname;
 
 			cur_filename = camel_data_cache_get_filename (
-				ifolder->cache, "cur", data->uid);
+				ifolder->cache, cache_path, data->cache_key);
 
 			tmp_filename = camel_data_cache_get_filename (
-				ifolder->cache, "tmp", data->uid);
+				ifolder->cache, "tmp", data->cache_key);
 
 			dirname = g_path_get_dirname (cur_filename);
 			g_mkdir_with_parents (dirname, 0700);
@@ -4326,42 +5709,204 @@ imapx_command_fetch_message_done (CamelIMAPXServer *is,
 			g_free (cur_filename);
 			g_free (tmp_filename);
 
-			/* Exchange the "tmp" stream for the "cur" stream. */
-			g_object_unref (data->stream);
-			data->stream = camel_data_cache_get (
-				ifolder->cache, "cur", data->uid, error);
-			success = (data->stream != NULL);
-		} else {
-			g_prefix_error (
-				error, "%s: ",
-				_("Failed to close the tmp stream"));
-		}
+			/* Exchange the "tmp" stream for the "cur" stream. */
+			g_object_unref (data->stream);
+			data->stream = camel_data_cache_get (
+				ifolder->cache, cache_path, data->cache_key, error);
+			success = (data->stream != NULL);
+		} else {
+			g_prefix_error (
+				error, "%s: ",
+				_("Failed to close the tmp stream"));
+		}
+	}
+
+	camel_data_cache_remove (ifolder->cache, "tmp", data->cache_key, NULL);
+	imapx_unregister_job (is, job);
+
+exit:
+	g_object_unref (folder);
+
+	camel_imapx_command_unref (ic);
+
+	g_clear_error (&local_error);
+
+	return success;
+}
+
+static gboolean
+imapx_job_get_message_start (CamelIMAPXJob *job,
+                             CamelIMAPXServer *is,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	CamelFolder *folder;
+	CamelIMAPXCommand *ic;
+	GetMessageData *data;
+	gint i;
+	gboolean success = TRUE;
+
+	data = camel_imapx_job_get_data (job);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	folder = camel_imapx_job_ref_folder (job);
+	g_return_val_if_fail (folder != NULL, FALSE);
+
+	if (data->section != NULL) {
+		success = imapx_get_message_queue_part (
+			is, job, folder, cancellable, error);
+	} else if (data->use_multi_fetch) {
+		data->chunk_size = MULTI_SIZE;
+		data->chunk_time = g_get_monotonic_time ();
+
+		for (i = 0; i < IMAPX_FETCH_PIPELINE_DEPTH && data->fetch_offset < data->size; i++) {
+			success = imapx_get_message_queue_chunk (
+				is, job, folder, job->pri,
+				cancellable, error);
+			if (!success)
+				break;
+		}
+	} else {
+		ic = camel_imapx_command_new (
+			is, "FETCH", folder,
+			"UID FETCH %t (BODY.PEEK[])",
+			data->uid);
+		ic->complete = imapx_command_fetch_message_done;
+		camel_imapx_command_set_job (ic, job);
+		ic->pri = job->pri;
+		job->commands++;
+
+		success = imapx_command_queue (is, ic, cancellable, error);
+	}
+
+	g_object_unref (folder);
+
+	return success;
+}
+
+static gboolean
+imapx_job_get_message_matches (CamelIMAPXJob *job,
+                               CamelFolder *folder,
+                               const gchar *uid)
+{
+	GetMessageData *data;
+
+	data = camel_imapx_job_get_data (job);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	if (!camel_imapx_job_has_folder (job, folder))
+		return FALSE;
+
+	if (g_strcmp0 (uid, data->cache_key) != 0)
+		return FALSE;
+
+	return TRUE;
+}
+
+/* ********************************************************************** */
+
+/* Keeps the structure in the folder's database and the header next
+ * to the message parts in the data cache. */
+static gboolean
+imapx_store_bodystructure (CamelFolder *folder,
+                           BodystructureData *data,
+                           GError **error)
+{
+	CamelIMAPXFolder *ifolder = CAMEL_IMAPX_FOLDER (folder);
+	CamelStore *parent_store;
+	CamelStream *stream;
+	gchar *header_key;
+	gchar *bodystructure;
+	gboolean success;
+
+	header_key = imapx_message_part_key (data->uid, "HEADER");
+	stream = camel_data_cache_add (
+		ifolder->cache, "part", header_key, error);
+	g_free (header_key);
+
+	if (stream == NULL)
+		return FALSE;
+
+	success = camel_stream_write (
+		stream, (gchar *) data->header->data,
+		data->header->len, NULL, error) != -1 &&
+		camel_stream_flush (stream, NULL, error) == 0;
+
+	g_object_unref (stream);
+
+	if (!success)
+		return FALSE;
+
+	/* Written last, its presence says the header is complete */
+	parent_store = camel_folder_get_parent_store (folder);
+	bodystructure = imapx_body_to_string (data->cinfo);
+	success = camel_db_write_bodystructure (
+		parent_store->cdb_w,
+		camel_folder_get_full_name (folder),
+		data->uid, bodystructure, error) == 0;
+	g_free (bodystructure);
+
+	return success;
+}
+
+static gboolean
+imapx_command_get_bodystructure_done (CamelIMAPXServer *is,
+                                      CamelIMAPXCommand *ic,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+	CamelIMAPXJob *job;
+	CamelFolder *folder;
+	BodystructureData *data;
+
+	job = camel_imapx_command_get_job (ic);
+	g_return_val_if_fail (CAMEL_IS_IMAPX_JOB (job), FALSE);
+
+	data = camel_imapx_job_get_data (job);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	folder = camel_imapx_job_ref_folder (job);
+	g_return_val_if_fail (folder != NULL, FALSE);
+
+	/* Failures here belong to the caller, not the connection */
+	if (camel_imapx_command_set_error_if_failed (ic, &data->error)) {
+		g_prefix_error (
+			&data->error, "%s: ",
+			_("Error fetching message"));
+	} else if (data->cinfo == NULL || data->header == NULL) {
+		g_set_error (
+			&data->error, CAMEL_IMAPX_ERROR, 1, "%s",
+			_("Server did not return the message structure"));
+	} else if (!imapx_store_bodystructure (folder, data, &data->error)) {
+		g_prefix_error (
+			&data->error, "%s: ",
+			_("Error writing to cache stream"));
+	}
+
+	if (data->error != NULL && data->cinfo != NULL) {
+		imapx_free_body (data->cinfo);
+		data->cinfo = NULL;
 	}
 
-	camel_data_cache_remove (ifolder->cache, "tmp", data->uid, NULL);
 	imapx_unregister_job (is, job);
 
-exit:
 	g_object_unref (folder);
 
 	camel_imapx_command_unref (ic);
 
-	g_clear_error (&local_error);
-
-	return success;
+	return TRUE;
 }
 
 static gboolean
-imapx_job_get_message_start (CamelIMAPXJob *job,
-                             CamelIMAPXServer *is,
-                             GCancellable *cancellable,
-                             GError **error)
+imapx_job_get_bodystructure_start (CamelIMAPXJob *job,
+                                   CamelIMAPXServer *is,
+                                   GCancellable *cancellable,
+                                   GError **error)
 {
 	CamelFolder *folder;
 	CamelIMAPXCommand *ic;
-	GetMessageData *data;
-	gint i;
-	gboolean success = TRUE;
+	BodystructureData *data;
+	gboolean success;
 
 	data = camel_imapx_job_get_data (job);
 	g_return_val_if_fail (data != NULL, FALSE);
@@ -4369,37 +5914,15 @@ imapx_job_get_message_start (CamelIMAPXJob *job,
 	folder = camel_imapx_job_ref_folder (job);
 	g_return_val_if_fail (folder != NULL, FALSE);
 
-	if (data->use_multi_fetch) {
-		for (i = 0; i < 3 && data->fetch_offset < data->size; i++) {
-			ic = camel_imapx_command_new (
-				is, "FETCH", folder,
-				"UID FETCH %t (BODY.PEEK[]",
-				data->uid);
-			camel_imapx_command_add (ic, "<%u.%u>", data->fetch_offset, MULTI_SIZE);
-			camel_imapx_command_add (ic, ")");
-			ic->complete = imapx_command_fetch_message_done;
-			camel_imapx_command_set_job (ic, job);
-			ic->pri = job->pri;
-			data->fetch_offset += MULTI_SIZE;
-			job->commands++;
-
-			success = imapx_command_queue (
-				is, ic, cancellable, error);
-			if (!success)
-				break;
-		}
-	} else {
-		ic = camel_imapx_command_new (
-			is, "FETCH", folder,
-			"UID FETCH %t (BODY.PEEK[])",
-			data->uid);
-		ic->complete = imapx_command_fetch_message_done;
-		camel_imapx_command_set_job (ic, job);
-		ic->pri = job->pri;
-		job->commands++;
+	ic = camel_imapx_command_new (
+		is, "FETCH", folder,
+		"UID FETCH %t (BODYSTRUCTURE BODY.PEEK[HEADER])",
+		data->uid);
+	ic->complete = imapx_command_get_bodystructure_done;
+	camel_imapx_command_set_job (ic, job);
+	ic->pri = job->pri;
 
-		success = imapx_command_queue (is, ic, cancellable, error);
-	}
+	success = imapx_command_queue (is, ic, cancellable, error);
 
 	g_object_unref (folder);
 
@@ -4407,11 +5930,11 @@ imapx_job_get_message_start (CamelIMAPXJob *job,
 }
 
 static gboolean
-imapx_job_get_message_matches (CamelIMAPXJob *job,
-                               CamelFolder *folder,
-                               const gchar *uid)
+imapx_job_get_bodystructure_matches (CamelIMAPXJob *job,
+                                     CamelFolder *folder,
+                                     const gchar *uid)
 {
-	GetMessageData *data;
+	BodystructureData *data;
 
 	data = camel_imapx_job_get_data (job);
 	g_return_val_if_fail (data != NULL, FALSE);
@@ -4419,10 +5942,7 @@ imapx_job_get_message_matches (CamelIMAPXJob *job,
 	if (!camel_imapx_job_has_folder (job, folder))
 		return FALSE;
 
-	if (g_strcmp0 (uid, data->uid) != 0)
-		return FALSE;
-
-	return TRUE;
+	return g_strcmp0 (uid, data->uid) == 0;
 }
 
 /* ********************************************************************** */
@@ -4460,7 +5980,9 @@ imapx_command_copy_messages_step_done (CamelIMAPXServer *is,
 		goto exit;
 	}
 
-	if (data->delete_originals) {
+	/* With MOVE the server has already expunged the originals, and
+	 * the summary was updated from the EXPUNGE/VANISHED responses. */
+	if (data->delete_originals && !data->use_move) {
 		gint j;
 
 		for (j = data->last_index; j < i; j++)
@@ -4470,18 +5992,9 @@ imapx_command_copy_messages_step_done (CamelIMAPXServer *is,
 	/* TODO Copy the summary and cached messages to the new folder.
 	 *      We might need a sorted insert to avoid refreshing the dest
 	 *      folder. */
-	if (ic->status && ic->status->condition == IMAPX_COPYUID) {
-		gint i;
-
-		for (i = 0; i < ic->status->u.copyuid.copied_uids->len; i++) {
-			guint32 uid = GPOINTER_TO_UINT (g_ptr_array_index (ic->status->u.copyuid.copied_uids, i));
-			gchar *str = g_strdup_printf ("%d",uid);
-			CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) data->dest;
-
-			g_hash_table_insert (ifolder->ignore_recent, str, GINT_TO_POINTER (1));
-		}
-
-	}
+	if (ic->status && ic->status->condition == IMAPX_COPYUID)
+		imapx_copy_messages_ignore_recent (
+			data, ic->status->u.copyuid.copied_uids);
 
 	if (i < uids->len) {
 		g_object_unref (folder);
@@ -4522,7 +6035,10 @@ imapx_command_copy_messages_step_start (CamelIMAPXServer *is,
 
 	uids = data->uids;
 
-	ic = camel_imapx_command_new (is, "COPY", folder, "UID COPY ");
+	if (data->use_move)
+		ic = camel_imapx_command_new (is, "MOVE", folder, "UID MOVE ");
+	else
+		ic = camel_imapx_command_new (is, "COPY", folder, "UID COPY ");
 	ic->complete = imapx_command_copy_messages_step_done;
 	camel_imapx_command_set_job (ic, job);
 	ic->pri = job->pri;
@@ -4576,6 +6092,11 @@ imapx_job_copy_messages_start (CamelIMAPXJob *job,
 	g_ptr_array_sort (data->uids, (GCompareFunc) imapx_uids_array_cmp);
 	imapx_uidset_init (&data->uidset, 0, MAX_COMMAND_LEN);
 
+	/* RFC 6851: moving in one step saves flagging the originals
+	 * as deleted and expunging them later. */
+	data->use_move = data->delete_originals && is->cinfo != NULL &&
+		(is->cinfo->capa & IMAPX_CAPABILITY_MOVE) != 0;
+
 	g_object_unref (folder);
 
 	return imapx_command_copy_messages_step_start (
@@ -4584,6 +6105,44 @@ imapx_job_copy_messages_start (CamelIMAPXJob *job,
 
 /* ********************************************************************** */
 
+/* Moves the spooled message @index of @data to the real cache
+ * under the @uid the server gave it, and adds it to the summary. */
+static void
+imapx_append_message_add_to_summary (CamelIMAPXServer *is,
+                                     CamelFolder *folder,
+                                     AppendMessageData *data,
+                                     guint index,
+                                     guint32 uid,
+                                     CamelFolderChangeInfo *changes)
+{
+	CamelIMAPXFolder *ifolder = CAMEL_IMAPX_FOLDER (folder);
+	CamelMessageInfo *info, *mi;
+	gchar *cur, *appended_uid;
+
+	info = data->infos->pdata[index];
+
+	appended_uid = g_strdup_printf ("%u", (guint) uid);
+
+	mi = camel_message_info_clone (info);
+	mi->uid = camel_pstring_add (g_strdup (appended_uid), TRUE);
+
+	cur = camel_data_cache_get_filename (ifolder->cache, "cur", mi->uid);
+	g_rename (data->paths->pdata[index], cur);
+	g_free (cur);
+
+	/* should we update the message count ? */
+	imapx_set_message_info_flags_for_new_message (
+		mi,
+		((CamelMessageInfoBase *) info)->flags,
+		((CamelMessageInfoBase *) info)->user_flags,
+		folder);
+	camel_folder_summary_add (folder->summary, mi);
+	camel_folder_change_info_add_uid (changes, mi->uid);
+
+	g_free (data->appended_uids->pdata[index]);
+	data->appended_uids->pdata[index] = appended_uid;
+}
+
 static gboolean
 imapx_command_append_message_done (CamelIMAPXServer *is,
                                    CamelIMAPXCommand *ic,
@@ -4593,9 +6152,8 @@ imapx_command_append_message_done (CamelIMAPXServer *is,
 	CamelIMAPXJob *job;
 	CamelIMAPXFolder *ifolder;
 	CamelFolder *folder;
-	CamelMessageInfo *mi;
 	AppendMessageData *data;
-	gchar *cur, *old_uid;
+	guint ii;
 	gboolean success = TRUE;
 
 	job = camel_imapx_command_get_job (ic);
@@ -4610,13 +6168,11 @@ imapx_command_append_message_done (CamelIMAPXServer *is,
 	ifolder = CAMEL_IMAPX_FOLDER (folder);
 
 	/* Append done.  If we the server supports UIDPLUS we will get
-	 * an APPENDUID response with the new uid.  This lets us move the
-	 * message we have directly to the cache and also create a correctly
-	 * numbered MessageInfo, without losing any information.  Otherwise
-	 * we have to wait for the server to let us know it was appended. */
-
-	mi = camel_message_info_clone (data->info);
-	old_uid = g_strdup (data->info->uid);
+	 * an APPENDUID response with the new uids, one per message in
+	 * the batch.  This lets us move the messages we have directly
+	 * to the cache and also create correctly numbered MessageInfos,
+	 * without losing any information.  Otherwise we have to wait for
+	 * the server to let us know they were appended. */
 
 	if (camel_imapx_command_set_error_if_failed (ic, error)) {
 		g_prefix_error (
@@ -4625,68 +6181,109 @@ imapx_command_append_message_done (CamelIMAPXServer *is,
 		success = FALSE;
 
 	} else if (ic->status && ic->status->condition == IMAPX_APPENDUID) {
+		GPtrArray *uids = ic->status->u.appenduid.uids;
+
 		c (is->tagprefix, "Got appenduid %d %d\n", (gint) ic->status->u.appenduid.uidvalidity, (gint) ic->status->u.appenduid.uid);
-		if (ic->status->u.appenduid.uidvalidity == ifolder->uidvalidity_on_server) {
+		if (ic->status->u.appenduid.uidvalidity != ifolder->uidvalidity_on_server) {
+			c (is->tagprefix, "but uidvalidity changed\n");
+		} else if (uids == NULL || uids->len != data->batch) {
+			c (is->tagprefix, "but got %u uids for %u messages\n", uids ? uids->len : 0, data->batch);
+		} else {
 			CamelFolderChangeInfo *changes;
 
-			data->appended_uid = g_strdup_printf ("%u", (guint) ic->status->u.appenduid.uid);
-			mi->uid = camel_pstring_add (data->appended_uid, FALSE);
+			changes = camel_folder_change_info_new ();
 
-			cur = camel_data_cache_get_filename  (ifolder->cache, "cur", mi->uid);
-			g_rename (data->path, cur);
+			for (ii = 0; ii < data->batch; ii++)
+				imapx_append_message_add_to_summary (
+					is, folder, data, data->index + ii,
+					GPOINTER_TO_UINT (uids->pdata[ii]),
+					changes);
 
-			/* should we update the message count ? */
-			imapx_set_message_info_flags_for_new_message (
-				mi,
-				((CamelMessageInfoBase *) data->info)->flags,
-				((CamelMessageInfoBase *) data->info)->user_flags,
-				folder);
-			camel_folder_summary_add (folder->summary, mi);
-			changes = camel_folder_change_info_new ();
-			camel_folder_change_info_add_uid (changes, mi->uid);
 			camel_folder_changed (folder, changes);
 			camel_folder_change_info_free (changes);
-
-			g_free (cur);
-		} else {
-			g_message ("but uidvalidity changed \n");
 		}
 	}
 
-	camel_data_cache_remove (ifolder->cache, "new", old_uid, NULL);
-	g_free (old_uid);
+	for (ii = data->index; ii < data->index + data->batch; ii++) {
+		CamelMessageInfo *info = data->infos->pdata[ii];
+
+		camel_data_cache_remove (ifolder->cache, "new", info->uid, NULL);
+	}
+
+	data->index += data->batch;
+	data->batch = 0;
 
 	g_object_unref (folder);
 
-	imapx_unregister_job (is, job);
+	/* Once the next batch is queued, its own completion ends the
+	 * job; on every other path nothing else would, so end it here. */
+	if (success && data->index < data->infos->len) {
+		success = imapx_job_append_message_step (
+			job, is, cancellable, error);
+		if (!success)
+			imapx_unregister_job (is, job);
+	} else {
+		imapx_unregister_job (is, job);
+	}
+
 	camel_imapx_command_unref (ic);
 
 	return success;
 }
 
+/* Sends the next message, or with MULTIAPPEND (RFC 3502) the next
+ * batch of messages, in a single APPEND command.  The literals are
+ * non-synchronizing if the server has LITERAL+, so the whole batch
+ * streams out without waiting for continuation requests. */
 static gboolean
-imapx_job_append_message_start (CamelIMAPXJob *job,
-                                CamelIMAPXServer *is,
-                                GCancellable *cancellable,
-                                GError **error)
+imapx_job_append_message_step (CamelIMAPXJob *job,
+                               CamelIMAPXServer *is,
+                               GCancellable *cancellable,
+                               GError **error)
 {
 	CamelFolder *folder;
 	CamelIMAPXCommand *ic;
 	AppendMessageData *data;
+	gboolean multiappend;
+	goffset batch_size = 0;
 
 	data = camel_imapx_job_get_data (job);
 	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (data->index < data->infos->len, FALSE);
 
 	folder = camel_imapx_job_ref_folder (job);
 	g_return_val_if_fail (folder != NULL, FALSE);
 
+	multiappend = is->cinfo &&
+		(is->cinfo->capa & IMAPX_CAPABILITY_MULTIAPPEND) != 0;
+
 	/* TODO: we could supply the original append date from the file timestamp */
 	ic = camel_imapx_command_new (
-		is, "APPEND", NULL,
-		"APPEND %f %F %P", folder,
-		((CamelMessageInfoBase *) data->info)->flags,
-		((CamelMessageInfoBase *) data->info)->user_flags,
-		data->path);
+		is, "APPEND", NULL, "APPEND %f", folder);
+
+	data->batch = 0;
+
+	while (data->index + data->batch < data->infos->len) {
+		CamelMessageInfoBase *info;
+		const gchar *path;
+		struct stat st;
+
+		info = data->infos->pdata[data->index + data->batch];
+		path = data->paths->pdata[data->index + data->batch];
+
+		if (g_stat (path, &st) == 0)
+			batch_size += st.st_size;
+
+		camel_imapx_command_add (
+			ic, " %F %P", info->flags, info->user_flags, path);
+		data->batch++;
+
+		if (!multiappend ||
+		    data->batch >= IMAPX_APPEND_BATCH_COUNT ||
+		    batch_size >= IMAPX_APPEND_BATCH_SIZE)
+			break;
+	}
+
 	ic->complete = imapx_command_append_message_done;
 	camel_imapx_command_set_job (ic, job);
 	ic->pri = job->pri;
@@ -4697,6 +6294,15 @@ imapx_job_append_message_start (CamelIMAPXJob *job,
 	return imapx_command_queue (is, ic, cancellable, error);
 }
 
+static gboolean
+imapx_job_append_message_start (CamelIMAPXJob *job,
+                                CamelIMAPXServer *is,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	return imapx_job_append_message_step (job, is, cancellable, error);
+}
+
 /* ********************************************************************** */
 
 static gint
@@ -4836,6 +6442,7 @@ imapx_command_step_fetch_done (CamelIMAPXServer *is,
 	if (i < data->infos->len) {
 		gint total = camel_folder_summary_count (folder->summary);
 		gint fetch_limit = data->fetch_msg_limit;
+		gchar *fetch_items;
 
 		camel_imapx_command_unref (ic);
 
@@ -4848,6 +6455,8 @@ imapx_command_step_fetch_done (CamelIMAPXServer *is,
 		//printf ("Total: %d: %d, %d, %d\n", total, fetch_limit, i, data->last_index);
 		data->last_index = i;
 
+		fetch_items = imapx_dup_summary_fetch_items (is, FALSE);
+
 		/* If its mobile client and  when total=0 (new account setup) fetch only one batch of mails,
  		 * on futher attempts download all new mails as per the limit. */
 		//printf ("Total: %d: %d\n", total, fetch_limit);
@@ -4859,10 +6468,11 @@ imapx_command_step_fetch_done (CamelIMAPXServer *is,
 			if (!r->exists) {
 				res = imapx_uidset_add (&data->uidset, ic, r->uid);
 				if (res == 1) {
-					camel_imapx_command_add (ic, " (RFC822.SIZE RFC822.HEADER)");
+					camel_imapx_command_add (ic, " (%t)", fetch_items);
 					data->index = i + 1;
 
 					g_object_unref (folder);
+					g_free (fetch_items);
 
 					return imapx_command_queue (is, ic, cancellable, error);
 				}
@@ -4872,12 +6482,15 @@ imapx_command_step_fetch_done (CamelIMAPXServer *is,
 		//printf ("Existing : %d Gonna fetch in %s for %d/%d\n", total, camel_folder_get_full_name (folder), i, data->infos->len);
 		data->index = data->infos->len;
 		if (imapx_uidset_done (&data->uidset, ic)) {
-			camel_imapx_command_add (ic, " (RFC822.SIZE RFC822.HEADER)");
+			camel_imapx_command_add (ic, " (%t)", fetch_items);
 
 			g_object_unref (folder);
+			g_free (fetch_items);
 
 			return imapx_command_queue (is, ic, cancellable, error);
 		}
+
+		g_free (fetch_items);
 	}
 
 	if (camel_folder_summary_count (folder->summary)) {
@@ -4989,6 +6602,39 @@ imapx_job_scan_changes_done (CamelIMAPXServer *is,
 		((CamelIMAPXSummary *) s)->uidnext = ifolder->uidnext_on_server;
 		((CamelIMAPXSummary *) s)->modseq = ifolder->modseq_on_server;
 
+		if (data->changed_since > 0) {
+			/* Only changed messages were returned; nothing can
+			 * be deduced about the others, so just update the
+			 * ones we got and note any we don't know yet. */
+			for (i = 0; i < data->infos->len; i++) {
+				struct _refresh_info *r = &g_array_index (data->infos, struct _refresh_info, i);
+
+				s_minfo = camel_folder_summary_get (s, r->uid);
+				if (s_minfo == NULL) {
+					fetch_new = TRUE;
+					continue;
+				}
+
+				if (imapx_update_message_info_flags (s_minfo, r->server_flags, r->server_user_flags, is->permanentflags, folder, FALSE))
+					camel_folder_change_info_change_uid (data->changes, camel_message_info_uid (s_minfo));
+				r->exists = TRUE;
+
+				camel_message_info_free (s_minfo);
+			}
+
+			qsort (data->infos->data, data->infos->len, sizeof (struct _refresh_info), imapx_refresh_info_cmp);
+
+			e (
+				is->tagprefix, "%u messages changed since modseq %" G_GUINT64_FORMAT " in %s\n",
+				data->infos->len, data->changed_since,
+				camel_folder_get_full_name (folder));
+
+			goto merged;
+		}
+
+		camel_imapx_summary_set_last_full_scan (
+			(CamelIMAPXSummary *) s, time (NULL));
+
 		/* Here we do the typical sort/iterate/merge loop.
 		 * If the server flags dont match what we had, we modify our
 		 * flags to pick up what the server now has - but we merge
@@ -5076,6 +6722,9 @@ imapx_job_scan_changes_done (CamelIMAPXServer *is,
 			g_list_free_full (removed, (GDestroyNotify) g_free);
 		}
 
+		camel_folder_summary_free_array (uids);
+
+	merged:
 		camel_folder_summary_save_to_db (s, NULL);
 		imapx_update_store_summary (folder);
 
@@ -5083,8 +6732,6 @@ imapx_job_scan_changes_done (CamelIMAPXServer *is,
 			camel_folder_changed (folder, data->changes);
 		camel_folder_change_info_clear (data->changes);
 
-		camel_folder_summary_free_array (uids);
-
 		/* If we have any new messages, download their headers, but only a few (100?) at a time */
 		if (fetch_new) {
 			job->pop_operation_msg = TRUE;
@@ -5125,6 +6772,36 @@ imapx_job_scan_changes_done (CamelIMAPXServer *is,
 	return success;
 }
 
+/* Returns the modseq to pass to CHANGEDSINCE when rescanning @folder,
+ * or 0 if all flags need to be fetched.  Without QRESYNC the server
+ * doesn't tell us about expunged messages, so this is only safe when
+ * the message count still matches. */
+static guint64
+imapx_scan_changed_since (CamelIMAPXServer *is,
+                          CamelFolder *folder)
+{
+	CamelIMAPXFolder *ifolder = CAMEL_IMAPX_FOLDER (folder);
+	CamelIMAPXSummary *isum = CAMEL_IMAPX_SUMMARY (folder->summary);
+	time_t now, last_full_scan;
+
+	if (is->cinfo == NULL || (is->cinfo->capa & IMAPX_CAPABILITY_CONDSTORE) == 0)
+		return 0;
+
+	if (isum->modseq == 0 || isum->validity != ifolder->uidvalidity_on_server)
+		return 0;
+
+	if (camel_folder_summary_count (folder->summary) != ifolder->exists_on_server)
+		return 0;
+
+	now = time (NULL);
+	last_full_scan = camel_imapx_summary_get_last_full_scan (isum);
+	if (last_full_scan > now ||
+	    now - last_full_scan >= IMAPX_FULL_SCAN_INTERVAL)
+		return 0;
+
+	return isum->modseq;
+}
+
 static gboolean
 imapx_job_scan_changes_start (CamelIMAPXJob *job,
                               CamelIMAPXServer *is,
@@ -5151,6 +6828,8 @@ imapx_job_scan_changes_start (CamelIMAPXJob *job,
 	if (mobile_mode)
 		uid = imapx_get_uid_from_index (folder->summary, 0);
 
+	data->changed_since = imapx_scan_changed_since (is, folder);
+
 	job->pop_operation_msg = TRUE;
 
 	camel_operation_push_message (
@@ -5165,6 +6844,10 @@ imapx_job_scan_changes_start (CamelIMAPXJob *job,
 	ic = camel_imapx_command_new (
 		is, "FETCH", folder,
 		"UID FETCH %s:* (UID FLAGS)", uid ? uid : "1");
+	if (data->changed_since > 0)
+		camel_imapx_command_add (
+			ic, " (CHANGEDSINCE %" G_GUINT64_FORMAT ")",
+			data->changed_since);
 	camel_imapx_command_set_job (ic, job);
 	ic->complete = imapx_job_scan_changes_done;
 
@@ -5293,60 +6976,172 @@ imapx_job_fetch_new_messages_start (CamelIMAPXJob *job,
 	data = camel_imapx_job_get_data (job);
 	g_return_val_if_fail (data != NULL, FALSE);
 
-	folder = camel_imapx_job_ref_folder (job);
-	g_return_val_if_fail (folder != NULL, FALSE);
+	folder = camel_imapx_job_ref_folder (job);
+	g_return_val_if_fail (folder != NULL, FALSE);
+
+	settings = camel_imapx_server_ref_settings (is);
+	fetch_order = camel_imapx_settings_get_fetch_order (settings);
+	uidset_size = camel_imapx_settings_get_batch_fetch_count (settings);
+	g_object_unref (settings);
+
+	ifolder = CAMEL_IMAPX_FOLDER (folder);
+
+	total = camel_folder_summary_count (folder->summary);
+	diff = ifolder->exists_on_server - total;
+
+	if (total > 0) {
+		guint64 uidl;
+		uid = imapx_get_uid_from_index (folder->summary, total - 1);
+		uidl = strtoull (uid, NULL, 10);
+		g_free (uid);
+		uid = g_strdup_printf ("%" G_GUINT64_FORMAT, uidl + 1);
+	} else
+		uid = g_strdup ("1");
+
+	job->pop_operation_msg = TRUE;
+
+	camel_operation_push_message (
+		cancellable,
+		_("Fetching summary information for new messages in '%s'"),
+		camel_folder_get_display_name (folder));
+
+	//printf ("Fetch order: %d/%d\n", fetch_order, CAMEL_SORT_DESCENDING);
+	if (diff > uidset_size || fetch_order == CAMEL_SORT_DESCENDING) {
+		ic = camel_imapx_command_new (
+			is, "FETCH", folder,
+			"UID FETCH %s:* (UID FLAGS)", uid);
+		imapx_uidset_init (&data->uidset, uidset_size, 0);
+		refresh_info_data_infos_free (data);
+		data->infos = g_array_new (0, 0, sizeof (struct _refresh_info));
+		ic->pri = job->pri;
+
+		data->scan_changes = TRUE;
+
+		if (fetch_order == CAMEL_SORT_DESCENDING)
+			ic->complete = imapx_command_fetch_new_uids_done;
+		else
+			ic->complete = imapx_command_step_fetch_done;
+	} else {
+		gchar *fetch_items;
+
+		fetch_items = imapx_dup_summary_fetch_items (is, TRUE);
+		ic = camel_imapx_command_new (
+			is, "FETCH", folder,
+			"UID FETCH %s:* (%t)", uid, fetch_items);
+		ic->pri = job->pri;
+		ic->complete = imapx_command_fetch_new_messages_done;
+		g_free (fetch_items);
+	}
+
+	g_free (uid);
+
+	camel_imapx_command_set_job (ic, job);
+
+	g_object_unref (folder);
+
+	return imapx_command_queue (is, ic, cancellable, error);
+}
+
+static gboolean
+imapx_command_fetch_summary_range_done (CamelIMAPXServer *is,
+                                        CamelIMAPXCommand *ic,
+                                        GCancellable *cancellable,
+                                        GError **error)
+{
+	CamelIMAPXJob *job;
+	gboolean success = TRUE;
+
+	job = camel_imapx_command_get_job (ic);
+	g_return_val_if_fail (CAMEL_IS_IMAPX_JOB (job), FALSE);
+
+	if (camel_imapx_command_set_error_if_failed (ic, error)) {
+		g_prefix_error (
+			error, "%s: ",
+			_("Error fetching new messages"));
+		success = FALSE;
+	}
+
+	imapx_unregister_job (is, job);
+	camel_imapx_command_unref (ic);
+
+	return success;
+}
+
+static gboolean
+imapx_job_fetch_summary_range_start (CamelIMAPXJob *job,
+                                     CamelIMAPXServer *is,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	CamelIMAPXCommand *ic;
+	CamelFolder *folder;
+	RefreshInfoData *data;
+	gchar *fetch_items;
+
+	data = camel_imapx_job_get_data (job);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	folder = camel_imapx_job_ref_folder (job);
+	g_return_val_if_fail (folder != NULL, FALSE);
+
+	fetch_items = imapx_dup_summary_fetch_items (is, TRUE);
+	ic = camel_imapx_command_new (
+		is, "FETCH", folder,
+		"UID FETCH %u:%u (%t)",
+		data->uidset.start, data->uidset.last, fetch_items);
+	ic->pri = job->pri;
+	ic->complete = imapx_command_fetch_summary_range_done;
+	g_free (fetch_items);
+
+	camel_imapx_command_set_job (ic, job);
 
-	settings = camel_imapx_server_ref_settings (is);
-	fetch_order = camel_imapx_settings_get_fetch_order (settings);
-	uidset_size = camel_imapx_settings_get_batch_fetch_count (settings);
-	g_object_unref (settings);
+	g_object_unref (folder);
 
-	ifolder = CAMEL_IMAPX_FOLDER (folder);
+	return imapx_command_queue (is, ic, cancellable, error);
+}
 
-	total = camel_folder_summary_count (folder->summary);
-	diff = ifolder->exists_on_server - total;
+static gboolean
+imapx_command_status_done (CamelIMAPXServer *is,
+                           CamelIMAPXCommand *ic,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	CamelIMAPXJob *job;
+	gboolean success = TRUE;
 
-	if (total > 0) {
-		guint64 uidl;
-		uid = imapx_get_uid_from_index (folder->summary, total - 1);
-		uidl = strtoull (uid, NULL, 10);
-		g_free (uid);
-		uid = g_strdup_printf ("%" G_GUINT64_FORMAT, uidl + 1);
-	} else
-		uid = g_strdup ("1");
+	job = camel_imapx_command_get_job (ic);
+	g_return_val_if_fail (CAMEL_IS_IMAPX_JOB (job), FALSE);
 
-	job->pop_operation_msg = TRUE;
+	if (camel_imapx_command_set_error_if_failed (ic, error)) {
+		g_prefix_error (
+			error, "%s: ",
+			_("Error refreshing folder"));
+		success = FALSE;
+	}
 
-	camel_operation_push_message (
-		cancellable,
-		_("Fetching summary information for new messages in '%s'"),
-		camel_folder_get_display_name (folder));
+	imapx_unregister_job (is, job);
+	camel_imapx_command_unref (ic);
 
-	//printf ("Fetch order: %d/%d\n", fetch_order, CAMEL_SORT_DESCENDING);
-	if (diff > uidset_size || fetch_order == CAMEL_SORT_DESCENDING) {
-		ic = camel_imapx_command_new (
-			is, "FETCH", folder,
-			"UID FETCH %s:* (UID FLAGS)", uid);
-		imapx_uidset_init (&data->uidset, uidset_size, 0);
-		refresh_info_data_infos_free (data);
-		data->infos = g_array_new (0, 0, sizeof (struct _refresh_info));
-		ic->pri = job->pri;
+	return success;
+}
 
-		data->scan_changes = TRUE;
+static gboolean
+imapx_job_status_start (CamelIMAPXJob *job,
+                        CamelIMAPXServer *is,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	CamelIMAPXCommand *ic;
+	CamelFolder *folder;
 
-		if (fetch_order == CAMEL_SORT_DESCENDING)
-			ic->complete = imapx_command_fetch_new_uids_done;
-		else
-			ic->complete = imapx_command_step_fetch_done;
-	} else {
-		ic = camel_imapx_command_new (
-			is, "FETCH", folder,
-			"UID FETCH %s:* (RFC822.SIZE RFC822.HEADER FLAGS)", uid);
-		ic->pri = job->pri;
-		ic->complete = imapx_command_fetch_new_messages_done;
-	}
+	folder = camel_imapx_job_ref_folder (job);
+	g_return_val_if_fail (folder != NULL, FALSE);
 
-	g_free (uid);
+	ic = camel_imapx_command_new (
+		is, "STATUS", NULL,
+		"STATUS %f (MESSAGES UNSEEN UIDVALIDITY UIDNEXT)", folder);
+	ic->pri = job->pri;
+	ic->complete = imapx_command_status_done;
 
 	camel_imapx_command_set_job (ic, job);
 
@@ -5455,6 +7250,7 @@ imapx_job_fetch_messages_start (CamelIMAPXJob *job,
 		g_free (uid);
 
 	} else if (ftype == CAMEL_FETCH_OLD_MESSAGES && total > 0) {
+		gchar *fetch_items;
 		guint64 uidl;
 		start_uid = imapx_get_uid_from_index (folder->summary, 0);
 		uidl = strtoull (start_uid, NULL, 10);
@@ -5468,12 +7264,14 @@ imapx_job_fetch_messages_start (CamelIMAPXJob *job,
 			data->fetch_msg_limit,
 			camel_folder_get_display_name (folder));
 
+		fetch_items = imapx_dup_summary_fetch_items (is, TRUE);
 		ic = camel_imapx_command_new (
 			is, "FETCH", folder,
-			"UID FETCH %s:%s (RFC822.SIZE RFC822.HEADER FLAGS)", start_uid, end_uid);
+			"UID FETCH %s:%s (%t)", start_uid, end_uid, fetch_items);
 		ic->pri = job->pri;
 		ic->complete = imapx_command_fetch_new_messages_done;
 
+		g_free (fetch_items);
 		g_free (start_uid);
 		g_free (end_uid);
 
@@ -5488,6 +7286,47 @@ imapx_job_fetch_messages_start (CamelIMAPXJob *job,
 	return imapx_command_queue (is, ic, cancellable, error);
 }
 
+/* Whether NOTIFY reported no change to @folder since its last
+ * refresh, so there is nothing to ask the server; see
+ * camel_imapx_conn_manager_begin_notify_refresh(). */
+static gboolean
+imapx_server_notify_quiet (CamelIMAPXServer *is,
+                           CamelFolder *folder,
+                           gboolean *tracked)
+{
+	CamelIMAPXStore *store;
+	CamelStoreSummary *summary;
+	CamelStoreInfo *si;
+	const gchar *full_name;
+	gboolean personal, subscribed = FALSE;
+	gboolean quiet = FALSE;
+
+	*tracked = FALSE;
+
+	store = camel_imapx_server_ref_store (is);
+	summary = (CamelStoreSummary *) store->summary;
+	full_name = camel_folder_get_full_name (folder);
+
+	if (store->con_man != NULL && store->summary->namespaces != NULL) {
+		personal = camel_imapx_store_summary_namespace_find_path (
+			store->summary, full_name) != NULL;
+
+		si = camel_store_summary_path (summary, full_name);
+		if (si != NULL) {
+			subscribed = (si->flags & CAMEL_STORE_INFO_FOLDER_SUBSCRIBED) != 0;
+			camel_store_summary_info_free (summary, si);
+		}
+
+		quiet = camel_imapx_conn_manager_begin_notify_refresh (
+			store->con_man, full_name,
+			personal, subscribed, tracked);
+	}
+
+	g_object_unref (store);
+
+	return quiet;
+}
+
 static gboolean
 imapx_job_refresh_info_start (CamelIMAPXJob *job,
                               CamelIMAPXServer *is,
@@ -5498,10 +7337,13 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 	CamelIMAPXSettings *settings;
 	CamelIMAPXSummary *isum;
 	CamelFolder *folder;
+	RefreshInfoData *data;
 	const gchar *full_name;
 	gboolean need_rescan = FALSE;
 	gboolean is_selected = FALSE;
 	gboolean can_qresync = FALSE;
+	gboolean reselected = FALSE;
+	gboolean have_status;
 	gboolean mobile_mode;
 	gboolean success;
 	guint32 total;
@@ -5518,6 +7360,8 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 
 	full_name = camel_folder_get_full_name (folder);
 
+	data = camel_imapx_job_get_data (job);
+
 	/* Sync changes first, else unread count will not
 	 * match. Need to think about better ways for this */
 	success = imapx_server_sync_changes (
@@ -5525,6 +7369,14 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 	if (!success)
 		goto done;
 
+	/* The server would have told us with NOTIFY if the folder
+	 * had changed, unless it is the one selected here. */
+	if (is->select_folder != folder &&
+	    imapx_server_notify_quiet (is, folder, &data->notify_tracked)) {
+		c (is->tagprefix, "No NOTIFY event for %s since the last refresh, not asking\n", full_name);
+		goto done;
+	}
+
 #if 0	/* There are issues with this still; continue with the buggy
 	 * behaviour where we issue STATUS on the current folder, for now. */
 	if (is->select_folder == folder)
@@ -5532,6 +7384,29 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 #endif
 	total = camel_folder_summary_count (folder->summary);
 
+	/* Counts from LIST-STATUS or NOTIFY are as good
+	 * as a STATUS of our own, so use them if we can. */
+	have_status = imapx_server_take_stashed_status (is, folder);
+
+	if (is->use_qresync && isum->modseq &&
+	    (ifolder->uidvalidity_on_server || isum->validity))
+		can_qresync = TRUE;
+
+	/* Selecting the folder with QRESYNC tells us all STATUS would,
+	 * and brings the changes since we last looked with it, so skip
+	 * STATUS.  With the NOOP right behind the SELECT, a folder where
+	 * nothing changed costs one round trip.  The server has no
+	 * unseen count to give, so trust ours from here on. */
+	if (can_qresync && !have_status && is->select_folder != folder) {
+		success = camel_imapx_server_noop (
+			is, folder, cancellable, error);
+		if (!success)
+			goto done;
+
+		reselected = TRUE;
+		total = camel_folder_summary_count (folder->summary);
+	}
+
 	if (ifolder->uidvalidity_on_server && isum->validity && isum->validity != ifolder->uidvalidity_on_server) {
 		invalidate_local_cache (ifolder, ifolder->uidvalidity_on_server);
 		need_rescan = TRUE;
@@ -5542,7 +7417,7 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 	 * message flags, but don't depend on modseq for the selected folder */
 	if (total != ifolder->exists_on_server ||
 	    isum->uidnext != ifolder->uidnext_on_server ||
-	    camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server ||
+	    (!reselected && camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server) ||
 	    (!is_selected && isum->modseq != ifolder->modseq_on_server))
 		need_rescan = TRUE;
 
@@ -5577,7 +7452,7 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 			}
 		} else
 		#endif
-		{
+		if (!have_status && !reselected) {
 			if (is->cinfo && (is->cinfo->capa & IMAPX_CAPABILITY_CONDSTORE) != 0)
 				ic = camel_imapx_command_new (
 					is, "STATUS", NULL,
@@ -5606,11 +7481,11 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 		/* Recalulate need_rescan */
 		if (total != ifolder->exists_on_server ||
 		    isum->uidnext != ifolder->uidnext_on_server ||
-		    camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server ||
+		    (!reselected && camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server) ||
 		    (!is_selected && isum->modseq != ifolder->modseq_on_server))
 			need_rescan = TRUE;
 
-	} else if (mobile_mode) {
+	} else if (mobile_mode && !have_status) {
 		/* We need to issue Status command to get the total unread count */
 		CamelIMAPXCommand *ic;
 
@@ -5633,9 +7508,6 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 		}
 	}
 
-	if (is->use_qresync && isum->modseq && ifolder->uidvalidity_on_server)
-		can_qresync = TRUE;
-
 	e (
 		is->tagprefix, "folder %s is %sselected, total %u / %u, unread %u / %u, modseq %" G_GUINT64_FORMAT " / %" G_GUINT64_FORMAT ", uidnext %u / %u: will %srescan\n",
 		full_name, is_selected?"": "not ", total, ifolder->exists_on_server,
@@ -5674,7 +7546,7 @@ imapx_job_refresh_info_start (CamelIMAPXJob *job,
 		isum->modseq = ifolder->modseq_on_server;
 		total = camel_folder_summary_count (folder->summary);
 		if (total != ifolder->exists_on_server ||
-		    camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server ||
+		    (!reselected && camel_folder_summary_get_unread_count (folder->summary) != ifolder->unread_on_server) ||
 		    (isum->modseq != ifolder->modseq_on_server)) {
 			c (
 				is->tagprefix, "Eep, after QRESYNC we're out of sync. total %u / %u, unread %u / %u, modseq %" G_GUINT64_FORMAT " / %" G_GUINT64_FORMAT "\n",
@@ -6264,12 +8136,25 @@ imapx_command_uid_search_done (CamelIMAPXServer *is,
 
 	/* Don't worry about the success state and presence of search
 	 * results not agreeing here.  camel_imapx_server_uid_search()
-	 * will disregard the search results if an error occurred. */
+	 * will disregard the search results if an error occurred.
+	 * A tagged ESEARCH reply has filled in data already. */
 	g_mutex_lock (&is->priv->search_results_lock);
-	data->results = is->priv->search_results;
-	is->priv->search_results = NULL;
+	if (data->results == NULL) {
+		data->results = is->priv->search_results;
+		data->count = is->priv->search_count;
+		is->priv->search_results = NULL;
+		is->priv->search_count = -1;
+	}
 	g_mutex_unlock (&is->priv->search_results_lock);
 
+	/* An ESEARCH reply may be omitted when nothing matched. */
+	if (success && data->results == NULL)
+		data->results = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+	/* Plain SEARCH has no COUNT, so count the results. */
+	if (data->count < 0 && data->results != NULL)
+		data->count = data->results->len;
+
 	imapx_unregister_job (is, job);
 	camel_imapx_command_unref (ic);
 
@@ -6292,9 +8177,17 @@ imapx_job_uid_search_start (CamelIMAPXJob *job,
 	folder = camel_imapx_job_ref_folder (job);
 	g_return_val_if_fail (folder != NULL, FALSE);
 
-	ic = camel_imapx_command_new (
-		is, "UID SEARCH", folder,
-		"UID SEARCH %t", data->criteria);
+	if (is->cinfo && (is->cinfo->capa & IMAPX_CAPABILITY_ESEARCH) != 0) {
+		ic = camel_imapx_command_new (
+			is, "UID SEARCH", folder,
+			"UID SEARCH RETURN (%t) %t",
+			data->count_only ? "COUNT" : "ALL",
+			data->criteria);
+	} else {
+		ic = camel_imapx_command_new (
+			is, "UID SEARCH", folder,
+			"UID SEARCH %t", data->criteria);
+	}
 	ic->pri = job->pri;
 	camel_imapx_command_set_job (ic, job);
 	ic->complete = imapx_command_uid_search_done;
@@ -6323,6 +8216,14 @@ imapx_command_noop_done (CamelIMAPXServer *is,
 			error, "%s: ",
 			_("Error performing NOOP"));
 		success = FALSE;
+
+	} else if (ic->select != NULL && ic->select != is->select_folder) {
+		/* Sent behind a SELECT which failed */
+		g_set_error (
+			error, CAMEL_IMAPX_ERROR, 1,
+			"Folder '%s' could not be selected",
+			camel_folder_get_full_name (ic->select));
+		success = FALSE;
 	}
 
 	imapx_unregister_job (is, job);
@@ -6690,6 +8591,37 @@ cancel_all_jobs (CamelIMAPXServer *is,
 
 /* ********************************************************************** */
 
+/* Lets the IDLE dwell timer wake the parser thread from the wait for
+ * the next response.  Returns FALSE, not to wait at all, if IDLE is
+ * due already; see imapx_idle_dwell_cb(). */
+static gboolean
+imapx_parser_begin_wait (CamelIMAPXServer *is)
+{
+	gboolean due;
+
+	QUEUE_LOCK (is);
+	due = imapx_idle_is_due (is);
+	is->priv->parser_waiting = !due;
+	QUEUE_UNLOCK (is);
+
+	return !due;
+}
+
+/* Ends imapx_parser_begin_wait().  If the server spoke just as the
+ * timer woke us, the response is read first, so the wakeup must not
+ * cancel that; IDLE is sent after it instead. */
+static void
+imapx_parser_end_wait (CamelIMAPXServer *is,
+                       GCancellable *cancellable,
+                       gboolean have_data)
+{
+	QUEUE_LOCK (is);
+	is->priv->parser_waiting = FALSE;
+	if (have_data && !is->parser_quit && imapx_idle_is_due (is))
+		g_cancellable_reset (cancellable);
+	QUEUE_UNLOCK (is);
+}
+
 static void
 parse_contents (CamelIMAPXServer *is,
                 GCancellable *cancellable,
@@ -6700,10 +8632,24 @@ parse_contents (CamelIMAPXServer *is,
 	stream = camel_imapx_server_ref_stream (is);
 	g_return_if_fail (stream != NULL);
 
+	if (camel_imapx_stream_buffered (stream) == 0) {
+		gboolean have_data = FALSE;
+
+		if (imapx_parser_begin_wait (is)) {
+			have_data = camel_imapx_stream_wait (
+				stream, cancellable, error);
+			imapx_parser_end_wait (is, cancellable, have_data);
+		}
+
+		if (!have_data)
+			goto exit;
+	}
+
 	while (imapx_step (is, cancellable, error))
 		if (camel_imapx_stream_buffered (stream) == 0)
 			break;
 
+exit:
 	g_object_unref (stream);
 }
 
@@ -6743,6 +8689,9 @@ imapx_parser_thread (gpointer d)
 	while (local_error == NULL && have_stream) {
 		g_cancellable_reset (cancellable);
 
+		if (!imapx_idle_issue_if_due (is, cancellable, &local_error))
+			break;
+
 #ifndef G_OS_WIN32
 		if (is->is_process_stream)	{
 			GPollFD fds[2] = { {0, 0, 0}, {0, 0, 0} };
@@ -6756,7 +8705,13 @@ imapx_parser_thread (gpointer d)
 			fds[0].events = G_IO_IN;
 			fds[1].fd = g_cancellable_get_fd (cancellable);
 			fds[1].events = G_IO_IN;
-			res = g_poll (fds, 2, -1);
+			res = 0;
+			if (imapx_parser_begin_wait (is)) {
+				res = g_poll (fds, 2, -1);
+				imapx_parser_end_wait (
+					is, cancellable, res > 0 &&
+					(fds[0].revents & G_IO_IN) != 0);
+			}
 			if (res == -1)
 				g_usleep (1) /* ?? */ ;
 			else if (res == 0)
@@ -6782,7 +8737,8 @@ imapx_parser_thread (gpointer d)
 			is_empty = camel_imapx_command_queue_is_empty (is->active);
 			QUEUE_UNLOCK (is);
 
-			if (is_empty || (imapx_idle_supported (is) && imapx_in_idle (is))) {
+			if (is_empty || imapx_idle_is_due (is) ||
+			    (imapx_idle_supported (is) && imapx_in_idle (is))) {
 				g_cancellable_reset (cancellable);
 				g_clear_error (&local_error);
 			} else {
@@ -6901,6 +8857,9 @@ imapx_server_dispose (GObject *object)
 	}
 	QUEUE_UNLOCK (server);
 
+	/* Before the parser thread goes, which is what IDLE wakes */
+	imapx_idle_stop_dwell (server);
+
 	if (server->parser_thread) {
 		if (server->parser_thread == g_thread_self ())
 			g_idle_add (&join_helper, server->parser_thread);
@@ -6948,6 +8907,17 @@ imapx_server_finalize (GObject *object)
 		g_array_unref (is->priv->search_results);
 	g_mutex_clear (&is->priv->search_results_lock);
 
+	g_hash_table_destroy (is->priv->stashed_status);
+	g_hash_table_destroy (is->priv->notify_refreshes);
+	g_mutex_clear (&is->priv->stashed_status_lock);
+
+	/* The parser may still hold the fetch info's header stream. */
+	if (is->priv->header_parser != NULL)
+		g_object_unref (is->priv->header_parser);
+	imapx_free_fetch (is->priv->fetch_info);
+
+	camel_imapx_stats_free (is->priv->stats);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_imapx_server_parent_class)->finalize (object);
 }
@@ -7045,6 +9015,21 @@ camel_imapx_server_init (CamelIMAPXServer *is)
 
 	g_mutex_init (&is->priv->stream_lock);
 	g_mutex_init (&is->priv->search_results_lock);
+	is->priv->search_count = -1;
+
+	is->priv->stashed_status = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) g_free);
+	is->priv->notify_refreshes = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+	g_mutex_init (&is->priv->stashed_status_lock);
+
+	is->priv->stats = camel_imapx_stats_new ();
 
 	is->queue = camel_imapx_command_queue_new ();
 	is->active = camel_imapx_command_queue_new ();
@@ -7136,6 +9121,8 @@ imapx_disconnect (CamelIMAPXServer *is)
 
 	g_mutex_unlock (&is->priv->stream_lock);
 
+	imapx_idle_stop_dwell (is);
+
 	/* TODO need a select lock */
 	if (is->select_folder) {
 		g_object_unref (is->select_folder);
@@ -7176,6 +9163,8 @@ camel_imapx_server_connect (CamelIMAPXServer *is,
 	if (!imapx_reconnect (is, cancellable, error))
 		return FALSE;
 
+	camel_imapx_stats_add_connections (is->priv->stats, 1, 0);
+
 	is->parser_thread = g_thread_new (NULL, (GThreadFunc) imapx_parser_thread, is);
 
 	return TRUE;
@@ -7185,23 +9174,72 @@ static CamelStream *
 imapx_server_get_message (CamelIMAPXServer *is,
                           CamelFolder *folder,
                           const gchar *uid,
+                          const gchar *section,
+                          const gchar *encoding,
                           gint pri,
                           GCancellable *cancellable,
                           GError **error)
 {
 	CamelStream *stream = NULL;
 	CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) folder;
+	CamelIMAPXConnManager *con_man = NULL;
+	CamelIMAPXServer *fetching = NULL;
+	CamelIMAPXStore *store;
 	CamelIMAPXJob *job;
 	CamelMessageInfo *mi;
 	GetMessageData *data;
+	const gchar *cache_path;
+	gchar *cache_key;
 	gboolean registered;
 	gboolean success;
 
+	if (section != NULL) {
+		cache_path = "part";
+		cache_key = imapx_message_part_key (uid, section);
+	} else {
+		cache_path = "cur";
+		cache_key = g_strdup (uid);
+	}
+
+	/* Another connection may be downloading this already, e.g. for
+	 * offline sync while the user opens the message; the fetch lock
+	 * keeps one from being queued elsewhere until ours is. */
+	store = camel_imapx_server_ref_store (is);
+	if (store != NULL && store->con_man != NULL)
+		con_man = g_object_ref (store->con_man);
+	g_clear_object (&store);
+
+	if (con_man != NULL) {
+		camel_imapx_conn_manager_lock_fetches (con_man);
+		fetching = camel_imapx_conn_manager_ref_fetching_connection (
+			con_man, folder, cache_key);
+	}
+
+	if (fetching != NULL && fetching != is) {
+		camel_imapx_conn_manager_unlock_fetches (con_man);
+		g_object_unref (con_man);
+		g_free (cache_key);
+
+		/* Promotes and waits on the job there. */
+		stream = imapx_server_get_message (
+			fetching, folder, uid, section, encoding,
+			pri, cancellable, error);
+		g_object_unref (fetching);
+
+		return stream;
+	}
+
+	g_clear_object (&fetching);
+
 	QUEUE_LOCK (is);
 
-	if ((job = imapx_is_job_in_queue (is, folder, IMAPX_JOB_GET_MESSAGE, uid))) {
-		if (pri > job->pri)
-			job->pri = pri;
+	if ((job = imapx_is_job_in_queue (is, folder, IMAPX_JOB_GET_MESSAGE, cache_key))) {
+		if (con_man != NULL) {
+			camel_imapx_conn_manager_unlock_fetches (con_man);
+			g_object_unref (con_man);
+		}
+
+		imapx_job_promote (is, job, pri);
 
 		/* Wait for the job to finish. This would be so much nicer if
 		 * we could just use the queue lock with a GCond, but instead
@@ -7222,15 +9260,16 @@ imapx_server_get_message (CamelIMAPXServer *is,
 			QUEUE_LOCK (is);
 
 		} while (imapx_is_job_in_queue (is, folder,
-						IMAPX_JOB_GET_MESSAGE, uid));
+						IMAPX_JOB_GET_MESSAGE, cache_key));
 
 		QUEUE_UNLOCK (is);
 
 		stream = camel_data_cache_get (
-			ifolder->cache, "cur", uid, error);
+			ifolder->cache, cache_path, cache_key, error);
 		if (stream == NULL)
 			g_prefix_error (
 				error, "Could not retrieve the message: ");
+		g_free (cache_key);
 		return stream;
 	}
 
@@ -7242,15 +9281,32 @@ imapx_server_get_message (CamelIMAPXServer *is,
 			_("Cannot get message with message ID %s: %s"),
 			uid, _("No such message available."));
 		QUEUE_UNLOCK (is);
+		if (con_man != NULL) {
+			camel_imapx_conn_manager_unlock_fetches (con_man);
+			g_object_unref (con_man);
+		}
+		g_free (cache_key);
 		return NULL;
 	}
 
 	data = g_slice_new0 (GetMessageData);
 	data->uid = g_strdup (uid);
-	data->stream = camel_data_cache_add (ifolder->cache, "tmp", uid, NULL);
-	data->size = ((CamelMessageInfoBase *) mi)->size;
-	if (data->size > MULTI_SIZE)
-		data->use_multi_fetch = TRUE;
+	data->cache_key = cache_key;
+	data->stream = camel_data_cache_add (ifolder->cache, "tmp", cache_key, NULL);
+
+	if (section != NULL) {
+		data->section = g_strdup (section);
+		data->encoding = g_strdup (encoding);
+		data->use_binary = is->cinfo != NULL &&
+			(is->cinfo->capa & IMAPX_CAPABILITY_BINARY) != 0;
+
+		if (!data->use_binary && data->stream != NULL)
+			imapx_get_message_decode_part (data);
+	} else {
+		data->size = ((CamelMessageInfoBase *) mi)->size;
+		if (data->size > MULTI_SIZE)
+			data->use_multi_fetch = TRUE;
+	}
 
 	job = camel_imapx_job_new (cancellable);
 	job->pri = pri;
@@ -7266,38 +9322,143 @@ imapx_server_get_message (CamelIMAPXServer *is,
 	camel_message_info_free (mi);
 	registered = imapx_register_job (is, job, error);
 
-	QUEUE_UNLOCK (is);
+	QUEUE_UNLOCK (is);
+
+	if (con_man != NULL) {
+		camel_imapx_conn_manager_unlock_fetches (con_man);
+		g_object_unref (con_man);
+	}
+
+	success = registered && camel_imapx_job_run (job, is, error);
+
+	if (success)
+		stream = g_object_ref (data->stream);
+
+	camel_imapx_job_unref (job);
+
+	g_mutex_lock (&is->fetch_mutex);
+	is->fetch_count++;
+	g_cond_broadcast (&is->fetch_cond);
+	g_mutex_unlock (&is->fetch_mutex);
+
+	return stream;
+}
+
+/* Whether a download of @cache_key, a message uid or a part key, from
+ * @folder is queued or in progress on @is. */
+gboolean
+camel_imapx_server_is_fetching (CamelIMAPXServer *is,
+                                CamelFolder *folder,
+                                const gchar *cache_key)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), FALSE);
+
+	return imapx_is_job_in_queue (
+		is, folder, IMAPX_JOB_GET_MESSAGE, cache_key) != NULL;
+}
+
+CamelStream *
+camel_imapx_server_get_message (CamelIMAPXServer *is,
+                                CamelFolder *folder,
+                                const gchar *uid,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	CamelStream *stream;
+
+	stream = imapx_server_get_message (
+		is, folder, uid, NULL, NULL,
+		IMAPX_PRIORITY_GET_MESSAGE,
+		cancellable, error);
+
+	return stream;
+}
+
+/* Returns the decoded content of the single MIME part @section of
+ * the message, as found in its BODYSTRUCTURE, and keeps it in the
+ * folder's data cache.  @encoding is the part's Content-Transfer-
+ * Encoding, needed when the server lacks BINARY (RFC 3516) and the
+ * part has to be decoded here. */
+CamelStream *
+camel_imapx_server_get_message_part (CamelIMAPXServer *is,
+                                     CamelFolder *folder,
+                                     const gchar *uid,
+                                     const gchar *section,
+                                     const gchar *encoding,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) folder;
+	CamelStream *stream;
+	gchar *cache_key;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), NULL);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (uid != NULL, NULL);
+	g_return_val_if_fail (section != NULL && *section != '\0', NULL);
+
+	cache_key = imapx_message_part_key (uid, section);
+	stream = camel_data_cache_get (ifolder->cache, "part", cache_key, NULL);
+	g_free (cache_key);
+
+	if (stream != NULL)
+		return stream;
+
+	return imapx_server_get_message (
+		is, folder, uid, section, encoding,
+		IMAPX_PRIORITY_GET_MESSAGE,
+		cancellable, error);
+}
+
+/* Fetches the BODYSTRUCTURE of a message along with its header, so
+ * its parts can be fetched one at a time with
+ * camel_imapx_server_get_message_part().  Both are kept for next
+ * time: the structure in the folder's database, see
+ * camel_db_read_bodystructure(), and the header in the data cache
+ * as the "HEADER" part.  Free the result with imapx_free_body(). */
+struct _CamelMessageContentInfo *
+camel_imapx_server_get_bodystructure (CamelIMAPXServer *is,
+                                      CamelFolder *folder,
+                                      const gchar *uid,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+	struct _CamelMessageContentInfo *cinfo = NULL;
+	CamelIMAPXJob *job;
+	BodystructureData *data;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), NULL);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (uid != NULL, NULL);
 
-	success = registered && camel_imapx_job_run (job, is, error);
+	data = g_slice_new0 (BodystructureData);
+	data->uid = g_strdup (uid);
 
-	if (success)
-		stream = g_object_ref (data->stream);
+	job = camel_imapx_job_new (cancellable);
+	job->pri = IMAPX_PRIORITY_GET_MESSAGE;
+	job->type = IMAPX_JOB_GET_BODYSTRUCTURE;
+	job->start = imapx_job_get_bodystructure_start;
+	job->matches = imapx_job_get_bodystructure_matches;
 
-	camel_imapx_job_unref (job);
+	camel_imapx_job_set_folder (job, folder);
 
-	g_mutex_lock (&is->fetch_mutex);
-	is->fetch_count++;
-	g_cond_broadcast (&is->fetch_cond);
-	g_mutex_unlock (&is->fetch_mutex);
+	camel_imapx_job_set_data (
+		job, data, (GDestroyNotify) bodystructure_data_free);
 
-	return stream;
-}
+	if (imapx_submit_job (is, job, error)) {
+		if (data->error != NULL) {
+			g_propagate_error (error, data->error);
+			data->error = NULL;
+		}
 
-CamelStream *
-camel_imapx_server_get_message (CamelIMAPXServer *is,
-                                CamelFolder *folder,
-                                const gchar *uid,
-                                GCancellable *cancellable,
-                                GError **error)
-{
-	CamelStream *stream;
+		cinfo = data->cinfo;
+		data->cinfo = NULL;
+	}
 
-	stream = imapx_server_get_message (
-		is, folder, uid,
-		IMAPX_PRIORITY_GET_MESSAGE,
-		cancellable, error);
+	camel_imapx_job_unref (job);
 
-	return stream;
+	return cinfo;
 }
 
 gboolean
@@ -7323,7 +9484,7 @@ camel_imapx_server_sync_message (CamelIMAPXServer *is,
 		return TRUE;
 
 	stream = imapx_server_get_message (
-		is, folder, uid,
+		is, folder, uid, NULL, NULL,
 		IMAPX_PRIORITY_SYNC_MESSAGE,
 		cancellable, error);
 
@@ -7369,30 +9530,23 @@ camel_imapx_server_copy_message (CamelIMAPXServer *is,
 	return imapx_submit_job (is, job, error);
 }
 
-gboolean
-camel_imapx_server_append_message (CamelIMAPXServer *is,
-                                   CamelFolder *folder,
-                                   CamelMimeMessage *message,
-                                   const CamelMessageInfo *mi,
-                                   gchar **appended_uid,
-                                   GCancellable *cancellable,
-                                   GError **error)
+/* Writes @message to the "new" cache of @folder, to be uploaded by an
+ * append job, and returns a summary entry for it with a temporary uid. */
+static CamelMessageInfo *
+imapx_server_spool_message (CamelIMAPXServer *is,
+                            CamelFolder *folder,
+                            CamelMimeMessage *message,
+                            const CamelMessageInfo *mi,
+                            gchar **out_path,
+                            GCancellable *cancellable,
+                            GError **error)
 {
-	gchar *uid = NULL, *path = NULL;
+	gchar *uid = NULL;
 	CamelStream *stream, *filter;
 	CamelIMAPXFolder *ifolder = (CamelIMAPXFolder *) folder;
 	CamelMimeFilter *canon;
-	CamelIMAPXJob *job;
 	CamelMessageInfo *info;
-	AppendMessageData *data;
 	gint res;
-	gboolean success;
-
-	/* Append just assumes we have no/a dodgy connection.  We dump
-	 * stuff into the 'new' directory, and let the summary know it's
-	 * there.  Then we fire off a no-reply job which will asynchronously
-	 * upload the message at some point in the future, and fix up the
-	 * summary to match */
 
 	/* chen cleanup this later */
 	uid = imapx_get_temp_uid ();
@@ -7400,7 +9554,7 @@ camel_imapx_server_append_message (CamelIMAPXServer *is,
 	if (stream == NULL) {
 		g_prefix_error (error, _("Cannot create spool file: "));
 		g_free (uid);
-		return FALSE;
+		return NULL;
 	}
 
 	filter = camel_stream_filter_new (stream);
@@ -7416,10 +9570,10 @@ camel_imapx_server_append_message (CamelIMAPXServer *is,
 		g_prefix_error (error, _("Cannot create spool file: "));
 		camel_data_cache_remove (ifolder->cache, "new", uid, NULL);
 		g_free (uid);
-		return FALSE;
+		return NULL;
 	}
 
-	path = camel_data_cache_get_filename (ifolder->cache, "new", uid);
+	*out_path = camel_data_cache_get_filename (ifolder->cache, "new", uid);
 	info = camel_folder_summary_info_new_from_message ((CamelFolderSummary *) folder->summary, message, NULL);
 	info->uid = camel_pstring_strdup (uid);
 	if (mi) {
@@ -7450,16 +9604,81 @@ camel_imapx_server_append_message (CamelIMAPXServer *is,
 
 	g_free (uid);
 
+	return info;
+}
+
+/* Uploads all of @messages to @folder, in as few APPEND commands as
+ * the server allows.  @infos may be NULL, or hold a CamelMessageInfo
+ * (or NULL) for each message to take the flags from.  If given,
+ * @appended_uids is set to an array of the uids the server assigned,
+ * with NULL where it did not tell us; free it with g_ptr_array_free()
+ * after freeing its elements with g_free(). */
+static gboolean
+imapx_server_append_messages (CamelIMAPXServer *is,
+                              CamelFolder *folder,
+                              GPtrArray *messages,
+                              GPtrArray *infos,
+                              GPtrArray **appended_uids,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	CamelIMAPXJob *job;
+	AppendMessageData *data;
+	gboolean success;
+	guint ii;
+
+	/* Append just assumes we have no/a dodgy connection.  We dump
+	 * stuff into the 'new' directory, and let the summary know it's
+	 * there.  Then we fire off a no-reply job which will asynchronously
+	 * upload the message at some point in the future, and fix up the
+	 * summary to match */
+
+	data = g_slice_new0 (AppendMessageData);
+	data->paths = g_ptr_array_new_with_free_func (g_free);
+	data->infos = g_ptr_array_new ();
+	data->appended_uids = g_ptr_array_new ();
+
+	for (ii = 0; ii < messages->len; ii++) {
+		CamelMessageInfo *info;
+		gchar *path = NULL;
+
+		info = imapx_server_spool_message (
+			is, folder, messages->pdata[ii],
+			infos ? infos->pdata[ii] : NULL,
+			&path, cancellable, error);
+
+		if (info == NULL) {
+			CamelIMAPXFolder *ifolder = CAMEL_IMAPX_FOLDER (folder);
+
+			while (data->infos->len > 0) {
+				info = data->infos->pdata[data->infos->len - 1];
+				camel_data_cache_remove (ifolder->cache, "new", info->uid, NULL);
+				camel_message_info_free (info);
+				g_ptr_array_remove_index (data->infos, data->infos->len - 1);
+			}
+
+			append_message_data_free (data);
+
+			return FALSE;
+		}
+
+		g_ptr_array_add (data->paths, path);  /* takes ownership */
+		g_ptr_array_add (data->infos, info);  /* takes ownership */
+		g_ptr_array_add (data->appended_uids, NULL);
+	}
+
+	if (data->infos->len == 0) {
+		if (appended_uids != NULL)
+			*appended_uids = g_ptr_array_new ();
+		append_message_data_free (data);
+		return TRUE;
+	}
+
 	/* So, we actually just want to let the server loop that
 	 * messages need appending, i think.  This is so the same
 	 * mechanism is used for normal uploading as well as
 	 * offline re-syncing when we go back online */
 
-	data = g_slice_new0 (AppendMessageData);
-	data->info = info;  /* takes ownership */
-	data->path = path;  /* takes ownership */
-	data->appended_uid = NULL;
-
 	job = camel_imapx_job_new (cancellable);
 	job->pri = IMAPX_PRIORITY_APPEND_MESSAGE;
 	job->type = IMAPX_JOB_APPEND_MESSAGE;
@@ -7473,9 +9692,9 @@ camel_imapx_server_append_message (CamelIMAPXServer *is,
 
 	success = imapx_submit_job (is, job, error);
 
-	if (appended_uid != NULL) {
-		*appended_uid = data->appended_uid;
-		data->appended_uid = NULL;
+	if (appended_uids != NULL) {
+		*appended_uids = data->appended_uids;
+		data->appended_uids = NULL;
 	}
 
 	camel_imapx_job_unref (job);
@@ -7483,6 +9702,41 @@ camel_imapx_server_append_message (CamelIMAPXServer *is,
 	return success;
 }
 
+gboolean
+camel_imapx_server_append_message (CamelIMAPXServer *is,
+                                   CamelFolder *folder,
+                                   CamelMimeMessage *message,
+                                   const CamelMessageInfo *mi,
+                                   gchar **appended_uid,
+                                   GCancellable *cancellable,
+                                   GError **error)
+{
+	GPtrArray *messages, *infos;
+	GPtrArray *appended_uids = NULL;
+	gboolean success;
+
+	messages = g_ptr_array_new ();
+	g_ptr_array_add (messages, message);
+
+	infos = g_ptr_array_new ();
+	g_ptr_array_add (infos, (gpointer) mi);
+
+	success = imapx_server_append_messages (
+		is, folder, messages, infos,
+		(appended_uid != NULL) ? &appended_uids : NULL,
+		cancellable, error);
+
+	if (appended_uids != NULL) {
+		*appended_uid = appended_uids->pdata[0];
+		g_ptr_array_free (appended_uids, TRUE);
+	}
+
+	g_ptr_array_free (messages, TRUE);
+	g_ptr_array_free (infos, TRUE);
+
+	return success;
+}
+
 gboolean
 camel_imapx_server_noop (CamelIMAPXServer *is,
                          CamelFolder *folder,
@@ -7552,6 +9806,15 @@ camel_imapx_server_refresh_info (CamelIMAPXServer *is,
 
 	success = registered && camel_imapx_job_run (job, is, error);
 
+	if (data->notify_tracked) {
+		CamelIMAPXStore *store;
+
+		store = camel_imapx_server_ref_store (is);
+		camel_imapx_conn_manager_end_notify_refresh (
+			store->con_man, full_name, success);
+		g_object_unref (store);
+	}
+
 	if (success && camel_folder_change_info_changed (data->changes))
 		camel_folder_changed (folder, data->changes);
 
@@ -8109,6 +10372,111 @@ camel_imapx_server_fetch_messages (CamelIMAPXServer *is,
 	return TRUE;
 }
 
+/* Fetches summary information for messages with UIDs from @first_uid
+ * to @last_uid, without adding them to the folder summary.  This is
+ * used to split the initial download of a large folder across several
+ * connections; the caller merges the returned CamelMessageInfo-s. */
+GPtrArray *
+camel_imapx_server_fetch_summary_range (CamelIMAPXServer *is,
+                                        CamelFolder *folder,
+                                        guint32 first_uid,
+                                        guint32 last_uid,
+                                        GCancellable *cancellable,
+                                        GError **error)
+{
+	CamelIMAPXJob *job;
+	RefreshInfoData *data;
+	GPtrArray *infos = NULL;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), NULL);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (first_uid > 0 && first_uid <= last_uid, NULL);
+
+	data = g_slice_new0 (RefreshInfoData);
+	data->changes = camel_folder_change_info_new ();
+	data->fetch_msg_limit = -1;
+	data->uidset.start = first_uid;
+	data->uidset.last = last_uid;
+	data->collected = g_ptr_array_new ();
+
+	job = camel_imapx_job_new (cancellable);
+	job->type = IMAPX_JOB_FETCH_NEW_MESSAGES;
+	job->start = imapx_job_fetch_summary_range_start;
+	job->matches = imapx_job_fetch_new_messages_matches;
+	job->pri = IMAPX_PRIORITY_NEW_MESSAGES;
+
+	camel_imapx_job_set_folder (job, folder);
+
+	camel_imapx_job_set_data (
+		job, data, (GDestroyNotify) refresh_info_data_free);
+
+	if (imapx_submit_job (is, job, error)) {
+		infos = data->collected;
+		data->collected = NULL;
+	}
+
+	camel_imapx_job_unref (job);
+
+	return infos;
+}
+
+/* Issues a STATUS for @folder, updating its counts and UIDNEXT
+ * without selecting it. */
+gboolean
+camel_imapx_server_status (CamelIMAPXServer *is,
+                           CamelFolder *folder,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	CamelIMAPXJob *job;
+	gboolean success;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), FALSE);
+
+	job = camel_imapx_job_new (cancellable);
+	job->type = IMAPX_JOB_STATUS;
+	job->start = imapx_job_status_start;
+	job->pri = IMAPX_PRIORITY_REFRESH_INFO;
+
+	camel_imapx_job_set_folder (job, folder);
+
+	success = imapx_submit_job (is, job, error);
+
+	camel_imapx_job_unref (job);
+
+	return success;
+}
+
+/* Copies the counts stashed for @folder from LIST-STATUS or NOTIFY
+ * into it, without using them up, so its next refresh on @is can
+ * still skip STATUS.  Returns whether there were any. */
+gboolean
+camel_imapx_server_peek_stashed_status (CamelIMAPXServer *is,
+                                        CamelFolder *folder)
+{
+	struct _state_info *stashed;
+	struct _state_info copy;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), FALSE);
+
+	g_mutex_lock (&is->priv->stashed_status_lock);
+	stashed = g_hash_table_lookup (
+		is->priv->stashed_status,
+		camel_folder_get_full_name (folder));
+	if (stashed != NULL)
+		copy = *stashed;
+	g_mutex_unlock (&is->priv->stashed_status_lock);
+
+	if (stashed == NULL)
+		return FALSE;
+
+	imapx_folder_apply_status (CAMEL_IMAPX_FOLDER (folder), &copy);
+
+	return TRUE;
+}
+
 gboolean
 camel_imapx_server_rename_folder (CamelIMAPXServer *is,
                                   const gchar *old_name,
@@ -8177,23 +10545,24 @@ camel_imapx_server_update_quota_info (CamelIMAPXServer *is,
 	return success;
 }
 
-GPtrArray *
-camel_imapx_server_uid_search (CamelIMAPXServer *is,
-                               CamelFolder *folder,
-                               const gchar *criteria,
-                               GCancellable *cancellable,
-                               GError **error)
+/* Runs a UID SEARCH and returns the numeric UIDs found.
+ * With @count_only the array is empty and only @out_count is set. */
+static GArray *
+imapx_server_uid_search (CamelIMAPXServer *is,
+                         CamelFolder *folder,
+                         const gchar *criteria,
+                         gboolean count_only,
+                         gint64 *out_count,
+                         GCancellable *cancellable,
+                         GError **error)
 {
 	CamelIMAPXJob *job;
 	SearchData *data;
-	GPtrArray *results = NULL;
-
-	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), NULL);
-	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
-	g_return_val_if_fail (criteria != NULL, NULL);
+	GArray *results = NULL;
 
 	data = g_slice_new0 (SearchData);
 	data->criteria = g_strdup (criteria);
+	data->count_only = count_only;
 
 	job = camel_imapx_job_new (cancellable);
 	job->type = IMAPX_JOB_UID_SEARCH;
@@ -8206,28 +10575,11 @@ camel_imapx_server_uid_search (CamelIMAPXServer *is,
 		job, data, (GDestroyNotify) search_data_free);
 
 	if (imapx_submit_job (is, job, error)) {
-		guint ii;
-
-		/* Convert the numeric UIDs to strings. */
-
 		g_return_val_if_fail (data->results != NULL, NULL);
 
-		results = g_ptr_array_new_full (
-			data->results->len,
-			(GDestroyNotify) camel_pstring_free);
-
-		for (ii = 0; ii < data->results->len; ii++) {
-			const gchar *pooled_uid;
-			guint64 numeric_uid;
-			gchar *alloced_uid;
-
-			numeric_uid = g_array_index (
-				data->results, guint64, ii);
-			alloced_uid = g_strdup_printf (
-				"%" G_GUINT64_FORMAT, numeric_uid);
-			pooled_uid = camel_pstring_add (alloced_uid, TRUE);
-			g_ptr_array_add (results, (gpointer) pooled_uid);
-		}
+		results = g_array_ref (data->results);
+		if (out_count != NULL)
+			*out_count = data->count;
 	}
 
 	camel_imapx_job_unref (job);
@@ -8235,6 +10587,101 @@ camel_imapx_server_uid_search (CamelIMAPXServer *is,
 	return results;
 }
 
+/* Converts numeric UIDs to pooled strings, keeping their order. */
+static GPtrArray *
+imapx_search_results_to_uids (GArray *numeric_uids)
+{
+	GPtrArray *results;
+	guint ii;
+
+	results = g_ptr_array_new_full (
+		numeric_uids->len,
+		(GDestroyNotify) camel_pstring_free);
+
+	for (ii = 0; ii < numeric_uids->len; ii++) {
+		const gchar *pooled_uid;
+		guint64 numeric_uid;
+		gchar *alloced_uid;
+
+		numeric_uid = g_array_index (
+			numeric_uids, guint64, ii);
+		alloced_uid = g_strdup_printf (
+			"%" G_GUINT64_FORMAT, numeric_uid);
+		pooled_uid = camel_pstring_add (alloced_uid, TRUE);
+		g_ptr_array_add (results, (gpointer) pooled_uid);
+	}
+
+	return results;
+}
+
+GPtrArray *
+camel_imapx_server_uid_search (CamelIMAPXServer *is,
+                               CamelFolder *folder,
+                               const gchar *criteria,
+                               GCancellable *cancellable,
+                               GError **error)
+{
+	GArray *numeric_uids;
+	GPtrArray *results;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), NULL);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (criteria != NULL, NULL);
+
+	numeric_uids = imapx_server_uid_search (
+		is, folder, criteria, FALSE, NULL,
+		cancellable, error);
+	if (numeric_uids == NULL)
+		return NULL;
+
+	results = imapx_search_results_to_uids (numeric_uids);
+
+	g_array_unref (numeric_uids);
+
+	return results;
+}
+
+/* Counts the messages matching @criteria.  With ESEARCH (RFC 4731)
+ * only the number is sent back instead of the whole list of UIDs. */
+gboolean
+camel_imapx_server_uid_search_count (CamelIMAPXServer *is,
+                                     CamelFolder *folder,
+                                     const gchar *criteria,
+                                     guint *out_count,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	GArray *numeric_uids;
+	gint64 count = 0;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), FALSE);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), FALSE);
+	g_return_val_if_fail (criteria != NULL, FALSE);
+	g_return_val_if_fail (out_count != NULL, FALSE);
+
+	numeric_uids = imapx_server_uid_search (
+		is, folder, criteria, TRUE, &count,
+		cancellable, error);
+	if (numeric_uids == NULL)
+		return FALSE;
+
+	*out_count = (guint) MAX (count, 0);
+
+	g_array_unref (numeric_uids);
+
+	return TRUE;
+}
+
+/* Returns a snapshot of the connection's counters,
+ * free it with camel_imapx_stats_free(). */
+IMAPXServerStats *
+camel_imapx_server_dup_stats (CamelIMAPXServer *is)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SERVER (is), NULL);
+
+	return camel_imapx_stats_copy (is->priv->stats);
+}
+
 IMAPXJobQueueInfo *
 camel_imapx_server_get_job_queue_info (CamelIMAPXServer *is)
 {
@@ -8253,12 +10700,17 @@ camel_imapx_server_get_job_queue_info (CamelIMAPXServer *is)
 
 	head = g_queue_peek_head_link (&is->jobs);
 
+	memcpy (jinfo->latency, is->priv->latency, sizeof (jinfo->latency));
+
 	for (link = head; link != NULL; link = g_list_next (link)) {
 		CamelFolder *folder;
 
 		job = (CamelIMAPXJob *) link->data;
 		folder = camel_imapx_job_ref_folder (job);
 
+		if (job->type != IMAPX_JOB_IDLE)
+			jinfo->latency[imapx_job_kind (job)].pending++;
+
 		if (folder != NULL) {
 			gchar *folder_name;
 
@@ -159,6 +159,9 @@ struct _CamelIMAPXServer {
 
 	gboolean use_qresync;
 
+	/* NOTIFY (RFC 5465) is reporting other folders' changes */
+	gboolean use_notify;
+
 	/* used to synchronize duplicate get_message requests */
 	GCond fetch_cond;
 	GMutex fetch_mutex;
@@ -221,6 +224,20 @@ gboolean	camel_imapx_server_fetch_messages
 						 gint limit,
 						 GCancellable *cancellable,
 						 GError **error);
+GPtrArray *	camel_imapx_server_fetch_summary_range
+						(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 guint32 first_uid,
+						 guint32 last_uid,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	camel_imapx_server_status	(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	camel_imapx_server_peek_stashed_status
+						(CamelIMAPXServer *is,
+						 CamelFolder *folder);
 gboolean	camel_imapx_server_noop		(CamelIMAPXServer *is,
 						 CamelFolder *folder,
 						 GCancellable *cancellable,
@@ -230,6 +247,24 @@ CamelStream *	camel_imapx_server_get_message	(CamelIMAPXServer *is,
 						 const gchar *uid,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	camel_imapx_server_is_fetching	(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 const gchar *cache_key);
+struct _CamelMessageContentInfo *
+		camel_imapx_server_get_bodystructure
+						(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 const gchar *uid,
+						 GCancellable *cancellable,
+						 GError **error);
+CamelStream *	camel_imapx_server_get_message_part
+						(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 const gchar *uid,
+						 const gchar *section,
+						 const gchar *encoding,
+						 GCancellable *cancellable,
+						 GError **error);
 gboolean	camel_imapx_server_copy_message	(CamelIMAPXServer *is,
 						 CamelFolder *source,
 						 CamelFolder *dest,
@@ -282,9 +317,18 @@ GPtrArray *	camel_imapx_server_uid_search	(CamelIMAPXServer *is,
 						 const gchar *criteria,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	camel_imapx_server_uid_search_count
+						(CamelIMAPXServer *is,
+						 CamelFolder *folder,
+						 const gchar *criteria,
+						 guint *out_count,
+						 GCancellable *cancellable,
+						 GError **error);
 struct _IMAPXJobQueueInfo *
 		camel_imapx_server_get_job_queue_info
 						(CamelIMAPXServer *is);
+struct _IMAPXServerStats *
+		camel_imapx_server_dup_stats	(CamelIMAPXServer *is);
 const CamelIMAPXUntaggedRespHandlerDesc *
 		camel_imapx_server_register_untagged_handler
 						(CamelIMAPXServer *is,
@@ -31,12 +31,16 @@ struct _CamelIMAPXSettingsPrivate {
 	gchar *real_junk_path;
 	gchar *real_trash_path;
 	gchar *shell_command;
+	gchar **fetch_headers_extra;
 
 	guint batch_fetch_count;
 	guint concurrent_connections;
+	guint prefetch_bandwidth;
+	guint prefetch_size_limit;
 
 	gboolean check_all;
 	gboolean check_subscribed;
+	gboolean fetch_text_first;
 	gboolean filter_all;
 	gboolean filter_junk;
 	gboolean filter_junk_inbox;
@@ -59,7 +63,9 @@ enum {
 	PROP_CHECK_ALL,
 	PROP_CHECK_SUBSCRIBED,
 	PROP_CONCURRENT_CONNECTIONS,
+	PROP_FETCH_HEADERS_EXTRA,
 	PROP_FETCH_ORDER,
+	PROP_FETCH_TEXT_FIRST,
 	PROP_FILTER_ALL,
 	PROP_FILTER_JUNK,
 	PROP_FILTER_JUNK_INBOX,
@@ -67,6 +73,8 @@ enum {
 	PROP_MOBILE_MODE,
 	PROP_NAMESPACE,
 	PROP_PORT,
+	PROP_PREFETCH_BANDWIDTH,
+	PROP_PREFETCH_SIZE_LIMIT,
 	PROP_REAL_JUNK_PATH,
 	PROP_REAL_TRASH_PATH,
 	PROP_SECURITY_METHOD,
@@ -125,12 +133,24 @@ imapx_settings_set_property (GObject *object,
 				g_value_get_uint (value));
 			return;
 
+		case PROP_FETCH_HEADERS_EXTRA:
+			camel_imapx_settings_set_fetch_headers_extra (
+				CAMEL_IMAPX_SETTINGS (object),
+				g_value_get_boxed (value));
+			return;
+
 		case PROP_FETCH_ORDER:
 			camel_imapx_settings_set_fetch_order (
 				CAMEL_IMAPX_SETTINGS (object),
 				g_value_get_enum (value));
 			return;
 
+		case PROP_FETCH_TEXT_FIRST:
+			camel_imapx_settings_set_fetch_text_first (
+				CAMEL_IMAPX_SETTINGS (object),
+				g_value_get_boolean (value));
+			return;
+
 		case PROP_FILTER_ALL:
 			camel_imapx_settings_set_filter_all (
 				CAMEL_IMAPX_SETTINGS (object),
@@ -173,6 +193,18 @@ imapx_settings_set_property (GObject *object,
 				g_value_get_uint (value));
 			return;
 
+		case PROP_PREFETCH_BANDWIDTH:
+			camel_imapx_settings_set_prefetch_bandwidth (
+				CAMEL_IMAPX_SETTINGS (object),
+				g_value_get_uint (value));
+			return;
+
+		case PROP_PREFETCH_SIZE_LIMIT:
+			camel_imapx_settings_set_prefetch_size_limit (
+				CAMEL_IMAPX_SETTINGS (object),
+				g_value_get_uint (value));
+			return;
+
 		case PROP_REAL_JUNK_PATH:
 			camel_imapx_settings_set_real_junk_path (
 				CAMEL_IMAPX_SETTINGS (object),
@@ -291,6 +323,13 @@ imapx_settings_get_property (GObject *object,
 				CAMEL_IMAPX_SETTINGS (object)));
 			return;
 
+		case PROP_FETCH_HEADERS_EXTRA:
+			g_value_take_boxed (
+				value,
+				camel_imapx_settings_dup_fetch_headers_extra (
+				CAMEL_IMAPX_SETTINGS (object)));
+			return;
+
 		case PROP_FETCH_ORDER:
 			g_value_set_enum (
 				value,
@@ -298,6 +337,13 @@ imapx_settings_get_property (GObject *object,
 				CAMEL_IMAPX_SETTINGS (object)));
 			return;
 
+		case PROP_FETCH_TEXT_FIRST:
+			g_value_set_boolean (
+				value,
+				camel_imapx_settings_get_fetch_text_first (
+				CAMEL_IMAPX_SETTINGS (object)));
+			return;
+
 		case PROP_FILTER_ALL:
 			g_value_set_boolean (
 				value,
@@ -347,6 +393,20 @@ imapx_settings_get_property (GObject *object,
 				CAMEL_NETWORK_SETTINGS (object)));
 			return;
 
+		case PROP_PREFETCH_BANDWIDTH:
+			g_value_set_uint (
+				value,
+				camel_imapx_settings_get_prefetch_bandwidth (
+				CAMEL_IMAPX_SETTINGS (object)));
+			return;
+
+		case PROP_PREFETCH_SIZE_LIMIT:
+			g_value_set_uint (
+				value,
+				camel_imapx_settings_get_prefetch_size_limit (
+				CAMEL_IMAPX_SETTINGS (object)));
+			return;
+
 		case PROP_REAL_JUNK_PATH:
 			g_value_take_string (
 				value,
@@ -446,6 +506,7 @@ imapx_settings_finalize (GObject *object)
 
 	g_free (priv->namespace);
 	g_free (priv->shell_command);
+	g_strfreev (priv->fetch_headers_extra);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_imapx_settings_parent_class)->finalize (object);
@@ -521,6 +582,18 @@ camel_imapx_settings_class_init (CamelIMAPXSettingsClass *class)
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property (
+		object_class,
+		PROP_FETCH_HEADERS_EXTRA,
+		g_param_spec_boxed (
+			"fetch-headers-extra",
+			"Fetch Headers Extra",
+			"Additional header fields to fetch for the summary",
+			G_TYPE_STRV,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS));
+
 	g_object_class_install_property (
 		object_class,
 		PROP_FETCH_ORDER,
@@ -534,6 +607,19 @@ camel_imapx_settings_class_init (CamelIMAPXSettingsClass *class)
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property (
+		object_class,
+		PROP_FETCH_TEXT_FIRST,
+		g_param_spec_boolean (
+			"fetch-text-first",
+			"Fetch Text First",
+			"Whether to download only the text parts of "
+			"large messages, and attachments when needed",
+			FALSE,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS));
+
 	g_object_class_install_property (
 		object_class,
 		PROP_FILTER_ALL,
@@ -606,6 +692,36 @@ camel_imapx_settings_class_init (CamelIMAPXSettingsClass *class)
 		PROP_PORT,
 		"port");
 
+	g_object_class_install_property (
+		object_class,
+		PROP_PREFETCH_BANDWIDTH,
+		g_param_spec_uint (
+			"prefetch-bandwidth",
+			"Prefetch Bandwidth",
+			"Kilobytes per second to spend on downloading "
+			"messages for offline use, 0 for no limit",
+			0,
+			G_MAXUINT,
+			0,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property (
+		object_class,
+		PROP_PREFETCH_SIZE_LIMIT,
+		g_param_spec_uint (
+			"prefetch-size-limit",
+			"Prefetch Size Limit",
+			"Megabytes of messages to keep for offline use "
+			"in each folder, 0 for no limit",
+			0,
+			G_MAXUINT,
+			0,
+			G_PARAM_READWRITE |
+			G_PARAM_CONSTRUCT |
+			G_PARAM_STATIC_STRINGS));
+
 	g_object_class_install_property (
 		object_class,
 		PROP_REAL_JUNK_PATH,
@@ -930,6 +1046,87 @@ camel_imapx_settings_set_concurrent_connections (CamelIMAPXSettings *settings,
 	g_object_notify (G_OBJECT (settings), "concurrent-connections");
 }
 
+/**
+ * camel_imapx_settings_get_fetch_headers_extra:
+ * @settings: a #CamelIMAPXSettings
+ *
+ * Returns the names of header fields to fetch for new messages in
+ * addition to those the folder summary itself needs, or %NULL if
+ * no additional fields have been configured.
+ *
+ * Returns: a %NULL-terminated array of header names, or %NULL
+ *
+ * Since: 3.8
+ **/
+const gchar * const *
+camel_imapx_settings_get_fetch_headers_extra (CamelIMAPXSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings), NULL);
+
+	return (const gchar * const *) settings->priv->fetch_headers_extra;
+}
+
+/**
+ * camel_imapx_settings_dup_fetch_headers_extra:
+ * @settings: a #CamelIMAPXSettings
+ *
+ * Thread-safe variation of camel_imapx_settings_get_fetch_headers_extra().
+ * Use this function when accessing @settings from multiple threads.
+ *
+ * The returned array should be freed with g_strfreev() when no longer
+ * needed.
+ *
+ * Returns: a newly-allocated copy of #CamelIMAPXSettings:fetch-headers-extra
+ *
+ * Since: 3.8
+ **/
+gchar **
+camel_imapx_settings_dup_fetch_headers_extra (CamelIMAPXSettings *settings)
+{
+	gchar **duplicate;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings), NULL);
+
+	g_mutex_lock (&settings->priv->property_lock);
+
+	duplicate = g_strdupv (settings->priv->fetch_headers_extra);
+
+	g_mutex_unlock (&settings->priv->property_lock);
+
+	return duplicate;
+}
+
+/**
+ * camel_imapx_settings_set_fetch_headers_extra:
+ * @settings: a #CamelIMAPXSettings
+ * @fetch_headers_extra: a %NULL-terminated array of header names, or %NULL
+ *
+ * Sets the names of header fields to fetch for new messages in addition
+ * to those the folder summary itself needs.  This is useful when filter
+ * rules or search folders test headers which are otherwise not downloaded.
+ *
+ * Since: 3.8
+ **/
+void
+camel_imapx_settings_set_fetch_headers_extra (CamelIMAPXSettings *settings,
+                                              const gchar * const *fetch_headers_extra)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings));
+
+	if (fetch_headers_extra != NULL && *fetch_headers_extra == NULL)
+		fetch_headers_extra = NULL;
+
+	g_mutex_lock (&settings->priv->property_lock);
+
+	g_strfreev (settings->priv->fetch_headers_extra);
+	settings->priv->fetch_headers_extra =
+		g_strdupv ((gchar **) fetch_headers_extra);
+
+	g_mutex_unlock (&settings->priv->property_lock);
+
+	g_object_notify (G_OBJECT (settings), "fetch-headers-extra");
+}
+
 /**
  * camel_imapx_settings_get_fetch_order:
  * @settings: a #CamelIMAPXSettings
@@ -973,6 +1170,51 @@ camel_imapx_settings_set_fetch_order (CamelIMAPXSettings *settings,
 	g_object_notify (G_OBJECT (settings), "fetch-order");
 }
 
+/**
+ * camel_imapx_settings_get_fetch_text_first:
+ * @settings: a #CamelIMAPXSettings
+ *
+ * Returns whether opening a large message downloads only its text
+ * parts, using the message's BODYSTRUCTURE, and leaves attachments
+ * to be downloaded when they are first needed.
+ *
+ * Returns: whether to download the text parts of messages first
+ *
+ * Since: 3.8
+ **/
+gboolean
+camel_imapx_settings_get_fetch_text_first (CamelIMAPXSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings), FALSE);
+
+	return settings->priv->fetch_text_first;
+}
+
+/**
+ * camel_imapx_settings_set_fetch_text_first:
+ * @settings: a #CamelIMAPXSettings
+ * @fetch_text_first: whether to download the text parts of messages first
+ *
+ * Sets whether opening a large message downloads only its text
+ * parts, using the message's BODYSTRUCTURE, and leaves attachments
+ * to be downloaded when they are first needed.
+ *
+ * Since: 3.8
+ **/
+void
+camel_imapx_settings_set_fetch_text_first (CamelIMAPXSettings *settings,
+                                           gboolean fetch_text_first)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings));
+
+	if (settings->priv->fetch_text_first == fetch_text_first)
+		return;
+
+	settings->priv->fetch_text_first = fetch_text_first;
+
+	g_object_notify (G_OBJECT (settings), "fetch-text-first");
+}
+
 /**
  * camel_imapx_settings_get_filter_all:
  * @settings: a #CamelIMAPXSettings
@@ -1225,6 +1467,96 @@ camel_imapx_settings_set_namespace (CamelIMAPXSettings *settings,
 	g_object_notify (G_OBJECT (settings), "namespace");
 }
 
+/**
+ * camel_imapx_settings_get_prefetch_bandwidth:
+ * @settings: a #CamelIMAPXSettings
+ *
+ * Returns the rate, in kilobytes per second, at which messages are
+ * downloaded for offline use, or 0 if the rate is not limited.
+ *
+ * Returns: the prefetch rate limit in kilobytes per second
+ *
+ * Since: 3.8
+ **/
+guint
+camel_imapx_settings_get_prefetch_bandwidth (CamelIMAPXSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings), 0);
+
+	return settings->priv->prefetch_bandwidth;
+}
+
+/**
+ * camel_imapx_settings_set_prefetch_bandwidth:
+ * @settings: a #CamelIMAPXSettings
+ * @prefetch_bandwidth: the rate limit in kilobytes per second, or 0
+ *
+ * Limits the rate at which messages are downloaded for offline use,
+ * so synchronizing a large mailbox does not take up the whole link.
+ * Messages the user opens are not affected.  A value of 0 removes
+ * the limit.
+ *
+ * Since: 3.8
+ **/
+void
+camel_imapx_settings_set_prefetch_bandwidth (CamelIMAPXSettings *settings,
+                                             guint prefetch_bandwidth)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings));
+
+	if (settings->priv->prefetch_bandwidth == prefetch_bandwidth)
+		return;
+
+	settings->priv->prefetch_bandwidth = prefetch_bandwidth;
+
+	g_object_notify (G_OBJECT (settings), "prefetch-bandwidth");
+}
+
+/**
+ * camel_imapx_settings_get_prefetch_size_limit:
+ * @settings: a #CamelIMAPXSettings
+ *
+ * Returns how many megabytes of messages in each folder are kept for
+ * offline use, or 0 if there is no limit.
+ *
+ * Returns: the offline size limit in megabytes
+ *
+ * Since: 3.8
+ **/
+guint
+camel_imapx_settings_get_prefetch_size_limit (CamelIMAPXSettings *settings)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings), 0);
+
+	return settings->priv->prefetch_size_limit;
+}
+
+/**
+ * camel_imapx_settings_set_prefetch_size_limit:
+ * @settings: a #CamelIMAPXSettings
+ * @prefetch_size_limit: the limit in megabytes, or 0
+ *
+ * Sets how many megabytes of messages in each folder are kept for
+ * offline use.  Messages are downloaded newest first, so once the
+ * limit is reached the older ones are left on the server.  A value
+ * of 0 removes the limit.
+ *
+ * Since: 3.8
+ **/
+void
+camel_imapx_settings_set_prefetch_size_limit (CamelIMAPXSettings *settings,
+                                              guint prefetch_size_limit)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_SETTINGS (settings));
+
+	if (settings->priv->prefetch_size_limit == prefetch_size_limit)
+		return;
+
+	settings->priv->prefetch_size_limit = prefetch_size_limit;
+
+	g_object_notify (G_OBJECT (settings), "prefetch-size-limit");
+}
+
 /**
  * camel_imapx_settings_get_real_junk_path:
  * @settings: a #CamelIMAPXSettings
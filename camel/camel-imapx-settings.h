@@ -80,11 +80,24 @@ guint		camel_imapx_settings_get_concurrent_connections
 void		camel_imapx_settings_set_concurrent_connections
 						(CamelIMAPXSettings *settings,
 						 guint concurrent_connections);
+const gchar * const *
+		camel_imapx_settings_get_fetch_headers_extra
+						(CamelIMAPXSettings *settings);
+gchar **	camel_imapx_settings_dup_fetch_headers_extra
+						(CamelIMAPXSettings *settings);
+void		camel_imapx_settings_set_fetch_headers_extra
+						(CamelIMAPXSettings *settings,
+						 const gchar * const *fetch_headers_extra);
 CamelSortType	camel_imapx_settings_get_fetch_order
 						(CamelIMAPXSettings *settings);
 void		camel_imapx_settings_set_fetch_order
 						(CamelIMAPXSettings *settings,
 						 CamelSortType fetch_order);
+gboolean	camel_imapx_settings_get_fetch_text_first
+						(CamelIMAPXSettings *settings);
+void		camel_imapx_settings_set_fetch_text_first
+						(CamelIMAPXSettings *settings,
+						 gboolean fetch_text_first);
 gboolean	camel_imapx_settings_get_filter_all
 						(CamelIMAPXSettings *settings);
 void		camel_imapx_settings_set_filter_all
@@ -112,6 +125,16 @@ gchar *		camel_imapx_settings_dup_namespace
 void		camel_imapx_settings_set_namespace
 						(CamelIMAPXSettings *settings,
 						 const gchar *namespace_);
+guint		camel_imapx_settings_get_prefetch_bandwidth
+						(CamelIMAPXSettings *settings);
+void		camel_imapx_settings_set_prefetch_bandwidth
+						(CamelIMAPXSettings *settings,
+						 guint prefetch_bandwidth);
+guint		camel_imapx_settings_get_prefetch_size_limit
+						(CamelIMAPXSettings *settings);
+void		camel_imapx_settings_set_prefetch_size_limit
+						(CamelIMAPXSettings *settings,
+						 guint prefetch_size_limit);
 const gchar *	camel_imapx_settings_get_real_junk_path
 						(CamelIMAPXSettings *settings);
 gchar *		camel_imapx_settings_dup_real_junk_path
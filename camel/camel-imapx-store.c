@@ -39,6 +39,11 @@
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 
+#ifdef G_OS_UNIX
+#include <signal.h>
+#include <glib-unix.h>
+#endif
+
 #include "camel-imapx-folder.h"
 #include "camel-imapx-server.h"
 #include "camel-imapx-settings.h"
@@ -59,6 +64,9 @@
 struct _CamelIMAPXStorePrivate {
 	GHashTable *quota_info;
 	GMutex quota_info_lock;
+
+	/* SIGUSR2 source dumping the imapx:stats counters */
+	guint stats_signal_id;
 };
 
 static GInitableIface *parent_initable_interface;
@@ -141,6 +149,11 @@ imapx_store_dispose (GObject *object)
 {
 	CamelIMAPXStore *imapx_store = CAMEL_IMAPX_STORE (object);
 
+	if (imapx_store->priv->stats_signal_id > 0) {
+		g_source_remove (imapx_store->priv->stats_signal_id);
+		imapx_store->priv->stats_signal_id = 0;
+	}
+
 	/* Force disconnect so we dont have it run later,
 	 * after we've cleaned up some stuff. */
 	if (imapx_store->con_man != NULL) {
@@ -178,6 +191,33 @@ imapx_store_finalize (GObject *object)
 	G_OBJECT_CLASS (camel_imapx_store_parent_class)->finalize (object);
 }
 
+static void
+imapx_store_dump_stats (CamelIMAPXStore *istore)
+{
+	IMAPXServerStats *stats;
+	gchar *text;
+
+	stats = camel_imapx_store_dup_stats (istore);
+	text = camel_imapx_stats_to_string (stats);
+	camel_imapx_stats_free (stats);
+
+	printf (
+		"IMAPX statistics for '%s':\n%s",
+		camel_service_get_display_name (CAMEL_SERVICE (istore)), text);
+
+	g_free (text);
+}
+
+#if defined (G_OS_UNIX) && GLIB_CHECK_VERSION (2, 36, 0)
+static gboolean
+imapx_store_stats_signal_cb (gpointer user_data)
+{
+	imapx_store_dump_stats (CAMEL_IMAPX_STORE (user_data));
+
+	return TRUE;
+}
+#endif
+
 static gchar *
 imapx_get_name (CamelService *service,
                 gboolean brief)
@@ -219,6 +259,18 @@ camel_imapx_store_get_server (CamelIMAPXStore *istore,
 		istore->con_man, folder_name, cancellable, error);
 }
 
+/* For operations a user is waiting on; see
+ * camel_imapx_conn_manager_get_interactive_connection(). */
+CamelIMAPXServer *
+camel_imapx_store_get_interactive_server (CamelIMAPXStore *istore,
+                                          const gchar *folder_name,
+                                          GCancellable *cancellable,
+                                          GError **error)
+{
+	return camel_imapx_conn_manager_get_interactive_connection (
+		istore->con_man, folder_name, cancellable, error);
+}
+
 void
 camel_imapx_store_op_done (CamelIMAPXStore *istore,
                            CamelIMAPXServer *server,
@@ -260,9 +312,13 @@ imapx_disconnect_sync (CamelService *service,
 	if (!service_class->disconnect_sync (service, clean, cancellable, error))
 		return FALSE;
 
-	if (istore->con_man != NULL)
+	if (istore->con_man != NULL) {
 		camel_imapx_conn_manager_close_connections (istore->con_man);
 
+		if (camel_debug_flag (stats))
+			imapx_store_dump_stats (istore);
+	}
+
 	return TRUE;
 }
 
@@ -1032,8 +1088,17 @@ fetch_folders_for_namespaces (CamelIMAPXStore *istore,
 			if (sync)
 				flags |= CAMEL_STORE_FOLDER_INFO_SUBSCRIPTION_LIST;
 
-			if (server->cinfo && (server->cinfo->capa & IMAPX_CAPABILITY_LIST_EXTENDED) != 0)
-				list_ext = "RETURN (SUBSCRIBED)";
+			/* With LIST-STATUS (RFC 5819) the counts for every
+			 * folder come back with the list, instead of each
+			 * folder needing a STATUS of its own later on. */
+			if (server->cinfo && (server->cinfo->capa & IMAPX_CAPABILITY_LIST_EXTENDED) != 0) {
+				if ((server->cinfo->capa & IMAPX_CAPABILITY_LIST_STATUS) == 0)
+					list_ext = "RETURN (SUBSCRIBED)";
+				else if ((server->cinfo->capa & IMAPX_CAPABILITY_CONDSTORE) != 0)
+					list_ext = "RETURN (SUBSCRIBED STATUS (MESSAGES UNSEEN UIDVALIDITY UIDNEXT HIGHESTMODSEQ))";
+				else
+					list_ext = "RETURN (SUBSCRIBED STATUS (MESSAGES UNSEEN UIDVALIDITY UIDNEXT))";
+			}
 
 			flags |= CAMEL_STORE_FOLDER_INFO_RECURSIVE;
 			if (!fetch_folders_for_pattern (
@@ -1952,6 +2017,13 @@ camel_imapx_store_init (CamelIMAPXStore *store)
 
 	imapx_utils_init ();
 
+#if defined (G_OS_UNIX) && GLIB_CHECK_VERSION (2, 36, 0)
+	/* Dumps on demand, from the default main context. */
+	if (camel_debug_flag (stats))
+		store->priv->stats_signal_id = g_unix_signal_add (
+			SIGUSR2, imapx_store_stats_signal_cb, store);
+#endif
+
 	g_signal_connect (
 		store, "notify::settings",
 		G_CALLBACK (imapx_store_update_store_flags), NULL);
@@ -1998,3 +2070,12 @@ camel_imapx_store_set_quota_info (CamelIMAPXStore *store,
 	g_mutex_unlock (&store->priv->quota_info_lock);
 }
 
+/* Counters of every connection this store has made, see
+ * the imapx:stats debug flag.  Free with camel_imapx_stats_free(). */
+IMAPXServerStats *
+camel_imapx_store_dup_stats (CamelIMAPXStore *store)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_STORE (store), NULL);
+
+	return camel_imapx_conn_manager_dup_stats (store->con_man);
+}
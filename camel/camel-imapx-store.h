@@ -95,6 +95,12 @@ CamelIMAPXServer *
 						 const gchar *folder_name,
 						 GCancellable *cancellable,
 						 GError **error);
+CamelIMAPXServer *
+		camel_imapx_store_get_interactive_server
+						(CamelIMAPXStore *store,
+						 const gchar *folder_name,
+						 GCancellable *cancellable,
+						 GError **error);
 void		camel_imapx_store_op_done	(CamelIMAPXStore *istore,
 						 CamelIMAPXServer *server,
 						 const gchar *folder_name);
@@ -106,6 +112,8 @@ void		camel_imapx_store_set_quota_info
 						(CamelIMAPXStore *store,
 						 const gchar *quota_root_name,
 						 const CamelFolderQuotaInfo *info);
+struct _IMAPXServerStats *
+		camel_imapx_store_dup_stats	(CamelIMAPXStore *store);
 
 G_END_DECLS
 
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <errno.h>
+#include <zlib.h>
 
 #include <glib/gi18n-lib.h>
 
@@ -43,6 +44,12 @@
 #define t(...) camel_imapx_debug(token, __VA_ARGS__)
 #define io(...) camel_imapx_debug(io, __VA_ARGS__)
 
+/* size of the compressed data buffers once COMPRESS=DEFLATE is active */
+#define IMAPX_ZBUF_SIZE (16384)
+
+/* literals at least this big are read in chunks of this size */
+#define IMAPX_LITERAL_CHUNK (65536)
+
 struct _CamelIMAPXStreamPrivate {
 	CamelStream *source;
 
@@ -56,6 +63,16 @@ struct _CamelIMAPXStreamPrivate {
 
 	guchar *tokenbuf;
 	guint bufsize;
+
+	/* RFC 4978 COMPRESS=DEFLATE, NULL until negotiated */
+	z_stream *inflate;
+	z_stream *deflate;
+	guchar *zinbuf, *zoutbuf;
+	guint zinsize;
+	gboolean inflate_pending;
+
+	/* owned by the server, may be NULL */
+	IMAPXServerStats *stats;
 };
 
 enum {
@@ -65,6 +82,100 @@ enum {
 
 G_DEFINE_TYPE (CamelIMAPXStream, camel_imapx_stream, CAMEL_TYPE_STREAM)
 
+/* Reads from the source stream, counting what came over the wire */
+static gssize
+imapx_stream_read_raw (CamelIMAPXStream *is,
+                       gchar *buffer,
+                       gsize n,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	gint64 start = 0;
+	gssize nread;
+
+	if (is->priv->stats != NULL)
+		start = g_get_monotonic_time ();
+
+	nread = camel_stream_read (
+		is->priv->source, buffer, n, cancellable, error);
+
+	if (is->priv->stats != NULL)
+		camel_imapx_stats_add_io (
+			is->priv->stats, MAX (nread, 0), 0,
+			g_get_monotonic_time () - start);
+
+	return nread;
+}
+
+/* Same for writing */
+static gssize
+imapx_stream_write_raw (CamelIMAPXStream *is,
+                        const gchar *buffer,
+                        gsize n,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	gssize nwritten;
+
+	nwritten = camel_stream_write (
+		is->priv->source, buffer, n, cancellable, error);
+
+	if (is->priv->stats != NULL && nwritten > 0)
+		camel_imapx_stats_add_io (is->priv->stats, 0, nwritten, 0);
+
+	return nwritten;
+}
+
+/* Reads from the source stream, inflating when compression is active */
+static gssize
+imapx_stream_read_source (CamelIMAPXStream *is,
+                          gchar *buffer,
+                          gsize n,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+	z_stream *zs = is->priv->inflate;
+	gint retval;
+
+	if (zs == NULL)
+		return imapx_stream_read_raw (
+			is, buffer, n, cancellable, error);
+
+	zs->next_out = (Bytef *) buffer;
+	zs->avail_out = n;
+
+	/* loop until at least one byte comes out of the inflater */
+	do {
+		if (zs->avail_in == 0 && !is->priv->inflate_pending) {
+			gssize nread;
+
+			nread = imapx_stream_read_raw (
+				is, (gchar *) is->priv->zinbuf,
+				is->priv->zinsize, cancellable, error);
+			if (nread <= 0)
+				return nread;
+
+			zs->next_in = is->priv->zinbuf;
+			zs->avail_in = nread;
+		}
+
+		retval = inflate (zs, Z_SYNC_FLUSH);
+		if (retval != Z_OK && retval != Z_BUF_ERROR) {
+			g_set_error (
+				error, CAMEL_IMAPX_ERROR, 1,
+				"inflate: %s", zs->msg ? zs->msg : "error");
+			return -1;
+		}
+
+		/* a full output buffer may leave more in the inflater */
+		is->priv->inflate_pending = (zs->avail_out == 0);
+	} while (zs->avail_out == n);
+
+	io (is->tagprefix, "camel_imapx_read: inflated %d bytes\n", (gint) (n - zs->avail_out));
+
+	return n - zs->avail_out;
+}
+
 static gint
 imapx_stream_fill (CamelIMAPXStream *is,
                    GCancellable *cancellable,
@@ -73,12 +184,15 @@ imapx_stream_fill (CamelIMAPXStream *is,
 	gint left = 0;
 
 	if (is->priv->source != NULL) {
+		/* The tokenizer only refills an empty buffer, so there
+		 * is normally nothing to move to the front here. */
 		left = is->priv->end - is->priv->ptr;
-		memcpy (is->priv->buf, is->priv->ptr, left);
+		if (left > 0 && is->priv->ptr != is->priv->buf)
+			memmove (is->priv->buf, is->priv->ptr, left);
 		is->priv->end = is->priv->buf + left;
 		is->priv->ptr = is->priv->buf;
-		left = camel_stream_read (
-			is->priv->source,
+		left = imapx_stream_read_source (
+			is,
 			(gchar *) is->priv->end,
 			is->priv->bufsize - (is->priv->end - is->priv->buf),
 			cancellable, error);
@@ -176,6 +290,19 @@ imapx_stream_finalize (GObject *object)
 	g_free (stream->priv->buf);
 	g_free (stream->priv->tokenbuf);
 
+	if (stream->priv->inflate != NULL) {
+		inflateEnd (stream->priv->inflate);
+		g_free (stream->priv->inflate);
+	}
+
+	if (stream->priv->deflate != NULL) {
+		deflateEnd (stream->priv->deflate);
+		g_free (stream->priv->deflate);
+	}
+
+	g_free (stream->priv->zinbuf);
+	g_free (stream->priv->zoutbuf);
+
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_imapx_stream_parent_class)->finalize (object);
 }
@@ -201,9 +328,8 @@ imapx_stream_read (CamelStream *stream,
 		is->priv->ptr += max;
 	} else {
 		max = MIN (is->priv->literal, n);
-		max = camel_stream_read (
-			is->priv->source,
-			buffer, max, cancellable, error);
+		max = imapx_stream_read_source (
+			is, buffer, max, cancellable, error);
 		if (max <= 0)
 			return max;
 	}
@@ -230,9 +356,36 @@ imapx_stream_write (CamelStream *stream,
 		io (is->tagprefix, "camel_imapx_write: '%.*s'\n", (gint) n, buffer);
 	}
 
-	return camel_stream_write (
-		is->priv->source,
-		buffer, n, cancellable, error);
+	if (is->priv->deflate != NULL) {
+		z_stream *zs = is->priv->deflate;
+
+		zs->next_in = (Bytef *) buffer;
+		zs->avail_in = n;
+
+		/* every write is flushed, commands go out in one piece
+		 * or are followed by a wait for a continuation anyway */
+		do {
+			zs->next_out = is->priv->zoutbuf;
+			zs->avail_out = IMAPX_ZBUF_SIZE;
+
+			if (deflate (zs, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+				g_set_error (
+					error, CAMEL_IMAPX_ERROR, 1,
+					"deflate: %s", zs->msg ? zs->msg : "error");
+				return -1;
+			}
+
+			if (imapx_stream_write_raw (
+				is, (gchar *) is->priv->zoutbuf,
+				IMAPX_ZBUF_SIZE - zs->avail_out,
+				cancellable, error) == -1)
+				return -1;
+		} while (zs->avail_out == 0);
+
+		return n;
+	}
+
+	return imapx_stream_write_raw (is, buffer, n, cancellable, error);
 }
 
 static gint
@@ -340,6 +493,102 @@ camel_imapx_stream_grow (CamelIMAPXStream *is,
 		*bufptr = is->priv->buf + (*bufptr - oldbuf);
 }
 
+/* Reads the current literal of @len bytes into @buffer: whatever is
+ * buffered already is copied, the rest is read from the source straight
+ * into @buffer, without passing through the stream buffer. */
+static gint
+imapx_stream_read_literal (CamelIMAPXStream *is,
+                           guchar *buffer,
+                           guint len,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	guint max;
+
+	max = MIN (is->priv->end - is->priv->ptr, len);
+	memcpy (buffer, is->priv->ptr, max);
+	is->priv->ptr += max;
+
+	while (max < len) {
+		gssize nread;
+
+		nread = imapx_stream_read_source (
+			is, (gchar *) buffer + max, len - max,
+			cancellable, error);
+		if (nread <= 0) {
+			if (nread == 0)
+				g_set_error (
+					error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+					_("Source stream returned no data"));
+			is->priv->literal = len - max;
+			return -1;
+		}
+
+		max += nread;
+	}
+
+	is->priv->literal = 0;
+
+	return 0;
+}
+
+/* Writes the current literal to @dest: the buffered part straight from
+ * the stream buffer, the rest read into that buffer a chunk at a time
+ * and written out from there.  If writing fails, the rest of the
+ * literal is still read, so the response can be parsed on. */
+static gssize
+imapx_stream_literal_to_stream (CamelIMAPXStream *is,
+                                CamelStream *dest,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	gssize written = 0;
+	gboolean write_failed = FALSE;
+
+	if (is->priv->literal >= IMAPX_LITERAL_CHUNK &&
+	    is->priv->bufsize < IMAPX_LITERAL_CHUNK)
+		camel_imapx_stream_grow (is, IMAPX_LITERAL_CHUNK - 1, NULL, NULL);
+
+	while (is->priv->literal > 0) {
+		guint max;
+
+		max = is->priv->end - is->priv->ptr;
+		if (max == 0) {
+			gssize nread;
+
+			/* After a failed write @error is set already */
+			nread = imapx_stream_read_source (
+				is, (gchar *) is->priv->buf,
+				MIN (is->priv->literal, is->priv->bufsize),
+				cancellable, write_failed ? NULL : error);
+			if (nread <= 0) {
+				if (nread == 0 && !write_failed)
+					g_set_error (
+						error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+						_("Source stream returned no data"));
+				return -1;
+			}
+
+			is->priv->ptr = is->priv->buf;
+			is->priv->end = is->priv->buf + nread;
+			max = nread;
+		}
+
+		max = MIN (max, is->priv->literal);
+
+		if (!write_failed && camel_stream_write (
+			dest, (gchar *) is->priv->ptr, max,
+			cancellable, error) == -1)
+			write_failed = TRUE;
+
+		is->priv->ptr += max;
+		is->priv->literal -= max;
+		written += max;
+	}
+
+	return write_failed ? -1 : written;
+}
+
 G_DEFINE_QUARK (camel-imapx-error-quark, camel_imapx_error)
 
 /**
@@ -374,9 +623,89 @@ camel_imapx_stream_buffered (CamelIMAPXStream *is)
 {
 	g_return_val_if_fail (CAMEL_IS_IMAPX_STREAM (is), 0);
 
+	if (is->priv->inflate != NULL && (
+	    is->priv->inflate->avail_in > 0 || is->priv->inflate_pending))
+		return is->priv->end - is->priv->ptr + 1;
+
 	return is->priv->end - is->priv->ptr;
 }
 
+/* Blocks until there is data to process, reading what the server sent
+ * into the buffer if there is none.  Between responses, being cancelled
+ * here leaves nothing half read, unlike in the middle of one. */
+gboolean
+camel_imapx_stream_wait (CamelIMAPXStream *is,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_STREAM (is), FALSE);
+
+	if (is->priv->unget > 0 || camel_imapx_stream_buffered (is) > 0)
+		return TRUE;
+
+	return imapx_stream_fill (is, cancellable, error) > 0;
+}
+
+/* Traffic and literals are counted into @stats from now on; the
+ * caller keeps it alive for as long as the stream is in use. */
+void
+camel_imapx_stream_set_stats (CamelIMAPXStream *is,
+                              IMAPXServerStats *stats)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_STREAM (is));
+
+	is->priv->stats = stats;
+}
+
+/* Switches to RFC 4978 DEFLATE compression in both directions.  Call
+ * right after reading the tagged OK to COMPRESS; anything buffered past
+ * that response is already compressed data. */
+gboolean
+camel_imapx_stream_start_compress (CamelIMAPXStream *is,
+                                   GError **error)
+{
+	guint left;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_STREAM (is), FALSE);
+	g_return_val_if_fail (is->priv->inflate == NULL, FALSE);
+
+	is->priv->inflate = g_new0 (z_stream, 1);
+	is->priv->deflate = g_new0 (z_stream, 1);
+
+	/* raw deflate, no zlib or gzip framing */
+	if (inflateInit2 (is->priv->inflate, -MAX_WBITS) != Z_OK ||
+	    deflateInit2 (
+		is->priv->deflate, Z_DEFAULT_COMPRESSION,
+		Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		g_set_error (
+			error, CAMEL_IMAPX_ERROR, 1,
+			"%s", _("Cannot initialize compression"));
+		/* inflateEnd() and deflateEnd() cope with failed inits */
+		inflateEnd (is->priv->inflate);
+		deflateEnd (is->priv->deflate);
+		g_free (is->priv->inflate);
+		g_free (is->priv->deflate);
+		is->priv->inflate = NULL;
+		is->priv->deflate = NULL;
+		return FALSE;
+	}
+
+	/* bytes read past the OK response are already compressed */
+	left = is->priv->end - is->priv->ptr;
+	is->priv->zinsize = MAX (IMAPX_ZBUF_SIZE, left);
+	is->priv->zinbuf = g_malloc (is->priv->zinsize);
+	is->priv->zoutbuf = g_malloc (IMAPX_ZBUF_SIZE);
+
+	memcpy (is->priv->zinbuf, is->priv->ptr, left);
+	is->priv->inflate->next_in = is->priv->zinbuf;
+	is->priv->inflate->avail_in = left;
+	is->priv->ptr = is->priv->end = is->priv->buf;
+
+	io (is->tagprefix, "COMPRESS=DEFLATE active, %d bytes carried over\n", left);
+
+	return TRUE;
+}
+
 /* FIXME: these should probably handle it themselves,
  * and get rid of the token interface? */
 gint
@@ -422,8 +751,7 @@ camel_imapx_stream_astring (CamelIMAPXStream *is,
                             GCancellable *cancellable,
                             GError **error)
 {
-	guchar *p, *start;
-	guint len, inlen;
+	guint len;
 	gint ret;
 	GError *local_error = NULL;
 
@@ -438,16 +766,11 @@ camel_imapx_stream_astring (CamelIMAPXStream *is,
 	case IMAPX_TOK_LITERAL:
 		if (len >= is->priv->bufsize)
 			camel_imapx_stream_grow (is, len, NULL, NULL);
-		p = is->priv->tokenbuf;
-		camel_imapx_stream_set_literal (is, len);
-		do {
-			ret = camel_imapx_stream_getl (is, &start, &inlen, cancellable, error);
-			if (ret < 0)
-				return ret;
-			memcpy (p, start, inlen);
-			p += inlen;
-		} while (ret > 0);
-		*p = 0;
+		ret = imapx_stream_read_literal (
+			is, is->priv->tokenbuf, len, cancellable, error);
+		if (ret < 0)
+			return ret;
+		is->priv->tokenbuf[len] = 0;
 		*data = is->priv->tokenbuf;
 		return 0;
 	case IMAPX_TOK_ERROR:
@@ -472,8 +795,8 @@ camel_imapx_stream_nstring (CamelIMAPXStream *is,
                             GCancellable *cancellable,
                             GError **error)
 {
-	guchar *p, *start;
-	guint len, inlen;
+	guchar *p;
+	guint len;
 	gint ret;
 	GError *local_error = NULL;
 
@@ -486,16 +809,11 @@ camel_imapx_stream_nstring (CamelIMAPXStream *is,
 	case IMAPX_TOK_LITERAL:
 		if (len >= is->priv->bufsize)
 			camel_imapx_stream_grow (is, len, NULL, NULL);
-		p = is->priv->tokenbuf;
-		camel_imapx_stream_set_literal (is, len);
-		do {
-			ret = camel_imapx_stream_getl (is, &start, &inlen, cancellable, error);
-			if (ret < 0)
-				return ret;
-			memcpy (p, start, inlen);
-			p += inlen;
-		} while (ret > 0);
-		*p = 0;
+		ret = imapx_stream_read_literal (
+			is, is->priv->tokenbuf, len, cancellable, error);
+		if (ret < 0)
+			return ret;
+		is->priv->tokenbuf[len] = 0;
 		*data = is->priv->tokenbuf;
 		return 0;
 	case IMAPX_TOK_TOKEN:
@@ -542,22 +860,22 @@ camel_imapx_stream_nstring_stream (CamelIMAPXStream *is,
 			mem = camel_stream_mem_new_with_buffer ((gchar *) token, len);
 			*stream = mem;
 			break;
-		case IMAPX_TOK_LITERAL:
-			/* if len is big, we could automatically use a file backing */
-			camel_imapx_stream_set_literal (is, len);
-			mem = camel_stream_mem_new ();
-			if (camel_stream_write_to_stream ((CamelStream *) is, mem, cancellable, error) == -1) {
-				g_object_unref (mem);
+		case IMAPX_TOK_LITERAL: {
+			GByteArray *buffer;
+
+			/* sized up front and read into in one go */
+			buffer = g_byte_array_sized_new (len);
+			g_byte_array_set_size (buffer, len);
+			if (imapx_stream_read_literal (is, buffer->data, len, cancellable, error) == -1) {
+				g_byte_array_free (buffer, TRUE);
 				ret = -1;
 				break;
 			}
 
-			g_seekable_seek (
-				G_SEEKABLE (mem), 0,
-				G_SEEK_SET, NULL, NULL);
-
+			mem = camel_stream_mem_new_with_byte_array (buffer);
 			*stream = mem;
 			break;
+		}
 		case IMAPX_TOK_TOKEN:
 			if (toupper (token[0]) == 'N' && toupper (token[1]) == 'I' && toupper (token[2]) == 'L' && token[3] == 0) {
 				*stream = NULL;
@@ -574,6 +892,85 @@ camel_imapx_stream_nstring_stream (CamelIMAPXStream *is,
 	return ret;
 }
 
+/* parse an nstring into a byte array, without an intermediate stream */
+gint
+camel_imapx_stream_nstring_bytes (CamelIMAPXStream *is,
+                                  GByteArray *buffer,
+                                  GCancellable *cancellable,
+                                  GError **error)
+{
+	guchar *token;
+	guint len;
+	gint ret = 0;
+	GError *local_error = NULL;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_STREAM (is), -1);
+	g_return_val_if_fail (buffer != NULL, -1);
+
+	g_byte_array_set_size (buffer, 0);
+
+	switch (camel_imapx_stream_token (is, &token, &len, cancellable, &local_error)) {
+		case IMAPX_TOK_STRING:
+			g_byte_array_append (buffer, token, len);
+			break;
+		case IMAPX_TOK_LITERAL:
+			g_byte_array_set_size (buffer, len);
+			ret = imapx_stream_read_literal (
+				is, buffer->data, len, cancellable, error);
+			break;
+		case IMAPX_TOK_TOKEN:
+			if (toupper (token[0]) == 'N' && toupper (token[1]) == 'I' && toupper (token[2]) == 'L' && token[3] == 0)
+				break;
+		default:
+			ret = -1;
+			if (local_error == NULL)
+				g_set_error (error, CAMEL_IMAPX_ERROR, 1, "nstring: token not string");
+			else
+				g_propagate_error (error, local_error);
+	}
+
+	return ret;
+}
+
+/* parse an nstring straight into another stream */
+gssize
+camel_imapx_stream_nstring_to_stream (CamelIMAPXStream *is,
+                                      CamelStream *dest,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+	guchar *token;
+	guint len;
+	gssize ret = 0;
+	GError *local_error = NULL;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_STREAM (is), -1);
+	g_return_val_if_fail (CAMEL_IS_STREAM (dest), -1);
+
+	switch (camel_imapx_stream_token (is, &token, &len, cancellable, &local_error)) {
+		case IMAPX_TOK_STRING:
+			ret = camel_stream_write (
+				dest, (gchar *) token, len,
+				cancellable, error);
+			break;
+		case IMAPX_TOK_LITERAL:
+			ret = imapx_stream_literal_to_stream (
+				is, dest, cancellable, error);
+			break;
+		case IMAPX_TOK_TOKEN:
+			if (toupper (token[0]) == 'N' && toupper (token[1]) == 'I' && toupper (token[2]) == 'L' && token[3] == 0)
+				break;
+		default:
+			ret = -1;
+			if (local_error == NULL)
+				g_set_error (error, CAMEL_IMAPX_ERROR, 1, "nstring: token not string");
+			else
+				g_propagate_error (error, local_error);
+	}
+
+	return ret;
+}
+
 guint64
 camel_imapx_stream_number (CamelIMAPXStream *is,
                            GCancellable *cancellable,
@@ -689,6 +1086,20 @@ camel_imapx_stream_token (CamelIMAPXStream *is,
 		c = *p++;
 	} while (c == ' ' || c == '\r');
 
+	/* A literal8 (RFC 3516) is "~{n}"; past the prefix it is read
+	 * exactly like a normal literal. */
+	if (c == '~') {
+		while (p >= e) {
+			is->priv->ptr = p;
+			if (imapx_stream_fill (is, cancellable, error) == IMAPX_TOK_ERROR)
+				return IMAPX_TOK_ERROR;
+			p = is->priv->ptr;
+			e = is->priv->end;
+		}
+		if (*p == '{')
+			c = *p++;
+	}
+
 	/*strchr("\n*()[]+", c)*/
 	if (imapx_is_token_char (c)) {
 		is->priv->ptr = p;
@@ -710,6 +1121,9 @@ camel_imapx_stream_token (CamelIMAPXStream *is,
 								*len = literal;
 								is->priv->ptr = p;
 								is->priv->literal = literal;
+								if (is->priv->stats != NULL)
+									camel_imapx_stats_add_literal (
+										is->priv->stats, literal);
 								t (is->tagprefix, "token LITERAL %d\n", literal);
 								return IMAPX_TOK_LITERAL;
 							}
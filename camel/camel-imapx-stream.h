@@ -57,6 +57,9 @@ typedef struct _CamelIMAPXStream CamelIMAPXStream;
 typedef struct _CamelIMAPXStreamClass CamelIMAPXStreamClass;
 typedef struct _CamelIMAPXStreamPrivate CamelIMAPXStreamPrivate;
 
+/* defined in camel-imapx-utils.h */
+struct _IMAPXServerStats;
+
 typedef enum {
 	IMAPX_TOK_PROTOCOL = -2,
 	IMAPX_TOK_ERROR = -1,
@@ -82,6 +85,14 @@ GQuark		camel_imapx_error_quark		(void) G_GNUC_CONST;
 CamelStream *	camel_imapx_stream_new		(CamelStream *source);
 CamelStream *	camel_imapx_stream_ref_source	(CamelIMAPXStream *is);
 gint		camel_imapx_stream_buffered	(CamelIMAPXStream *is);
+gboolean	camel_imapx_stream_wait		(CamelIMAPXStream *is,
+						 GCancellable *cancellable,
+						 GError **error);
+void		camel_imapx_stream_set_stats	(CamelIMAPXStream *is,
+						 struct _IMAPXServerStats *stats);
+gboolean	camel_imapx_stream_start_compress
+						(CamelIMAPXStream *is,
+						 GError **error);
 
 camel_imapx_token_t
 		camel_imapx_stream_token	(CamelIMAPXStream *is,
@@ -129,6 +140,18 @@ gint		camel_imapx_stream_nstring_stream
 						 CamelStream **stream,
 						 GCancellable *cancellable,
 						 GError **error);
+/* gets a NIL or string into buffer, replacing its contents, empty if NIL */
+gint		camel_imapx_stream_nstring_bytes
+						(CamelIMAPXStream *is,
+						 GByteArray *buffer,
+						 GCancellable *cancellable,
+						 GError **error);
+/* writes a NIL or string to dest, returns the bytes written or -1 */
+gssize		camel_imapx_stream_nstring_to_stream
+						(CamelIMAPXStream *is,
+						 CamelStream *dest,
+						 GCancellable *cancellable,
+						 GError **error);
 /* gets 'text' */
 gint		camel_imapx_stream_text		(CamelIMAPXStream *is,
 						 guchar **text,
@@ -37,7 +37,20 @@
 
 #include "camel-imapx-summary.h"
 
-#define CAMEL_IMAPX_SUMMARY_VERSION (4)
+#define CAMEL_IMAPX_SUMMARY_VERSION (5)
+
+#define CAMEL_IMAPX_SUMMARY_GET_PRIVATE(obj) \
+	(G_TYPE_INSTANCE_GET_PRIVATE \
+	((obj), CAMEL_TYPE_IMAPX_SUMMARY, CamelIMAPXSummaryPrivate))
+
+typedef struct _CamelIMAPXSummaryPrivate CamelIMAPXSummaryPrivate;
+
+/* Kept out of the instance struct so its layout does not change. */
+struct _CamelIMAPXSummaryPrivate {
+	/* when the flags of every message were last fetched;
+	 * in between, only CONDSTORE changes are asked for */
+	time_t last_full_scan;
+};
 
 static gboolean info_set_user_flag (CamelMessageInfo *info, const gchar *id, gboolean state);
 
@@ -76,6 +89,8 @@ camel_imapx_summary_class_init (CamelIMAPXSummaryClass *class)
 {
 	CamelFolderSummaryClass *folder_summary_class;
 
+	g_type_class_add_private (class, sizeof (CamelIMAPXSummaryPrivate));
+
 	folder_summary_class = CAMEL_FOLDER_SUMMARY_CLASS (class);
 	folder_summary_class->message_info_size = sizeof (CamelIMAPXMessageInfo);
 	folder_summary_class->content_info_size = sizeof (CamelIMAPXMessageContentInfo);
@@ -187,6 +202,10 @@ summary_header_from_db (CamelFolderSummary *s,
 		ims->modseq = bdata_extract_digit (&part);
 	}
 
+	if (ims->version >= 5)
+		CAMEL_IMAPX_SUMMARY_GET_PRIVATE (ims)->last_full_scan =
+			bdata_extract_digit (&part);
+
 	if (ims->version > CAMEL_IMAPX_SUMMARY_VERSION) {
 		g_warning ("Unknown summary version\n");
 		errno = EINVAL;
@@ -211,9 +230,11 @@ summary_header_to_db (CamelFolderSummary *s,
 	if (!fir)
 		return NULL;
 	fir->bdata = g_strdup_printf (
-		"%d %" G_GUINT64_FORMAT " %u %" G_GUINT64_FORMAT, CAMEL_IMAPX_SUMMARY_VERSION,
+		"%d %" G_GUINT64_FORMAT " %u %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT,
+		CAMEL_IMAPX_SUMMARY_VERSION,
 		(guint64) ims->validity, ims->uidnext,
-		(guint64) ims->modseq);
+		(guint64) ims->modseq,
+		(gint64) CAMEL_IMAPX_SUMMARY_GET_PRIVATE (ims)->last_full_scan);
 	return fir;
 }
 
@@ -371,3 +392,41 @@ camel_imapx_summary_add_offline_uncached (CamelFolderSummary *summary,
 
 	camel_folder_summary_add (summary, (CamelMessageInfo *) mi);
 }
+
+/**
+ * camel_imapx_summary_get_last_full_scan:
+ * @summary: a #CamelIMAPXSummary
+ *
+ * Returns when the flags of every message in @summary were last
+ * fetched from the server, or 0 if never.
+ *
+ * Returns: a time, as from time()
+ *
+ * Since: 3.8
+ **/
+time_t
+camel_imapx_summary_get_last_full_scan (CamelIMAPXSummary *summary)
+{
+	g_return_val_if_fail (CAMEL_IS_IMAPX_SUMMARY (summary), 0);
+
+	return CAMEL_IMAPX_SUMMARY_GET_PRIVATE (summary)->last_full_scan;
+}
+
+/**
+ * camel_imapx_summary_set_last_full_scan:
+ * @summary: a #CamelIMAPXSummary
+ * @last_full_scan: a time, as from time()
+ *
+ * Records when the flags of every message in @summary were fetched
+ * from the server.  It is saved with the summary header.
+ *
+ * Since: 3.8
+ **/
+void
+camel_imapx_summary_set_last_full_scan (CamelIMAPXSummary *summary,
+                                        time_t last_full_scan)
+{
+	g_return_if_fail (CAMEL_IS_IMAPX_SUMMARY (summary));
+
+	CAMEL_IMAPX_SUMMARY_GET_PRIVATE (summary)->last_full_scan = last_full_scan;
+}
@@ -101,6 +101,11 @@ void		camel_imapx_summary_add_offline_uncached
 						(CamelFolderSummary *summary,
 						 const gchar *uid,
 						 const CamelMessageInfo *info);
+time_t		camel_imapx_summary_get_last_full_scan
+						(CamelIMAPXSummary *summary);
+void		camel_imapx_summary_set_last_full_scan
+						(CamelIMAPXSummary *summary,
+						 time_t last_full_scan);
 
 G_END_DECLS
 
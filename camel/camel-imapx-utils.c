@@ -57,6 +57,7 @@ static void camel_imapx_set_debug_flags (void)
 	debug_set_flag (token);
 	debug_set_flag (parse);
 	debug_set_flag (conman);
+	debug_set_flag (stats);
 }
 
 #include "camel-imapx-tokenise.h"
@@ -370,7 +371,13 @@ struct {
 	{ "QRESYNC", IMAPX_CAPABILITY_QRESYNC },
 	{ "LIST-EXTENDED", IMAPX_CAPABILITY_LIST_EXTENDED },
 	{ "LIST-STATUS", IMAPX_CAPABILITY_LIST_STATUS },
-	{ "QUOTA", IMAPX_CAPABILITY_QUOTA }
+	{ "QUOTA", IMAPX_CAPABILITY_QUOTA },
+	{ "COMPRESS=DEFLATE", IMAPX_CAPABILITY_COMPRESS_DEFLATE },
+	{ "MOVE", IMAPX_CAPABILITY_MOVE },
+	{ "BINARY", IMAPX_CAPABILITY_BINARY },
+	{ "ESEARCH", IMAPX_CAPABILITY_ESEARCH },
+	{ "NOTIFY", IMAPX_CAPABILITY_NOTIFY },
+	{ "MULTIAPPEND", IMAPX_CAPABILITY_MULTIAPPEND }
 };
 
 static GMutex capa_htable_lock;         /* capabilities lookup table lock */
@@ -1260,11 +1267,20 @@ imapx_parse_body (CamelIMAPXStream *is,
 
 			/* what do we do with the envelope?? */
 			minfo = imapx_parse_envelope (is, cancellable, &local_error);
-			/* what do we do with the message content info?? */
-			//((CamelMessageInfoBase *) minfo)->content = imapx_parse_body (is);
-			camel_message_info_free (minfo);
+			if (minfo != NULL)
+				camel_message_info_free (minfo);
 			minfo = NULL;
 			d (is->tagprefix, "Scanned envelope - what do i do with it?\n");
+
+			/* The enclosed message's own body comes next, keep
+			 * it as the child of the message/rfc822 part. */
+			if (cinfo != NULL && local_error == NULL) {
+				subinfo = imapx_parse_body (is, cancellable, &local_error);
+				if (subinfo != NULL) {
+					cinfo->childs = subinfo;
+					subinfo->parent = cinfo;
+				}
+			}
 		}
 
 		d (is->tagprefix, "fld_lines?\n");
@@ -1305,6 +1321,8 @@ imapx_parse_body (CamelIMAPXStream *is,
 	/* there should only be simple tokens, no lists */
 	do {
 		tok = camel_imapx_stream_token (is, &token, &len, cancellable, &local_error);
+		if (tok == IMAPX_TOK_ERROR || tok == IMAPX_TOK_PROTOCOL)
+			break;
 		if (tok != ')') {
 			d (is->tagprefix, "Dropping extension data '%s'\n", token);
 		}
@@ -1327,6 +1345,146 @@ imapx_parse_body (CamelIMAPXStream *is,
 	return cinfo;
 }
 
+/* Key for a single MIME part of a message, both in the data cache
+ * and for matching FETCH responses to the job which asked for it. */
+gchar *
+imapx_message_part_key (const gchar *uid,
+                        const gchar *section)
+{
+	return g_strdup_printf ("%s.%s", uid, section);
+}
+
+static void
+imapx_body_append_string (GString *out,
+                          const gchar *value)
+{
+	const gchar *p;
+
+	if (value == NULL) {
+		g_string_append (out, "NIL");
+		return;
+	}
+
+	/* quoted strings can't hold line breaks */
+	if (strpbrk (value, "\r\n") != NULL) {
+		g_string_append_printf (
+			out, "{%" G_GSIZE_FORMAT "}\r\n%s",
+			strlen (value), value);
+		return;
+	}
+
+	g_string_append_c (out, '"');
+	for (p = value; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			g_string_append_c (out, '\\');
+		g_string_append_c (out, *p);
+	}
+	g_string_append_c (out, '"');
+}
+
+static void
+imapx_body_append_params (GString *out,
+                          struct _camel_header_param *params)
+{
+	if (params == NULL) {
+		g_string_append (out, "NIL");
+		return;
+	}
+
+	g_string_append_c (out, '(');
+	for (; params != NULL; params = params->next) {
+		imapx_body_append_string (out, params->name);
+		g_string_append_c (out, ' ');
+		imapx_body_append_string (out, params->value);
+		if (params->next != NULL)
+			g_string_append_c (out, ' ');
+	}
+	g_string_append_c (out, ')');
+}
+
+static void
+imapx_body_append (GString *out,
+                   struct _CamelMessageContentInfo *cinfo)
+{
+	CamelContentType *type = cinfo->type;
+
+	g_string_append_c (out, '(');
+
+	if (type != NULL && cinfo->childs != NULL &&
+	    g_ascii_strcasecmp (type->type, "multipart") == 0) {
+		struct _CamelMessageContentInfo *child;
+
+		for (child = cinfo->childs; child != NULL; child = child->next)
+			imapx_body_append (out, child);
+
+		g_string_append_c (out, ' ');
+		imapx_body_append_string (out, type->subtype);
+
+		if (type->params != NULL) {
+			g_string_append_c (out, ' ');
+			imapx_body_append_params (out, type->params);
+		}
+	} else {
+		/* Leaves only; an enclosed message is fetched whole */
+		imapx_body_append_string (
+			out, type != NULL ? type->type : "application");
+		g_string_append_c (out, ' ');
+		imapx_body_append_string (
+			out, type != NULL ? type->subtype : "octet-stream");
+		g_string_append_c (out, ' ');
+		imapx_body_append_params (
+			out, type != NULL ? type->params : NULL);
+		g_string_append_c (out, ' ');
+		imapx_body_append_string (out, cinfo->id);
+		g_string_append_c (out, ' ');
+		imapx_body_append_string (out, cinfo->description);
+		g_string_append_c (out, ' ');
+		imapx_body_append_string (
+			out, cinfo->encoding != NULL ? cinfo->encoding : "7BIT");
+		g_string_append_printf (out, " %u", cinfo->size);
+	}
+
+	g_string_append_c (out, ')');
+}
+
+/* Writes out the parts of a parsed BODYSTRUCTURE that we keep,
+ * in BODYSTRUCTURE syntax so imapx_body_from_string() can read
+ * it back with the same parser. */
+gchar *
+imapx_body_to_string (struct _CamelMessageContentInfo *cinfo)
+{
+	GString *out;
+
+	g_return_val_if_fail (cinfo != NULL, NULL);
+
+	out = g_string_new (NULL);
+	imapx_body_append (out, cinfo);
+
+	return g_string_free (out, FALSE);
+}
+
+struct _CamelMessageContentInfo *
+imapx_body_from_string (const gchar *bodystructure,
+                        GError **error)
+{
+	struct _CamelMessageContentInfo *cinfo;
+	CamelStream *source, *stream;
+
+	g_return_val_if_fail (bodystructure != NULL, NULL);
+
+	source = camel_stream_mem_new_with_buffer (
+		bodystructure, strlen (bodystructure));
+	stream = camel_imapx_stream_new (source);
+	g_object_unref (source);
+
+	cinfo = imapx_parse_body (
+		CAMEL_IMAPX_STREAM (stream), NULL, error);
+
+	g_object_unref (stream);
+
+	return cinfo;
+}
+
 gchar *
 imapx_parse_section (CamelIMAPXStream *is,
                      GCancellable *cancellable,
@@ -1420,17 +1578,14 @@ imapx_parse_modseq (CamelIMAPXStream *is,
 	return ret;
 }
 
-void
-imapx_free_fetch (struct _fetch_info *finfo)
+static void
+imapx_clear_fetch (struct _fetch_info *finfo)
 {
-	if (finfo == NULL)
-		return;
-
 	if (finfo->body)
 		g_object_unref (finfo->body);
 	if (finfo->text)
 		g_object_unref (finfo->text);
-	if (finfo->header)
+	if (finfo->header && finfo->header != finfo->header_stream)
 		g_object_unref (finfo->header);
 	if (finfo->minfo)
 		camel_message_info_free (finfo->minfo);
@@ -1440,6 +1595,49 @@ imapx_free_fetch (struct _fetch_info *finfo)
 	g_free (finfo->date);
 	g_free (finfo->section);
 	g_free (finfo->uid);
+	g_clear_error (&finfo->body_error);
+}
+
+/* Empties @finfo for imapx_parse_fetch_into(), keeping the header
+ * buffer, so a connection can parse one FETCH after another without
+ * allocating a new fetch info and header stream for each of them. */
+void
+imapx_reset_fetch (struct _fetch_info *finfo)
+{
+	GByteArray *header_buffer;
+	CamelStream *header_stream;
+	CamelStream * (*body_sink) (struct _fetch_info *, gpointer);
+	gpointer body_sink_data;
+
+	g_return_if_fail (finfo != NULL);
+
+	imapx_clear_fetch (finfo);
+
+	header_buffer = finfo->header_buffer;
+	header_stream = finfo->header_stream;
+	body_sink = finfo->body_sink;
+	body_sink_data = finfo->body_sink_data;
+
+	memset (finfo, 0, sizeof (*finfo));
+
+	finfo->header_buffer = header_buffer;
+	finfo->header_stream = header_stream;
+	finfo->body_sink = body_sink;
+	finfo->body_sink_data = body_sink_data;
+}
+
+void
+imapx_free_fetch (struct _fetch_info *finfo)
+{
+	if (finfo == NULL)
+		return;
+
+	imapx_clear_fetch (finfo);
+
+	if (finfo->header_stream)
+		g_object_unref (finfo->header_stream);
+	if (finfo->header_buffer)
+		g_byte_array_free (finfo->header_buffer, TRUE);
 	g_free (finfo);
 }
 
@@ -1521,23 +1719,87 @@ imapx_dump_fetch (struct _fetch_info *finfo)
 	g_object_unref (sout);
 }
 
+/* Reads BODY[] or BINARY[] data, into the body sink if there is one.
+ * Should writing there fail, the data is skipped and the error kept in
+ * @finfo for whoever the data was for; the FETCH is still parsed on. */
+static void
+imapx_parse_fetch_body (CamelIMAPXStream *is,
+                        struct _fetch_info *finfo,
+                        GCancellable *cancellable)
+{
+	CamelStream *sink = NULL;
+
+	if (finfo->body_sink != NULL && finfo->uid != NULL)
+		sink = finfo->body_sink (finfo, finfo->body_sink_data);
+
+	if (sink != NULL) {
+		finfo->body_len = camel_imapx_stream_nstring_to_stream (
+			is, sink, cancellable, &finfo->body_error);
+		finfo->got |= FETCH_BODY_SUNK;
+		g_object_unref (sink);
+	} else {
+		camel_imapx_stream_nstring_stream (
+			is, &finfo->body, cancellable, NULL);
+	}
+
+	finfo->got |= FETCH_BODY;
+}
+
+/* Reads a header straight into the reusable buffer of @finfo. */
+static void
+imapx_parse_fetch_header (CamelIMAPXStream *is,
+                          struct _fetch_info *finfo,
+                          GCancellable *cancellable)
+{
+	if (finfo->header_buffer == NULL) {
+		finfo->header_buffer = g_byte_array_new ();
+		finfo->header_stream = camel_stream_mem_new ();
+		camel_stream_mem_set_byte_array (
+			CAMEL_STREAM_MEM (finfo->header_stream),
+			finfo->header_buffer);
+	}
+
+	camel_imapx_stream_nstring_bytes (
+		is, finfo->header_buffer, cancellable, NULL);
+
+	g_seekable_seek (
+		G_SEEKABLE (finfo->header_stream),
+		0, G_SEEK_SET, NULL, NULL);
+
+	finfo->header = finfo->header_stream;
+}
+
 struct _fetch_info *
 imapx_parse_fetch (CamelIMAPXStream *is,
                    GCancellable *cancellable,
                    GError **error)
 {
-	gint tok;
-	guint len;
-	guchar *token, *p, c;
 	struct _fetch_info *finfo;
 
 	finfo = g_malloc0 (sizeof (*finfo));
 
+	if (!imapx_parse_fetch_into (is, finfo, cancellable, error)) {
+		imapx_free_fetch (finfo);
+		return NULL;
+	}
+
+	return finfo;
+}
+
+gboolean
+imapx_parse_fetch_into (CamelIMAPXStream *is,
+                        struct _fetch_info *finfo,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	gint tok;
+	guint len;
+	guchar *token, *p, c;
+
 	tok = camel_imapx_stream_token (is, &token, &len, cancellable, NULL);
 	if (tok != '(') {
 		g_set_error (error, CAMEL_IMAPX_ERROR, 1, "fetch: expecting '('");
-		g_free (finfo);
-		return NULL;
+		return FALSE;
 	}
 
 	while ((tok = camel_imapx_stream_token (is, &token, &len, cancellable, NULL)) == IMAPX_TOK_TOKEN) {
@@ -1562,7 +1824,7 @@ imapx_parse_fetch (CamelIMAPXStream *is,
 				finfo->got |= FETCH_DATE;
 				break;
 			case IMAPX_RFC822_HEADER:
-				camel_imapx_stream_nstring_stream (is, &finfo->header, cancellable, NULL);
+				imapx_parse_fetch_header (is, finfo, cancellable);
 				finfo->got |= FETCH_HEADER;
 				break;
 			case IMAPX_RFC822_TEXT:
@@ -1596,13 +1858,36 @@ imapx_parse_fetch (CamelIMAPXStream *is,
 					} else {
 						camel_imapx_stream_ungettoken (is, tok, token, len);
 					}
-					camel_imapx_stream_nstring_stream (is, &finfo->body, cancellable, NULL);
-					finfo->got |= FETCH_BODY;
+					/* BODY[HEADER] and BODY[HEADER.FIELDS (...)] carry the
+					 * same data as RFC822.HEADER, so treat them alike */
+					if (finfo->section != NULL &&
+					    g_ascii_strncasecmp (finfo->section, "HEADER", 6) == 0) {
+						imapx_parse_fetch_header (is, finfo, cancellable);
+						finfo->got |= FETCH_HEADER;
+					} else {
+						imapx_parse_fetch_body (is, finfo, cancellable);
+					}
 				} else {
 					g_set_error (error, CAMEL_IMAPX_ERROR, 1, "unknown body response");
-					imapx_free_fetch (finfo);
-					return NULL;
+					return FALSE;
+				}
+				break;
+			case IMAPX_BINARY:
+				/* RFC 3516: the section content with its transfer
+				 * encoding already removed, usually as a literal8 */
+				finfo->section = imapx_parse_section (is, cancellable, NULL);
+				if (finfo->section == NULL) {
+					g_set_error (error, CAMEL_IMAPX_ERROR, 1, "unknown binary response");
+					return FALSE;
+				}
+				finfo->got |= FETCH_SECTION;
+				tok = camel_imapx_stream_token (is, &token, &len, cancellable, NULL);
+				if (token[0] == '<') {
+					finfo->offset = strtoul ((gchar *) token + 1, NULL, 10);
+				} else {
+					camel_imapx_stream_ungettoken (is, tok, token, len);
 				}
+				imapx_parse_fetch_body (is, finfo, cancellable);
 				break;
 			case IMAPX_UID:
 				tok = camel_imapx_stream_token (is, &token, &len, cancellable, NULL);
@@ -1614,19 +1899,17 @@ imapx_parse_fetch (CamelIMAPXStream *is,
 				finfo->got |= FETCH_UID;
 				break;
 			default:
-				imapx_free_fetch (finfo);
 				g_set_error (error, CAMEL_IMAPX_ERROR, 1, "unknown body response");
-				return NULL;
+				return FALSE;
 		}
 	}
 
 	if (tok != ')') {
 		g_set_error (error, CAMEL_IMAPX_ERROR, 1, "missing closing ')' on fetch response");
-		imapx_free_fetch (finfo);
-		return NULL;
+		return FALSE;
 	}
 
-	return finfo;
+	return TRUE;
 }
 
 struct _state_info *
@@ -1659,21 +1942,27 @@ imapx_parse_status_info (CamelIMAPXStream *is,
 		switch (imapx_tokenise ((gchar *) token, len)) {
 			case IMAPX_MESSAGES:
 				sinfo->messages = camel_imapx_stream_number (is, cancellable, NULL);
+				sinfo->have |= IMAPX_STATUS_MESSAGES;
 				break;
 			case IMAPX_RECENT:
 				sinfo->recent = camel_imapx_stream_number (is, cancellable, NULL);
+				sinfo->have |= IMAPX_STATUS_RECENT;
 				break;
 			case IMAPX_UIDNEXT:
 				sinfo->uidnext = camel_imapx_stream_number (is, cancellable, NULL);
+				sinfo->have |= IMAPX_STATUS_UIDNEXT;
 				break;
 			case IMAPX_UIDVALIDITY:
 				sinfo->uidvalidity = camel_imapx_stream_number (is, cancellable, NULL);
+				sinfo->have |= IMAPX_STATUS_UIDVALIDITY;
 				break;
 			case IMAPX_UNSEEN:
 				sinfo->unseen = camel_imapx_stream_number (is, cancellable, NULL);
+				sinfo->have |= IMAPX_STATUS_UNSEEN;
 				break;
 			case IMAPX_HIGHESTMODSEQ:
 				sinfo->highestmodseq = camel_imapx_stream_number (is, cancellable, NULL);
+				sinfo->have |= IMAPX_STATUS_HIGHESTMODSEQ;
 				break;
 			case IMAPX_NOMODSEQ:
 			break;
@@ -1700,6 +1989,13 @@ generate_uids_from_sequence (GPtrArray *uids,
 {
 	guint32 i;
 
+	/* A range may be written backwards, "4:2" is "2:4" (RFC 3501). */
+	if (begin_uid > end_uid) {
+		for (i = begin_uid; i >= end_uid && i > 0; i--)
+			g_ptr_array_add (uids, GUINT_TO_POINTER (i));
+		return;
+	}
+
 	for (i = begin_uid; i <= end_uid; i++)
 		g_ptr_array_add (uids, GUINT_TO_POINTER (i));
 }
@@ -1794,10 +2090,14 @@ imapx_parse_status (CamelIMAPXStream *is,
 			case IMAPX_PARSE:
 			case IMAPX_TRYCREATE:
 			case IMAPX_CLOSED:
+			case IMAPX_NOTIFICATIONOVERFLOW:
 				break;
 			case IMAPX_APPENDUID:
 				sinfo->u.appenduid.uidvalidity = camel_imapx_stream_number (is, cancellable, NULL);
-				sinfo->u.appenduid.uid = camel_imapx_stream_number (is, cancellable, NULL);
+				/* a uid-set after MULTIAPPEND (RFC 3502) */
+				sinfo->u.appenduid.uids = imapx_parse_uids (is, cancellable, NULL);
+				if (sinfo->u.appenduid.uids != NULL && sinfo->u.appenduid.uids->len > 0)
+					sinfo->u.appenduid.uid = GPOINTER_TO_UINT (sinfo->u.appenduid.uids->pdata[0]);
 				break;
 			case IMAPX_COPYUID:
 				sinfo->u.copyuid.uidvalidity = camel_imapx_stream_number (is, cancellable, NULL);
@@ -1865,6 +2165,12 @@ imapx_copy_status (struct _status_info *sinfo)
 	if (out->condition == IMAPX_NEWNAME) {
 		out->u.newname.oldname = g_strdup (out->u.newname.oldname);
 		out->u.newname.newname = g_strdup (out->u.newname.newname);
+	} else if (out->condition == IMAPX_APPENDUID && out->u.appenduid.uids != NULL) {
+		GPtrArray *uids = out->u.appenduid.uids;
+
+		out->u.appenduid.uids = g_ptr_array_sized_new (uids->len);
+		g_ptr_array_set_size (out->u.appenduid.uids, uids->len);
+		memcpy (out->u.appenduid.uids->pdata, uids->pdata, uids->len * sizeof (gpointer));
 	}
 
 	return out;
@@ -1881,6 +2187,10 @@ imapx_free_status (struct _status_info *sinfo)
 		g_free (sinfo->u.newname.oldname);
 		g_free (sinfo->u.newname.newname);
 		break;
+	case IMAPX_APPENDUID:
+		if (sinfo->u.appenduid.uids != NULL)
+			g_ptr_array_free (sinfo->u.appenduid.uids, TRUE);
+		break;
 	case IMAPX_COPYUID:
 		g_ptr_array_free (sinfo->u.copyuid.uids, FALSE);
 		g_ptr_array_free (sinfo->u.copyuid.copied_uids, FALSE);
@@ -2423,3 +2733,274 @@ camel_imapx_destroy_job_queue_info (IMAPXJobQueueInfo *jinfo)
 	g_hash_table_destroy (jinfo->folders);
 	g_free (jinfo);
 }
+
+static guint
+imapx_stats_bucket (guint64 value,
+                    guint64 limit)
+{
+	guint bucket = 0;
+
+	while (bucket < IMAPX_STATS_BUCKETS - 1 && value >= limit) {
+		limit *= 4;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/* Caller must hold stats->lock. */
+static IMAPXCommandStats *
+imapx_stats_lookup_command (IMAPXServerStats *stats,
+                            const gchar *name)
+{
+	IMAPXCommandStats *cstats;
+
+	cstats = g_hash_table_lookup (stats->commands, name);
+	if (cstats == NULL) {
+		cstats = g_new0 (IMAPXCommandStats, 1);
+		g_hash_table_insert (stats->commands, g_strdup (name), cstats);
+	}
+
+	return cstats;
+}
+
+IMAPXServerStats *
+camel_imapx_stats_new (void)
+{
+	IMAPXServerStats *stats;
+
+	stats = g_new0 (IMAPXServerStats, 1);
+	g_mutex_init (&stats->lock);
+	stats->commands = g_hash_table_new_full (
+		g_str_hash, g_str_equal, g_free, g_free);
+
+	return stats;
+}
+
+IMAPXServerStats *
+camel_imapx_stats_copy (IMAPXServerStats *stats)
+{
+	IMAPXServerStats *copy;
+
+	copy = camel_imapx_stats_new ();
+	camel_imapx_stats_merge (copy, stats);
+
+	return copy;
+}
+
+void
+camel_imapx_stats_free (IMAPXServerStats *stats)
+{
+	if (stats == NULL)
+		return;
+
+	g_hash_table_destroy (stats->commands);
+	g_mutex_clear (&stats->lock);
+	g_free (stats);
+}
+
+/* Adds the counts in other to those in stats. */
+void
+camel_imapx_stats_merge (IMAPXServerStats *stats,
+                         IMAPXServerStats *other)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	guint ii;
+
+	g_return_if_fail (stats != NULL);
+	g_return_if_fail (other != NULL);
+	g_return_if_fail (stats != other);
+
+	g_mutex_lock (&stats->lock);
+	g_mutex_lock (&other->lock);
+
+	stats->n_connections += other->n_connections;
+	stats->n_lost += other->n_lost;
+	stats->bytes_in += other->bytes_in;
+	stats->bytes_out += other->bytes_out;
+	stats->n_literals += other->n_literals;
+	stats->literal_bytes += other->literal_bytes;
+	stats->literal_max = MAX (stats->literal_max, other->literal_max);
+	stats->parse_total += other->parse_total;
+	stats->read_wait += other->read_wait;
+
+	for (ii = 0; ii < IMAPX_STATS_BUCKETS; ii++)
+		stats->literal_sizes[ii] += other->literal_sizes[ii];
+
+	g_hash_table_iter_init (&iter, other->commands);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		IMAPXCommandStats *src = value;
+		IMAPXCommandStats *dest;
+
+		dest = imapx_stats_lookup_command (stats, key);
+		dest->count += src->count;
+		dest->failed += src->failed;
+		dest->wait_total += src->wait_total;
+		dest->latency_total += src->latency_total;
+		dest->latency_max = MAX (dest->latency_max, src->latency_max);
+
+		for (ii = 0; ii < IMAPX_STATS_BUCKETS; ii++)
+			dest->latency[ii] += src->latency[ii];
+	}
+
+	g_mutex_unlock (&other->lock);
+	g_mutex_unlock (&stats->lock);
+}
+
+void
+camel_imapx_stats_add_io (IMAPXServerStats *stats,
+                          gsize bytes_in,
+                          gsize bytes_out,
+                          gint64 read_wait)
+{
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&stats->lock);
+	stats->bytes_in += bytes_in;
+	stats->bytes_out += bytes_out;
+	stats->read_wait += read_wait;
+	g_mutex_unlock (&stats->lock);
+}
+
+void
+camel_imapx_stats_add_literal (IMAPXServerStats *stats,
+                               gsize size)
+{
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&stats->lock);
+	stats->n_literals++;
+	stats->literal_bytes += size;
+	stats->literal_max = MAX (stats->literal_max, size);
+	stats->literal_sizes[imapx_stats_bucket (size, 1024)]++;
+	g_mutex_unlock (&stats->lock);
+}
+
+void
+camel_imapx_stats_add_parse (IMAPXServerStats *stats,
+                             gint64 parse_time)
+{
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&stats->lock);
+	stats->parse_total += parse_time;
+	g_mutex_unlock (&stats->lock);
+}
+
+void
+camel_imapx_stats_add_command (IMAPXServerStats *stats,
+                               const gchar *name,
+                               gboolean failed,
+                               gint64 wait,
+                               gint64 latency)
+{
+	IMAPXCommandStats *cstats;
+
+	g_return_if_fail (stats != NULL);
+	g_return_if_fail (name != NULL);
+
+	g_mutex_lock (&stats->lock);
+
+	cstats = imapx_stats_lookup_command (stats, name);
+	cstats->count++;
+	if (failed)
+		cstats->failed++;
+	cstats->wait_total += wait;
+	cstats->latency_total += latency;
+	cstats->latency_max = MAX (cstats->latency_max, latency);
+	cstats->latency[imapx_stats_bucket (latency, 1000)]++;
+
+	g_mutex_unlock (&stats->lock);
+}
+
+void
+camel_imapx_stats_add_connections (IMAPXServerStats *stats,
+                                   guint n_opened,
+                                   guint n_lost)
+{
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&stats->lock);
+	stats->n_connections += n_opened;
+	stats->n_lost += n_lost;
+	g_mutex_unlock (&stats->lock);
+}
+
+/* A plain text table of the counters, for debugging output. */
+gchar *
+camel_imapx_stats_to_string (IMAPXServerStats *stats)
+{
+	static const gchar *latency_labels[IMAPX_STATS_BUCKETS] = {
+		"<1ms", "<4ms", "<16ms", "<64ms",
+		"<256ms", "<1s", "<4s", ">=4s"
+	};
+	static const gchar *size_labels[IMAPX_STATS_BUCKETS] = {
+		"<1K", "<4K", "<16K", "<64K",
+		"<256K", "<1M", "<4M", ">=4M"
+	};
+	GString *out;
+	GList *names, *link;
+	guint ii;
+
+	g_return_val_if_fail (stats != NULL, NULL);
+
+	out = g_string_new (NULL);
+
+	g_mutex_lock (&stats->lock);
+
+	g_string_append_printf (
+		out, "connections: %u opened, %u lost\n",
+		stats->n_connections, stats->n_lost);
+	g_string_append_printf (
+		out, "bytes: %" G_GUINT64_FORMAT " in, %"
+		G_GUINT64_FORMAT " out\n",
+		stats->bytes_in, stats->bytes_out);
+	g_string_append_printf (
+		out, "responses: %.1f ms handling, %.1f ms of it "
+		"waiting for the server\n",
+		stats->parse_total / 1000.0, stats->read_wait / 1000.0);
+
+	g_string_append_printf (
+		out, "literals: %" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT
+		" bytes, largest %" G_GUINT64_FORMAT "\n ",
+		stats->n_literals, stats->literal_bytes, stats->literal_max);
+	for (ii = 0; ii < IMAPX_STATS_BUCKETS; ii++)
+		g_string_append_printf (
+			out, " %s:%" G_GUINT64_FORMAT,
+			size_labels[ii], stats->literal_sizes[ii]);
+	g_string_append_c (out, '\n');
+
+	g_string_append (
+		out, "command        count failed avg-wait  avg-rtt  max-rtt");
+	for (ii = 0; ii < IMAPX_STATS_BUCKETS; ii++)
+		g_string_append_printf (out, " %7s", latency_labels[ii]);
+	g_string_append_c (out, '\n');
+
+	names = g_hash_table_get_keys (stats->commands);
+	names = g_list_sort (names, (GCompareFunc) g_strcmp0);
+
+	for (link = names; link != NULL; link = g_list_next (link)) {
+		IMAPXCommandStats *cstats;
+
+		cstats = g_hash_table_lookup (stats->commands, link->data);
+
+		g_string_append_printf (
+			out, "%-12s %7" G_GUINT64_FORMAT " %6" G_GUINT64_FORMAT
+			" %6.1fms %6.1fms %6.1fms",
+			(gchar *) link->data, cstats->count, cstats->failed,
+			cstats->wait_total / 1000.0 / MAX (cstats->count, 1),
+			cstats->latency_total / 1000.0 / MAX (cstats->count, 1),
+			cstats->latency_max / 1000.0);
+		for (ii = 0; ii < IMAPX_STATS_BUCKETS; ii++)
+			g_string_append_printf (
+				out, " %7" G_GUINT64_FORMAT, cstats->latency[ii]);
+		g_string_append_c (out, '\n');
+	}
+
+	g_list_free (names);
+
+	g_mutex_unlock (&stats->lock);
+
+	return g_string_free (out, FALSE);
+}
@@ -37,6 +37,7 @@ typedef enum _camel_imapx_id_t {
 	IMAPX_ALERT,
 	IMAPX_APPENDUID,
 	IMAPX_BAD,
+	IMAPX_BINARY,
 	IMAPX_BODY,
 	IMAPX_BODYSTRUCTURE,
 	IMAPX_BYE,
@@ -58,6 +59,7 @@ typedef enum _camel_imapx_id_t {
 	IMAPX_NEWNAME,
 	IMAPX_NO,
 	IMAPX_NOMODSEQ,
+	IMAPX_NOTIFICATIONOVERFLOW,
 	IMAPX_OK,
 	IMAPX_PARSE,
 	IMAPX_PERMANENTFLAGS,
@@ -80,6 +82,7 @@ typedef enum _camel_imapx_id_t {
 #define CAMEL_IMAPX_UNTAGGED_BAD        "BAD"
 #define CAMEL_IMAPX_UNTAGGED_BYE        "BYE"
 #define CAMEL_IMAPX_UNTAGGED_CAPABILITY "CAPABILITY"
+#define CAMEL_IMAPX_UNTAGGED_ESEARCH    "ESEARCH"
 #define CAMEL_IMAPX_UNTAGGED_EXISTS     "EXISTS"
 #define CAMEL_IMAPX_UNTAGGED_EXPUNGE    "EXPUNGE"
 #define CAMEL_IMAPX_UNTAGGED_FETCH      "FETCH"
@@ -147,7 +150,13 @@ enum {
 	IMAPX_CAPABILITY_QRESYNC		= (1 << 9),
 	IMAPX_CAPABILITY_LIST_STATUS		= (1 << 10),
 	IMAPX_CAPABILITY_LIST_EXTENDED		= (1 << 11),
-	IMAPX_CAPABILITY_QUOTA			= (1 << 12)
+	IMAPX_CAPABILITY_QUOTA			= (1 << 12),
+	IMAPX_CAPABILITY_COMPRESS_DEFLATE	= (1 << 13),
+	IMAPX_CAPABILITY_MOVE			= (1 << 14),
+	IMAPX_CAPABILITY_BINARY			= (1 << 15),
+	IMAPX_CAPABILITY_ESEARCH		= (1 << 16),
+	IMAPX_CAPABILITY_NOTIFY			= (1 << 17),
+	IMAPX_CAPABILITY_MULTIAPPEND		= (1 << 18)
 };
 
 struct _capability_info {
@@ -191,6 +200,12 @@ gchar *		imapx_parse_section		(struct _CamelIMAPXStream *is,
 						 GCancellable *cancellable,
 						 GError **error);
 void		imapx_free_body			(struct _CamelMessageContentInfo *cinfo);
+gchar *		imapx_message_part_key		(const gchar *uid,
+						 const gchar *section);
+gchar *		imapx_body_to_string		(struct _CamelMessageContentInfo *cinfo);
+struct _CamelMessageContentInfo *
+		imapx_body_from_string		(const gchar *bodystructure,
+						 GError **error);
 
 /* ********************************************************************** */
 /* all the possible stuff we might get from a fetch request */
@@ -210,6 +225,19 @@ struct _fetch_info {
 	gchar *date;		/* INTERNALDATE */
 	gchar *section;		/* section for a BODY[section] request */
 	gchar *uid;		/* UID */
+
+	/* @header points here when set; kept by imapx_reset_fetch() */
+	GByteArray *header_buffer;
+	CamelStream *header_stream;
+
+	/* When set and the UID came before the BODY[] data, asked for a
+	 * stream to write that data straight to instead of into @body.
+	 * Also kept by imapx_reset_fetch(). */
+	CamelStream *	(*body_sink)	(struct _fetch_info *finfo,
+					 gpointer user_data);
+	gpointer body_sink_data;
+	gssize body_len;	/* bytes written to the body sink */
+	GError *body_error;	/* why writing to the body sink failed */
 };
 
 #define FETCH_BODY (1 << 0)
@@ -224,11 +252,17 @@ struct _fetch_info {
 #define FETCH_SECTION (1 << 9)
 #define FETCH_UID (1 << 10)
 #define FETCH_MODSEQ (1 << 11)
+#define FETCH_BODY_SUNK (1 << 12)
 
 struct _fetch_info *
 		imapx_parse_fetch		(struct _CamelIMAPXStream *is,
 						 GCancellable *cancellable,
 						 GError **error);
+gboolean	imapx_parse_fetch_into		(struct _CamelIMAPXStream *is,
+						 struct _fetch_info *finfo,
+						 GCancellable *cancellable,
+						 GError **error);
+void		imapx_reset_fetch		(struct _fetch_info *finfo);
 void		imapx_free_fetch		(struct _fetch_info *finfo);
 void		imapx_dump_fetch		(struct _fetch_info *finfo);
 
@@ -250,7 +284,9 @@ struct _status_info {
 		guint64 highestmodseq;
 		struct {
 			guint64 uidvalidity;
+			/* the first of uids, for single appends */
 			guint32 uid;
+			GPtrArray *uids;
 		} appenduid;
 		struct {
 			guint64 uidvalidity;
@@ -273,6 +309,15 @@ void		imapx_free_status		(struct _status_info *sinfo);
 
 /* ********************************************************************** */
 /* parses the response from the status command */
+enum {
+	IMAPX_STATUS_MESSAGES		= (1 << 0),
+	IMAPX_STATUS_RECENT		= (1 << 1),
+	IMAPX_STATUS_UIDNEXT		= (1 << 2),
+	IMAPX_STATUS_UNSEEN		= (1 << 3),
+	IMAPX_STATUS_UIDVALIDITY	= (1 << 4),
+	IMAPX_STATUS_HIGHESTMODSEQ	= (1 << 5)
+};
+
 struct _state_info {
 	gchar *name;
 	guint32 messages;
@@ -281,6 +326,9 @@ struct _state_info {
 	guint32 unseen;
 	guint64 uidvalidity;
 	guint64 highestmodseq;
+	/* IMAPX_STATUS_* flags of the attributes present;
+	 * unsolicited STATUS (RFC 5465) may carry only some */
+	guint32 have;
 };
 
 /* use g_free to free the return value */
@@ -320,11 +368,34 @@ gboolean	camel_imapx_parse_quotaroot	(struct _CamelIMAPXStream *is,
 						 GError **error);
 
 /* ********************************************************************** */
+
+/* Interactive jobs are those a user is waiting on, like opening a
+ * message or searching; bulk jobs are refreshes, flag synchronization,
+ * offline downloads and the like, which can be made to wait. */
+typedef enum {
+	IMAPX_JOB_KIND_INTERACTIVE,
+	IMAPX_JOB_KIND_BULK,
+	IMAPX_N_JOB_KINDS
+} IMAPXJobKind;
+
+/* Latencies are in microseconds, measured from when a job is queued. */
+typedef struct _IMAPXJobLatency {
+	guint pending;		/* jobs queued or running now */
+	guint64 finished;	/* jobs finished so far */
+	gint64 wait_total;	/* until its first command was sent */
+	gint64 wait_max;
+	gint64 run_total;	/* until it finished */
+	gint64 run_max;
+} IMAPXJobLatency;
+
 typedef struct _IMAPXJobQueueInfo {
 	guint queue_len;
 
 	/* list of folders for which jobs are in the queue */
 	GHashTable *folders;
+
+	/* indexed by IMAPXJobKind */
+	IMAPXJobLatency latency[IMAPX_N_JOB_KINDS];
 } IMAPXJobQueueInfo;
 
 void		camel_imapx_destroy_job_queue_info
@@ -332,6 +403,72 @@ void		camel_imapx_destroy_job_queue_info
 
 /* ********************************************************************** */
 
+/* Histograms have buckets each four times as wide as the one before:
+ * round trips under 1ms, 4ms, 16ms, ... 4.096s and longer, literals
+ * under 1KB, 4KB, 16KB, ... 4MB and larger. */
+#define IMAPX_STATS_BUCKETS (8)
+
+/* Times are in microseconds. */
+typedef struct _IMAPXCommandStats {
+	guint64 count;
+	guint64 failed;
+	gint64 wait_total;	/* queued until sent */
+	gint64 latency_total;	/* sent until the tagged response */
+	gint64 latency_max;
+	guint64 latency[IMAPX_STATS_BUCKETS];
+} IMAPXCommandStats;
+
+typedef struct _IMAPXServerStats {
+	GMutex lock;
+
+	guint n_connections;	/* opened */
+	guint n_lost;		/* dropped other than by disconnecting */
+
+	guint64 bytes_in;	/* as on the wire, so compressed if COMPRESS is on */
+	guint64 bytes_out;
+
+	guint64 n_literals;
+	guint64 literal_bytes;
+	guint64 literal_max;
+	guint64 literal_sizes[IMAPX_STATS_BUCKETS];
+
+	/* Handling server responses takes parse_total, of which
+	 * read_wait is spent waiting for data from the server. */
+	gint64 parse_total;
+	gint64 read_wait;
+
+	/* command name -> IMAPXCommandStats */
+	GHashTable *commands;
+} IMAPXServerStats;
+
+IMAPXServerStats *
+		camel_imapx_stats_new		(void);
+IMAPXServerStats *
+		camel_imapx_stats_copy		(IMAPXServerStats *stats);
+void		camel_imapx_stats_free		(IMAPXServerStats *stats);
+void		camel_imapx_stats_merge		(IMAPXServerStats *stats,
+						 IMAPXServerStats *other);
+void		camel_imapx_stats_add_io	(IMAPXServerStats *stats,
+						 gsize bytes_in,
+						 gsize bytes_out,
+						 gint64 read_wait);
+void		camel_imapx_stats_add_literal	(IMAPXServerStats *stats,
+						 gsize size);
+void		camel_imapx_stats_add_parse	(IMAPXServerStats *stats,
+						 gint64 parse_time);
+void		camel_imapx_stats_add_command	(IMAPXServerStats *stats,
+						 const gchar *name,
+						 gboolean failed,
+						 gint64 wait,
+						 gint64 latency);
+void		camel_imapx_stats_add_connections
+						(IMAPXServerStats *stats,
+						 guint n_opened,
+						 guint n_lost);
+gchar *		camel_imapx_stats_to_string	(IMAPXServerStats *stats);
+
+/* ********************************************************************** */
+
 extern guchar imapx_specials[256];
 
 #define IMAPX_TYPE_CHAR (1 << 0)
@@ -365,9 +502,10 @@ extern gint camel_imapx_debug_flags;
 #define CAMEL_IMAPX_DEBUG_token		(1 << 4)
 #define CAMEL_IMAPX_DEBUG_parse		(1 << 5)
 #define CAMEL_IMAPX_DEBUG_conman	(1 << 6)
+#define CAMEL_IMAPX_DEBUG_stats		(1 << 7)
 
 /* Set this to zero to remove all debug output at build time */
-#define CAMEL_IMAPX_DEBUG_ALL		((1 << 7)-1)
+#define CAMEL_IMAPX_DEBUG_ALL		((1 << 8)-1)
 
 #define camel_debug_flag(type) \
 	(camel_imapx_debug_flags & \
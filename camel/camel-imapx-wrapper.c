@@ -0,0 +1,210 @@
+/*
+ * camel-imapx-wrapper.c
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the program; if not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/* The content of a single MIME part of a message on the server,
+ * downloaded the first time anything asks for it.  Used for the
+ * attachments of messages opened with only their text parts, see
+ * CamelIMAPXSettings:fetch-text-first. */
+
+#include "camel-imapx-wrapper.h"
+
+#define CAMEL_IMAPX_WRAPPER_GET_PRIVATE(obj) \
+	(G_TYPE_INSTANCE_GET_PRIVATE \
+	((obj), CAMEL_TYPE_IMAPX_WRAPPER, CamelIMAPXWrapperPrivate))
+
+struct _CamelIMAPXWrapperPrivate {
+	CamelIMAPXFolder *folder;
+	gchar *uid;
+	gchar *section;
+	gchar *encoding;
+
+	/* Held while the part is being fetched. */
+	GMutex fetch_lock;
+};
+
+G_DEFINE_TYPE (
+	CamelIMAPXWrapper,
+	camel_imapx_wrapper,
+	CAMEL_TYPE_DATA_WRAPPER)
+
+static void
+imapx_wrapper_dispose (GObject *object)
+{
+	CamelIMAPXWrapperPrivate *priv;
+
+	priv = CAMEL_IMAPX_WRAPPER_GET_PRIVATE (object);
+
+	g_clear_object (&priv->folder);
+
+	/* Chain up to parent's dispose() method. */
+	G_OBJECT_CLASS (camel_imapx_wrapper_parent_class)->dispose (object);
+}
+
+static void
+imapx_wrapper_finalize (GObject *object)
+{
+	CamelIMAPXWrapperPrivate *priv;
+
+	priv = CAMEL_IMAPX_WRAPPER_GET_PRIVATE (object);
+
+	g_free (priv->uid);
+	g_free (priv->section);
+	g_free (priv->encoding);
+
+	g_mutex_clear (&priv->fetch_lock);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (camel_imapx_wrapper_parent_class)->finalize (object);
+}
+
+/* Fills the wrapper with the part's content, from the folder's
+ * data cache if it is there, else from the server. */
+static gboolean
+imapx_wrapper_fetch (CamelDataWrapper *data_wrapper,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+	CamelIMAPXWrapperPrivate *priv;
+	CamelStream *stream;
+	gboolean success = TRUE;
+
+	priv = CAMEL_IMAPX_WRAPPER_GET_PRIVATE (data_wrapper);
+
+	g_mutex_lock (&priv->fetch_lock);
+
+	if (!data_wrapper->offline)
+		goto exit;
+
+	if (priv->folder == NULL) {
+		g_set_error_literal (
+			error, CAMEL_FOLDER_ERROR,
+			CAMEL_FOLDER_ERROR_INVALID,
+			"Folder for message part is gone");
+		success = FALSE;
+		goto exit;
+	}
+
+	stream = camel_imapx_folder_get_message_part (
+		priv->folder, priv->uid, priv->section,
+		priv->encoding, cancellable, error);
+
+	if (stream == NULL) {
+		success = FALSE;
+		goto exit;
+	}
+
+	success = CAMEL_DATA_WRAPPER_CLASS (camel_imapx_wrapper_parent_class)->
+		construct_from_stream_sync (
+		data_wrapper, stream, cancellable, error);
+
+	g_object_unref (stream);
+
+	if (success) {
+		data_wrapper->offline = FALSE;
+
+		/* Everything we need is in memory now. */
+		g_clear_object (&priv->folder);
+	}
+
+exit:
+	g_mutex_unlock (&priv->fetch_lock);
+
+	return success;
+}
+
+static gssize
+imapx_wrapper_write_to_stream_sync (CamelDataWrapper *data_wrapper,
+                                    CamelStream *stream,
+                                    GCancellable *cancellable,
+                                    GError **error)
+{
+	if (!imapx_wrapper_fetch (data_wrapper, cancellable, error))
+		return -1;
+
+	/* Chain up to parent's write_to_stream_sync() method. */
+	return CAMEL_DATA_WRAPPER_CLASS (camel_imapx_wrapper_parent_class)->
+		write_to_stream_sync (data_wrapper, stream, cancellable, error);
+}
+
+static void
+camel_imapx_wrapper_class_init (CamelIMAPXWrapperClass *class)
+{
+	GObjectClass *object_class;
+	CamelDataWrapperClass *data_wrapper_class;
+
+	g_type_class_add_private (class, sizeof (CamelIMAPXWrapperPrivate));
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->dispose = imapx_wrapper_dispose;
+	object_class->finalize = imapx_wrapper_finalize;
+
+	data_wrapper_class = CAMEL_DATA_WRAPPER_CLASS (class);
+	data_wrapper_class->write_to_stream_sync = imapx_wrapper_write_to_stream_sync;
+}
+
+static void
+camel_imapx_wrapper_init (CamelIMAPXWrapper *wrapper)
+{
+	wrapper->priv = CAMEL_IMAPX_WRAPPER_GET_PRIVATE (wrapper);
+
+	g_mutex_init (&wrapper->priv->fetch_lock);
+}
+
+/**
+ * camel_imapx_wrapper_new:
+ * @folder: a #CamelIMAPXFolder
+ * @uid: a message UID
+ * @section: the part's section number, as in BODYSTRUCTURE
+ * @encoding: the part's Content-Transfer-Encoding, or %NULL
+ * @content_type: the part's #CamelContentType
+ *
+ * Returns a new #CamelDataWrapper for one part of a message in
+ * @folder, which is downloaded the first time the wrapper is written
+ * or decoded.  Until then camel_data_wrapper_is_offline() is %TRUE.
+ *
+ * Returns: a new #CamelIMAPXWrapper
+ *
+ * Since: 3.8
+ **/
+CamelDataWrapper *
+camel_imapx_wrapper_new (CamelIMAPXFolder *folder,
+                         const gchar *uid,
+                         const gchar *section,
+                         const gchar *encoding,
+                         CamelContentType *content_type)
+{
+	CamelDataWrapper *data_wrapper;
+	CamelIMAPXWrapperPrivate *priv;
+
+	g_return_val_if_fail (CAMEL_IS_IMAPX_FOLDER (folder), NULL);
+	g_return_val_if_fail (uid != NULL, NULL);
+	g_return_val_if_fail (section != NULL, NULL);
+	g_return_val_if_fail (content_type != NULL, NULL);
+
+	data_wrapper = g_object_new (CAMEL_TYPE_IMAPX_WRAPPER, NULL);
+	camel_data_wrapper_set_mime_type_field (data_wrapper, content_type);
+	data_wrapper->offline = TRUE;
+
+	priv = CAMEL_IMAPX_WRAPPER (data_wrapper)->priv;
+	priv->folder = g_object_ref (folder);
+	priv->uid = g_strdup (uid);
+	priv->section = g_strdup (section);
+	priv->encoding = g_strdup (encoding);
+
+	return data_wrapper;
+}
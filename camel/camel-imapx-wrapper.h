@@ -0,0 +1,81 @@
+/*
+ * camel-imapx-wrapper.h
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the program; if not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#if !defined (__CAMEL_H_INSIDE__) && !defined (CAMEL_COMPILATION)
+#error "Only <camel/camel.h> can be included directly."
+#endif
+
+#ifndef CAMEL_IMAPX_WRAPPER_H
+#define CAMEL_IMAPX_WRAPPER_H
+
+#include <camel/camel-data-wrapper.h>
+#include <camel/camel-imapx-folder.h>
+
+/* Standard GObject macros */
+#define CAMEL_TYPE_IMAPX_WRAPPER \
+	(camel_imapx_wrapper_get_type ())
+#define CAMEL_IMAPX_WRAPPER(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST \
+	((obj), CAMEL_TYPE_IMAPX_WRAPPER, CamelIMAPXWrapper))
+#define CAMEL_IMAPX_WRAPPER_CLASS(cls) \
+	(G_TYPE_CHECK_CLASS_CAST \
+	((cls), CAMEL_TYPE_IMAPX_WRAPPER, CamelIMAPXWrapperClass))
+#define CAMEL_IS_IMAPX_WRAPPER(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE \
+	((obj), CAMEL_TYPE_IMAPX_WRAPPER))
+#define CAMEL_IS_IMAPX_WRAPPER_CLASS(cls) \
+	(G_TYPE_CHECK_CLASS_TYPE \
+	((cls), CAMEL_TYPE_IMAPX_WRAPPER))
+#define CAMEL_IMAPX_WRAPPER_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS \
+	((obj), CAMEL_TYPE_IMAPX_WRAPPER, CamelIMAPXWrapperClass))
+
+G_BEGIN_DECLS
+
+typedef struct _CamelIMAPXWrapper CamelIMAPXWrapper;
+typedef struct _CamelIMAPXWrapperClass CamelIMAPXWrapperClass;
+typedef struct _CamelIMAPXWrapperPrivate CamelIMAPXWrapperPrivate;
+
+/**
+ * CamelIMAPXWrapper:
+ *
+ * Contains only private data that should be read and manipulated using the
+ * functions below.
+ *
+ * Since: 3.8
+ **/
+struct _CamelIMAPXWrapper {
+	CamelDataWrapper parent;
+	CamelIMAPXWrapperPrivate *priv;
+};
+
+struct _CamelIMAPXWrapperClass {
+	CamelDataWrapperClass parent_class;
+};
+
+GType		camel_imapx_wrapper_get_type	(void) G_GNUC_CONST;
+CamelDataWrapper *
+		camel_imapx_wrapper_new		(CamelIMAPXFolder *folder,
+						 const gchar *uid,
+						 const gchar *section,
+						 const gchar *encoding,
+						 CamelContentType *content_type);
+
+G_END_DECLS
+
+#endif /* CAMEL_IMAPX_WRAPPER_H */
@@ -41,6 +41,11 @@ struct _CamelMimeFilterCharsetPrivate {
 	iconv_t ic;
 	gchar *from;
 	gchar *to;
+
+	/* converting to UTF-8 from a charset in which 7-bit text
+	 * needs no conversion (and from UTF-8 itself, respectively) */
+	guint ascii_passthrough : 1;
+	guint utf8_passthrough : 1;
 };
 
 G_DEFINE_TYPE (CamelMimeFilterCharset, camel_mime_filter_charset, CAMEL_TYPE_MIME_FILTER)
@@ -64,6 +69,34 @@ mime_filter_charset_finalize (GObject *object)
 	G_OBJECT_CLASS (camel_mime_filter_charset_parent_class)->finalize (object);
 }
 
+/* Returns the number of leading bytes of @in which can be passed on
+ * untouched.  Anything else has to go through iconv. */
+static gsize
+mime_filter_charset_passthrough (CamelMimeFilterCharsetPrivate *priv,
+                                 const gchar *in,
+                                 gsize len)
+{
+	register const guchar *inptr = (const guchar *) in;
+	const guchar *inend = inptr + len;
+	const gchar *end;
+
+	if (priv->utf8_passthrough) {
+		if (g_utf8_validate (in, len, &end))
+			return len;
+
+		return end - in;
+	}
+
+	if (priv->ascii_passthrough) {
+		while (inptr < inend && *inptr < 0x80)
+			inptr++;
+
+		return inptr - (const guchar *) in;
+	}
+
+	return 0;
+}
+
 static void
 mime_filter_charset_complete (CamelMimeFilter *mime_filter,
                               const gchar *in,
@@ -83,6 +116,10 @@ mime_filter_charset_complete (CamelMimeFilter *mime_filter,
 	if (priv->ic == (iconv_t) -1)
 		goto noop;
 
+	/* nothing to convert, hand the input back as is */
+	if (mime_filter_charset_passthrough (priv, in, len) == len)
+		goto noop;
+
 	camel_mime_filter_set_size (mime_filter, len * 5 + 16, FALSE);
 	outbuf = mime_filter->outbuf;
 	outleft = mime_filter->outsize;
@@ -168,12 +205,26 @@ mime_filter_charset_filter (CamelMimeFilter *mime_filter,
 	gsize inleft, outleft, converted = 0;
 	const gchar *inbuf;
 	gchar *outbuf;
+	gsize valid;
 
 	priv = CAMEL_MIME_FILTER_CHARSET_GET_PRIVATE (mime_filter);
 
 	if (priv->ic == (iconv_t) -1)
 		goto noop;
 
+	valid = mime_filter_charset_passthrough (priv, in, len);
+	if (valid == len)
+		goto noop;
+
+	/* A valid UTF-8 buffer cut in the middle of a character; pass
+	 * the complete characters on and keep the tail for next time. */
+	if (priv->utf8_passthrough && valid > 0 &&
+	    g_utf8_get_char_validated (in + valid, len - valid) == (gunichar) -2) {
+		camel_mime_filter_backup (mime_filter, in + valid, len - valid);
+		len = valid;
+		goto noop;
+	}
+
 	camel_mime_filter_set_size (mime_filter, len * 5 + 16, FALSE);
 	outbuf = mime_filter->outbuf + converted;
 	outleft = mime_filter->outsize - converted;
@@ -295,8 +346,17 @@ camel_mime_filter_charset_new (const gchar *from_charset,
 		g_object_unref (new);
 		new = NULL;
 	} else {
+		const gchar *to = camel_iconv_charset_name (to_charset);
+		const gchar *from = camel_iconv_charset_name (from_charset);
+
 		priv->from = g_strdup (from_charset);
 		priv->to = g_strdup (to_charset);
+
+		if (!g_ascii_strcasecmp (to, "UTF-8")) {
+			priv->utf8_passthrough = !g_ascii_strcasecmp (from, "UTF-8");
+			priv->ascii_passthrough =
+				camel_iconv_charset_is_ascii_compatible (from);
+		}
 	}
 
 	return new;
@@ -20,6 +20,8 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
+
 #include "camel-mime-filter-crlf.h"
 
 #define CAMEL_MIME_FILTER_CRLF_GET_PRIVATE(obj) \
@@ -36,6 +38,53 @@ struct _CamelMimeFilterCRLFPrivate {
 
 G_DEFINE_TYPE (CamelMimeFilterCRLF, camel_mime_filter_crlf, CAMEL_TYPE_MIME_FILTER)
 
+/* Checks whether @in is already in the form the filter would produce,
+ * which is the usual case for text that went through the filter once
+ * already.  If so, updates the state as the filter would have. */
+static gboolean
+mime_filter_crlf_is_canonical (CamelMimeFilterCRLFPrivate *priv,
+                               const gchar *in,
+                               gsize len)
+{
+	register const gchar *inptr = in;
+	const gchar *inend = in + len;
+	gboolean do_dots;
+	gboolean saw_cr = priv->saw_cr;
+	gboolean saw_lf = priv->saw_lf;
+
+	do_dots = priv->mode == CAMEL_MIME_FILTER_CRLF_MODE_CRLF_DOTS;
+
+	if (priv->direction == CAMEL_MIME_FILTER_CRLF_ENCODE) {
+		while (inptr < inend) {
+			if (*inptr == '\r') {
+				saw_cr = TRUE;
+			} else if (*inptr == '\n') {
+				if (!saw_cr)
+					return FALSE;
+				saw_lf = TRUE;
+				saw_cr = FALSE;
+			} else {
+				if (do_dots && *inptr == '.' && saw_lf)
+					return FALSE;
+				saw_cr = FALSE;
+				saw_lf = FALSE;
+			}
+			inptr++;
+		}
+	} else {
+		/* nothing to strip, but keep it simple around dots */
+		if (saw_cr || do_dots || memchr (in, '\r', len) != NULL)
+			return FALSE;
+
+		saw_lf = len > 0 ? FALSE : saw_lf;
+	}
+
+	priv->saw_cr = saw_cr;
+	priv->saw_lf = saw_lf;
+
+	return TRUE;
+}
+
 static void
 mime_filter_crlf_filter (CamelMimeFilter *mime_filter,
                          const gchar *in,
@@ -58,6 +107,13 @@ mime_filter_crlf_filter (CamelMimeFilter *mime_filter,
 	inptr = in;
 	inend = in + len;
 
+	if (mime_filter_crlf_is_canonical (priv, in, len)) {
+		*out = (gchar *) in;
+		*outlen = len;
+		*outprespace = prespace;
+		return;
+	}
+
 	if (priv->direction == CAMEL_MIME_FILTER_CRLF_ENCODE) {
 		camel_mime_filter_set_size (mime_filter, 3 * len, FALSE);
 
@@ -41,6 +41,81 @@ struct _CamelMimeFilterPrivate {
 #define PRE_HEAD (64)
 #define BACK_HEAD (64)
 
+/* Filters are usually created for one MIME part and thrown away again,
+ * so rather than have every new filter malloc and grow its own set of
+ * buffers, they are recycled through a small pool of power-of-two sized
+ * buffers.  Free buffers are chained through their first bytes. */
+#define BUFFER_POOL_MIN_SHIFT (10)	/* 1 KiB */
+#define BUFFER_POOL_MAX_SHIFT (20)	/* 1 MiB */
+#define BUFFER_POOL_DEPTH (8)		/* free buffers kept per size */
+
+static GMutex buffer_pool_lock;
+static gchar *buffer_pool[BUFFER_POOL_MAX_SHIFT - BUFFER_POOL_MIN_SHIFT + 1];
+static guint buffer_pool_length[BUFFER_POOL_MAX_SHIFT - BUFFER_POOL_MIN_SHIFT + 1];
+
+/* Allocates at least *size bytes, and sets *size to what was actually
+ * allocated; that is what has to be passed back to buffer_pool_free() */
+static gchar *
+buffer_pool_alloc (gsize *size)
+{
+	gchar *buffer = NULL;
+	gint shift, i;
+
+	for (shift = BUFFER_POOL_MIN_SHIFT; ((gsize) 1 << shift) < *size; shift++) {
+		if (shift == BUFFER_POOL_MAX_SHIFT)
+			return g_malloc (*size);
+	}
+
+	*size = (gsize) 1 << shift;
+	i = shift - BUFFER_POOL_MIN_SHIFT;
+
+	g_mutex_lock (&buffer_pool_lock);
+	if (buffer_pool[i] != NULL) {
+		buffer = buffer_pool[i];
+		buffer_pool[i] = *((gchar **) buffer);
+		buffer_pool_length[i]--;
+	}
+	g_mutex_unlock (&buffer_pool_lock);
+
+	if (buffer == NULL)
+		buffer = g_malloc (*size);
+
+	return buffer;
+}
+
+static void
+buffer_pool_free (gchar *buffer,
+                  gsize size)
+{
+	gint shift, i;
+
+	if (buffer == NULL)
+		return;
+
+	for (shift = BUFFER_POOL_MIN_SHIFT; shift <= BUFFER_POOL_MAX_SHIFT; shift++) {
+		if (((gsize) 1 << shift) == size)
+			break;
+	}
+
+	if (shift > BUFFER_POOL_MAX_SHIFT) {
+		g_free (buffer);
+		return;
+	}
+
+	i = shift - BUFFER_POOL_MIN_SHIFT;
+
+	g_mutex_lock (&buffer_pool_lock);
+	if (buffer_pool_length[i] < BUFFER_POOL_DEPTH) {
+		*((gchar **) buffer) = buffer_pool[i];
+		buffer_pool[i] = buffer;
+		buffer_pool_length[i]++;
+		buffer = NULL;
+	}
+	g_mutex_unlock (&buffer_pool_lock);
+
+	g_free (buffer);
+}
+
 G_DEFINE_ABSTRACT_TYPE (CamelMimeFilter, camel_mime_filter, CAMEL_TYPE_OBJECT)
 
 static void
@@ -50,9 +125,10 @@ mime_filter_finalize (GObject *object)
 
 	mime_filter = CAMEL_MIME_FILTER (object);
 
-	g_free (mime_filter->outreal);
-	g_free (mime_filter->backbuf);
-	g_free (mime_filter->priv->inbuf);
+	if (mime_filter->outreal != NULL)
+		buffer_pool_free (mime_filter->outreal, mime_filter->outsize + PRE_HEAD * 4);
+	buffer_pool_free (mime_filter->backbuf, mime_filter->backsize);
+	buffer_pool_free (mime_filter->priv->inbuf, mime_filter->priv->inlen);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (camel_mime_filter_parent_class)->finalize (object);
@@ -156,9 +232,9 @@ static void filter_run (CamelMimeFilter *f,
 		newlen = len + prespace + f->backlen;
 		if (p->inlen < newlen) {
 			/* NOTE: g_realloc copies data, we dont need that (slower) */
-			g_free (p->inbuf);
-			p->inbuf = g_malloc (newlen + PRE_HEAD);
+			buffer_pool_free (p->inbuf, p->inlen);
 			p->inlen = newlen + PRE_HEAD;
+			p->inbuf = buffer_pool_alloc (&p->inlen);
 		}
 
 		/* copy to end of structure */
@@ -200,6 +276,10 @@ static void filter_run (CamelMimeFilter *f,
  *
  * Passes the input buffer, @in, through @filter and generates an
  * output buffer, @out.
+ *
+ * Filters which leave (part of) their input unchanged may avoid the copy
+ * by pointing @out into @in itself, so @out is only valid until the next
+ * call on @filter, and only as long as @in is.
  **/
 void
 camel_mime_filter_filter (CamelMimeFilter *filter,
@@ -301,9 +381,9 @@ camel_mime_filter_backup (CamelMimeFilter *filter,
 {
 	if (filter->backsize < length) {
 		/* g_realloc copies data, unnecessary overhead */
-		g_free (filter->backbuf);
-		filter->backbuf = g_malloc (length + BACK_HEAD);
+		buffer_pool_free (filter->backbuf, filter->backsize);
 		filter->backsize = length + BACK_HEAD;
+		filter->backbuf = buffer_pool_alloc (&filter->backsize);
 	}
 	filter->backlen = length;
 	memcpy (filter->backbuf, data, length);
@@ -325,15 +405,20 @@ camel_mime_filter_set_size (CamelMimeFilter *filter,
 {
 	if (filter->outsize < size) {
 		gint offset = filter->outptr - filter->outreal;
-		if (keep) {
-			filter->outreal = g_realloc (filter->outreal, size + PRE_HEAD * 4);
-		} else {
-			g_free (filter->outreal);
-			filter->outreal = g_malloc (size + PRE_HEAD * 4);
+		gsize realsize = size + PRE_HEAD * 4;
+		gchar *outreal;
+
+		outreal = buffer_pool_alloc (&realsize);
+		if (filter->outreal != NULL) {
+			if (keep)
+				memcpy (outreal, filter->outreal, filter->outsize + PRE_HEAD * 4);
+			buffer_pool_free (filter->outreal, filter->outsize + PRE_HEAD * 4);
 		}
+
+		filter->outreal = outreal;
 		filter->outptr = filter->outreal + offset;
 		filter->outbuf = filter->outreal + PRE_HEAD * 4;
-		filter->outsize = size;
+		filter->outsize = realsize - PRE_HEAD * 4;
 		/* this could be offset from the end of the structure, but
 		 * this should be good enough */
 		filter->outpre = PRE_HEAD * 4;
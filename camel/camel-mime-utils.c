@@ -920,6 +920,25 @@ camel_iconv_strndup (iconv_t cd,
 
 #define is_ascii(c) isascii ((gint) ((guchar) (c)))
 
+/* checks whether the text can be used as UTF-8 as is, when coming
+ * from @charset, without going through iconv at all */
+static gboolean
+is_passthrough_text (const gchar *text,
+                     gsize len,
+                     const gchar *charset)
+{
+	register const guchar *inptr = (const guchar *) text;
+	const guchar *inend = inptr + len;
+
+	while (inptr < inend && *inptr < 0x80)
+		inptr++;
+
+	if (inptr < inend)
+		return FALSE;
+
+	return camel_iconv_charset_is_ascii_compatible (charset);
+}
+
 static gchar *
 decode_8bit (const gchar *text,
              gsize len,
@@ -1161,6 +1180,10 @@ rfc2047_decode_word (const gchar *in,
 	if (charset[0])
 		charset = camel_iconv_charset_name (charset);
 
+	/* the common 7-bit case, e.g. =?iso-8859-1?q?...?= with no 8bit chars */
+	if (charset[0] && is_passthrough_text ((gchar *) decoded, declen, charset))
+		return g_strndup ((gchar *) decoded, declen);
+
 	if (!charset[0] || (cd = camel_iconv_open ("UTF-8", charset)) == (iconv_t) -1) {
 		w (g_warning (
 			"Cannot convert from %s to UTF-8, "
@@ -2193,6 +2216,9 @@ header_convert (const gchar *to,
 	gsize outlen, ret;
 	gchar *outbuf, *outbase, *result = NULL;
 
+	if (!g_ascii_strcasecmp (to, "UTF-8") && is_passthrough_text (in, inlen, from))
+		return g_strndup (in, inlen);
+
 	ic = camel_iconv_open (to, from);
 	if (ic == (iconv_t) -1)
 		return NULL;
@@ -5051,6 +5077,289 @@ camel_header_address_list_format (struct _camel_header_address *a)
 	return ret;
 }
 
+/* Scans the next word the way header_decode_word() does, without
+ * copying it anywhere.  Returns 1 and the word (the contents, for a
+ * quoted string) on success, 0 if there is no word and -1 for the
+ * constructs address_list_format_fast() leaves to the full parser. */
+static gint
+header_scan_word (const gchar **in,
+                  const gchar **word,
+                  gsize *len)
+{
+	const gchar *inptr, *start;
+
+	header_decode_lwsp (in);
+	inptr = start = *in;
+
+	if (*inptr == '"') {
+		start = ++inptr;
+		while (*inptr && *inptr != '"') {
+			if (*inptr == '\\')
+				return -1;
+			inptr++;
+		}
+
+		if (*inptr != '"')
+			return -1;
+
+		*word = start;
+		*len = inptr - start;
+		*in = inptr + 1;
+
+		return 1;
+	}
+
+	if (inptr[0] == '=' && inptr[1] == '?') {
+		inptr += 2;
+
+		while (*inptr && *inptr != '?')
+			inptr++;
+
+		if (inptr[0] == '?' && inptr[1] && strchr ("BbQq", inptr[1]) && inptr[2] == '?') {
+			inptr += 3;
+
+			while (*inptr && strncmp (inptr, "?=", 2) != 0)
+				inptr++;
+
+			if (*inptr) {
+				*word = start;
+				*len = inptr + 2 - start;
+				*in = inptr + 2;
+
+				return 1;
+			}
+		}
+
+		inptr = start;
+	}
+
+	while (camel_mime_is_atom (*inptr))
+		inptr++;
+
+	if (inptr == start)
+		return 0;
+
+	*word = start;
+	*len = inptr - start;
+	*in = inptr;
+
+	return 1;
+}
+
+static gboolean
+is_plain_ascii_word (const gchar *word,
+                     gsize len)
+{
+	const gchar *inend = word + len;
+
+	while (word < inend) {
+		if (!is_ascii (*word))
+			return FALSE;
+		if (word[0] == '=' && word + 1 < inend && word[1] == '?')
+			return FALSE;
+		word++;
+	}
+
+	return TRUE;
+}
+
+/* Formats a well-formed address list straight into @out, giving the
+ * same text camel_header_address_list_format() would for the decoded
+ * list.  Anything unusual (comments, groups, route addresses, 8bit
+ * addresses and the various broken mailer workarounds) makes it give
+ * up and return -1, otherwise it returns the number of addresses. */
+static gint
+address_list_format_fast (GString *out,
+                          const gchar *in,
+                          const gchar *charset)
+{
+	const gchar *inptr = in, *word, *last;
+	gsize len, lastlen, name_start, addr_start;
+	gboolean closeme;
+	gint count = 0, rv;
+
+	if (strchr (in, '('))
+		return -1;
+
+	while (TRUE) {
+		header_decode_lwsp (&inptr);
+		if (*inptr == '\0')
+			break;
+
+		if (*inptr == ',') {
+			/* empty list element */
+			inptr++;
+			continue;
+		}
+
+		if (count > 0)
+			g_string_append (out, ", ");
+
+		name_start = out->len;
+		closeme = FALSE;
+
+		if ((rv = header_scan_word (&inptr, &word, &len)) == -1)
+			return -1;
+
+		header_decode_lwsp (&inptr);
+		if (*inptr == '.' || *inptr == '@') {
+			/* bare addr-spec */
+			if (rv == 0)
+				return -1;
+			addr_start = name_start;
+		} else if (*inptr == ',' || *inptr == '\0') {
+			/* no domain, or a broken name with no address */
+			return -1;
+		} else {
+			/* display name followed by a route address */
+			last = NULL;
+			lastlen = 0;
+
+			while (rv == 1) {
+				/* dont append ' ' between successive encoded words */
+				if (last != NULL &&
+				    !(lastlen > 6 && last[lastlen - 2] == '?' && last[lastlen - 1] == '=' &&
+				      len > 6 && word[0] == '=' && word[1] == '?'))
+					g_string_append_c (out, ' ');
+
+				if (is_plain_ascii_word (word, len)) {
+					g_string_append_len (out, word, len);
+				} else {
+					gchar *raw, *text;
+
+					raw = g_strndup (word, len);
+					text = camel_header_decode_string (raw, charset);
+					g_string_append (out, text);
+					g_free (text);
+					g_free (raw);
+				}
+
+				last = word;
+				lastlen = len;
+
+				rv = header_scan_word (&inptr, &word, &len);
+			}
+
+			header_decode_lwsp (&inptr);
+			if (rv == -1 || *inptr != '<')
+				return -1;
+
+			if (out->len > name_start)
+				g_string_append (out, " <");
+			addr_start = out->len;
+			closeme = TRUE;
+
+			inptr++;
+			header_decode_lwsp (&inptr);
+			if (*inptr == '@' || header_scan_word (&inptr, &word, &len) != 1)
+				return -1;
+		}
+
+		/* local-part */
+		g_string_append_len (out, word, len);
+		while (*inptr == '.') {
+			inptr++;
+			if (header_scan_word (&inptr, &word, &len) != 1)
+				return -1;
+			g_string_append_c (out, '.');
+			g_string_append_len (out, word, len);
+			header_decode_lwsp (&inptr);
+		}
+
+		if (*inptr != '@')
+			return -1;
+		g_string_append_c (out, '@');
+		inptr++;
+
+		/* domain */
+		while (TRUE) {
+			header_decode_lwsp (&inptr);
+			word = inptr;
+			while (camel_mime_is_atom (*inptr))
+				inptr++;
+			if (inptr == word)
+				return -1;
+			g_string_append_len (out, word, inptr - word);
+
+			header_decode_lwsp (&inptr);
+			if (*inptr != '.')
+				break;
+			g_string_append_c (out, '.');
+			inptr++;
+		}
+
+		/* 8bit or encoded-word addresses get special treatment */
+		if (!is_plain_ascii_word (out->str + addr_start, out->len - addr_start))
+			return -1;
+
+		if (closeme) {
+			if (*inptr != '>')
+				return -1;
+			if (addr_start > name_start)
+				g_string_append_c (out, '>');
+			inptr++;
+		}
+
+		count++;
+
+		header_decode_lwsp (&inptr);
+		if (*inptr == ',')
+			inptr++;
+		else if (*inptr != '\0')
+			return -1;
+	}
+
+	return count;
+}
+
+/**
+ * camel_header_address_list_format_append:
+ * @out: a #GString to append to
+ * @in: an address list header value
+ * @charset: default charset to use if improperly encoded
+ *
+ * Appends the display form of the address list in @in to @out.  The
+ * result is the same as formatting the list returned by
+ * camel_header_address_decode() with camel_header_address_list_format(),
+ * but well-formed lists are formatted in a single pass without building
+ * the #camel_header_address tree.
+ *
+ * Returns: %TRUE if @in contained any address, %FALSE otherwise, in
+ * which case @out is left untouched
+ *
+ * Since: 3.8
+ **/
+gboolean
+camel_header_address_list_format_append (GString *out,
+                                         const gchar *in,
+                                         const gchar *charset)
+{
+	struct _camel_header_address *addr;
+	gsize start;
+	gchar *str;
+
+	g_return_val_if_fail (out != NULL, FALSE);
+
+	if (in == NULL)
+		return FALSE;
+
+	start = out->len;
+	if (address_list_format_fast (out, in, charset) > 0)
+		return TRUE;
+
+	g_string_truncate (out, start);
+
+	if (!(addr = camel_header_address_decode (in, charset)))
+		return FALSE;
+
+	str = camel_header_address_list_format (addr);
+	camel_header_address_list_clear (&addr);
+	g_string_append (out, str);
+	g_free (str);
+
+	return TRUE;
+}
+
 gchar *
 camel_header_address_fold (const gchar *in,
                            gsize headerlen)
@@ -127,6 +127,7 @@ struct _camel_header_address *camel_header_mailbox_decode (const gchar *in, cons
 gchar *camel_header_address_list_encode (struct _camel_header_address *addrlist);
 /* for display */
 gchar *camel_header_address_list_format (struct _camel_header_address *addrlist);
+gboolean camel_header_address_list_format_append (GString *out, const gchar *in, const gchar *charset);
 
 /* structured header prameters */
 struct _camel_header_param *camel_header_param_list_decode (const gchar *in);
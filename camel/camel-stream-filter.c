@@ -181,7 +181,7 @@ stream_filter_write (CamelStream *stream,
 	CamelStreamFilterPrivate *priv;
 	struct _filter *f;
 	gsize presize, len, left = n;
-	gchar *buffer, realbuffer[READ_SIZE + READ_PAD];
+	gchar *buffer;
 
 	priv = CAMEL_STREAM_FILTER_GET_PRIVATE (stream);
 
@@ -194,15 +194,16 @@ stream_filter_write (CamelStream *stream,
 	g_check (priv->realbuffer);
 
 	while (left) {
-		/* Sigh, since filters expect non const args, copy the input first, we do this in handy sized chunks */
+		/* Filters never modify their input, so hand them the
+		 * caller's buffer directly, in handy sized chunks.  There
+		 * is no prespace in front of it, of course. */
 		len = MIN (READ_SIZE, left);
-		buffer = realbuffer + READ_PAD;
-		memcpy (buffer, buf, len);
+		buffer = (gchar *) buf;
 		buf += len;
 		left -= len;
 
 		f = priv->filters;
-		presize = READ_PAD;
+		presize = 0;
 		while (f) {
 			camel_mime_filter_filter (f->filter, buffer, len, presize, &buffer, &len, &presize);
 
@@ -154,6 +154,7 @@
 #include <camel/camel-imapx-summary.h>
 #include <camel/camel-imapx-settings.h>
 #include <camel/camel-imapx-utils.h>
+#include <camel/camel-imapx-wrapper.h>
 
 #undef __CAMEL_H_INSIDE__
 
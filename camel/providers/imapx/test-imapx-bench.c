@@ -0,0 +1,344 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* IMAPX benchmark against the local test server.
+ *
+ * Connects a CamelIMAPXStore to a synthetic INBOX and times the
+ * initial refresh, a server-side search, fetching messages, syncing
+ * flag changes and refreshing again after reconnecting, reporting
+ * wall time, round trips and bytes for each.  Also serves as an
+ * offline smoke test: it fails if any step fails or returns the
+ * wrong number of messages.
+ *
+ * CAMEL_BENCH_MESSAGES	 mailbox size (default 1000)
+ * CAMEL_BENCH_SIZE	 message size in bytes (default 4096)
+ * CAMEL_BENCH_FETCH	 messages to fetch (default 100)
+ * CAMEL_BENCH_LATENCY	 latency per command in ms (default 0)
+ * CAMEL_BENCH_BANDWIDTH bytes per second per connection (default 0,
+ *			 unlimited)
+ * CAMEL_BENCH_CAPS	 comma-separated subset of
+ *			 idle,condstore,qresync,uidplus,literal+
+ *			 (default all of them) */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gmodule.h>
+#include <camel/camel.h>
+
+#include "test-imapx-server.h"
+
+#define DEFAULT_MESSAGES (1000)
+#define DEFAULT_SIZE (4096)
+#define DEFAULT_FETCH (100)
+
+typedef CamelSession BenchSession;
+typedef CamelSessionClass BenchSessionClass;
+
+GType bench_session_get_type (void);
+
+G_DEFINE_TYPE (BenchSession, bench_session, CAMEL_TYPE_SESSION)
+
+/* The password is set up front, so one attempt is all there is. */
+static gboolean
+bench_session_authenticate_sync (CamelSession *session,
+                                 CamelService *service,
+                                 const gchar *mechanism,
+                                 GCancellable *cancellable,
+                                 GError **error)
+{
+	CamelAuthenticationResult result;
+
+	result = camel_service_authenticate_sync (
+		service, mechanism, cancellable, error);
+
+	return (result == CAMEL_AUTHENTICATION_ACCEPTED);
+}
+
+static void
+bench_session_class_init (BenchSessionClass *class)
+{
+	class->authenticate_sync = bench_session_authenticate_sync;
+}
+
+static void
+bench_session_init (BenchSession *session)
+{
+}
+
+typedef struct {
+	TestIMAPXServer *server;
+	gint64 start;
+} Phase;
+
+static void
+phase_start (Phase *phase)
+{
+	test_imapx_server_reset_stats (phase->server);
+	phase->start = g_get_monotonic_time ();
+}
+
+static void
+phase_end (Phase *phase,
+           const gchar *what,
+           guint n_items)
+{
+	TestIMAPXServerStats stats;
+	gdouble secs;
+
+	secs = MAX (g_get_monotonic_time () - phase->start, 1) /
+		(gdouble) G_USEC_PER_SEC;
+
+	test_imapx_server_get_stats (phase->server, &stats);
+
+	printf (
+		"%-12s %7u items %8.3f s %7u round trips %10.1f KB in %10.1f KB out\n",
+		what, n_items, secs, stats.n_commands,
+		stats.bytes_in / 1024.0, stats.bytes_out / 1024.0);
+}
+
+static TestIMAPXServerCaps
+parse_caps (const gchar *value)
+{
+	TestIMAPXServerCaps caps = 0;
+	gchar **names;
+	gint ii;
+
+	if (value == NULL)
+		return TEST_IMAPX_SERVER_ALL_CAPS;
+
+	names = g_strsplit (value, ",", -1);
+	for (ii = 0; names[ii] != NULL; ii++) {
+		const gchar *name = g_strstrip (names[ii]);
+
+		if (g_ascii_strcasecmp (name, "idle") == 0)
+			caps |= TEST_IMAPX_SERVER_IDLE;
+		else if (g_ascii_strcasecmp (name, "condstore") == 0)
+			caps |= TEST_IMAPX_SERVER_CONDSTORE;
+		else if (g_ascii_strcasecmp (name, "qresync") == 0)
+			caps |= TEST_IMAPX_SERVER_QRESYNC | TEST_IMAPX_SERVER_CONDSTORE;
+		else if (g_ascii_strcasecmp (name, "uidplus") == 0)
+			caps |= TEST_IMAPX_SERVER_UIDPLUS;
+		else if (g_ascii_strcasecmp (name, "literal+") == 0)
+			caps |= TEST_IMAPX_SERVER_LITERALPLUS;
+		else if (*name != '\0')
+			g_printerr ("Ignoring unknown capability '%s'\n", name);
+	}
+	g_strfreev (names);
+
+	return caps;
+}
+
+static guint
+env_uint (const gchar *name,
+          guint default_value)
+{
+	const gchar *value = g_getenv (name);
+
+	return value != NULL ? strtoul (value, NULL, 10) : default_value;
+}
+
+static gboolean
+load_provider (GError **error)
+{
+	CamelProvider *provider;
+
+	camel_provider_init ();
+
+	provider = camel_provider_get ("imapx", NULL);
+	if (provider != NULL)
+		return TRUE;
+
+	/* Not installed yet; use the one built next to us */
+	return camel_provider_load (
+		IMAPX_BUILDDIR "/.libs/libcamelimapx." G_MODULE_SUFFIX, error);
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+	TestIMAPXServer *server;
+	TestIMAPXServerCaps caps;
+	CamelSession *session = NULL;
+	CamelService *service = NULL;
+	CamelSettings *settings;
+	CamelFolder *folder = NULL;
+	GPtrArray *uids = NULL, *matches;
+	Phase phase;
+	guint n_messages, message_size, n_fetch, ii;
+	gchar *data_dir;
+	GError *error = NULL;
+	gint status = 1;
+
+	n_messages = env_uint ("CAMEL_BENCH_MESSAGES", DEFAULT_MESSAGES);
+	message_size = env_uint ("CAMEL_BENCH_SIZE", DEFAULT_SIZE);
+	n_fetch = MIN (env_uint ("CAMEL_BENCH_FETCH", DEFAULT_FETCH), n_messages);
+	caps = parse_caps (g_getenv ("CAMEL_BENCH_CAPS"));
+
+	data_dir = g_dir_make_tmp ("test-imapx-bench-XXXXXX", &error);
+	if (data_dir == NULL)
+		goto exit;
+
+	camel_init (data_dir, FALSE);
+
+	if (!load_provider (&error))
+		goto exit;
+
+	server = test_imapx_server_new (n_messages, message_size, caps, &error);
+	if (server == NULL)
+		goto exit;
+
+	test_imapx_server_set_latency (
+		server, env_uint ("CAMEL_BENCH_LATENCY", 0));
+	test_imapx_server_set_bandwidth (
+		server, env_uint ("CAMEL_BENCH_BANDWIDTH", 0));
+
+	phase.server = server;
+
+	session = g_object_new (
+		bench_session_get_type (),
+		"user-data-dir", data_dir,
+		"user-cache-dir", data_dir, NULL);
+	camel_session_set_online (session, TRUE);
+
+	service = camel_session_add_service (
+		session, "bench", "imapx", CAMEL_PROVIDER_STORE, &error);
+	if (service == NULL)
+		goto exit_server;
+
+	settings = camel_service_ref_settings (service);
+	g_object_set (
+		settings,
+		"host", "127.0.0.1",
+		"port", (guint) test_imapx_server_get_port (server),
+		"user", "bench",
+		"security-method", CAMEL_NETWORK_SECURITY_METHOD_NONE,
+		"use-idle", (caps & TEST_IMAPX_SERVER_IDLE) != 0,
+		"use-qresync", (caps & TEST_IMAPX_SERVER_QRESYNC) != 0,
+		NULL);
+	g_object_unref (settings);
+
+	camel_service_set_password (service, "bench");
+
+	printf (
+		"%u messages of %u bytes, %u ms latency, %u bytes/s\n",
+		n_messages, message_size,
+		env_uint ("CAMEL_BENCH_LATENCY", 0),
+		env_uint ("CAMEL_BENCH_BANDWIDTH", 0));
+
+	phase_start (&phase);
+	if (!camel_service_connect_sync (service, NULL, &error))
+		goto exit_server;
+	phase_end (&phase, "connect", 0);
+
+	phase_start (&phase);
+	folder = camel_store_get_folder_sync (
+		CAMEL_STORE (service), "INBOX", 0, NULL, &error);
+	if (folder == NULL ||
+	    !camel_folder_refresh_info_sync (folder, NULL, &error))
+		goto exit_server;
+	phase_end (&phase, "refresh", camel_folder_get_message_count (folder));
+
+	if (camel_folder_get_message_count (folder) != n_messages) {
+		g_printerr (
+			"Refresh got %d messages, expected %u\n",
+			camel_folder_get_message_count (folder), n_messages);
+		goto exit_server;
+	}
+
+	/* The test server matches every message */
+	phase_start (&phase);
+	matches = camel_folder_search_by_expression (
+		folder, "(match-all (body-contains \"padding\"))",
+		NULL, &error);
+	if (matches == NULL && error != NULL)
+		goto exit_server;
+	phase_end (&phase, "search", matches != NULL ? matches->len : 0);
+	if (matches != NULL)
+		camel_folder_search_free (folder, matches);
+
+	uids = camel_folder_get_uids (folder);
+
+	phase_start (&phase);
+	for (ii = 0; ii < n_fetch && ii < uids->len; ii++) {
+		CamelMimeMessage *message;
+
+		message = camel_folder_get_message_sync (
+			folder, uids->pdata[ii], NULL, &error);
+		if (message == NULL)
+			goto exit_server;
+		g_object_unref (message);
+	}
+	phase_end (&phase, "get_message", n_fetch);
+
+	phase_start (&phase);
+	for (ii = 0; ii < uids->len; ii++)
+		camel_folder_set_message_flags (
+			folder, uids->pdata[ii],
+			CAMEL_MESSAGE_FLAGGED, CAMEL_MESSAGE_FLAGGED);
+	if (!camel_folder_synchronize_sync (folder, FALSE, NULL, &error))
+		goto exit_server;
+	phase_end (&phase, "sync", uids->len);
+
+	/* Nothing changed on the server, so with QRESYNC this should
+	 * be a SELECT and a NOOP, sent together, and nothing else. */
+	if (!camel_service_disconnect_sync (service, TRUE, NULL, &error) ||
+	    !camel_service_connect_sync (service, NULL, &error))
+		goto exit_server;
+
+	phase_start (&phase);
+	if (!camel_folder_refresh_info_sync (folder, NULL, &error))
+		goto exit_server;
+	phase_end (&phase, "reopen", camel_folder_get_message_count (folder));
+
+	phase_start (&phase);
+	if (!camel_service_disconnect_sync (service, TRUE, NULL, &error))
+		goto exit_server;
+	phase_end (&phase, "disconnect", 0);
+
+	status = 0;
+
+exit_server:
+	if (uids != NULL)
+		camel_folder_free_uids (folder, uids);
+	if (folder != NULL)
+		g_object_unref (folder);
+	if (service != NULL) {
+		camel_service_disconnect_sync (service, FALSE, NULL, NULL);
+		g_object_unref (service);
+	}
+	if (session != NULL)
+		g_object_unref (session);
+
+	test_imapx_server_free (server);
+
+exit:
+	if (error != NULL) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+	}
+
+	g_free (data_dir);
+
+	return status;
+}
@@ -0,0 +1,1075 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "test-imapx-server.h"
+
+/* Responses are collected and written out in one go, which keeps
+ * Nagle's algorithm from stalling the client on small writes. */
+#define FLUSH_THRESHOLD (65536)
+
+#define UIDVALIDITY (1)
+#define INTERNALDATE "01-Jan-2013 00:00:00 +0000"
+
+typedef struct _TestClient TestClient;
+
+struct _TestIMAPXServer {
+	GSocketListener *listener;
+	GCancellable *cancellable;
+	GThread *accept_thread;
+	guint16 port;
+
+	TestIMAPXServerCaps caps;
+	gsize message_size;
+
+	/* APPEND adds messages, so this is updated atomically */
+	volatile gint n_messages;
+	volatile gint latency_ms;
+	volatile gint bandwidth;
+
+	GMutex lock;
+	GHashTable *script;
+	GSList *clients;
+	TestIMAPXServerStats stats;
+};
+
+struct _TestClient {
+	TestIMAPXServer *server;
+	GSocketConnection *connection;
+	GDataInputStream *input;
+	GOutputStream *output;
+	GThread *thread;
+	GString *out;
+};
+
+static gchar *
+test_server_dup_capabilities (TestIMAPXServer *server)
+{
+	GString *capa;
+
+	capa = g_string_new ("IMAP4rev1 NAMESPACE");
+
+	if (server->caps & TEST_IMAPX_SERVER_LITERALPLUS)
+		g_string_append (capa, " LITERAL+");
+	if (server->caps & TEST_IMAPX_SERVER_IDLE)
+		g_string_append (capa, " IDLE");
+	if (server->caps & TEST_IMAPX_SERVER_UIDPLUS)
+		g_string_append (capa, " UIDPLUS");
+	if (server->caps & TEST_IMAPX_SERVER_CONDSTORE)
+		g_string_append (capa, " CONDSTORE");
+	if (server->caps & TEST_IMAPX_SERVER_QRESYNC)
+		g_string_append (capa, " ENABLE QRESYNC");
+
+	return g_string_free (capa, FALSE);
+}
+
+/* Messages are generated from their UID on demand, so mailboxes of
+ * any size cost nothing until their messages are fetched. */
+static GString *
+test_server_message_header (guint uid)
+{
+	GString *header;
+
+	header = g_string_sized_new (512);
+	g_string_append_printf (
+		header,
+		"From: Sender %u <sender%u@example.com>\r\n"
+		"To: Bench <bench@example.com>\r\n"
+		"Subject: Synthetic message %u\r\n"
+		"Date: Tue, 1 Jan 2013 00:00:00 +0000\r\n"
+		"Message-ID: <%u.bench@example.com>\r\n"
+		"MIME-Version: 1.0\r\n"
+		"Content-Type: text/plain; charset=us-ascii\r\n"
+		"\r\n",
+		uid % 97, uid % 97, uid, uid);
+
+	return header;
+}
+
+static gsize
+test_server_message_size (TestIMAPXServer *server,
+                          gsize header_len)
+{
+	return MAX (server->message_size, header_len);
+}
+
+static GString *
+test_server_message (TestIMAPXServer *server,
+                     guint uid)
+{
+	GString *message;
+	gsize size;
+
+	message = test_server_message_header (uid);
+	size = test_server_message_size (server, message->len);
+
+	while (message->len < size)
+		g_string_append_printf (
+			message,
+			"Line %08u of message %08u, padding it out to size.\r\n",
+			(guint) message->len, uid);
+
+	g_string_truncate (message, size);
+
+	return message;
+}
+
+static gboolean
+test_server_is_seen (guint uid)
+{
+	return (uid % 2) == 1;
+}
+
+static void
+test_server_add_bytes (TestIMAPXServer *server,
+                       gsize bytes_in,
+                       gsize bytes_out)
+{
+	g_mutex_lock (&server->lock);
+	server->stats.bytes_in += bytes_in;
+	server->stats.bytes_out += bytes_out;
+	g_mutex_unlock (&server->lock);
+}
+
+static gboolean
+test_client_flush (TestClient *client)
+{
+	TestIMAPXServer *server = client->server;
+	const gchar *data = client->out->str;
+	gsize len = client->out->len;
+	gint bandwidth;
+	gboolean success = TRUE;
+
+	bandwidth = g_atomic_int_get (&server->bandwidth);
+
+	while (len > 0) {
+		gsize chunk = len;
+
+		/* Throttle in slices of about 10ms */
+		if (bandwidth > 0)
+			chunk = MIN (len, MAX (bandwidth / 100, 512));
+
+		success = g_output_stream_write_all (
+			client->output, data, chunk, NULL, NULL, NULL);
+		if (!success)
+			break;
+
+		test_server_add_bytes (server, 0, chunk);
+
+		if (bandwidth > 0)
+			g_usleep ((guint64) chunk * G_USEC_PER_SEC / bandwidth);
+
+		data += chunk;
+		len -= chunk;
+	}
+
+	g_string_truncate (client->out, 0);
+
+	return success;
+}
+
+static void
+test_client_wait (TestClient *client)
+{
+	gint latency_ms;
+
+	latency_ms = g_atomic_int_get (&client->server->latency_ms);
+	if (latency_ms > 0)
+		g_usleep (latency_ms * 1000);
+}
+
+static gchar *
+test_client_read_line (TestClient *client)
+{
+	gchar *line;
+	gsize len = 0;
+
+	line = g_data_input_stream_read_line (
+		client->input, &len, NULL, NULL);
+	if (line != NULL)
+		test_server_add_bytes (client->server, len + 2, 0);
+
+	return line;
+}
+
+/* Reads a whole command, including any literals in it. */
+static GString *
+test_client_read_command (TestClient *client)
+{
+	GString *command;
+	gchar *line;
+
+	line = test_client_read_line (client);
+	if (line == NULL)
+		return NULL;
+
+	command = g_string_new (NULL);
+
+	while (line != NULL) {
+		gsize len = strlen (line);
+		gboolean plus = FALSE;
+		gchar *start, *buffer;
+		guint64 size;
+		gsize n_read = 0;
+
+		g_string_append (command, line);
+
+		if (len < 3 || line[len - 1] != '}') {
+			g_free (line);
+			break;
+		}
+
+		start = strrchr (line, '{');
+		if (start == NULL) {
+			g_free (line);
+			break;
+		}
+
+		size = g_ascii_strtoull (start + 1, NULL, 10);
+		plus = (line[len - 2] == '+');
+		g_free (line);
+
+		if (!plus) {
+			g_string_append (client->out, "+ Ready for literal data\r\n");
+			if (!test_client_flush (client))
+				goto fail;
+		}
+
+		buffer = g_malloc (size + 1);
+		if (!g_input_stream_read_all (
+			G_INPUT_STREAM (client->input),
+			buffer, size, &n_read, NULL, NULL) || n_read != size) {
+			g_free (buffer);
+			goto fail;
+		}
+		buffer[size] = '\0';
+		test_server_add_bytes (client->server, size, 0);
+
+		g_string_append_len (command, buffer, size);
+		g_free (buffer);
+
+		line = test_client_read_line (client);
+		if (line == NULL)
+			goto fail;
+	}
+
+	return command;
+
+fail:
+	g_string_free (command, TRUE);
+
+	return NULL;
+}
+
+static gchar *
+test_client_next_word (gchar **pp)
+{
+	gchar *p = *pp, *start;
+
+	while (*p == ' ')
+		p++;
+
+	start = p;
+	while (*p != '\0' && *p != ' ')
+		p++;
+
+	*pp = p;
+
+	return g_strndup (start, p - start);
+}
+
+/* Parses a sequence set such as 1:5,7,9:* into ranges, clamped to
+ * the messages that exist.  As UIDs are 1..n in this mailbox, UIDs
+ * and sequence numbers are the same thing. */
+static GArray *
+test_client_parse_set (const gchar *set,
+                       guint n_messages)
+{
+	GArray *ranges;
+	gchar **parts;
+	gint ii;
+
+	ranges = g_array_new (FALSE, FALSE, sizeof (guint));
+	parts = g_strsplit (set, ",", -1);
+
+	for (ii = 0; parts[ii] != NULL; ii++) {
+		gchar *colon;
+		guint first, last;
+
+		colon = strchr (parts[ii], ':');
+		if (colon != NULL)
+			*colon++ = '\0';
+
+		first = (*parts[ii] == '*') ?
+			n_messages : strtoul (parts[ii], NULL, 10);
+		if (colon != NULL)
+			last = (*colon == '*') ?
+				n_messages : strtoul (colon, NULL, 10);
+		else
+			last = first;
+
+		if (first > last) {
+			guint tmp = first;
+			first = last;
+			last = tmp;
+		}
+
+		first = MAX (first, 1);
+		last = MIN (last, n_messages);
+		if (first > last)
+			continue;
+
+		g_array_append_val (ranges, first);
+		g_array_append_val (ranges, last);
+	}
+
+	g_strfreev (parts);
+
+	return ranges;
+}
+
+/* Splits a parenthesized FETCH item list at the top level. */
+static GPtrArray *
+test_client_parse_items (const gchar *p)
+{
+	GPtrArray *items;
+	const gchar *start;
+	gint depth = 0;
+
+	items = g_ptr_array_new_with_free_func (g_free);
+
+	while (*p == ' ')
+		p++;
+
+	if (*p == '(')
+		p++;
+
+	start = p;
+	for (; *p != '\0'; p++) {
+		if (*p == '[' || *p == '(') {
+			depth++;
+		} else if (*p == ']' || (*p == ')' && depth > 0)) {
+			depth--;
+		} else if (depth == 0 && (*p == ' ' || *p == ')')) {
+			if (p > start)
+				g_ptr_array_add (items, g_strndup (start, p - start));
+			if (*p == ')')
+				break;
+			start = p + 1;
+		}
+	}
+
+	if (*p == '\0' && p > start)
+		g_ptr_array_add (items, g_strndup (start, p - start));
+
+	return items;
+}
+
+static void
+test_client_append_literal (TestClient *client,
+                            const gchar *data,
+                            gsize len)
+{
+	g_string_append_printf (client->out, "{%" G_GSIZE_FORMAT "}\r\n", len);
+	g_string_append_len (client->out, data, len);
+}
+
+/* BODY[section]<partial> and BINARY[section]<partial> */
+static void
+test_client_append_section (TestClient *client,
+                            guint uid,
+                            const gchar *item)
+{
+	const gchar *open, *close, *partial;
+	GString *message, *header;
+	gchar *name, *section;
+	gsize header_len, offset = 0, len;
+	const gchar *data;
+
+	open = strchr (item, '[');
+	close = strrchr (item, ']');
+	if (open == NULL || close == NULL || close < open)
+		return;
+
+	name = g_strndup (item, open - item);
+	if (g_str_has_suffix (name, ".PEEK") || g_str_has_suffix (name, ".peek"))
+		name[strlen (name) - 5] = '\0';
+	section = g_strndup (open + 1, close - open - 1);
+
+	message = test_server_message (client->server, uid);
+	header = test_server_message_header (uid);
+	header_len = header->len;
+	g_string_free (header, TRUE);
+	data = message->str;
+	len = message->len;
+
+	if (g_ascii_strncasecmp (section, "HEADER", 6) == 0) {
+		len = header_len;
+	} else if (g_ascii_strcasecmp (section, "TEXT") == 0 ||
+		   g_ascii_strcasecmp (section, "1") == 0) {
+		data += header_len;
+		len -= header_len;
+	} else if (g_ascii_strcasecmp (section, "1.MIME") == 0) {
+		data = "Content-Type: text/plain; charset=us-ascii\r\n\r\n";
+		len = strlen (data);
+	} else if (*section != '\0') {
+		len = 0;
+	}
+
+	g_string_append_printf (client->out, " %s[%s]", name, section);
+
+	partial = close + 1;
+	if (*partial == '<') {
+		gsize limit;
+
+		offset = strtoul (partial + 1, NULL, 10);
+		limit = strchr (partial, '.') ?
+			strtoul (strchr (partial, '.') + 1, NULL, 10) : len;
+
+		offset = MIN (offset, len);
+		data += offset;
+		len = MIN (len - offset, limit);
+
+		g_string_append_printf (
+			client->out, "<%" G_GSIZE_FORMAT ">", offset);
+	}
+
+	g_string_append_c (client->out, ' ');
+	test_client_append_literal (client, data, len);
+
+	g_string_free (message, TRUE);
+	g_free (section);
+	g_free (name);
+}
+
+static void
+test_client_append_fetch (TestClient *client,
+                          guint uid,
+                          GPtrArray *items,
+                          gboolean with_uid,
+                          gboolean with_modseq)
+{
+	TestIMAPXServer *server = client->server;
+	GString *header;
+	gsize size;
+	guint ii;
+
+	header = test_server_message_header (uid);
+	size = test_server_message_size (server, header->len);
+
+	g_string_append_printf (client->out, "* %u FETCH (", uid);
+
+	/* UID goes first so the client knows which message
+	 * the following data is for before it arrives. */
+	if (with_uid)
+		g_string_append_printf (client->out, "UID %u", uid);
+
+	for (ii = 0; ii < items->len; ii++) {
+		const gchar *item = items->pdata[ii];
+
+		if (g_ascii_strcasecmp (item, "UID") == 0) {
+			if (!with_uid)
+				g_string_append_printf (client->out, " UID %u", uid);
+		} else if (g_ascii_strcasecmp (item, "FLAGS") == 0) {
+			g_string_append_printf (
+				client->out, " FLAGS (%s)",
+				test_server_is_seen (uid) ? "\\Seen" : "");
+		} else if (g_ascii_strcasecmp (item, "RFC822.SIZE") == 0) {
+			g_string_append_printf (
+				client->out, " RFC822.SIZE %" G_GSIZE_FORMAT, size);
+		} else if (g_ascii_strcasecmp (item, "INTERNALDATE") == 0) {
+			g_string_append (
+				client->out, " INTERNALDATE \"" INTERNALDATE "\"");
+		} else if (g_ascii_strcasecmp (item, "MODSEQ") == 0) {
+			with_modseq = TRUE;
+		} else if (g_ascii_strcasecmp (item, "BODYSTRUCTURE") == 0 ||
+			   g_ascii_strcasecmp (item, "BODY") == 0) {
+			g_string_append_printf (
+				client->out,
+				" %s (\"TEXT\" \"PLAIN\" (\"CHARSET\" \"us-ascii\") "
+				"NIL NIL \"7BIT\" %" G_GSIZE_FORMAT " %" G_GSIZE_FORMAT
+				" NIL NIL NIL NIL)",
+				g_ascii_strcasecmp (item, "BODY") == 0 ?
+					"BODY" : "BODYSTRUCTURE",
+				size - header->len,
+				(size - header->len) / 54);
+		} else if (g_ascii_strcasecmp (item, "RFC822.HEADER") == 0) {
+			g_string_append (client->out, " RFC822.HEADER ");
+			test_client_append_literal (
+				client, header->str, header->len);
+		} else if (strchr (item, '[') != NULL) {
+			test_client_append_section (client, uid, item);
+		}
+	}
+
+	if (with_modseq && (server->caps & TEST_IMAPX_SERVER_CONDSTORE))
+		g_string_append_printf (client->out, " MODSEQ (%u)", uid);
+
+	g_string_append (client->out, ")\r\n");
+
+	g_string_free (header, TRUE);
+}
+
+static void
+test_client_fetch (TestClient *client,
+                   gchar *args,
+                   gboolean by_uid)
+{
+	GArray *ranges;
+	GPtrArray *items;
+	gchar *set;
+	gboolean with_modseq;
+	guint ii, n_messages;
+
+	n_messages = g_atomic_int_get (&client->server->n_messages);
+
+	set = test_client_next_word (&args);
+	ranges = test_client_parse_set (set, n_messages);
+	items = test_client_parse_items (args);
+	with_modseq = (strstr (args, "CHANGEDSINCE") != NULL);
+
+	for (ii = 0; ii + 1 < ranges->len; ii += 2) {
+		guint uid, last;
+
+		uid = g_array_index (ranges, guint, ii);
+		last = g_array_index (ranges, guint, ii + 1);
+
+		for (; uid <= last; uid++) {
+			test_client_append_fetch (
+				client, uid, items, by_uid, with_modseq);
+
+			if (client->out->len > FLUSH_THRESHOLD &&
+			    !test_client_flush (client))
+				break;
+		}
+	}
+
+	g_ptr_array_unref (items);
+	g_array_unref (ranges);
+	g_free (set);
+}
+
+static void
+test_client_select (TestClient *client,
+                    const gchar *tag,
+                    const gchar *args)
+{
+	TestIMAPXServer *server = client->server;
+	guint n_messages;
+
+	while (*args == ' ')
+		args++;
+
+	if (g_ascii_strncasecmp (args, "INBOX", 5) != 0 &&
+	    g_ascii_strncasecmp (args, "\"INBOX\"", 7) != 0) {
+		g_string_append_printf (
+			client->out, "%s NO Mailbox does not exist\r\n", tag);
+		return;
+	}
+
+	n_messages = g_atomic_int_get (&server->n_messages);
+
+	g_string_append_printf (
+		client->out,
+		"* FLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft)\r\n"
+		"* OK [PERMANENTFLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft \\*)] Flags permitted\r\n"
+		"* %u EXISTS\r\n"
+		"* 0 RECENT\r\n"
+		"* OK [UIDVALIDITY %u] UIDs valid\r\n"
+		"* OK [UIDNEXT %u] Predicted next UID\r\n",
+		n_messages, UIDVALIDITY, n_messages + 1);
+
+	if (server->caps & TEST_IMAPX_SERVER_CONDSTORE)
+		g_string_append_printf (
+			client->out,
+			"* OK [HIGHESTMODSEQ %u] Highest\r\n",
+			MAX (n_messages, 1));
+
+	g_string_append_printf (
+		client->out, "%s OK [READ-WRITE] Select completed\r\n", tag);
+}
+
+static void
+test_client_status (TestClient *client,
+                    const gchar *tag)
+{
+	TestIMAPXServer *server = client->server;
+	guint n_messages;
+
+	n_messages = g_atomic_int_get (&server->n_messages);
+
+	g_string_append_printf (
+		client->out,
+		"* STATUS INBOX (MESSAGES %u UNSEEN %u UIDVALIDITY %u UIDNEXT %u",
+		n_messages, n_messages / 2, UIDVALIDITY, n_messages + 1);
+
+	if (server->caps & TEST_IMAPX_SERVER_CONDSTORE)
+		g_string_append_printf (
+			client->out, " HIGHESTMODSEQ %u", MAX (n_messages, 1));
+
+	g_string_append_printf (
+		client->out, ")\r\n%s OK Status completed\r\n", tag);
+}
+
+static void
+test_client_list (TestClient *client,
+                  const gchar *tag,
+                  const gchar *command,
+                  const gchar *args)
+{
+	/* LIST "" "" asks for the hierarchy separator */
+	if (strstr (args, "\"\" \"\"") != NULL)
+		g_string_append_printf (
+			client->out, "* %s (\\Noselect) \"/\" \"\"\r\n", command);
+	else
+		g_string_append_printf (
+			client->out, "* %s (\\HasNoChildren) \"/\" INBOX\r\n", command);
+
+	g_string_append_printf (client->out, "%s OK %s completed\r\n", tag, command);
+}
+
+static void
+test_client_search (TestClient *client,
+                    const gchar *tag)
+{
+	guint n_messages, uid;
+
+	/* Every message matches, good enough to measure the cost */
+	n_messages = g_atomic_int_get (&client->server->n_messages);
+
+	g_string_append (client->out, "* SEARCH");
+	for (uid = 1; uid <= n_messages; uid++)
+		g_string_append_printf (client->out, " %u", uid);
+	g_string_append_printf (
+		client->out, "\r\n%s OK Search completed\r\n", tag);
+}
+
+static gboolean
+test_client_idle (TestClient *client,
+                  const gchar *tag)
+{
+	gchar *line;
+
+	g_string_append (client->out, "+ idling\r\n");
+	if (!test_client_flush (client))
+		return FALSE;
+
+	while ((line = test_client_read_line (client)) != NULL) {
+		gboolean done;
+
+		done = (g_ascii_strcasecmp (line, "DONE") == 0);
+		g_free (line);
+
+		if (done)
+			break;
+	}
+
+	if (line == NULL)
+		return FALSE;
+
+	test_client_wait (client);
+
+	g_string_append_printf (client->out, "%s OK Idle completed\r\n", tag);
+
+	return TRUE;
+}
+
+static void
+test_client_scripted (TestClient *client,
+                      const gchar *tag,
+                      const gchar *response)
+{
+	gchar **parts;
+	gint ii;
+
+	parts = g_strsplit (response, "$TAG", -1);
+	for (ii = 0; parts[ii] != NULL; ii++) {
+		if (ii > 0)
+			g_string_append (client->out, tag);
+		g_string_append (client->out, parts[ii]);
+	}
+	g_strfreev (parts);
+}
+
+/* Returns FALSE once the connection should be closed. */
+static gboolean
+test_client_handle (TestClient *client,
+                    GString *line)
+{
+	TestIMAPXServer *server = client->server;
+	gchar *args, *tag, *command, *upper, *response = NULL;
+	gboolean keep_going = TRUE;
+
+	args = line->str;
+	tag = test_client_next_word (&args);
+	command = test_client_next_word (&args);
+
+	if (g_ascii_strcasecmp (command, "UID") == 0) {
+		gchar *sub = test_client_next_word (&args);
+		gchar *tmp = g_strconcat (command, " ", sub, NULL);
+
+		g_free (command);
+		g_free (sub);
+		command = tmp;
+	}
+
+	upper = g_ascii_strup (command, -1);
+	g_free (command);
+	command = upper;
+
+	g_mutex_lock (&server->lock);
+	server->stats.n_commands++;
+	response = g_strdup (g_hash_table_lookup (server->script, command));
+	g_mutex_unlock (&server->lock);
+
+	/* Every command costs one round trip's worth of latency */
+	if (g_strcmp0 (command, "IDLE") != 0)
+		test_client_wait (client);
+
+	if (response != NULL) {
+		test_client_scripted (client, tag, response);
+	} else if (g_strcmp0 (command, "CAPABILITY") == 0) {
+		gchar *capa = test_server_dup_capabilities (server);
+
+		g_string_append_printf (
+			client->out,
+			"* CAPABILITY %s\r\n%s OK Capability completed\r\n",
+			capa, tag);
+		g_free (capa);
+	} else if (g_strcmp0 (command, "LOGIN") == 0) {
+		gchar *capa = test_server_dup_capabilities (server);
+
+		g_string_append_printf (
+			client->out, "%s OK [CAPABILITY %s] Logged in\r\n",
+			tag, capa);
+		g_free (capa);
+	} else if (g_strcmp0 (command, "LOGOUT") == 0) {
+		g_string_append_printf (
+			client->out,
+			"* BYE Logging out\r\n%s OK Logout completed\r\n", tag);
+		keep_going = FALSE;
+	} else if (g_strcmp0 (command, "NAMESPACE") == 0) {
+		g_string_append_printf (
+			client->out,
+			"* NAMESPACE ((\"\" \"/\")) NIL NIL\r\n"
+			"%s OK Namespace completed\r\n", tag);
+	} else if (g_strcmp0 (command, "ENABLE") == 0) {
+		g_string_append (client->out, "* ENABLED");
+		if (server->caps & TEST_IMAPX_SERVER_CONDSTORE)
+			g_string_append (client->out, " CONDSTORE");
+		if (server->caps & TEST_IMAPX_SERVER_QRESYNC)
+			g_string_append (client->out, " QRESYNC");
+		g_string_append_printf (
+			client->out, "\r\n%s OK Enable completed\r\n", tag);
+	} else if (g_strcmp0 (command, "LIST") == 0 ||
+		   g_strcmp0 (command, "LSUB") == 0) {
+		test_client_list (client, tag, command, args);
+	} else if (g_strcmp0 (command, "SELECT") == 0 ||
+		   g_strcmp0 (command, "EXAMINE") == 0) {
+		test_client_select (client, tag, args);
+	} else if (g_strcmp0 (command, "STATUS") == 0) {
+		test_client_status (client, tag);
+	} else if (g_strcmp0 (command, "FETCH") == 0 ||
+		   g_strcmp0 (command, "UID FETCH") == 0) {
+		test_client_fetch (client, args, command[0] == 'U');
+		g_string_append_printf (
+			client->out, "%s OK Fetch completed\r\n", tag);
+	} else if (g_strcmp0 (command, "SEARCH") == 0 ||
+		   g_strcmp0 (command, "UID SEARCH") == 0) {
+		test_client_search (client, tag);
+	} else if (g_strcmp0 (command, "IDLE") == 0 &&
+		   (server->caps & TEST_IMAPX_SERVER_IDLE) != 0) {
+		keep_going = test_client_idle (client, tag);
+	} else if (g_strcmp0 (command, "APPEND") == 0) {
+		gint uid;
+
+		uid = g_atomic_int_add (&server->n_messages, 1) + 1;
+
+		if (server->caps & TEST_IMAPX_SERVER_UIDPLUS)
+			g_string_append_printf (
+				client->out,
+				"%s OK [APPENDUID %u %d] Append completed\r\n",
+				tag, UIDVALIDITY, uid);
+		else
+			g_string_append_printf (
+				client->out, "%s OK Append completed\r\n", tag);
+	} else if (g_strcmp0 (command, "NOOP") == 0 ||
+		   g_strcmp0 (command, "CHECK") == 0 ||
+		   g_strcmp0 (command, "CLOSE") == 0 ||
+		   g_strcmp0 (command, "EXPUNGE") == 0 ||
+		   g_strcmp0 (command, "CREATE") == 0 ||
+		   g_strcmp0 (command, "DELETE") == 0 ||
+		   g_strcmp0 (command, "RENAME") == 0 ||
+		   g_strcmp0 (command, "SUBSCRIBE") == 0 ||
+		   g_strcmp0 (command, "UNSUBSCRIBE") == 0 ||
+		   g_strcmp0 (command, "STORE") == 0 ||
+		   g_strcmp0 (command, "UID STORE") == 0 ||
+		   g_strcmp0 (command, "UID COPY") == 0 ||
+		   g_strcmp0 (command, "UID EXPUNGE") == 0) {
+		/* Changes are acknowledged but not kept */
+		g_string_append_printf (
+			client->out, "%s OK %s completed\r\n", tag, command);
+	} else {
+		g_string_append_printf (
+			client->out, "%s BAD Unknown command %s\r\n", tag, command);
+	}
+
+	if (!test_client_flush (client))
+		keep_going = FALSE;
+
+	g_free (response);
+	g_free (command);
+	g_free (tag);
+
+	return keep_going;
+}
+
+static gpointer
+test_client_thread (gpointer user_data)
+{
+	TestClient *client = user_data;
+	gchar *capa;
+	GString *line;
+
+	capa = test_server_dup_capabilities (client->server);
+	g_string_append_printf (
+		client->out, "* OK [CAPABILITY %s] Test server ready\r\n", capa);
+	g_free (capa);
+
+	test_client_wait (client);
+
+	if (!test_client_flush (client))
+		return NULL;
+
+	while ((line = test_client_read_command (client)) != NULL) {
+		gboolean keep_going;
+
+		keep_going = test_client_handle (client, line);
+		g_string_free (line, TRUE);
+
+		if (!keep_going)
+			break;
+	}
+
+	g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+
+	return NULL;
+}
+
+static gpointer
+test_server_accept_thread (gpointer user_data)
+{
+	TestIMAPXServer *server = user_data;
+	GSocketConnection *connection;
+
+	while ((connection = g_socket_listener_accept (
+		server->listener, NULL, server->cancellable, NULL)) != NULL) {
+		TestClient *client;
+		GInputStream *input;
+
+		input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+
+		client = g_slice_new0 (TestClient);
+		client->server = server;
+		client->connection = connection;
+		client->input = g_data_input_stream_new (input);
+		client->output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+		client->out = g_string_sized_new (FLUSH_THRESHOLD);
+
+		g_data_input_stream_set_newline_type (
+			client->input, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+
+		g_mutex_lock (&server->lock);
+		server->clients = g_slist_prepend (server->clients, client);
+		server->stats.n_connections++;
+		g_mutex_unlock (&server->lock);
+
+		client->thread = g_thread_new (
+			"test-imapx-client", test_client_thread, client);
+	}
+
+	return NULL;
+}
+
+static void
+test_client_free (TestClient *client)
+{
+	GSocket *sock;
+
+	/* Wakes up the client thread if it is blocked in a read */
+	sock = g_socket_connection_get_socket (client->connection);
+	g_socket_shutdown (sock, TRUE, TRUE, NULL);
+
+	g_thread_join (client->thread);
+
+	g_object_unref (client->input);
+	g_object_unref (client->connection);
+	g_string_free (client->out, TRUE);
+
+	g_slice_free (TestClient, client);
+}
+
+TestIMAPXServer *
+test_imapx_server_new (guint n_messages,
+                       gsize message_size,
+                       TestIMAPXServerCaps caps,
+                       GError **error)
+{
+	TestIMAPXServer *server;
+	GInetAddress *loopback;
+	GSocketAddress *address;
+	GSocketAddress *effective = NULL;
+	gboolean success;
+
+	server = g_slice_new0 (TestIMAPXServer);
+	server->n_messages = n_messages;
+	server->message_size = message_size;
+	server->caps = caps;
+	server->listener = g_socket_listener_new ();
+	server->cancellable = g_cancellable_new ();
+	server->script = g_hash_table_new_full (
+		g_str_hash, g_str_equal, g_free, g_free);
+	g_mutex_init (&server->lock);
+
+	/* Port 0 picks a free one */
+	loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+	address = g_inet_socket_address_new (loopback, 0);
+	success = g_socket_listener_add_address (
+		server->listener, address,
+		G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
+		NULL, (GSocketAddress **) &effective, error);
+	g_object_unref (address);
+	g_object_unref (loopback);
+
+	if (!success) {
+		test_imapx_server_free (server);
+		return NULL;
+	}
+
+	server->port = g_inet_socket_address_get_port (
+		G_INET_SOCKET_ADDRESS (effective));
+	g_object_unref (effective);
+
+	server->accept_thread = g_thread_new (
+		"test-imapx-server", test_server_accept_thread, server);
+
+	return server;
+}
+
+void
+test_imapx_server_free (TestIMAPXServer *server)
+{
+	g_return_if_fail (server != NULL);
+
+	g_cancellable_cancel (server->cancellable);
+	if (server->accept_thread != NULL)
+		g_thread_join (server->accept_thread);
+
+	g_socket_listener_close (server->listener);
+
+	g_slist_free_full (server->clients, (GDestroyNotify) test_client_free);
+
+	g_object_unref (server->listener);
+	g_object_unref (server->cancellable);
+	g_hash_table_destroy (server->script);
+	g_mutex_clear (&server->lock);
+
+	g_slice_free (TestIMAPXServer, server);
+}
+
+guint16
+test_imapx_server_get_port (TestIMAPXServer *server)
+{
+	g_return_val_if_fail (server != NULL, 0);
+
+	return server->port;
+}
+
+/* Added before the reply to every command, and to the greeting. */
+void
+test_imapx_server_set_latency (TestIMAPXServer *server,
+                               guint latency_ms)
+{
+	g_return_if_fail (server != NULL);
+
+	g_atomic_int_set (&server->latency_ms, latency_ms);
+}
+
+/* Per connection; 0 means no limit. */
+void
+test_imapx_server_set_bandwidth (TestIMAPXServer *server,
+                                 guint bytes_per_second)
+{
+	g_return_if_fail (server != NULL);
+
+	g_atomic_int_set (&server->bandwidth, bytes_per_second);
+}
+
+/* Replaces the built-in reply to @command (e.g. "NOOP" or "UID SEARCH")
+ * with @response, sent as is except that each "$TAG" is replaced with
+ * the command's tag.  A %NULL @response restores the built-in reply. */
+void
+test_imapx_server_set_response (TestIMAPXServer *server,
+                                const gchar *command,
+                                const gchar *response)
+{
+	g_return_if_fail (server != NULL);
+	g_return_if_fail (command != NULL);
+
+	g_mutex_lock (&server->lock);
+	if (response != NULL)
+		g_hash_table_insert (
+			server->script,
+			g_ascii_strup (command, -1),
+			g_strdup (response));
+	else {
+		gchar *key = g_ascii_strup (command, -1);
+		g_hash_table_remove (server->script, key);
+		g_free (key);
+	}
+	g_mutex_unlock (&server->lock);
+}
+
+void
+test_imapx_server_get_stats (TestIMAPXServer *server,
+                             TestIMAPXServerStats *stats)
+{
+	g_return_if_fail (server != NULL);
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&server->lock);
+	*stats = server->stats;
+	g_mutex_unlock (&server->lock);
+}
+
+void
+test_imapx_server_reset_stats (TestIMAPXServer *server)
+{
+	g_return_if_fail (server != NULL);
+
+	g_mutex_lock (&server->lock);
+	memset (&server->stats, 0, sizeof (server->stats));
+	g_mutex_unlock (&server->lock);
+}
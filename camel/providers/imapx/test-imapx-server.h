@@ -0,0 +1,74 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU Lesser General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* A small IMAP server stand-in for testing and benchmarking IMAPX
+ * without a real server.  It listens on a local port and serves a
+ * single synthetic INBOX of any size.  Latency, bandwidth and the
+ * advertised capabilities can be set, and responses to individual
+ * commands can be replaced with scripted ones. */
+
+#ifndef TEST_IMAPX_SERVER_H
+#define TEST_IMAPX_SERVER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _TestIMAPXServer TestIMAPXServer;
+typedef struct _TestIMAPXServerStats TestIMAPXServerStats;
+
+typedef enum {
+	TEST_IMAPX_SERVER_IDLE = 1 << 0,
+	TEST_IMAPX_SERVER_CONDSTORE = 1 << 1,
+	TEST_IMAPX_SERVER_QRESYNC = 1 << 2,
+	TEST_IMAPX_SERVER_UIDPLUS = 1 << 3,
+	TEST_IMAPX_SERVER_LITERALPLUS = 1 << 4
+} TestIMAPXServerCaps;
+
+#define TEST_IMAPX_SERVER_ALL_CAPS \
+	(TEST_IMAPX_SERVER_IDLE | TEST_IMAPX_SERVER_CONDSTORE | \
+	 TEST_IMAPX_SERVER_QRESYNC | TEST_IMAPX_SERVER_UIDPLUS | \
+	 TEST_IMAPX_SERVER_LITERALPLUS)
+
+struct _TestIMAPXServerStats {
+	guint n_connections;
+	guint n_commands;	/* each tagged command is one round trip */
+	guint64 bytes_in;
+	guint64 bytes_out;
+};
+
+TestIMAPXServer *
+		test_imapx_server_new		(guint n_messages,
+						 gsize message_size,
+						 TestIMAPXServerCaps caps,
+						 GError **error);
+void		test_imapx_server_free		(TestIMAPXServer *server);
+guint16		test_imapx_server_get_port	(TestIMAPXServer *server);
+void		test_imapx_server_set_latency	(TestIMAPXServer *server,
+						 guint latency_ms);
+void		test_imapx_server_set_bandwidth	(TestIMAPXServer *server,
+						 guint bytes_per_second);
+void		test_imapx_server_set_response	(TestIMAPXServer *server,
+						 const gchar *command,
+						 const gchar *response);
+void		test_imapx_server_get_stats	(TestIMAPXServer *server,
+						 TestIMAPXServerStats *stats);
+void		test_imapx_server_reset_stats	(TestIMAPXServer *server);
+
+G_END_DECLS
+
+#endif /* TEST_IMAPX_SERVER_H */
@@ -24,6 +24,11 @@
 #include <config.h>
 #endif
 
+/* for copy_file_range() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -33,6 +38,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
 #include <glib/gi18n-lib.h>
 #include <glib/gstdio.h>
 
@@ -51,6 +60,14 @@
 #define PATH_MAX _POSIX_PATH_MAX
 #endif
 
+/* How camel_local_folder_write_raw() moves message bytes; each method
+ * gives way to the next once the kernel refuses it for a pair of files. */
+enum {
+	RAW_COPY_FILE_RANGE,
+	RAW_COPY_SENDFILE,
+	RAW_COPY_WRITE
+};
+
 #define CAMEL_LOCAL_FOLDER_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE \
 	((obj), CAMEL_TYPE_LOCAL_FOLDER, CamelLocalFolderPrivate))
@@ -446,6 +463,203 @@ local_folder_synchronize_sync (CamelFolder *folder,
 	return success;
 }
 
+/* Splits what camel_folder_get_filename() returned into the file to
+ * copy from and, for an mbox, the offset of the message's From line
+ * ("path!frompos"); @frompos is -1 when the file is the message.
+ * Returns NULL if there's no such file. */
+static gchar *
+local_folder_raw_source (const gchar *filename,
+                         goffset *frompos)
+{
+	const gchar *bang;
+	gchar *path, *end = NULL;
+
+	*frompos = -1;
+
+	if (filename == NULL)
+		return NULL;
+
+	if (g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+		return g_strdup (filename);
+
+	bang = strrchr (filename, '!');
+	if (bang == NULL || bang[1] == '\0')
+		return NULL;
+
+	*frompos = g_ascii_strtoll (bang + 1, &end, 10);
+	path = g_strndup (filename, bang - filename);
+
+	if (*end != '\0' || *frompos < 0 || !g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+		*frompos = -1;
+		g_free (path);
+		return NULL;
+	}
+
+	return path;
+}
+
+static gboolean
+local_folder_transfer_messages_to_sync (CamelFolder *source,
+                                        GPtrArray *uids,
+                                        CamelFolder *dest,
+                                        gboolean delete_originals,
+                                        GPtrArray **transferred_uids,
+                                        GCancellable *cancellable,
+                                        GError **error)
+{
+	CamelFolderClass *folder_class;
+	CamelFolderSummaryClass *summary_class;
+	CamelLocalFolderClass *class;
+	CamelLocalFolder *df;
+	GPtrArray *filenames, *fallback_uids, *fallback_transferred = NULL;
+	GArray *fallback_index;
+	gboolean success = TRUE;
+	guint ii;
+
+	folder_class = CAMEL_FOLDER_CLASS (camel_local_folder_parent_class);
+
+	if (!CAMEL_IS_LOCAL_FOLDER (dest) ||
+	    CAMEL_LOCAL_FOLDER_GET_CLASS (dest)->append_raw == NULL)
+		return folder_class->transfer_messages_to_sync (
+			source, uids, dest, delete_originals,
+			transferred_uids, cancellable, error);
+
+	df = CAMEL_LOCAL_FOLDER (dest);
+	class = CAMEL_LOCAL_FOLDER_GET_CLASS (df);
+	summary_class = CAMEL_FOLDER_SUMMARY_GET_CLASS (dest->summary);
+
+	/* look the files up first, an mbox source takes its own lock
+	 * and rescans its summary for each of them */
+	filenames = g_ptr_array_new_with_free_func (g_free);
+	for (ii = 0; ii < uids->len; ii++)
+		g_ptr_array_add (filenames, camel_folder_get_filename (source, uids->pdata[ii], NULL));
+
+	/* hold the destination lock for the whole batch, so an mbox
+	 * isn't locked and unlocked once per message */
+	if (camel_local_folder_lock (df, CAMEL_LOCK_WRITE, error) == -1) {
+		g_ptr_array_free (filenames, TRUE);
+		return FALSE;
+	}
+
+	if (transferred_uids) {
+		*transferred_uids = g_ptr_array_new ();
+		g_ptr_array_set_size (*transferred_uids, uids->len);
+	}
+
+	fallback_uids = g_ptr_array_new ();
+	fallback_index = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	if (delete_originals)
+		camel_operation_push_message (
+			cancellable, _("Moving messages"));
+	else
+		camel_operation_push_message (
+			cancellable, _("Copying messages"));
+
+	if (uids->len > 1) {
+		camel_folder_freeze (dest);
+		if (delete_originals)
+			camel_folder_freeze (source);
+	}
+
+	for (ii = 0; ii < uids->len && success; ii++) {
+		const gchar *uid = uids->pdata[ii];
+		CamelMessageInfo *minfo, *info;
+		GError *local_error = NULL;
+		gboolean copied = FALSE;
+		gchar *filename;
+		goffset frompos;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			success = FALSE;
+			break;
+		}
+
+		filename = local_folder_raw_source (filenames->pdata[ii], &frompos);
+		minfo = camel_folder_summary_get (source->summary, uid);
+
+		if (filename != NULL && minfo != NULL) {
+			/* the clone has the destination's info type */
+			info = summary_class->message_info_clone (dest->summary, minfo);
+			((CamelMessageInfoBase *) info)->flags &= 0xffff;
+
+			/* unset deleted flag when transferring from trash folder */
+			if ((source->folder_flags & CAMEL_FOLDER_IS_TRASH) != 0)
+				((CamelMessageInfoBase *) info)->flags &= ~CAMEL_MESSAGE_DELETED;
+			/* unset junk flag when transferring from junk folder */
+			if ((source->folder_flags & CAMEL_FOLDER_IS_JUNK) != 0)
+				((CamelMessageInfoBase *) info)->flags &= ~CAMEL_MESSAGE_JUNK;
+
+			copied = class->append_raw (
+				df, filename, frompos, info, transferred_uids ?
+				(gchar **) &(*transferred_uids)->pdata[ii] : NULL,
+				cancellable, &local_error);
+
+			camel_message_info_free (info);
+
+			if (!copied && !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+				g_propagate_error (error, local_error);
+				local_error = NULL;
+				success = FALSE;
+			}
+
+			g_clear_error (&local_error);
+		}
+
+		if (copied) {
+			if (delete_originals)
+				camel_folder_set_message_flags (
+					source, uid, CAMEL_MESSAGE_DELETED |
+					CAMEL_MESSAGE_SEEN, ~0);
+		} else if (success) {
+			g_ptr_array_add (fallback_uids, (gpointer) uid);
+			g_array_append_val (fallback_index, ii);
+		}
+
+		if (minfo != NULL)
+			camel_message_info_free (minfo);
+		g_free (filename);
+
+		camel_operation_progress (cancellable, ii * 100 / uids->len);
+	}
+
+	if (uids->len > 1) {
+		camel_folder_thaw (dest);
+		if (delete_originals)
+			camel_folder_thaw (source);
+	}
+
+	camel_operation_pop_message (cancellable);
+
+	camel_local_folder_unlock (df);
+
+	if (camel_folder_change_info_changed (df->changes)) {
+		camel_folder_changed (dest, df->changes);
+		camel_folder_change_info_clear (df->changes);
+	}
+
+	/* whatever couldn't be copied verbatim goes the usual way */
+	if (success && fallback_uids->len > 0) {
+		success = folder_class->transfer_messages_to_sync (
+			source, fallback_uids, dest, delete_originals,
+			transferred_uids ? &fallback_transferred : NULL,
+			cancellable, error);
+
+		for (ii = 0; fallback_transferred && ii < fallback_transferred->len; ii++)
+			(*transferred_uids)->pdata[g_array_index (fallback_index, guint, ii)] =
+				fallback_transferred->pdata[ii];
+
+		if (fallback_transferred)
+			g_ptr_array_free (fallback_transferred, TRUE);
+	}
+
+	g_ptr_array_free (filenames, TRUE);
+	g_ptr_array_free (fallback_uids, TRUE);
+	g_array_free (fallback_index, TRUE);
+
+	return success;
+}
+
 static gint
 local_folder_lock (CamelLocalFolder *lf,
                    CamelLockType type,
@@ -486,6 +700,7 @@ camel_local_folder_class_init (CamelLocalFolderClass *class)
 	folder_class->expunge_sync = local_folder_expunge_sync;
 	folder_class->refresh_info_sync = local_folder_refresh_info_sync;
 	folder_class->synchronize_sync = local_folder_synchronize_sync;
+	folder_class->transfer_messages_to_sync = local_folder_transfer_messages_to_sync;
 
 	class->lock = local_folder_lock;
 	class->unlock = local_folder_unlock;
@@ -727,3 +942,403 @@ set_cannot_get_message_ex (GError **error,
 		_("Cannot get message %s from folder %s\n%s"),
 		msgID, folder_path, detailErr);
 }
+
+static gboolean
+local_folder_write_all (gint fd,
+                        const gchar *data,
+                        gsize len,
+                        GError **error)
+{
+	while (len > 0) {
+		gssize n;
+
+		n = write (fd, data, len);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+
+			g_set_error (
+				error, G_IO_ERROR,
+				g_io_error_from_errno (errno),
+				"%s", g_strerror (errno));
+			return FALSE;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+/* Copies bytes [start, end) of the message file @in_fd to the current
+ * position of @fd.  @data is the same file mapped into memory, it is
+ * only touched when neither copy_file_range() nor sendfile() accept
+ * the two files (different filesystems on old kernels, O_APPEND, ...) */
+static gboolean
+local_folder_copy_range (gint in_fd,
+                         const gchar *data,
+                         gsize start,
+                         gsize end,
+                         gint fd,
+                         gint *method,
+                         GError **error)
+{
+	while (start < end && *method != RAW_COPY_WRITE) {
+		gssize n = -1;
+
+		if (*method == RAW_COPY_FILE_RANGE) {
+#ifdef HAVE_COPY_FILE_RANGE
+			loff_t in_off = start;
+
+			n = copy_file_range (in_fd, &in_off, fd, NULL, end - start, 0);
+#else
+			errno = ENOSYS;
+#endif
+		} else {
+#if defined (HAVE_SENDFILE) && defined (HAVE_SYS_SENDFILE_H)
+			off_t in_off = start;
+
+			n = sendfile (fd, in_fd, &in_off, end - start);
+#else
+			errno = ENOSYS;
+#endif
+		}
+
+		if (n > 0) {
+			start += n;
+		} else if (n == -1 && errno == EINTR) {
+			continue;
+		} else if (n == -1 && errno != ENOSYS && errno != EXDEV &&
+			   errno != EINVAL && errno != EOPNOTSUPP && errno != EBADF) {
+			g_set_error (
+				error, G_IO_ERROR,
+				g_io_error_from_errno (errno),
+				"%s", g_strerror (errno));
+			return FALSE;
+		} else {
+			(*method)++;
+		}
+	}
+
+	return start >= end || local_folder_write_all (fd, data + start, end - start, error);
+}
+
+/* As above, but quotes lines starting with "From " the way
+ * CamelMimeFilterFrom does.  @start must be at the start of a line. */
+static gboolean
+local_folder_copy_range_escaped (gint in_fd,
+                                 const gchar *data,
+                                 gsize start,
+                                 gsize end,
+                                 gint fd,
+                                 gint *method,
+                                 GError **error)
+{
+	gsize line = start;
+
+	while (line < end) {
+		const gchar *nl;
+
+		if (end - line >= 5 && strncmp (data + line, "From ", 5) == 0) {
+			if (!local_folder_copy_range (in_fd, data, start, line, fd, method, error) ||
+			    !local_folder_write_all (fd, ">", 1, error))
+				return FALSE;
+			start = line;
+		}
+
+		nl = memchr (data + line, '\n', end - line);
+		if (nl == NULL)
+			break;
+		line = nl - data + 1;
+	}
+
+	return local_folder_copy_range (in_fd, data, start, end, fd, method, error);
+}
+
+/* Returns the offset of the blank line ending the headers, or -1 if
+ * there is none, e.g. for CRLF files camel never writes itself. */
+static gssize
+local_folder_raw_headers_end (const gchar *data,
+                              gsize start,
+                              gsize len)
+{
+	gsize line = start;
+
+	while (line < len) {
+		const gchar *nl;
+
+		if (data[line] == '\n')
+			return line;
+
+		nl = memchr (data + line, '\n', len - line);
+		if (nl == NULL)
+			break;
+		line = nl - data + 1;
+	}
+
+	return -1;
+}
+
+/* Returns the offset just past the header line at @line, including any
+ * continuation lines. */
+static gsize
+local_folder_raw_header_next (const gchar *data,
+                              gsize line,
+                              gsize hend)
+{
+	do {
+		const gchar *nl;
+
+		nl = memchr (data + line, '\n', hend - line);
+		line = nl - data + 1;
+	} while (line < hend && (data[line] == ' ' || data[line] == '\t'));
+
+	return line;
+}
+
+/* Finds the message of the mbox entry whose From line is at @frompos:
+ * it starts on the line after that and ends before the next From line,
+ * less the blank line separating the two.  Fails if there's no From
+ * line at @frompos, i.e. the mbox was rewritten since. */
+static gboolean
+local_folder_raw_mbox_range (const gchar *data,
+                             gsize len,
+                             goffset frompos,
+                             gsize *start,
+                             gsize *end)
+{
+	const gchar *nl;
+	gsize line;
+
+	if ((gsize) frompos + 5 > len || strncmp (data + frompos, "From ", 5) != 0)
+		return FALSE;
+
+	nl = memchr (data + frompos, '\n', len - frompos);
+	if (nl == NULL)
+		return FALSE;
+
+	*start = line = nl - data + 1;
+	*end = len;
+
+	while (line < len) {
+		if (len - line >= 5 && strncmp (data + line, "From ", 5) == 0) {
+			*end = line;
+			break;
+		}
+
+		nl = memchr (data + line, '\n', len - line);
+		if (nl == NULL)
+			break;
+		line = nl - data + 1;
+	}
+
+	if (*end - *start >= 2 && data[*end - 1] == '\n' && data[*end - 2] == '\n')
+		(*end)--;
+
+	return TRUE;
+}
+
+static GMappedFile *
+local_folder_raw_open (const gchar *filename,
+                       gint *in_fd,
+                       GError **error)
+{
+	GMappedFile *map;
+	gint fd;
+
+	fd = g_open (filename, O_RDONLY | O_LARGEFILE, 0);
+	if (fd == -1) {
+		g_set_error (
+			error, G_IO_ERROR,
+			g_io_error_from_errno (errno),
+			"%s", g_strerror (errno));
+		return NULL;
+	}
+
+	map = g_mapped_file_new_from_fd (fd, FALSE, error);
+	if (map == NULL || in_fd == NULL)
+		close (fd);
+	else
+		*in_fd = fd;
+
+	return map;
+}
+
+/* Copies the message in @filename, written by another local folder, to
+ * the current position of @fd without parsing it.  With @frompos other
+ * than -1, @filename is an mbox and the message the one whose From line
+ * is at that offset.  Headers are only touched when @xev is set, to
+ * replace the X-Evolution header, or just drop it if @xev is empty;
+ * with @from_line the message is written as an mbox entry.  Everything
+ * else is moved with copy_file_range() or sendfile() where the kernel
+ * can.
+ *
+ * Fails with G_IO_ERROR_NOT_SUPPORTED if the file can't be copied
+ * verbatim, callers should then fall back to parsing it. */
+gboolean
+camel_local_folder_write_raw (gint fd,
+                              const gchar *filename,
+                              goffset frompos,
+                              const gchar *from_line,
+                              const gchar *xev,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	gboolean (*copy) (gint, const gchar *, gsize, gsize, gint, gint *, GError **);
+	GMappedFile *map;
+	const gchar *data;
+	gsize len, pos = 0;
+	gint in_fd = -1, method = RAW_COPY_FILE_RANGE;
+	gboolean success = FALSE;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	map = local_folder_raw_open (filename, &in_fd, error);
+	if (map == NULL)
+		return FALSE;
+
+	data = g_mapped_file_get_contents (map);
+	len = g_mapped_file_get_length (map);
+
+	if (frompos != -1 && !local_folder_raw_mbox_range (data, len, frompos, &pos, &len)) {
+		g_set_error (
+			error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			_("Cannot copy message %s verbatim"), filename);
+		goto exit;
+	}
+
+	copy = from_line ? local_folder_copy_range_escaped : local_folder_copy_range;
+
+	if (from_line && !local_folder_write_all (fd, from_line, strlen (from_line), error))
+		goto exit;
+
+	if (xev) {
+		gssize hend;
+		gsize line = pos;
+
+		hend = local_folder_raw_headers_end (data, pos, len);
+		if (hend == -1) {
+			g_set_error (
+				error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				_("Cannot copy message %s verbatim"), filename);
+			goto exit;
+		}
+
+		/* copy the headers, leaving out any stale X-Evolution one */
+		while (line < (gsize) hend) {
+			gsize next = local_folder_raw_header_next (data, line, hend);
+
+			if (g_ascii_strncasecmp (data + line, "X-Evolution:", 12) == 0) {
+				if (!copy (in_fd, data, pos, line, fd, &method, error))
+					goto exit;
+				pos = next;
+			}
+
+			line = next;
+		}
+
+		if (!copy (in_fd, data, pos, hend, fd, &method, error))
+			goto exit;
+
+		if (*xev) {
+			gchar *xevline;
+
+			xevline = g_strdup_printf ("X-Evolution: %s\n", xev);
+			success = local_folder_write_all (fd, xevline, strlen (xevline), error);
+			g_free (xevline);
+			if (!success)
+				goto exit;
+		}
+
+		success = FALSE;
+		pos = hend;
+	}
+
+	if (!copy (in_fd, data, pos, len, fd, &method, error))
+		goto exit;
+
+	/* an mbox entry ends with an empty line */
+	if (from_line) {
+		if (len > pos && data[len - 1] != '\n' &&
+		    !local_folder_write_all (fd, "\n", 1, error))
+			goto exit;
+		if (!local_folder_write_all (fd, "\n", 1, error))
+			goto exit;
+	}
+
+	success = TRUE;
+
+ exit:
+	g_mapped_file_unref (map);
+	close (in_fd);
+
+	return success;
+}
+
+/* Skips the uid in an X-Evolution value, "uid-flags; params". */
+static const gchar *
+local_folder_raw_xev_skip_uid (const gchar *xev,
+                               const gchar *xev_end)
+{
+	const gchar *dash;
+
+	dash = memchr (xev, '-', xev_end - xev);
+
+	return dash ? dash + 1 : NULL;
+}
+
+/* Whether the file can be shared (hard linked) with a folder expecting
+ * @xev as its X-Evolution header, i.e. the header already carries the
+ * same flags.  The uid in it is ignored, it's the source folder's; the
+ * mh summary names messages after their files anyway.  A file without
+ * the header doesn't qualify, a rescan would lose its flags. */
+gboolean
+camel_local_folder_raw_xev_matches (const gchar *filename,
+                                    const gchar *xev)
+{
+	GMappedFile *map;
+	const gchar *data, *xev_tail;
+	gssize hend;
+	gsize line = 0;
+	gboolean matches = FALSE;
+
+	if (xev == NULL)
+		return FALSE;
+
+	xev_tail = local_folder_raw_xev_skip_uid (xev, xev + strlen (xev));
+	if (xev_tail == NULL)
+		return FALSE;
+
+	map = local_folder_raw_open (filename, NULL, NULL);
+	if (map == NULL)
+		return FALSE;
+
+	data = g_mapped_file_get_contents (map);
+	hend = local_folder_raw_headers_end (data, 0, g_mapped_file_get_length (map));
+
+	while (hend != -1 && line < (gsize) hend) {
+		gsize next = local_folder_raw_header_next (data, line, hend);
+
+		if (g_ascii_strncasecmp (data + line, "X-Evolution:", 12) == 0) {
+			const gchar *value = data + line + 12;
+			const gchar *value_end = data + next - 1;
+
+			while (*value == ' ' || *value == '\t')
+				value++;
+
+			value = local_folder_raw_xev_skip_uid (value, value_end);
+			matches = value != NULL &&
+				strlen (xev_tail) == (gsize) (value_end - value) &&
+				strncmp (value, xev_tail, value_end - value) == 0;
+			break;
+		}
+
+		line = next;
+	}
+
+	g_mapped_file_unref (map);
+
+	return matches;
+}
@@ -91,6 +91,17 @@ struct _CamelLocalFolderClass {
 
 	/* Unlock the folder for my operations */
 	void		(*unlock)		(CamelLocalFolder *);
+
+	/* Add a message stored in @filename to the folder without
+	 * parsing it, or the one at @frompos if @filename is an mbox;
+	 * @info is a template of the folder's own type */
+	gboolean	(*append_raw)		(CamelLocalFolder *lf,
+						 const gchar *filename,
+						 goffset frompos,
+						 CamelMessageInfo *info,
+						 gchar **appended_uid,
+						 GCancellable *cancellable,
+						 GError **error);
 };
 
 GType		camel_local_folder_get_type	(void);
@@ -30,7 +30,7 @@
 #include <config.h>
 #endif
 
-#include <glib.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -49,6 +49,17 @@ gint		camel_local_frompos_sort	(gpointer enc,
 						 gint len2,
 						 gpointer data2);
 
+gboolean	camel_local_folder_write_raw	(gint fd,
+						 const gchar *filename,
+						 goffset frompos,
+						 const gchar *from_line,
+						 const gchar *xev,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	camel_local_folder_raw_xev_matches
+						(const gchar *filename,
+						 const gchar *xev);
+
 G_END_DECLS
 
 #endif /* CAMEL_LOCAL_PRIVATE_H */
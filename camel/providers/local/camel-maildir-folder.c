@@ -35,6 +35,7 @@
 #include <glib/gi18n-lib.h>
 #include <glib/gstdio.h>
 
+#include "camel-local-private.h"
 #include "camel-maildir-folder.h"
 #include "camel-maildir-store.h"
 #include "camel-maildir-summary.h"
@@ -246,6 +247,87 @@ maildir_folder_append_message_sync (CamelFolder *folder,
 	return success;
 }
 
+static gboolean
+maildir_folder_append_raw (CamelLocalFolder *lf,
+                           const gchar *filename,
+                           goffset frompos,
+                           CamelMessageInfo *info,
+                           gchar **appended_uid,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (lf);
+	CamelMaildirMessageInfo *mdi = (CamelMaildirMessageInfo *) info;
+	gchar *name, *dest;
+	gboolean success = TRUE;
+
+	if (camel_local_folder_lock (lf, CAMEL_LOCK_WRITE, error) == -1)
+		return FALSE;
+
+	info->uid = camel_pstring_add (camel_folder_summary_next_uid_string (folder->summary), TRUE);
+	camel_maildir_info_set_filename (mdi, camel_maildir_summary_info_to_name (mdi));
+
+	name = g_strdup_printf ("%s/tmp/%s", lf->folder_path, camel_message_info_uid (info));
+	dest = g_strdup_printf ("%s/cur/%s", lf->folder_path, camel_maildir_info_filename (mdi));
+
+	/* maildir keeps no X-Evolution header, so the file can always be
+	 * shared with the source folder; copy it only if we can't link.
+	 * An mbox entry is always copied, without its X-Evolution header */
+	if (frompos != -1 || link (filename, name) == -1) {
+		gint fd;
+
+		fd = g_open (name, O_WRONLY | O_CREAT | O_EXCL | O_LARGEFILE, 0600);
+		if (fd == -1) {
+			g_set_error (
+				error, G_IO_ERROR,
+				g_io_error_from_errno (errno),
+				"%s", g_strerror (errno));
+			success = FALSE;
+		} else {
+			success = camel_local_folder_write_raw (
+				fd, filename, frompos, NULL,
+				frompos != -1 ? "" : NULL,
+				cancellable, error);
+			if (close (fd) == -1 && success) {
+				g_set_error (
+					error, G_IO_ERROR,
+					g_io_error_from_errno (errno),
+					"%s", g_strerror (errno));
+				success = FALSE;
+			}
+		}
+	}
+
+	/* now move from tmp to cur, as append does */
+	if (success && g_rename (name, dest) == -1) {
+		g_set_error (
+			error, G_IO_ERROR,
+			g_io_error_from_errno (errno),
+			"%s", g_strerror (errno));
+		success = FALSE;
+	}
+
+	if (success) {
+		camel_folder_summary_add (folder->summary, camel_message_info_ref (info));
+		camel_folder_change_info_add_uid (lf->changes, camel_message_info_uid (info));
+
+		if (appended_uid)
+			*appended_uid = g_strdup (camel_message_info_uid (info));
+	} else {
+		g_unlink (name);
+		g_prefix_error (
+			error, _("Cannot append message to maildir folder: %s: "),
+			name);
+	}
+
+	g_free (dest);
+	g_free (name);
+
+	camel_local_folder_unlock (lf);
+
+	return success;
+}
+
 static CamelMimeMessage *
 maildir_folder_get_message_sync (CamelFolder *folder,
                                  const gchar *uid,
@@ -447,6 +529,7 @@ camel_maildir_folder_class_init (CamelMaildirFolderClass *class)
 
 	local_folder_class = CAMEL_LOCAL_FOLDER_CLASS (class);
 	local_folder_class->create_summary = maildir_folder_create_summary;
+	local_folder_class->append_raw = maildir_folder_append_raw;
 }
 
 static void
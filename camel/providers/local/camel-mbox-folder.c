@@ -36,6 +36,7 @@
 #include <glib/gi18n-lib.h>
 #include <glib/gstdio.h>
 
+#include "camel-local-private.h"
 #include "camel-mbox-folder.h"
 #include "camel-mbox-store.h"
 #include "camel-mbox-summary.h"
@@ -293,6 +294,146 @@ fail:
 	return FALSE;
 }
 
+static const gchar tz_months[][4] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+	"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static const gchar tz_days[][4] = {
+	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+/* camel_mime_message_build_mbox_from(), from the summary instead */
+static gchar *
+mbox_folder_build_from_line (const CamelMessageInfo *info)
+{
+	struct _camel_header_address *addr = NULL;
+	const gchar *from;
+	time_t thetime;
+	struct tm tm;
+	gchar *ret;
+
+	from = camel_message_info_from (info);
+	if (from && *from)
+		addr = camel_header_address_decode (from, NULL);
+
+	thetime = camel_message_info_date_received (info);
+	if (thetime <= 0)
+		thetime = camel_message_info_date_sent (info);
+	if (thetime < 0)
+		thetime = 0;
+	gmtime_r (&thetime, &tm);
+
+	ret = g_strdup_printf (
+		"From %s %s %s %2d %02d:%02d:%02d %4d\n",
+		addr && addr->type == CAMEL_HEADER_ADDRESS_NAME ?
+		addr->v.addr : "unknown@nodomain.now.au",
+		tz_days[tm.tm_wday],
+		tz_months[tm.tm_mon],
+		tm.tm_mday,
+		tm.tm_hour,
+		tm.tm_min,
+		tm.tm_sec,
+		tm.tm_year + 1900);
+
+	if (addr)
+		camel_header_address_unref (addr);
+
+	return ret;
+}
+
+static gboolean
+mbox_folder_append_raw (CamelLocalFolder *lf,
+                        const gchar *filename,
+                        goffset frompos,
+                        CamelMessageInfo *info,
+                        gchar **appended_uid,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (lf);
+	CamelMboxSummary *mbs = (CamelMboxSummary *) folder->summary;
+	CamelMboxMessageInfo *mi = (CamelMboxMessageInfo *) info;
+	gchar *fromline, *xev;
+	struct stat st;
+	gint fd, retval;
+	gboolean success;
+
+	if (camel_local_folder_lock (lf, CAMEL_LOCK_WRITE, error) == -1)
+		return FALSE;
+
+	/* first, check the summary is correct (updates folder_size too) */
+	if (camel_local_summary_check ((CamelLocalSummary *) folder->summary, lf->changes, cancellable, error) == -1) {
+		camel_local_folder_unlock (lf);
+		return FALSE;
+	}
+
+	/* no O_APPEND, copy_file_range() refuses such files; we hold
+	 * the folder lock so the end of the mailbox stays put */
+	fd = g_open (lf->folder_path, O_WRONLY | O_BINARY | O_LARGEFILE, 0);
+	if (fd == -1 || lseek (fd, mbs->folder_size, SEEK_SET) == -1) {
+		g_set_error (
+			error, G_IO_ERROR,
+			g_io_error_from_errno (errno),
+			_("Cannot open mailbox: %s: %s"),
+			lf->folder_path, g_strerror (errno));
+		if (fd != -1)
+			close (fd);
+		camel_local_folder_unlock (lf);
+		return FALSE;
+	}
+
+	info->uid = camel_pstring_add (camel_folder_summary_next_uid_string (folder->summary), TRUE);
+	mi->frompos = mbs->folder_size;
+
+	xev = camel_local_summary_encode_x_evolution ((CamelLocalSummary *) mbs, &mi->info);
+	fromline = mbox_folder_build_from_line (info);
+
+	success = camel_local_folder_write_raw (
+		fd, filename, frompos, fromline, xev, cancellable, error);
+
+	if (!success) {
+		/* reset the file to original size */
+		do {
+			retval = ftruncate (fd, mbs->folder_size);
+		} while (retval == -1 && errno == EINTR);
+
+		g_prefix_error (
+			error, _("Cannot append message to mbox file: %s: "),
+			lf->folder_path);
+	}
+
+	if (close (fd) == -1 && success) {
+		g_set_error (
+			error, G_IO_ERROR,
+			g_io_error_from_errno (errno),
+			_("Cannot append message to mbox file: %s: %s"),
+			lf->folder_path, g_strerror (errno));
+		success = FALSE;
+	}
+
+	if (success) {
+		camel_folder_summary_add (folder->summary, camel_message_info_ref (info));
+		camel_folder_change_info_add_uid (lf->changes, camel_message_info_uid (info));
+
+		if (appended_uid)
+			*appended_uid = g_strdup (camel_message_info_uid (info));
+	}
+
+	/* and tell the summary it's up-to-date */
+	if (g_stat (lf->folder_path, &st) == 0) {
+		((CamelFolderSummary *) mbs)->time = st.st_mtime;
+		mbs->folder_size = st.st_size;
+	}
+
+	g_free (fromline);
+	g_free (xev);
+
+	camel_local_folder_unlock (lf);
+
+	return success;
+}
+
 static CamelMimeMessage *
 mbox_folder_get_message_sync (CamelFolder *folder,
                               const gchar *uid,
@@ -478,6 +619,7 @@ camel_mbox_folder_class_init (CamelMboxFolderClass *class)
 
 	local_folder_class = CAMEL_LOCAL_FOLDER_CLASS (class);
 	local_folder_class->create_summary = mbox_folder_create_summary;
+	local_folder_class->append_raw = mbox_folder_append_raw;
 	local_folder_class->lock = mbox_folder_lock;
 	local_folder_class->unlock = mbox_folder_unlock;
 }
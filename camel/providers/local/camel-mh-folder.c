@@ -33,7 +33,9 @@
 #include <sys/types.h>
 
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 
+#include "camel-local-private.h"
 #include "camel-mh-folder.h"
 #include "camel-mh-store.h"
 #include "camel-mh-summary.h"
@@ -135,6 +137,77 @@ mh_folder_append_message_sync (CamelFolder *folder,
 	return TRUE;
 }
 
+static gboolean
+mh_folder_append_raw (CamelLocalFolder *lf,
+                      const gchar *filename,
+                      goffset frompos,
+                      CamelMessageInfo *info,
+                      gchar **appended_uid,
+                      GCancellable *cancellable,
+                      GError **error)
+{
+	CamelFolder *folder = CAMEL_FOLDER (lf);
+	gchar *name, *xev;
+	gboolean success = TRUE;
+
+	if (camel_local_folder_lock (lf, CAMEL_LOCK_WRITE, error) == -1)
+		return FALSE;
+
+	/* this also creates the (empty) message file, claiming the uid */
+	info->uid = camel_pstring_add (camel_folder_summary_next_uid_string (folder->summary), TRUE);
+	xev = camel_local_summary_encode_x_evolution (
+		(CamelLocalSummary *) folder->summary,
+		(CamelLocalMessageInfo *) info);
+
+	name = g_strdup_printf ("%s/%s", lf->folder_path, camel_message_info_uid (info));
+
+	/* the file can only be shared with the source folder if it
+	 * already carries the flags we would write */
+	if (frompos != -1 || !camel_local_folder_raw_xev_matches (filename, xev)
+	    || g_unlink (name) == -1 || link (filename, name) == -1) {
+		gint fd;
+
+		fd = g_open (name, O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0600);
+		if (fd == -1) {
+			g_set_error (
+				error, G_IO_ERROR,
+				g_io_error_from_errno (errno),
+				"%s", g_strerror (errno));
+			success = FALSE;
+		} else {
+			success = camel_local_folder_write_raw (
+				fd, filename, frompos, NULL, xev,
+				cancellable, error);
+			if (close (fd) == -1 && success) {
+				g_set_error (
+					error, G_IO_ERROR,
+					g_io_error_from_errno (errno),
+					"%s", g_strerror (errno));
+				success = FALSE;
+			}
+		}
+	}
+
+	if (success) {
+		camel_folder_summary_add (folder->summary, camel_message_info_ref (info));
+		camel_folder_change_info_add_uid (lf->changes, camel_message_info_uid (info));
+
+		if (appended_uid)
+			*appended_uid = g_strdup (camel_message_info_uid (info));
+	} else {
+		g_unlink (name);
+		g_prefix_error (
+			error, _("Cannot append message to mh folder: %s: "), name);
+	}
+
+	g_free (name);
+	g_free (xev);
+
+	camel_local_folder_unlock (lf);
+
+	return success;
+}
+
 static CamelMimeMessage *
 mh_folder_get_message_sync (CamelFolder *folder,
                             const gchar *uid,
@@ -221,6 +294,7 @@ camel_mh_folder_class_init (CamelMhFolderClass *class)
 
 	local_folder_class = CAMEL_LOCAL_FOLDER_CLASS (class);
 	local_folder_class->create_summary = mh_folder_create_summary;
+	local_folder_class->append_raw = mh_folder_append_raw;
 }
 
 static void
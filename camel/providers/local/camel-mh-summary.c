@@ -50,9 +50,12 @@ static gint mh_summary_sync (CamelLocalSummary *cls, gboolean expunge, CamelFold
 /*static gint mh_summary_add(CamelLocalSummary *cls, CamelMimeMessage *msg, CamelMessageInfo *info, CamelFolderChangeInfo *, GError **error);*/
 
 static gchar *mh_summary_next_uid_string (CamelFolderSummary *s);
+static CamelMessageInfo *mh_summary_message_info_new_from_header (CamelFolderSummary *s, struct _camel_header_raw *h);
 
 struct _CamelMhSummaryPrivate {
 	gchar *current_uid;
+	/* whether the file being added has other hard links */
+	gboolean current_linked;
 };
 
 G_DEFINE_TYPE (CamelMhSummary, camel_mh_summary, CAMEL_TYPE_LOCAL_SUMMARY)
@@ -67,6 +70,7 @@ camel_mh_summary_class_init (CamelMhSummaryClass *class)
 
 	folder_summary_class = CAMEL_FOLDER_SUMMARY_CLASS (class);
 	folder_summary_class->next_uid_string = mh_summary_next_uid_string;
+	folder_summary_class->message_info_new_from_header = mh_summary_message_info_new_from_header;
 
 	local_summary_class = CAMEL_LOCAL_SUMMARY_CLASS (class);
 	local_summary_class->check = mh_summary_check;
@@ -148,6 +152,27 @@ mh_summary_next_uid_string (CamelFolderSummary *s)
 	return uidstr;
 }
 
+static CamelMessageInfo *
+mh_summary_message_info_new_from_header (CamelFolderSummary *s,
+                                         struct _camel_header_raw *h)
+{
+	CamelMhSummary *mhs = (CamelMhSummary *) s;
+	CamelMessageInfo *mi;
+
+	mi = CAMEL_FOLDER_SUMMARY_CLASS (camel_mh_summary_parent_class)->message_info_new_from_header (s, h);
+
+	/* a file shared with another folder, see mh_folder_append_raw(),
+	 * may carry that folder's uid in its X-Evolution header, so it
+	 * is named after its file here; others keep the header's uid */
+	if (mi && mhs->priv->current_uid && mhs->priv->current_linked
+	    && g_strcmp0 (camel_message_info_uid (mi), mhs->priv->current_uid) != 0) {
+		camel_pstring_free (mi->uid);
+		mi->uid = camel_pstring_strdup (mhs->priv->current_uid);
+	}
+
+	return mi;
+}
+
 static gint
 camel_mh_summary_add (CamelLocalSummary *cls,
                       const gchar *name,
@@ -158,6 +183,7 @@ camel_mh_summary_add (CamelLocalSummary *cls,
 	gchar *filename = g_strdup_printf ("%s/%s", cls->folder_path, name);
 	gint fd;
 	CamelMimeParser *mp;
+	struct stat st;
 
 	d (printf ("summarising: %s\n", name));
 
@@ -177,9 +203,11 @@ camel_mh_summary_add (CamelLocalSummary *cls,
 		camel_folder_summary_set_index ((CamelFolderSummary *) mhs, NULL);
 	}
 	mhs->priv->current_uid = (gchar *) name;
+	mhs->priv->current_linked = fstat (fd, &st) == 0 && st.st_nlink > 1;
 	camel_folder_summary_add_from_parser ((CamelFolderSummary *) mhs, mp);
 	g_object_unref (mp);
 	mhs->priv->current_uid = NULL;
+	mhs->priv->current_linked = FALSE;
 	camel_folder_summary_set_index ((CamelFolderSummary *) mhs, NULL);
 	g_free (filename);
 	return 0;
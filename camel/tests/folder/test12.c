@@ -0,0 +1,287 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* copying messages between local folders without parsing them */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "camel-test.h"
+#include "camel-test-provider.h"
+#include "folders.h"
+#include "messages.h"
+#include "session.h"
+
+static const gchar *local_drivers[] = {
+	"local"
+};
+
+/* these share message files with the source folder where they can */
+static const gchar *link_providers[] = {
+	"mh",
+	"maildir"
+};
+
+static CamelFolder *
+get_folder (CamelSession *session,
+            const gchar *provider,
+            const gchar *name)
+{
+	CamelService *service;
+	CamelFolder *folder;
+	GError *error = NULL;
+	gchar *path, *uid;
+
+	path = g_strdup_printf ("%s:///tmp/camel-test/%s", provider, provider);
+	uid = g_strdup_printf ("test-%s", provider);
+
+	service = camel_session_get_service (session, uid);
+	if (service == NULL)
+		service = camel_session_add_service (
+			session, uid, path, CAMEL_PROVIDER_STORE, &error);
+	check_msg (error == NULL, "adding store: %s", error ? error->message : "");
+	check (CAMEL_IS_STORE (service));
+
+	folder = camel_store_get_folder_sync (
+		CAMEL_STORE (service), name,
+		CAMEL_STORE_FOLDER_CREATE, NULL, &error);
+	check_msg (error == NULL, "getting folder: %s", error ? error->message : "");
+	check (folder != NULL);
+
+	g_free (path);
+	g_free (uid);
+
+	return folder;
+}
+
+/* a line mbox has to quote */
+static const gchar *simple_text = "From the start of a line\nand the rest.\n";
+
+static gchar *
+append_simple (CamelFolder *folder,
+               const gchar *subject)
+{
+	const gchar *text = simple_text;
+	CamelMimeMessage *msg;
+	GError *error = NULL;
+	gchar *uid = NULL;
+
+	msg = test_message_create_simple ();
+	camel_mime_message_set_subject (msg, subject);
+	test_message_set_content_simple (
+		(CamelMimePart *) msg, 0, "text/plain", text, strlen (text));
+
+	camel_folder_append_message_sync (
+		folder, msg, NULL, &uid, NULL, &error);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (uid != NULL);
+
+	check_unref (msg, 1);
+
+	return uid;
+}
+
+static GPtrArray *
+transfer (CamelFolder *source,
+          CamelFolder *dest,
+          GPtrArray *uids,
+          gboolean delete_originals)
+{
+	GPtrArray *transferred = NULL;
+	GError *error = NULL;
+
+	camel_folder_transfer_messages_to_sync (
+		source, uids, dest, delete_originals,
+		&transferred, NULL, &error);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (transferred != NULL && transferred->len == uids->len);
+
+	return transferred;
+}
+
+/* checks the subject and that the body comes back unquoted */
+static void
+check_message (CamelFolder *folder,
+               const gchar *uid,
+               const gchar *subject)
+{
+	CamelMimeMessage *msg;
+	GError *error = NULL;
+
+	msg = camel_folder_get_message_sync (folder, uid, NULL, &error);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (msg != NULL);
+	check_msg (
+		g_strcmp0 (camel_mime_message_get_subject (msg), subject) == 0,
+		"subject is '%s'", camel_mime_message_get_subject (msg));
+	test_message_compare_content (
+		camel_medium_get_content ((CamelMedium *) msg),
+		simple_text, strlen (simple_text));
+	check_unref (msg, 1);
+}
+
+/* checks whether the file behind @uid, or the mbox holding it,
+ * has the body's "From " line quoted */
+static void
+check_quoted (CamelFolder *folder,
+              const gchar *uid,
+              gboolean quoted)
+{
+	gchar *filename, *contents = NULL, *bang;
+	GError *error = NULL;
+
+	filename = camel_folder_get_filename (folder, uid, &error);
+	check_msg (error == NULL, "%s", error ? error->message : "");
+	check (filename != NULL);
+
+	/* mbox names its messages "path!offset" */
+	bang = strrchr (filename, '!');
+	if (bang != NULL)
+		*bang = '\0';
+
+	check (g_file_get_contents (filename, &contents, NULL, NULL));
+	check_msg (
+		(strstr (contents, "\n>From the start of a line\n") != NULL) == quoted,
+		"'From ' line %squoted in %s", quoted ? "not " : "", filename);
+	check ((strstr (contents, "\nFrom the start of a line\n") != NULL) == !quoted);
+
+	g_free (contents);
+	g_free (filename);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	CamelSession *session;
+	CamelFolder *source, *dest;
+	GPtrArray *uids, *transferred;
+	struct stat st_source, st_dest;
+	gchar *source_file, *dest_file, *name;
+	gint i;
+
+	camel_test_init (argc, argv);
+	camel_test_provider_init (1, local_drivers);
+
+	/* clear out any camel-test data */
+	system ("/bin/rm -rf /tmp/camel-test");
+
+	session = camel_test_session_new ("/tmp/camel-test");
+
+	for (i = 0; i < G_N_ELEMENTS (link_providers); i++) {
+		name = g_strdup_printf ("Sharing message files, %s", link_providers[i]);
+		camel_test_start (name);
+		g_free (name);
+
+		source = get_folder (session, link_providers[i], "source");
+		dest = get_folder (session, link_providers[i], "dest");
+
+		uids = g_ptr_array_new_with_free_func (g_free);
+		g_ptr_array_add (uids, append_simple (source, "Linked message"));
+
+		push ("copying a message");
+		transferred = transfer (source, dest, uids, FALSE);
+		test_folder_counts (source, 1, 1);
+		test_folder_counts (dest, 1, 1);
+		check_message (dest, transferred->pdata[0], "Linked message");
+		check_quoted (dest, transferred->pdata[0], FALSE);
+		pull ();
+
+		push ("checking the file is shared");
+		source_file = camel_folder_get_filename (source, uids->pdata[0], NULL);
+		dest_file = camel_folder_get_filename (dest, transferred->pdata[0], NULL);
+		check (source_file != NULL && dest_file != NULL);
+		check (g_stat (source_file, &st_source) == 0);
+		check (g_stat (dest_file, &st_dest) == 0);
+		check_msg (st_source.st_nlink == 2, "link count is %d", (gint) st_source.st_nlink);
+		check (st_source.st_ino == st_dest.st_ino);
+		g_free (source_file);
+		g_free (dest_file);
+		pull ();
+
+		g_ptr_array_foreach (transferred, (GFunc) g_free, NULL);
+		g_ptr_array_free (transferred, TRUE);
+		g_ptr_array_free (uids, TRUE);
+
+		push ("moving a message");
+		uids = g_ptr_array_new_with_free_func (g_free);
+		g_ptr_array_add (uids, append_simple (source, "Moved message"));
+		transferred = transfer (source, dest, uids, TRUE);
+		check (camel_folder_synchronize_sync (source, TRUE, NULL, NULL));
+		test_folder_counts (source, 1, 1);
+		test_folder_counts (dest, 2, 2);
+		check_message (dest, transferred->pdata[0], "Moved message");
+		dest_file = camel_folder_get_filename (dest, transferred->pdata[0], NULL);
+		check (dest_file != NULL);
+		check (g_stat (dest_file, &st_dest) == 0);
+		check_msg (st_dest.st_nlink == 1, "link count is %d", (gint) st_dest.st_nlink);
+		g_free (dest_file);
+		pull ();
+
+		g_ptr_array_foreach (transferred, (GFunc) g_free, NULL);
+		g_ptr_array_free (transferred, TRUE);
+		g_ptr_array_free (uids, TRUE);
+
+		check_unref (dest, 1);
+		check_unref (source, 1);
+
+		camel_test_end ();
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (link_providers); i++) {
+		name = g_strdup_printf ("Copying out of an mbox, %s", link_providers[i]);
+		camel_test_start (name);
+		g_free (name);
+
+		source = get_folder (session, "mbox", "source");
+		dest = get_folder (session, link_providers[i], "from-mbox");
+
+		if (i == 0) {
+			g_free (append_simple (source, "First mbox message"));
+			g_free (append_simple (source, "Second mbox message"));
+		}
+		uids = camel_folder_get_uids (source);
+		check (uids->len == 2);
+		camel_folder_sort_uids (source, uids);
+
+		push ("copying two messages");
+		check_quoted (source, uids->pdata[0], TRUE);
+		transferred = transfer (source, dest, uids, FALSE);
+		test_folder_counts (dest, 2, 2);
+		check_message (dest, transferred->pdata[0], "First mbox message");
+		check_message (dest, transferred->pdata[1], "Second mbox message");
+		check_quoted (dest, transferred->pdata[0], FALSE);
+		check_quoted (dest, transferred->pdata[1], FALSE);
+		pull ();
+
+		g_ptr_array_foreach (transferred, (GFunc) g_free, NULL);
+		g_ptr_array_free (transferred, TRUE);
+		camel_folder_free_uids (source, uids);
+
+		check_unref (dest, 1);
+		check_unref (source, 1);
+
+		camel_test_end ();
+	}
+
+	g_object_unref (session);
+
+	return 0;
+}
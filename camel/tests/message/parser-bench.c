@@ -0,0 +1,513 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+/* MIME parser benchmark.
+ *
+ * Generates a reproducible corpus of messages (nested multiparts, large
+ * base64 attachments, long folded headers, text in many charsets) and
+ * runs it through camel_mime_parser_step() and through
+ * camel_data_wrapper_construct_from_stream_sync(), checking the parsed
+ * structure against what was generated and reporting messages/s,
+ * bytes/s and allocations per message for each.
+ *
+ * CAMEL_BENCH_MESSAGES sets the corpus size (default 100),
+ * CAMEL_BENCH_SEED the random seed (default 42). */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camel-test.h"
+
+#define DEFAULT_MESSAGES (100)
+#define DEFAULT_SEED (42)
+
+extern gint camel_test_verbose;
+
+/* allocation counting; GSlice is switched to plain malloc in main()
+ * so that it goes through this vtable too */
+static volatile gint n_allocs;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+	g_atomic_int_inc (&n_allocs);
+	return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,
+                  gsize n_bytes)
+{
+	g_atomic_int_inc (&n_allocs);
+	return realloc (mem, n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks,
+                 gsize n_block_bytes)
+{
+	g_atomic_int_inc (&n_allocs);
+	return calloc (n_blocks, n_block_bytes);
+}
+
+static GMemVTable counting_vtable = {
+	counting_malloc,
+	counting_realloc,
+	free,
+	counting_calloc,
+	counting_malloc,
+	counting_realloc
+};
+
+static struct {
+	const gchar *charset;
+	const gchar *encoding;
+	const gchar *text;	/* UTF-8 */
+} samples[] = {
+	{ "us-ascii", "7bit", "The quick brown fox jumps over the lazy dog." },
+	{ "iso-8859-1", "quoted-printable", "Gr\xc3\xbc\xc3\x9f" "e aus K\xc3\xb6ln, caf\xc3\xa9 cr\xc3\xa8me br\xc3\xbbl\xc3\xa9" "e." },
+	{ "iso-8859-2", "8bit", "Za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87 g\xc4\x99\xc5\x9bl\xc4\x85 ja\xc5\xba\xc5\x84." },
+	{ "iso-8859-7", "quoted-printable", "\xce\x9a\xce\xb1\xce\xbb\xce\xb7\xce\xbc\xce\xad\xcf\x81\xce\xb1 \xce\xba\xcf\x8c\xcf\x83\xce\xbc\xce\xb5." },
+	{ "koi8-r", "8bit", "\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 \xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 \xd0\xb1\xd1\x83\xd0\xbb\xd0\xbe\xd0\xba." },
+	{ "windows-1251", "base64", "\xd0\xa1\xd1\x8a\xd0\xb5\xd1\x88\xd1\x8c \xd0\xb6\xd0\xb5 \xd0\xb5\xd1\x89\xd1\x91 \xd1\x8d\xd1\x82\xd0\xb8\xd1\x85 \xd0\xbc\xd1\x8f\xd0\xb3\xd0\xba\xd0\xb8\xd1\x85 \xd0\xb1\xd1\x83\xd0\xbb\xd0\xbe\xd0\xba." },
+	{ "iso-2022-jp", "7bit", "\xe3\x81\x84\xe3\x82\x8d\xe3\x81\xaf\xe3\x81\xab\xe3\x81\xbb\xe3\x81\xb8\xe3\x81\xa8 \xe3\x81\xa1\xe3\x82\x8a\xe3\x81\xac\xe3\x82\x8b\xe3\x82\x92" },
+	{ "euc-jp", "8bit", "\xe3\x81\x84\xe3\x82\x8d\xe3\x81\xaf\xe3\x81\xab\xe3\x81\xbb\xe3\x81\xb8\xe3\x81\xa8 \xe3\x81\xa1\xe3\x82\x8a\xe3\x81\xac\xe3\x82\x8b\xe3\x82\x92" },
+	{ "shift_jis", "base64", "\xe3\x81\x84\xe3\x82\x8d\xe3\x81\xaf\xe3\x81\xab\xe3\x81\xbb\xe3\x81\xb8\xe3\x81\xa8 \xe3\x81\xa1\xe3\x82\x8a\xe3\x81\xac\xe3\x82\x8b\xe3\x82\x92" },
+	{ "gb2312", "base64", "\xe6\x88\x91\xe8\x83\xbd\xe5\x90\x9e\xe4\xb8\x8b\xe7\x8e\xbb\xe7\x92\x83\xe8\x80\x8c\xe4\xb8\x8d\xe4\xbc\xa4\xe8\xba\xab\xe4\xbd\x93" },
+	{ "big5", "8bit", "\xe6\x88\x91\xe8\x83\xbd\xe5\x90\x9e\xe4\xb8\x8b\xe7\x8e\xbb\xe7\x92\x83\xe8\x80\x8c\xe4\xb8\x8d\xe5\x82\xb7\xe8\xba\xab\xe9\xab\x94" },
+	{ "euc-kr", "base64", "\xeb\x8b\xa4\xeb\x9e\x8c\xec\xa5\x90 \xed\x97\x8c \xec\xb3\x87\xeb\xb0\x94\xed\x80\xb4\xec\x97\x90 \xed\x83\x80\xea\xb3\xa0\xed\x8c\x8c" },
+	{ "utf-8", "quoted-printable", "Gr\xc3\xbc\xc3\x9f" "e, \xd0\xbf\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xe3\x81\x93\xe3\x82\x93\xe3\x81\xab\xe3\x81\xa1\xe3\x81\xaf, \xe4\xbd\xa0\xe5\xa5\xbd." }
+};
+
+typedef struct {
+	GString *data;
+	gint n_parts;	/* MIME entities, top-level message included */
+} Message;
+
+static gchar *
+convert_sample (gint sample,
+                gsize *len)
+{
+	gchar *text;
+
+	text = g_convert (samples[sample].text, -1, samples[sample].charset, "UTF-8", NULL, len, NULL);
+	if (text == NULL) {
+		/* not supported by the local iconv, fall back to UTF-8 */
+		text = g_strdup (samples[sample].text);
+		*len = strlen (text);
+	}
+
+	return text;
+}
+
+static void
+append_base64 (GString *out,
+               const guchar *data,
+               gsize len)
+{
+	gchar *encoded;
+	gsize i, n;
+
+	encoded = g_base64_encode (data, len);
+	n = strlen (encoded);
+
+	for (i = 0; i < n; i += 76) {
+		g_string_append_len (out, encoded + i, MIN (76, n - i));
+		g_string_append_c (out, '\n');
+	}
+
+	g_free (encoded);
+}
+
+static void
+append_encoded_word (GString *out,
+                     GRand *rand)
+{
+	gint sample = g_rand_int_range (rand, 0, G_N_ELEMENTS (samples));
+	gchar *text, *encoded;
+	gsize len;
+
+	text = convert_sample (sample, &len);
+	encoded = g_base64_encode ((guchar *) text, len);
+	g_string_append_printf (out, "=?%s?B?%s?=", samples[sample].charset, encoded);
+	g_free (encoded);
+	g_free (text);
+}
+
+static void
+append_headers (GString *out,
+                GRand *rand,
+                gint index)
+{
+	gint i, n;
+
+	n = g_rand_int_range (rand, 2, 12);
+	for (i = 0; i < n; i++)
+		g_string_append_printf (
+			out, "Received: from relay%d.example.org (relay%d.example.org [10.0.%d.%d])\n"
+			"\tby mx.example.com with ESMTP id %08x;\n"
+			"\tMon, 7 Jan 2013 10:%02d:%02d +0100\n",
+			i, i, i, index % 256, g_rand_int (rand), i % 60, index % 60);
+
+	g_string_append (out, "From: ");
+	append_encoded_word (out, rand);
+	g_string_append_printf (out, " <sender%d@example.com>\n", index);
+
+	/* a long, folded recipient list */
+	g_string_append (out, "To: ");
+	n = g_rand_int_range (rand, 1, 60);
+	for (i = 0; i < n; i++)
+		g_string_append_printf (
+			out, "%s\"Recipient %d\" <user%d@lists.example.com>",
+			i ? ",\n\t" : "", i, i);
+	g_string_append_c (out, '\n');
+
+	g_string_append (out, "Subject: Re: ");
+	append_encoded_word (out, rand);
+	g_string_append_c (out, ' ');
+	append_encoded_word (out, rand);
+	g_string_append_printf (out, " #%d\n", index);
+
+	g_string_append_printf (out, "Message-ID: <%d.%08x@example.com>\n", index, g_rand_int (rand));
+
+	g_string_append (out, "References:");
+	n = g_rand_int_range (rand, 0, 40);
+	for (i = 0; i < n; i++)
+		g_string_append_printf (out, "\n <%d.%d.%08x@example.com>", index, i, g_rand_int (rand));
+	g_string_append_c (out, '\n');
+
+	g_string_append (out, "Date: Mon, 7 Jan 2013 10:00:00 +0100\nMIME-Version: 1.0\n");
+}
+
+static gint
+append_text_part (GString *out,
+                  GRand *rand,
+                  const gchar *subtype)
+{
+	gint sample = g_rand_int_range (rand, 0, G_N_ELEMENTS (samples));
+	const gchar *encoding = samples[sample].encoding;
+	GString *body;
+	gchar *text;
+	gsize len;
+	gint i, n;
+
+	text = convert_sample (sample, &len);
+
+	body = g_string_new ("");
+	n = g_rand_int_range (rand, 5, 400);
+	for (i = 0; i < n; i++) {
+		g_string_append_len (body, text, len);
+		g_string_append_c (body, '\n');
+	}
+
+	g_string_append_printf (
+		out, "Content-Type: text/%s; charset=%s\n"
+		"Content-Transfer-Encoding: %s\n\n",
+		subtype, samples[sample].charset, encoding);
+
+	if (!strcmp (encoding, "base64")) {
+		append_base64 (out, (guchar *) body->str, body->len);
+	} else if (!strcmp (encoding, "quoted-printable")) {
+		guchar *encoded;
+		gint state = -1, save = 0;
+
+		encoded = g_malloc (body->len * 4 + 4);
+		len = camel_quoted_encode_close ((guchar *) body->str, body->len, encoded, &state, &save);
+		g_string_append_len (out, (gchar *) encoded, len);
+		g_string_append_c (out, '\n');
+		g_free (encoded);
+	} else {
+		g_string_append_len (out, body->str, body->len);
+	}
+
+	g_string_free (body, TRUE);
+	g_free (text);
+
+	return 1;
+}
+
+static gint
+append_attachment (GString *out,
+                   GRand *rand,
+                   gint index)
+{
+	guchar *data;
+	gsize len, i;
+
+	/* mostly small, now and then a big one */
+	if (g_rand_int_range (rand, 0, 10) == 0)
+		len = g_rand_int_range (rand, 512 * 1024, 4 * 1024 * 1024);
+	else
+		len = g_rand_int_range (rand, 1024, 64 * 1024);
+
+	data = g_malloc (len);
+	for (i = 0; i < len; i++)
+		data[i] = g_rand_int (rand) & 0xff;
+
+	g_string_append_printf (
+		out, "Content-Type: application/octet-stream; name=\"attachment-%d.bin\"\n"
+		"Content-Disposition: attachment;\n\tfilename=\"attachment-%d.bin\"\n"
+		"Content-Transfer-Encoding: base64\n\n", index, index);
+	append_base64 (out, data, len);
+
+	g_free (data);
+
+	return 1;
+}
+
+static gint append_entity (GString *out, GRand *rand, gint depth, gint index);
+
+static gint
+append_multipart (GString *out,
+                  GRand *rand,
+                  gint depth,
+                  gint index)
+{
+	static const gchar *subtypes[] = { "mixed", "alternative", "related" };
+	const gchar *subtype = subtypes[g_rand_int_range (rand, 0, G_N_ELEMENTS (subtypes))];
+	gchar *boundary;
+	gint i, n, count = 1;
+
+	boundary = g_strdup_printf ("=-bench-%d-%d-%08x", index, depth, g_rand_int (rand));
+
+	g_string_append_printf (
+		out, "Content-Type: multipart/%s;\n\tboundary=\"%s\"\n\n"
+		"This is a multi-part message in MIME format.\n",
+		subtype, boundary);
+
+	n = g_rand_int_range (rand, 2, 6);
+	for (i = 0; i < n; i++) {
+		g_string_append_printf (out, "\n--%s\n", boundary);
+		if (!strcmp (subtype, "alternative"))
+			count += append_text_part (out, rand, i ? "html" : "plain");
+		else
+			count += append_entity (out, rand, depth + 1, index);
+	}
+
+	g_string_append_printf (out, "\n--%s--\n", boundary);
+	g_free (boundary);
+
+	return count;
+}
+
+static gint
+append_entity (GString *out,
+               GRand *rand,
+               gint depth,
+               gint index)
+{
+	gint kind = g_rand_int_range (rand, 0, 8);
+
+	if (depth < 3 && kind < 3)
+		return append_multipart (out, rand, depth, index);
+
+	if (depth < 3 && kind == 3) {
+		g_string_append (out, "Content-Type: message/rfc822\n\n");
+		append_headers (out, rand, index);
+		return 1 + append_entity (out, rand, depth + 1, index);
+	}
+
+	if (kind < 6)
+		return append_text_part (out, rand, "plain");
+
+	return append_attachment (out, rand, index);
+}
+
+static Message *
+generate_corpus (gint n_messages,
+                 guint32 seed,
+                 gsize *total)
+{
+	Message *corpus;
+	GRand *rand;
+	gint i;
+
+	rand = g_rand_new_with_seed (seed);
+	corpus = g_new0 (Message, n_messages);
+	*total = 0;
+
+	for (i = 0; i < n_messages; i++) {
+		corpus[i].data = g_string_new ("");
+		append_headers (corpus[i].data, rand, i);
+		corpus[i].n_parts = append_entity (corpus[i].data, rand, 0, i);
+		*total += corpus[i].data->len;
+	}
+
+	g_rand_free (rand);
+
+	return corpus;
+}
+
+static gint
+count_parts (CamelMimePart *part)
+{
+	CamelDataWrapper *content;
+	gint i, n, count = 1;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (part));
+
+	if (CAMEL_IS_MULTIPART (content)) {
+		n = camel_multipart_get_number (CAMEL_MULTIPART (content));
+		for (i = 0; i < n; i++)
+			count += count_parts (camel_multipart_get_part (CAMEL_MULTIPART (content), i));
+	} else if (CAMEL_IS_MIME_MESSAGE (content)) {
+		count += count_parts (CAMEL_MIME_PART (content));
+	}
+
+	return count;
+}
+
+static void
+report (const gchar *what,
+        gint n_messages,
+        gsize total,
+        gint64 elapsed,
+        gint allocs)
+{
+	gdouble secs = MAX (elapsed, 1) / (gdouble) G_USEC_PER_SEC;
+
+	if (camel_test_verbose == 0)
+		return;
+
+	printf (
+		"%-12s %6d msgs %8.3f s %10.1f msgs/s %8.2f MB/s",
+		what, n_messages, secs, n_messages / secs,
+		total / secs / (1024.0 * 1024.0));
+
+	/* newer GLib ignores g_mem_set_vtable () */
+	if (g_mem_is_system_malloc ())
+		printf ("       n/a allocs/msg\n");
+	else
+		printf (" %10.1f allocs/msg\n", (gdouble) allocs / n_messages);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	gint n_messages = DEFAULT_MESSAGES;
+	guint32 seed = DEFAULT_SEED;
+	gint i, allocs, count;
+	gint64 start, elapsed;
+	Message *corpus;
+	gsize total;
+
+	/* must happen before anything allocates */
+	setenv ("G_SLICE", "always-malloc", TRUE);
+	g_mem_set_vtable (&counting_vtable);
+
+	if (getenv ("CAMEL_BENCH_MESSAGES"))
+		n_messages = MAX (1, atoi (getenv ("CAMEL_BENCH_MESSAGES")));
+	if (getenv ("CAMEL_BENCH_SEED"))
+		seed = strtoul (getenv ("CAMEL_BENCH_SEED"), NULL, 10);
+
+	camel_test_init (argc, argv);
+
+	corpus = generate_corpus (n_messages, seed, &total);
+
+	camel_test_start ("MIME parser step");
+
+	allocs = 0;
+	elapsed = 0;
+	for (i = 0; i < n_messages; i++) {
+		CamelMimeParser *parser;
+		CamelStream *stream;
+		gchar *data;
+		gsize len;
+		gint state;
+
+		push ("parsing message %d", i);
+
+		stream = camel_stream_mem_new_with_buffer (corpus[i].data->str, corpus[i].data->len);
+
+		g_atomic_int_set (&n_allocs, 0);
+		start = g_get_monotonic_time ();
+
+		parser = camel_mime_parser_new ();
+		camel_mime_parser_init_with_stream (parser, stream, NULL);
+
+		count = 0;
+		while ((state = camel_mime_parser_step (parser, &data, &len)) != CAMEL_MIME_PARSER_STATE_EOF) {
+			if (state == CAMEL_MIME_PARSER_STATE_HEADER ||
+			    state == CAMEL_MIME_PARSER_STATE_MULTIPART ||
+			    state == CAMEL_MIME_PARSER_STATE_MESSAGE)
+				count++;
+		}
+
+		g_object_unref (parser);
+
+		elapsed += g_get_monotonic_time () - start;
+		allocs += g_atomic_int_get (&n_allocs);
+
+		g_object_unref (stream);
+
+		check_msg (count == corpus[i].n_parts, "parts = %d, expected %d", count, corpus[i].n_parts);
+
+		pull ();
+	}
+
+	report ("parser step", n_messages, total, elapsed, allocs);
+
+	camel_test_end ();
+
+	camel_test_start ("MIME message construction");
+
+	allocs = 0;
+	elapsed = 0;
+	for (i = 0; i < n_messages; i++) {
+		CamelMimeMessage *message;
+		CamelStream *stream;
+
+		push ("constructing message %d", i);
+
+		stream = camel_stream_mem_new_with_buffer (corpus[i].data->str, corpus[i].data->len);
+
+		g_atomic_int_set (&n_allocs, 0);
+		start = g_get_monotonic_time ();
+
+		message = camel_mime_message_new ();
+		check (camel_data_wrapper_construct_from_stream_sync (
+			CAMEL_DATA_WRAPPER (message), stream, NULL, NULL));
+
+		elapsed += g_get_monotonic_time () - start;
+		allocs += g_atomic_int_get (&n_allocs);
+
+		count = count_parts (CAMEL_MIME_PART (message));
+		check_msg (count == corpus[i].n_parts, "parts = %d, expected %d", count, corpus[i].n_parts);
+
+		g_object_unref (message);
+		g_object_unref (stream);
+
+		pull ();
+	}
+
+	report ("construct", n_messages, total, elapsed, allocs);
+
+	camel_test_end ();
+
+	for (i = 0; i < n_messages; i++)
+		g_string_free (corpus[i].data, TRUE);
+	g_free (corpus);
+
+	return 0;
+}
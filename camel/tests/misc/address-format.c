@@ -0,0 +1,95 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "camel-test.h"
+
+/* camel_header_address_list_format_append() must give exactly what the
+ * camel_header_address tree gives, whether or not it takes its fast path */
+static const gchar *addresses[] = {
+	"fred@example.com",
+	"Fred Flintstone <fred@example.com>",
+	"\"Flintstone, Fred\" <fred@example.com>, barney@example.com",
+	"<fred@example.com>",
+	"\"\" <fred@example.com>",
+	"fred . flintstone @ example . com",
+	"\"fred flintstone\"@example.com",
+	"=?iso-8859-1?q?Fr=E9d?= =?iso-8859-1?q?_Flintstone?= <fred@example.com>",
+	"=?utf-8?b?RnLDqWQ=?= Flintstone <fred@example.com>",
+	"fred@example.com, , barney@example.com,",
+	"Fred (the caveman) <fred@example.com>",
+	"fred@example.com (Fred Flintstone)",
+	"Flintstones: fred@example.com, wilma@example.com;",
+	"Fred \"The\" Flintstone <fred@example.com>",
+	"Fred Q. Flintstone <fred@example.com>",
+	"\"Fred \\\"The\\\" Flintstone\" <fred@example.com>",
+	"<@route.example.com:fred@example.com>",
+	"fred",
+	"fred@[127.0.0.1]",
+	"Fred Flintstone fred@example.com",
+	""
+};
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	struct _camel_header_address *addr;
+	GString *out;
+	gchar *expected;
+	gboolean found;
+	gint i;
+
+	camel_test_init (argc, argv);
+
+	camel_test_start ("address list formatting");
+
+	out = g_string_new ("");
+
+	for (i = 0; i < G_N_ELEMENTS (addresses); i++) {
+		camel_test_push ("address list formatting[%d] '%s'", i, addresses[i]);
+
+		addr = camel_header_address_decode (addresses[i], "iso-8859-1");
+		expected = camel_header_address_list_format (addr);
+		camel_header_address_list_clear (&addr);
+
+		g_string_assign (out, "prefix");
+		found = camel_header_address_list_format_append (out, addresses[i], "iso-8859-1");
+
+		check_msg (found == (expected != NULL), "found = %d", found);
+		check_msg (
+			strncmp (out->str, "prefix", 6) == 0 &&
+			strcmp (out->str + 6, expected ? expected : "") == 0,
+			"got '%s', expected '%s'", out->str + 6, expected);
+
+		g_free (expected);
+		camel_test_pull ();
+	}
+
+	g_string_free (out, TRUE);
+
+	camel_test_end ();
+
+	return 0;
+}